@@ -18,6 +18,7 @@
 #include <oc_config.h>
 #ifdef OC_BLOCK_WISE
 #include "oc_blockwise.h"
+#include "messaging/coap/coap_index.h"
 #include "oc_endpoint.h"
 #include "port/oc_log.h"
 #include "util/oc_list.h"
@@ -38,10 +39,78 @@ typedef struct oc_app_data_buffer_t
 OC_MEMB_STATIC(oc_app_data_s, oc_app_data_buffer_t, OC_APP_DATA_BUFFER_POOL);
 #endif /* OC_APP_DATA_BUFFER_POOL */
 
+#ifdef OC_CLIENT
+#define BLOCKWISE_KIND(buffer, request_kind, response_kind)                    \
+  ((buffer)->is_response ? (response_kind) : (request_kind))
+#define BLOCKWISE_MID_KIND(buffer)                                             \
+  BLOCKWISE_KIND(buffer, COAP_INDEX_BLOCKWISE_REQUEST_MID,                     \
+                 COAP_INDEX_BLOCKWISE_RESPONSE_MID)
+#define BLOCKWISE_TOKEN_KIND(buffer)                                           \
+  BLOCKWISE_KIND(buffer, COAP_INDEX_BLOCKWISE_REQUEST_TOKEN,                   \
+                 COAP_INDEX_BLOCKWISE_RESPONSE_TOKEN)
+#define BLOCKWISE_CLIENT_CB_KIND(buffer)                                       \
+  BLOCKWISE_KIND(buffer, COAP_INDEX_BLOCKWISE_REQUEST_CLIENT_CB,               \
+                 COAP_INDEX_BLOCKWISE_RESPONSE_CLIENT_CB)
+
+/* the mid is always indexed, the token and client callback once set */
+static void
+oc_blockwise_index_remove(oc_blockwise_state_t *buffer)
+{
+  coap_index_remove_mid(BLOCKWISE_MID_KIND(buffer), buffer->mid, buffer);
+  if (buffer->token_len > 0) {
+    coap_index_remove(BLOCKWISE_TOKEN_KIND(buffer), buffer->token,
+                      buffer->token_len, buffer);
+  }
+  if (buffer->client_cb != NULL) {
+    coap_index_remove_ptr(BLOCKWISE_CLIENT_CB_KIND(buffer), buffer->client_cb,
+                          buffer);
+  }
+}
+
+void
+oc_blockwise_set_mid(oc_blockwise_state_t *buffer, uint16_t mid)
+{
+  coap_index_remove_mid(BLOCKWISE_MID_KIND(buffer), buffer->mid, buffer);
+  buffer->mid = mid;
+  coap_index_add_mid(BLOCKWISE_MID_KIND(buffer), buffer->mid, buffer);
+}
+
+void
+oc_blockwise_set_token(oc_blockwise_state_t *buffer, const uint8_t *token,
+                       uint8_t token_len)
+{
+  if (buffer->token_len > 0) {
+    coap_index_remove(BLOCKWISE_TOKEN_KIND(buffer), buffer->token,
+                      buffer->token_len, buffer);
+  }
+  memcpy(buffer->token, token, token_len);
+  buffer->token_len = token_len;
+  if (buffer->token_len > 0) {
+    coap_index_add(BLOCKWISE_TOKEN_KIND(buffer), buffer->token,
+                   buffer->token_len, buffer);
+  }
+}
+
+void
+oc_blockwise_set_client_cb(oc_blockwise_state_t *buffer, void *client_cb)
+{
+  if (buffer->client_cb != NULL) {
+    coap_index_remove_ptr(BLOCKWISE_CLIENT_CB_KIND(buffer), buffer->client_cb,
+                          buffer);
+  }
+  buffer->client_cb = client_cb;
+  if (buffer->client_cb != NULL) {
+    coap_index_add_ptr(BLOCKWISE_CLIENT_CB_KIND(buffer), buffer->client_cb,
+                       buffer);
+  }
+}
+#endif /* OC_CLIENT */
+
 static oc_blockwise_state_t *
 oc_blockwise_init_buffer(struct oc_memb *pool, const char *href,
                          size_t href_len, oc_endpoint_t *endpoint,
-                         oc_method_t method, oc_blockwise_role_t role)
+                         oc_method_t method, oc_blockwise_role_t role,
+                         bool stream)
 {
   if (href_len == 0)
     return NULL;
@@ -49,22 +118,27 @@ oc_blockwise_init_buffer(struct oc_memb *pool, const char *href,
   oc_blockwise_state_t *buffer = (oc_blockwise_state_t *)oc_memb_alloc(pool);
   if (buffer) {
 #ifdef OC_DYNAMIC_ALLOCATION
+    /* streamed transfers are not reassembled */
+    if (!stream) {
 #ifdef OC_APP_DATA_BUFFER_POOL
-    oc_app_data_buffer_t *app_buffer =
-      (oc_app_data_buffer_t *)oc_memb_alloc(&oc_app_data_s);
-    if (app_buffer) {
-      buffer->block = app_buffer;
-      buffer->buffer = app_buffer->buffer;
-    }
+      oc_app_data_buffer_t *app_buffer =
+        (oc_app_data_buffer_t *)oc_memb_alloc(&oc_app_data_s);
+      if (app_buffer) {
+        buffer->block = app_buffer;
+        buffer->buffer = app_buffer->buffer;
+      }
 #endif /* OC_APP_DATA_BUFFER_POOL */
-    if (!buffer->buffer) {
-      buffer->buffer = (uint8_t *)malloc(OC_MAX_APP_DATA_SIZE);
-    }
-    if (!buffer->buffer) {
-      oc_memb_free(pool, buffer);
-      return NULL;
+      if (!buffer->buffer) {
+        buffer->buffer = (uint8_t *)malloc(OC_MAX_APP_DATA_SIZE);
+      }
+      if (!buffer->buffer) {
+        oc_memb_free(pool, buffer);
+        return NULL;
+      }
     }
-#endif /* OC_DYNAMIC_ALLOCATION */
+#else  /* OC_DYNAMIC_ALLOCATION */
+    (void)stream;
+#endif /* !OC_DYNAMIC_ALLOCATION */
     buffer->next_block_offset = 0;
     buffer->payload_size = 0;
     buffer->ref_count = 1;
@@ -77,6 +151,8 @@ oc_blockwise_init_buffer(struct oc_memb *pool, const char *href,
 #ifdef OC_CLIENT
     buffer->mid = 0;
     buffer->client_cb = NULL;
+    buffer->is_response = (pool == &oc_blockwise_response_states_s);
+    coap_index_add_mid(BLOCKWISE_MID_KIND(buffer), buffer->mid, buffer);
 #endif /* OC_CLIENT */
     return buffer;
   }
@@ -94,6 +170,9 @@ oc_blockwise_free_buffer(oc_list_t list, struct oc_memb *pool,
     return;
   }
 
+#ifdef OC_CLIENT
+  oc_blockwise_index_remove(buffer);
+#endif /* OC_CLIENT */
   oc_free_string(&buffer->uri_query);
   oc_free_string(&buffer->href);
   oc_list_remove(list, buffer);
@@ -128,14 +207,15 @@ oc_blockwise_response_timeout(void *data)
   return OC_EVENT_DONE;
 }
 
-oc_blockwise_state_t *
-oc_blockwise_alloc_request_buffer(const char *href, size_t href_len,
-                                  oc_endpoint_t *endpoint, oc_method_t method,
-                                  oc_blockwise_role_t role)
+static oc_blockwise_state_t *
+oc_blockwise_alloc_request(const char *href, size_t href_len,
+                           oc_endpoint_t *endpoint, oc_method_t method,
+                           oc_blockwise_role_t role, bool stream)
 {
   oc_blockwise_request_state_t *buffer =
     (oc_blockwise_request_state_t *)oc_blockwise_init_buffer(
-      &oc_blockwise_request_states_s, href, href_len, endpoint, method, role);
+      &oc_blockwise_request_states_s, href, href_len, endpoint, method, role,
+      stream);
   if (buffer) {
     oc_ri_add_timed_event_callback_seconds(buffer, oc_blockwise_request_timeout,
                                            OC_EXCHANGE_LIFETIME);
@@ -144,6 +224,23 @@ oc_blockwise_alloc_request_buffer(const char *href, size_t href_len,
   return (oc_blockwise_state_t *)buffer;
 }
 
+oc_blockwise_state_t *
+oc_blockwise_alloc_request_buffer(const char *href, size_t href_len,
+                                  oc_endpoint_t *endpoint, oc_method_t method,
+                                  oc_blockwise_role_t role)
+{
+  return oc_blockwise_alloc_request(href, href_len, endpoint, method, role,
+                                    false);
+}
+
+oc_blockwise_state_t *
+oc_blockwise_alloc_request_stream(const char *href, size_t href_len,
+                                  oc_endpoint_t *endpoint, oc_method_t method)
+{
+  return oc_blockwise_alloc_request(href, href_len, endpoint, method,
+                                    OC_BLOCKWISE_SERVER, true);
+}
+
 oc_blockwise_state_t *
 oc_blockwise_alloc_response_buffer(const char *href, size_t href_len,
                                    oc_endpoint_t *endpoint, oc_method_t method,
@@ -151,7 +248,8 @@ oc_blockwise_alloc_response_buffer(const char *href, size_t href_len,
 {
   oc_blockwise_response_state_t *buffer =
     (oc_blockwise_response_state_t *)oc_blockwise_init_buffer(
-      &oc_blockwise_response_states_s, href, href_len, endpoint, method, role);
+      &oc_blockwise_response_states_s, href, href_len, endpoint, method, role,
+      false);
   if (buffer) {
     int i = COAP_ETAG_LEN;
     uint32_t r = oc_random_value();
@@ -188,6 +286,20 @@ oc_blockwise_free_response_buffer(oc_blockwise_state_t *buffer)
 void
 oc_blockwise_scrub_buffers_for_client_cb(void *cb)
 {
+  if (coap_index_is_complete()) {
+    oc_blockwise_state_t *buffer;
+    while ((buffer = coap_index_find(COAP_INDEX_BLOCKWISE_REQUEST_CLIENT_CB,
+                                     &cb, sizeof(void *), NULL, NULL)) !=
+           NULL) {
+      oc_blockwise_free_request_buffer(buffer);
+    }
+    while ((buffer = coap_index_find(COAP_INDEX_BLOCKWISE_RESPONSE_CLIENT_CB,
+                                     &cb, sizeof(void *), NULL, NULL)) !=
+           NULL) {
+      oc_blockwise_free_response_buffer(buffer);
+    }
+    return;
+  }
   oc_blockwise_state_t *buffer = oc_list_head(oc_blockwise_requests), *next;
   while (buffer != NULL) {
     next = buffer->next;
@@ -231,10 +343,27 @@ oc_blockwise_scrub_buffers(bool all)
 }
 
 #ifdef OC_CLIENT
+static bool
+oc_blockwise_is_client(const void *obj, const void *ctx)
+{
+  (void)ctx;
+  return ((const oc_blockwise_state_t *)obj)->role == OC_BLOCKWISE_CLIENT;
+}
+
 static oc_blockwise_state_t *
 oc_blockwise_find_buffer_by_token(oc_list_t list, uint8_t *token,
                                   uint8_t token_len)
 {
+  if (coap_index_is_complete()) {
+    if (token_len == 0) {
+      return NULL;
+    }
+    coap_index_kind_t kind = (list == oc_blockwise_responses)
+                               ? COAP_INDEX_BLOCKWISE_RESPONSE_TOKEN
+                               : COAP_INDEX_BLOCKWISE_REQUEST_TOKEN;
+    return coap_index_find(kind, token, token_len, oc_blockwise_is_client,
+                           NULL);
+  }
   oc_blockwise_state_t *buffer = oc_list_head(list);
   while (buffer) {
     if (token_len > 0 && buffer->role == OC_BLOCKWISE_CLIENT &&
@@ -263,6 +392,13 @@ oc_blockwise_find_response_buffer_by_token(uint8_t *token, uint8_t token_len)
 static oc_blockwise_state_t *
 oc_blockwise_find_buffer_by_mid(oc_list_t list, uint16_t mid)
 {
+  if (coap_index_is_complete()) {
+    coap_index_kind_t kind = (list == oc_blockwise_responses)
+                               ? COAP_INDEX_BLOCKWISE_RESPONSE_MID
+                               : COAP_INDEX_BLOCKWISE_REQUEST_MID;
+    return coap_index_find(kind, &mid, sizeof(mid), oc_blockwise_is_client,
+                           NULL);
+  }
   oc_blockwise_state_t *buffer = oc_list_head(list);
   while (buffer) {
     if (buffer->mid == mid && buffer->role == OC_BLOCKWISE_CLIENT)
@@ -284,10 +420,26 @@ oc_blockwise_find_response_buffer_by_mid(uint16_t mid)
   return oc_blockwise_find_buffer_by_mid(oc_blockwise_responses, mid);
 }
 
+static bool
+oc_blockwise_is_client_for_endpoint(const void *obj, const void *ctx)
+{
+  const oc_blockwise_state_t *buffer = (const oc_blockwise_state_t *)obj;
+  return buffer->role == OC_BLOCKWISE_CLIENT &&
+         oc_endpoint_compare((const oc_endpoint_t *)ctx, &buffer->endpoint) ==
+           0;
+}
+
 static oc_blockwise_state_t *
 oc_blockwise_find_buffer_by_client_cb(oc_list_t list, oc_endpoint_t *endpoint,
                                       void *client_cb)
 {
+  if (coap_index_is_complete()) {
+    coap_index_kind_t kind = (list == oc_blockwise_responses)
+                               ? COAP_INDEX_BLOCKWISE_RESPONSE_CLIENT_CB
+                               : COAP_INDEX_BLOCKWISE_REQUEST_CLIENT_CB;
+    return coap_index_find(kind, &client_cb, sizeof(void *),
+                           oc_blockwise_is_client_for_endpoint, endpoint);
+  }
   oc_blockwise_state_t *buffer = oc_list_head(list);
   while (buffer) {
     if (buffer->role == OC_BLOCKWISE_CLIENT && buffer->client_cb == client_cb &&
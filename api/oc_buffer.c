@@ -18,9 +18,11 @@
 #include "messaging/coap/engine.h"
 #include "oc_signal_event_loop.h"
 #include "port/oc_network_events_mutex.h"
+#include "util/oc_list.h"
 #include "util/oc_memb.h"
 #include "messaging/coap/coap.h"
 #include "api/oc_replay.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #ifdef OC_DYNAMIC_ALLOCATION
@@ -46,14 +48,166 @@ OC_MEMB(oc_incoming_buffers, oc_message_t, OC_MAX_NUM_CONCURRENT_REQUESTS);
 OC_MEMB(oc_outgoing_buffers, oc_message_t, OC_MAX_NUM_CONCURRENT_REQUESTS);
 #endif /* !OC_INOUT_BUFFER_POOL */
 
+#ifdef OC_MESSAGE_SIZE_CLASSES
+#ifndef OC_MESSAGE_SMALL_SIZE
+#define OC_MESSAGE_SMALL_SIZE (128)
+#endif /* OC_MESSAGE_SMALL_SIZE */
+#ifndef OC_MESSAGE_MEDIUM_SIZE
+#define OC_MESSAGE_MEDIUM_SIZE (512)
+#endif /* OC_MESSAGE_MEDIUM_SIZE */
+#ifndef OC_MESSAGE_MTU_SIZE
+#define OC_MESSAGE_MTU_SIZE (1280)
+#endif /* OC_MESSAGE_MTU_SIZE */
+#ifndef OC_MESSAGE_SMALL_BUFFERS
+#define OC_MESSAGE_SMALL_BUFFERS (8)
+#endif /* OC_MESSAGE_SMALL_BUFFERS */
+#ifndef OC_MESSAGE_MEDIUM_BUFFERS
+#define OC_MESSAGE_MEDIUM_BUFFERS (4)
+#endif /* OC_MESSAGE_MEDIUM_BUFFERS */
+#ifndef OC_MESSAGE_MTU_BUFFERS
+#define OC_MESSAGE_MTU_BUFFERS (2)
+#endif /* OC_MESSAGE_MTU_BUFFERS */
+
+/* The data of received messages comes from the smallest size class that fits,
+ * larger messages and messages for which all buffers of the fitting classes
+ * are in use get OC_PDU_SIZE bytes from the heap. Every buffer of a class
+ * starts with its message, so that the message of a pointer into the data is
+ * found without searching. */
+typedef struct message_data_header_t
+{
+  oc_message_t *message;
+} message_data_header_t;
+
+typedef struct message_data_small_t
+{
+  message_data_header_t header;
+  uint8_t data[OC_MESSAGE_SMALL_SIZE];
+} message_data_small_t;
+
+typedef struct message_data_medium_t
+{
+  message_data_header_t header;
+  uint8_t data[OC_MESSAGE_MEDIUM_SIZE];
+} message_data_medium_t;
+
+typedef struct message_data_mtu_t
+{
+  message_data_header_t header;
+  uint8_t data[OC_MESSAGE_MTU_SIZE];
+} message_data_mtu_t;
+
+OC_MEMB_STATIC(oc_message_data_small, message_data_small_t,
+               OC_MESSAGE_SMALL_BUFFERS);
+OC_MEMB_STATIC(oc_message_data_medium, message_data_medium_t,
+               OC_MESSAGE_MEDIUM_BUFFERS);
+OC_MEMB_STATIC(oc_message_data_mtu, message_data_mtu_t,
+               OC_MESSAGE_MTU_BUFFERS);
+
+typedef struct message_size_class_t
+{
+  struct oc_memb *pool;
+  size_t size;
+} message_size_class_t;
+
+static const message_size_class_t message_size_classes[] = {
+  { &oc_message_data_small, OC_MESSAGE_SMALL_SIZE },
+  { &oc_message_data_medium, OC_MESSAGE_MEDIUM_SIZE },
+  { &oc_message_data_mtu, OC_MESSAGE_MTU_SIZE },
+};
+
+#define NUM_MESSAGE_SIZE_CLASSES                                               \
+  (sizeof(message_size_classes) / sizeof(message_size_classes[0]))
+
+/* the data of all classes is at the same offset */
+#define MESSAGE_DATA_OFFSET (offsetof(message_data_small_t, data))
+
+/* received OSCORE messages are decrypted and serialized again in place, the
+ * plain message may be longer than the protected one */
+#ifdef OC_OSCORE
+#define MESSAGE_HEADROOM (COAP_MAX_HEADER_SIZE)
+#else  /* OC_OSCORE */
+#define MESSAGE_HEADROOM (0)
+#endif /* !OC_OSCORE */
+
+static bool
+message_alloc_data(oc_message_t *message, size_t size)
+{
+  for (size_t i = 0; i < NUM_MESSAGE_SIZE_CLASSES; i++) {
+    const message_size_class_t *size_class = &message_size_classes[i];
+    if (size > size_class->size || size_class->size > (size_t)OC_PDU_SIZE) {
+      continue;
+    }
+    oc_network_event_handler_mutex_lock();
+    uint8_t *block = (uint8_t *)oc_memb_alloc(size_class->pool);
+    oc_network_event_handler_mutex_unlock();
+    if (block != NULL) {
+      ((message_data_header_t *)block)->message = message;
+      message->data = block + MESSAGE_DATA_OFFSET;
+      message->size = size_class->size;
+      return true;
+    }
+  }
+  message->data = malloc(OC_PDU_SIZE);
+  message->size = OC_PDU_SIZE;
+  return message->data != NULL;
+}
+
+/* like the message itself, freed without taking the network event handler
+ * mutex, oc_message_unref may be called with the mutex held */
+static void
+message_free_data(oc_message_t *message)
+{
+  for (size_t i = 0; i < NUM_MESSAGE_SIZE_CLASSES; i++) {
+    struct oc_memb *pool = message_size_classes[i].pool;
+    if (oc_memb_inmemb(pool, message->data)) {
+      oc_memb_free(pool, message->data - MESSAGE_DATA_OFFSET);
+      return;
+    }
+  }
+  free(message->data);
+}
+
 static oc_message_t *
-allocate_message(struct oc_memb *pool)
+message_with_data_ptr(uint8_t *data)
 {
+  for (size_t i = 0; i < NUM_MESSAGE_SIZE_CLASSES; i++) {
+    struct oc_memb *pool = message_size_classes[i].pool;
+    if (!oc_memb_inmemb(pool, data)) {
+      continue;
+    }
+    size_t block = (size_t)((char *)data - (char *)pool->mem) / pool->size;
+    if (pool->count[block] <= 0) {
+      return NULL;
+    }
+    oc_message_t *msg =
+      ((message_data_header_t *)((char *)pool->mem + block * pool->size))
+        ->message;
+    if (msg->data <= data && data < msg->data + msg->length) {
+      return msg;
+    }
+    return NULL;
+  }
+  return NULL;
+}
+#endif /* OC_MESSAGE_SIZE_CLASSES */
+
+static oc_message_t *
+allocate_message(struct oc_memb *pool, size_t size)
+{
+#ifndef OC_MESSAGE_SIZE_CLASSES
+  (void)size;
+#endif /* !OC_MESSAGE_SIZE_CLASSES */
   oc_network_event_handler_mutex_lock();
   oc_message_t *message = (oc_message_t *)oc_memb_alloc(pool);
   oc_network_event_handler_mutex_unlock();
   if (message) {
-#if defined(OC_DYNAMIC_ALLOCATION) && !defined(OC_INOUT_BUFFER_SIZE)
+#ifdef OC_MESSAGE_SIZE_CLASSES
+    if (!message_alloc_data(message, size)) {
+      OC_ERR("Out of memory, cannot allocate message");
+      oc_memb_free(pool, message);
+      return NULL;
+    }
+#elif defined(OC_DYNAMIC_ALLOCATION) && !defined(OC_INOUT_BUFFER_SIZE)
     message->data = malloc(OC_PDU_SIZE);
     if (!message->data) {
       OC_ERR("Out of memory, cannot allocate message");
@@ -92,7 +246,7 @@ allocate_message(struct oc_memb *pool)
         message->soft_ref_cb(message);
         // we know that was the last reference, so now we can allocate
         // a new message successfully
-        return allocate_message(pool);
+        return allocate_message(pool, size);
       }
     }
 
@@ -106,7 +260,7 @@ oc_message_t *
 oc_allocate_message_from_pool(struct oc_memb *pool)
 {
   if (pool) {
-    return allocate_message(pool);
+    return allocate_message(pool, OC_PDU_SIZE);
   }
   return NULL;
 }
@@ -120,13 +274,22 @@ oc_set_buffers_avail_cb(oc_memb_buffers_avail_callback_t cb)
 oc_message_t *
 oc_allocate_message(void)
 {
-  return allocate_message(&oc_incoming_buffers);
+  return allocate_message(&oc_incoming_buffers, OC_PDU_SIZE);
+}
+
+oc_message_t *
+oc_allocate_message_with_size(size_t size)
+{
+#ifdef OC_MESSAGE_SIZE_CLASSES
+  size += MESSAGE_HEADROOM;
+#endif /* OC_MESSAGE_SIZE_CLASSES */
+  return allocate_message(&oc_incoming_buffers, size);
 }
 
 oc_message_t *
 oc_internal_allocate_outgoing_message(void)
 {
-  return allocate_message(&oc_outgoing_buffers);
+  return allocate_message(&oc_outgoing_buffers, OC_PDU_SIZE);
 }
 
 void
@@ -143,7 +306,11 @@ oc_message_unref(oc_message_t *message)
   if (message) {
     message->ref_count--;
     if (message->ref_count <= 0) {
-#if defined(OC_DYNAMIC_ALLOCATION) && !defined(OC_INOUT_BUFFER_SIZE)
+#ifdef OC_MESSAGE_SIZE_CLASSES
+      if (message->data != NULL) {
+        message_free_data(message);
+      }
+#elif defined(OC_DYNAMIC_ALLOCATION) && !defined(OC_INOUT_BUFFER_SIZE)
       if (message->data != NULL) {
         free(message->data);
       }
@@ -156,13 +323,129 @@ oc_message_unref(oc_message_t *message)
   }
 }
 
+/* hands a received message to OSCORE, or to the CoAP engine when it is not
+ * protected */
+static void
+handle_inbound_message(oc_message_t *message)
+{
+#ifdef OC_OSCORE
+  if (oscore_is_oscore_message(message) == 0) {
+    OC_DBG_OSCORE("Inbound network event: oscore request");
+#ifdef OC_DIRECT_DISPATCH
+    OC_PROCESS_CONTEXT_BEGIN(&oc_oscore_handler);
+    oc_oscore_recv_message(message);
+    OC_PROCESS_CONTEXT_END(&oc_oscore_handler);
+#else  /* OC_DIRECT_DISPATCH */
+    oc_process_post(&oc_oscore_handler, oc_events[INBOUND_OSCORE_EVENT],
+                    message);
+#endif /* !OC_DIRECT_DISPATCH */
+  } else
+#endif /* OC_OSCORE */
+  {
+    OC_DBG_OSCORE("Inbound network event: decrypted request");
+#ifdef OC_DIRECT_DISPATCH
+    coap_engine_dispatch(message);
+#else  /* OC_DIRECT_DISPATCH */
+    oc_process_post(&coap_engine, oc_events[INBOUND_RI_EVENT], message);
+#endif /* !OC_DIRECT_DISPATCH */
+  }
+}
+
+/* hands a message to be sent to OSCORE, or to the network when it does not
+ * have to be protected */
+static void
+handle_outbound_message(oc_message_t *message)
+{
+  /* handle OSCORE first*/
+#if OC_OSCORE
+  if ((message->endpoint.flags & MULTICAST) &&
+      (message->endpoint.flags & OSCORE) &&
+      ((message->endpoint.flags & OSCORE_ENCRYPTED) == 0)) {
+    OC_DBG_OSCORE("Outbound secure multicast request: forwarding to OSCORE");
+#ifndef OC_DIRECT_DISPATCH
+    oc_process_post(&oc_oscore_handler, oc_events[OUTBOUND_GROUP_OSCORE_EVENT],
+                    message);
+#elif defined(OC_CLIENT)
+    OC_PROCESS_CONTEXT_BEGIN(&oc_oscore_handler);
+    oc_oscore_send_multicast_message(message);
+    OC_PROCESS_CONTEXT_END(&oc_oscore_handler);
+#else  /* OC_CLIENT */
+    oc_message_unref(message);
+#endif /* !OC_CLIENT */
+  } else if ((message->endpoint.flags & OSCORE) &&
+             ((message->endpoint.flags & OSCORE_ENCRYPTED) == 0)) {
+    OC_DBG_OSCORE("Outbound network event: forwarding to OSCORE");
+#ifdef OC_DIRECT_DISPATCH
+    OC_PROCESS_CONTEXT_BEGIN(&oc_oscore_handler);
+    oc_oscore_send_message(message);
+    OC_PROCESS_CONTEXT_END(&oc_oscore_handler);
+#else  /* OC_DIRECT_DISPATCH */
+    oc_process_post(&oc_oscore_handler, oc_events[OUTBOUND_OSCORE_EVENT],
+                    message);
+#endif /* !OC_DIRECT_DISPATCH */
+  } else
+#endif /* !OC_OSCORE */
+    if (message->endpoint.flags & DISCOVERY) {
+      OC_DBG("Outbound network event: multicast request");
+      oc_endpoint_print(&message->endpoint);
+      oc_send_discovery_request(message);
+      oc_message_unref(message);
+    } else {
+      OC_DBG("Outbound network event: unicast message");
+      oc_send_buffer(message);
+      oc_message_unref(message);
+    }
+}
+
+#ifdef OC_DIRECT_DISPATCH
+/* Run to completion: a received message is decrypted and handled by direct
+ * calls. The messages sent meanwhile are queued and sent when the received
+ * message has been handled, the callers of oc_send_message may still look at
+ * a message after handing it over. Messages sent outside of a dispatch are
+ * sent from the poll handler of the buffer handler. */
+OC_LIST(outbound_messages);
+static int dispatch_depth;
+
+static bool
+outbound_message_queued(const oc_message_t *message)
+{
+  const oc_message_t *queued =
+    (const oc_message_t *)oc_list_head(outbound_messages);
+  for (; queued != NULL; queued = queued->next) {
+    if (queued == message) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void
+send_outbound_messages(void)
+{
+  oc_message_t *message = (oc_message_t *)oc_list_pop(outbound_messages);
+  while (message != NULL) {
+    handle_outbound_message(message);
+    message = (oc_message_t *)oc_list_pop(outbound_messages);
+  }
+}
+#endif /* OC_DIRECT_DISPATCH */
+
 void
 oc_recv_message(oc_message_t *message)
 {
+#ifdef OC_DIRECT_DISPATCH
+  dispatch_depth++;
+  handle_inbound_message(message);
+  dispatch_depth--;
+  if (dispatch_depth == 0) {
+    send_outbound_messages();
+  }
+#else  /* OC_DIRECT_DISPATCH */
   if (oc_process_post(&message_buffer_handler, oc_events[INBOUND_NETWORK_EVENT],
                       message) == OC_PROCESS_ERR_FULL) {
     oc_message_unref(message);
   }
+#endif /* !OC_DIRECT_DISPATCH */
 }
 
 void
@@ -186,12 +469,27 @@ oc_send_message(oc_message_t *message)
     oc_replay_message_track(message, token_len, token);
   }
 
+#ifdef OC_DIRECT_DISPATCH
+  if (outbound_message_queued(message)) {
+    /* sent again before it went out, e.g. a retransmission: adding it twice
+     * would break the list, so it goes out once and the reference of this
+     * send is released */
+    OC_DBG("message is already queued for sending");
+    oc_message_unref(message);
+  } else {
+    oc_list_add(outbound_messages, message);
+  }
+  if (dispatch_depth == 0) {
+    oc_process_poll(&message_buffer_handler);
+  }
+#else  /* OC_DIRECT_DISPATCH */
   if (oc_process_post(&message_buffer_handler,
                       oc_events[OUTBOUND_NETWORK_EVENT],
                       message) == OC_PROCESS_ERR_FULL) {
     OC_ERR("oc_send_message  ref_count decrease due to FULL\n");
     message->ref_count--;
   }
+#endif /* !OC_DIRECT_DISPATCH */
 
   _oc_signal_event_loop();
 }
@@ -214,54 +512,18 @@ oc_close_all_tls_sessions(void)
 
 OC_PROCESS_THREAD(message_buffer_handler, ev, data)
 {
+#ifdef OC_DIRECT_DISPATCH
+  OC_PROCESS_POLLHANDLER(send_outbound_messages());
+#endif /* OC_DIRECT_DISPATCH */
   OC_PROCESS_BEGIN();
   OC_DBG("Started buffer handler process");
   while (1) {
     OC_PROCESS_YIELD();
 
     if (ev == oc_events[INBOUND_NETWORK_EVENT]) {
-
-#ifdef OC_OSCORE
-      if (oscore_is_oscore_message((oc_message_t *)data) == 0) {
-        OC_DBG_OSCORE("Inbound network event: oscore request");
-        oc_process_post(&oc_oscore_handler, oc_events[INBOUND_OSCORE_EVENT],
-                        data);
-      } else
-#endif /* OC_OSCORE */
-      {
-        OC_DBG_OSCORE("Inbound network event: decrypted request");
-        oc_process_post(&coap_engine, oc_events[INBOUND_RI_EVENT], data);
-      }
-
+      handle_inbound_message((oc_message_t *)data);
     } else if (ev == oc_events[OUTBOUND_NETWORK_EVENT]) {
-      oc_message_t *message = (oc_message_t *)data;
-      /* handle OSCORE first*/
-#if OC_OSCORE
-      if ((message->endpoint.flags & MULTICAST) &&
-          (message->endpoint.flags & OSCORE) &&
-          ((message->endpoint.flags & OSCORE_ENCRYPTED) == 0)) {
-        OC_DBG_OSCORE(
-          "Outbound secure multicast request: forwarding to OSCORE");
-        oc_process_post(&oc_oscore_handler,
-                        oc_events[OUTBOUND_GROUP_OSCORE_EVENT], data);
-      } else if ((message->endpoint.flags & OSCORE) &&
-                 ((message->endpoint.flags & OSCORE_ENCRYPTED) == 0)) {
-        OC_DBG_OSCORE("Outbound network event: forwarding to OSCORE");
-        oc_process_post(&oc_oscore_handler, oc_events[OUTBOUND_OSCORE_EVENT],
-                        data);
-      } else
-#endif /* !OC_OSCORE */
-        if (message->endpoint.flags & DISCOVERY) {
-          OC_DBG("Outbound network event: multicast request");
-          oc_endpoint_print(&message->endpoint);
-          oc_send_discovery_request(message);
-          oc_message_unref(message);
-        } else {
-          OC_DBG("Outbound network event: unicast message");
-          oc_message_t *message = (oc_message_t *)data;
-          oc_send_buffer(message);
-          oc_message_unref(message);
-        }
+      handle_outbound_message((oc_message_t *)data);
     } else if (ev == oc_events[OUTBOUND_NETWORK_EVENT_ENCRYPTED]) {
       OC_DBG("Outbound network event:OUTBOUND_NETWORK_EVENT_ENCRYPTED");
       oc_message_t *message = (oc_message_t *)data;
@@ -275,6 +537,13 @@ OC_PROCESS_THREAD(message_buffer_handler, ev, data)
 oc_message_t *
 oc_get_incoming_message_with_ptr(uint8_t *data)
 {
+#ifdef OC_MESSAGE_SIZE_CLASSES
+  oc_message_t *message = message_with_data_ptr(data);
+  if (message != NULL) {
+    return message;
+  }
+  /* data taken from the heap has no header, search the messages */
+#endif /* OC_MESSAGE_SIZE_CLASSES */
   struct oc_memb *pool = &oc_incoming_buffers;
   for (size_t i = 0; i < pool->num; ++i) {
     // unused block, should not contain data of a valid message
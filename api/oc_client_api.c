@@ -22,6 +22,7 @@
 #endif /* OC_TCP */
 #include "oc_api.h"
 #ifdef OC_OSCORE
+#include "security/oc_oscore.h"
 #include "security/oc_tls.h"
 #endif /* OC_OSCORE */
 #ifdef OC_CLIENT
@@ -38,6 +39,8 @@ static oc_blockwise_state_t *request_buffer = NULL;
 
 #ifdef OC_OSCORE
 oc_message_t *multicast_update = NULL;
+/* the header of the multicast update, NULL to serialize request */
+static const coap_frame_template_t *multicast_frame = NULL;
 #endif /* OC_OSCORE */
 oc_event_callback_retval_t oc_ri_remove_client_cb(void *data);
 
@@ -53,8 +56,24 @@ dispatch_coap_request(oc_content_format_t content, oc_content_format_t accept)
     request_buffer->payload_size = (uint32_t)payload_size;
     uint32_t block_size;
 #ifdef OC_TCP
-    if (!(transaction->message->endpoint.flags & TCP) &&
-        payload_size > OC_BLOCK_SIZE) {
+    /* a payload that does not fit in a message to the peer is sent in BERT
+     * blocks */
+    oc_endpoint_t *endpoint = &transaction->message->endpoint;
+    uint32_t bert_size = 0;
+    if ((endpoint->flags & TCP) &&
+        (uint32_t)payload_size > coap_tcp_get_max_payload_size(endpoint)) {
+      bert_size = coap_tcp_get_bert_size(endpoint);
+    }
+    if (bert_size > 0) {
+      const void *payload = oc_blockwise_dispatch_block(
+        request_buffer, 0, bert_size, &block_size);
+      if (payload) {
+        coap_set_payload(request, payload, block_size);
+        coap_set_header_block1_bert(request, 0, 1);
+        coap_set_header_size1(request, (uint32_t)payload_size);
+        client_cb->qos = HIGH_QOS;
+      }
+    } else if (!(endpoint->flags & TCP) && payload_size > OC_BLOCK_SIZE) {
 #else  /* OC_TCP */
     if ((long)payload_size > OC_BLOCK_SIZE) {
 #endif /* !OC_TCP */
@@ -171,8 +190,8 @@ prepare_coap_request_ex(oc_client_cb_t *cb, oc_content_format_t accept)
     }
     oc_rep_new(request_buffer->buffer, OC_MAX_APP_DATA_SIZE);
 
-    request_buffer->mid = cb->mid;
-    request_buffer->client_cb = cb;
+    oc_blockwise_set_mid(request_buffer, cb->mid);
+    oc_blockwise_set_client_cb(request_buffer, cb);
   }
 #endif /* OC_BLOCK_WISE_REQUEST */
 
@@ -210,47 +229,74 @@ prepare_coap_request(oc_client_cb_t *cb)
 }
 
 #ifdef OC_OSCORE
+static void
+send_multicast_copy(const oc_endpoint_t *destination)
+{
+  oc_message_t *copy = oc_internal_allocate_outgoing_message();
+  if (!copy) {
+    OC_ERR("no buffer to send multicast update to an extra destination");
+    return;
+  }
+  memcpy(&copy->endpoint, destination, sizeof(oc_endpoint_t));
+  copy->endpoint.next = NULL;
+  copy->endpoint.group_address = multicast_update->endpoint.group_address;
+  copy->endpoint.flags |= MULTICAST | DISCOVERY;
+  copy->endpoint.flags |=
+    (multicast_update->endpoint.flags & OSCORE_ENCRYPTED);
+  copy->length = multicast_update->length;
+  memcpy(copy->data, multicast_update->data, multicast_update->length);
+  oc_send_message(copy);
+}
+
 bool
-oc_do_multicast_update(void)
+oc_do_multicast_update_to(const oc_endpoint_t *destinations,
+                          size_t nr_destinations)
 {
   int payload_size = oc_rep_get_encoded_payload_size();
 
-  if (payload_size > 0 && multicast_update) {
-    coap_set_payload(request, multicast_update->data + COAP_MAX_HEADER_SIZE,
-                     payload_size);
-  } else {
+  if (payload_size <= 0 || !multicast_update) {
     goto do_multicast_update_error;
   }
 
-  if (payload_size > 0) {
+  if (multicast_frame) {
+    multicast_update->length = coap_serialize_frame(
+      multicast_frame, request->mid, request->token, request->token_len,
+      multicast_update->data + COAP_MAX_HEADER_SIZE, (size_t)payload_size,
+      multicast_update->data);
+  } else {
+    coap_set_payload(request, multicast_update->data + COAP_MAX_HEADER_SIZE,
+                     payload_size);
     // still the inner...
     coap_set_header_content_format(request, APPLICATION_CBOR);
+    multicast_update->length =
+      coap_serialize_message(request, multicast_update->data);
   }
-
-  multicast_update->length =
-    coap_serialize_message(request, multicast_update->data);
-  if (multicast_update->length > 0) {
-    oc_send_message(multicast_update);
-  } else {
+  if (multicast_update->length == 0) {
     goto do_multicast_update_error;
   }
 
-#ifdef OC_IPV4
-  oc_message_t *multicast_update4 = oc_internal_allocate_outgoing_message();
-  if (multicast_update4) {
-    oc_make_ipv4_endpoint(mcast4, IPV4 | MULTICAST | SECURED, 5683, 0xe0, 0x00,
-                          0x01, 0xbb);
-
-    memcpy(&multicast_update4->endpoint, &mcast4, sizeof(oc_endpoint_t));
-
-    multicast_update4->length = multicast_update->length;
-    memcpy(multicast_update4->data, multicast_update->data,
-           multicast_update->length);
+  // protect once: all destinations get the same ciphertext and SSN
+  if (multicast_update->endpoint.flags & OSCORE) {
+    if (oc_oscore_protect_multicast_message(multicast_update) != 0) {
+      goto do_multicast_update_error;
+    }
+    // already protected: the buffer handler sends it out as multicast
+    multicast_update->endpoint.flags |= DISCOVERY;
+  }
 
-    oc_send_message(multicast_update4);
+  size_t i;
+  for (i = 0; i < nr_destinations; i++) {
+    send_multicast_copy(&destinations[i]);
   }
+
+#ifdef OC_IPV4
+  oc_make_ipv4_endpoint(mcast4, IPV4 | MULTICAST | SECURED, 5683, 0xe0, 0x00,
+                        0x01, 0xbb);
+  send_multicast_copy(&mcast4);
 #endif /* OC_IPV4 */
 
+  oc_send_message(multicast_update);
+
   multicast_update = NULL;
   return true;
 do_multicast_update_error:
@@ -259,6 +305,12 @@ do_multicast_update_error:
   return false;
 }
 
+bool
+oc_do_multicast_update(void)
+{
+  return oc_do_multicast_update_to(NULL, 0);
+}
+
 bool
 oc_init_multicast_update(oc_endpoint_t *mcast, const char *uri,
                          const char *query)
@@ -274,8 +326,21 @@ oc_init_multicast_update(oc_endpoint_t *mcast, const char *uri,
   memcpy(&multicast_update->endpoint, mcast, sizeof(oc_endpoint_t));
   oc_rep_new(multicast_update->data + COAP_MAX_HEADER_SIZE, OC_BLOCK_SIZE);
   coap_udp_init_message(request, type, OC_POST, coap_get_mid());
-  // still the inner message
-  coap_set_header_accept(request, APPLICATION_CBOR);
+
+  // s-mode messages only differ in mid, token and payload
+  multicast_frame = NULL;
+  if (!query) {
+    multicast_frame = coap_get_frame_template(type, OC_POST, uri, strlen(uri),
+                                              APPLICATION_CBOR);
+  }
+  if (!multicast_frame) {
+    // still the inner message
+    coap_set_header_accept(request, APPLICATION_CBOR);
+    coap_set_header_uri_path(request, uri, strlen(uri));
+    if (query) {
+      coap_set_header_uri_query(request, query);
+    }
+  }
 
   request->token_len = 8;
   int i = 0;
@@ -286,12 +351,6 @@ oc_init_multicast_update(oc_endpoint_t *mcast, const char *uri,
     i += sizeof(r);
   }
 
-  coap_set_header_uri_path(request, uri, strlen(uri));
-
-  if (query) {
-    coap_set_header_uri_query(request, query);
-  }
-
   return true;
 }
 #endif /* OC_OSCORE */
@@ -556,7 +615,7 @@ oc_stop_observe(const char *uri, oc_endpoint_t *endpoint)
   if (!cb)
     return false;
 
-  cb->mid = coap_get_mid();
+  oc_ri_client_cb_set_mid(cb, coap_get_mid());
   cb->observe_seq = 1;
 
   bool status = false;
@@ -638,8 +697,8 @@ dispatch_ip_discovery_ex(oc_client_cb_t *cb4, const char *uri,
   if (cb) {
     cb->discovery = true;
     if (cb4) {
-      cb->mid = cb4->mid;
-      memcpy(cb->token, cb4->token, cb4->token_len);
+      oc_ri_client_cb_set_mid(cb, cb4->mid);
+      oc_ri_client_cb_set_token(cb, cb4->token, cb4->token_len);
     }
 
     if (prepare_coap_request_ex(cb, accept) &&
@@ -746,91 +805,153 @@ oc_close_session(oc_endpoint_t *endpoint)
 
 // -----------------------------------------------------------------------------
 
-int
-oc_lf_number_of_entries(const char *payload, int payload_len)
+/* the next delimiter that is not in a quoted string, or end */
+static const char *
+lf_find(const char *p, const char *end, char delimiter)
 {
-  int nr_entries = 0;
-  int i;
-  if (payload == NULL) {
-    return nr_entries;
-  }
-  if (payload_len < 5) {
-    return nr_entries;
-  }
-
-  // multiple lines
-  for (i = 0; i < payload_len; i++) {
-    if (payload[i] == ',') {
-      nr_entries++;
+  while (p < end) {
+    const char *d = memchr(p, delimiter, (size_t)(end - p));
+    if (!d) {
+      return end;
     }
-  }
-  if (nr_entries > 0) {
-    // add the last entry, that does not have the continuation character.
-    nr_entries++;
-  }
-
-  if (nr_entries == 0) {
-    // only 1 line
-    if (payload[0] == '<') {
-      nr_entries = 1;
+    const char *quote = memchr(p, '"', (size_t)(d - p));
+    if (!quote) {
+      return d;
     }
+    quote = memchr(quote + 1, '"', (size_t)(end - quote - 1));
+    if (!quote) {
+      return end;
+    }
+    p = quote + 1;
   }
-
-  return nr_entries;
+  return end;
 }
 
-int
-oc_lf_get_line(const char *payload, int payload_len, int entry,
-               const char **line, int *line_len)
+void
+oc_lf_iterator_init(oc_lf_iterator_t *it, const char *payload,
+                    int payload_len)
 {
-  int nr_entries = 0;
-  int i;
-  if (payload == NULL) {
-    return nr_entries;
-  }
-  if (payload_len < 5) {
-    return nr_entries;
+  it->payload = payload;
+  it->payload_len = 0;
+  it->pos = 0;
+  if (payload != NULL && payload_len >= 5) {
+    it->payload_len = payload_len;
   }
+}
 
-  int begin_line_index = 0;
-  int end_line_index = 0;
-  bool begin_set = false;
-  bool end_set = false;
+bool
+oc_lf_iterator_next(oc_lf_iterator_t *it, oc_lf_entry_t *entry)
+{
+  const char *end = it->payload + it->payload_len;
 
-  // find begin
-  for (i = 0; i < payload_len - 1; i++) {
-    if (entry == nr_entries) {
-      if (begin_set == false) {
-        begin_line_index = i;
-        begin_set = true;
-      }
+  while (it->pos < it->payload_len) {
+    const char *line = it->payload + it->pos;
+    while (line < end && (*line == ' ' || *line == '\t' || *line == '\r' ||
+                          *line == '\n')) {
+      line++;
     }
-    if (entry + 1 == nr_entries) {
-      if (end_set == false) {
-        end_line_index = i;
-        end_set = true;
-      }
+    if (line == end) {
+      break;
+    }
+    // <coap://[fe80::8d4c:632a:c5e7:ae09]:60054/p/a>;rt="urn:knx:dpa.352.51",
+    const char *uri_end = NULL;
+    if (*line == '<') {
+      uri_end = memchr(line + 1, '>', (size_t)(end - line - 1));
     }
-    if (payload[i] == ',') {
-      nr_entries++;
+    const char *line_end = lf_find(uri_end ? uri_end : line, end, ',');
+    it->pos = (int)(line_end - it->payload) + 1;
+    if (uri_end == NULL) {
+      // not a link
+      continue;
     }
+    entry->uri = line + 1;
+    entry->uri_len = (int)(uri_end - line - 1);
+    while (line_end > uri_end + 1 &&
+           (line_end[-1] == ' ' || line_end[-1] == '\t' ||
+            line_end[-1] == '\r' || line_end[-1] == '\n')) {
+      line_end--;
+    }
+    entry->params = uri_end + 1;
+    entry->params_len = (int)(line_end - uri_end - 1);
+    return true;
   }
-  if (end_line_index == 0) {
-    end_line_index = payload_len;
+  it->pos = it->payload_len;
+  return false;
+}
+
+bool
+oc_lf_entry_get_param(const oc_lf_entry_t *entry, const char *param,
+                      const char **p_out, int *p_len)
+{
+  size_t param_len = strlen(param);
+  const char *end = entry->params + entry->params_len;
+  const char *p = lf_find(entry->params, end, ';');
+
+  while (p < end) {
+    const char *name = p + 1;
+    p = lf_find(name, end, ';');
+    if ((size_t)(p - name) < param_len ||
+        memcmp(name, param, param_len) != 0) {
+      continue;
+    }
+    const char *value = name + param_len;
+    if (value < p && *value != '=') {
+      // longer name with the same prefix
+      continue;
+    }
+    if (value < p) {
+      value++;
+    }
+    *p_out = value;
+    *p_len = (int)(p - value);
+    return true;
   }
+  return false;
+}
 
-  if (payload[begin_line_index] == '\n') {
-    begin_line_index++;
+static bool
+lf_get_entry(const char *payload, int payload_len, int entry,
+             oc_lf_entry_t *lf_entry)
+{
+  oc_lf_iterator_t it;
+  oc_lf_iterator_init(&it, payload, payload_len);
+  int i;
+  for (i = 0; oc_lf_iterator_next(&it, lf_entry); i++) {
+    if (i == entry) {
+      return true;
+    }
   }
-  // remove the trailing comma, if it exists.
-  if (payload[end_line_index - 1] == ',') {
-    end_line_index--;
+  return false;
+}
+
+int
+oc_lf_number_of_entries(const char *payload, int payload_len)
+{
+  int nr_entries = 0;
+  oc_lf_iterator_t it;
+  oc_lf_entry_t entry;
+
+  oc_lf_iterator_init(&it, payload, payload_len);
+  while (oc_lf_iterator_next(&it, &entry)) {
+    nr_entries++;
   }
-  int line_tot = end_line_index - begin_line_index;
+  return nr_entries;
+}
 
-  *line = &payload[begin_line_index];
-  *line_len = line_tot;
+int
+oc_lf_get_line(const char *payload, int payload_len, int entry,
+               const char **line, int *line_len)
+{
+  oc_lf_entry_t lf_entry;
 
+  if (!lf_get_entry(payload, payload_len, entry, &lf_entry)) {
+    *line = payload;
+    *line_len = 0;
+    return 0;
+  }
+  // from the '<' up to the end of the parameters
+  *line = lf_entry.uri - 1;
+  *line_len = (int)(lf_entry.params + lf_entry.params_len - *line);
   return 1;
 }
 
@@ -838,27 +959,15 @@ int
 oc_lf_get_entry_uri(const char *payload, int payload_len, int entry,
                     const char **uri, int *uri_len)
 {
-  const char *line = NULL;
-  int line_len = 0;
-  int i;
-  int begin_uri = 0;
-  int end_uri = 0;
-
-  oc_lf_get_line(payload, payload_len, entry, &line, &line_len);
+  oc_lf_entry_t lf_entry;
 
-  for (i = 0; i < line_len; i++) {
-    if (line[i] == '<') {
-      begin_uri = i + 1;
-    }
-    if (line[i] == '>') {
-      end_uri = i;
-      break;
-    }
+  if (!lf_get_entry(payload, payload_len, entry, &lf_entry)) {
+    *uri = payload;
+    *uri_len = 0;
+    return 0;
   }
-
-  *uri = &line[begin_uri];
-  *uri_len = end_uri - begin_uri;
-
+  *uri = lf_entry.uri;
+  *uri_len = lf_entry.uri_len;
   return 1;
 }
 
@@ -866,47 +975,19 @@ int
 oc_lf_get_entry_param(const char *payload, int payload_len, int entry,
                       const char *param, const char **p_out, int *p_len)
 {
-  const char *line = NULL;
-  int line_len = 0;
-  int i;
-  int begin_param = 0;
-  int end_param = 0;
-  int found = 0;
-
-  oc_lf_get_line(payload, payload_len, entry, &line, &line_len);
-
-  // <coap://[fe80::8d4c:632a:c5e7:ae09]:60054/p/a>;rt="urn:knx:dpa.352.51";if=if.a;ct=60
-  int param_len = (int)strlen(param);
-  for (i = 0; i < line_len - param_len - 1; i++) {
-    if (line[i] == ';') {
-      if (strncmp(&line[i + 1], param, param_len) == 0) {
-        begin_param = i + 1;
-        found = 1;
-        break;
-      }
-    }
-  }
-  if (found == 1) {
-    for (i = begin_param + 1; i < line_len - 1; i++) {
-      if (line[i] == ';') {
-        end_param = i;
-        break;
-      }
-    }
-    if (end_param == 0) {
-      end_param = line_len;
-    }
+  oc_lf_entry_t lf_entry;
 
-    // remove the "param=" part from the return value.
-    *p_out = &line[begin_param + param_len + 1];
-    *p_len = end_param - (begin_param + param_len + 1);
-
-  } else {
-    *p_out = line;
-    *p_len = line_len;
+  if (!lf_get_entry(payload, payload_len, entry, &lf_entry)) {
+    *p_out = payload;
+    *p_len = 0;
+    return 0;
   }
-
-  return found;
+  if (!oc_lf_entry_get_param(&lf_entry, param, p_out, p_len)) {
+    *p_out = lf_entry.params;
+    *p_len = lf_entry.params_len;
+    return 0;
+  }
+  return 1;
 }
 
 #endif /* OC_CLIENT */
@@ -0,0 +1,181 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "oc_crypto_worker.h"
+#include "port/oc_log.h"
+#include "port/oc_random.h"
+
+#ifdef OC_CRYPTO_WORKER
+#include "mbedtls/entropy.h"
+#include "oc_signal_event_loop.h"
+#include "util/oc_list.h"
+#include <pthread.h>
+#include <string.h>
+
+#ifndef OC_CRYPTO_WORKER_THREADS
+#define OC_CRYPTO_WORKER_THREADS (1)
+#endif /* OC_CRYPTO_WORKER_THREADS */
+
+#if OC_CRYPTO_WORKER_THREADS < 1
+#error "OC_CRYPTO_WORKER_THREADS must be at least 1"
+#endif
+
+/* every worker has its own random generator, the one of the stack is not
+ * thread safe */
+typedef struct crypto_worker_t
+{
+  pthread_t thread;
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context rng;
+} crypto_worker_t;
+
+static crypto_worker_t workers[OC_CRYPTO_WORKER_THREADS];
+static int num_workers;
+static bool stopping;
+
+/* both lists are protected by the mutex */
+OC_LIST(pending_jobs);
+OC_LIST(done_jobs);
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+static void *
+crypto_worker_thread(void *data)
+{
+  crypto_worker_t *worker = (crypto_worker_t *)data;
+
+  pthread_mutex_lock(&jobs_mutex);
+  while (!stopping) {
+    oc_crypto_job_t *job = (oc_crypto_job_t *)oc_list_pop(pending_jobs);
+    if (job == NULL) {
+      pthread_cond_wait(&jobs_cond, &jobs_mutex);
+      continue;
+    }
+    pthread_mutex_unlock(&jobs_mutex);
+
+    job->rng = &worker->rng;
+    job->work(job);
+
+    pthread_mutex_lock(&jobs_mutex);
+    oc_list_add(done_jobs, job);
+    oc_process_poll(&oc_crypto_worker_events);
+    _oc_signal_event_loop();
+  }
+  pthread_mutex_unlock(&jobs_mutex);
+  return NULL;
+}
+
+static bool
+crypto_worker_start(void)
+{
+  static const char personalization[] = "oc_crypto_worker";
+
+  while (num_workers < OC_CRYPTO_WORKER_THREADS) {
+    crypto_worker_t *worker = &workers[num_workers];
+    mbedtls_entropy_init(&worker->entropy);
+    mbedtls_ctr_drbg_init(&worker->rng);
+    if (mbedtls_ctr_drbg_seed(&worker->rng, mbedtls_entropy_func,
+                              &worker->entropy,
+                              (const unsigned char *)personalization,
+                              strlen(personalization)) != 0 ||
+        pthread_create(&worker->thread, NULL, &crypto_worker_thread, worker) !=
+          0) {
+      OC_ERR("could not start crypto worker %d", num_workers);
+      mbedtls_ctr_drbg_free(&worker->rng);
+      mbedtls_entropy_free(&worker->entropy);
+      break;
+    }
+    num_workers++;
+  }
+  return num_workers > 0;
+}
+
+static void
+crypto_worker_complete_jobs(void)
+{
+  for (;;) {
+    pthread_mutex_lock(&jobs_mutex);
+    oc_crypto_job_t *job = (oc_crypto_job_t *)oc_list_pop(done_jobs);
+    pthread_mutex_unlock(&jobs_mutex);
+    if (job == NULL) {
+      return;
+    }
+    job->complete(job);
+  }
+}
+
+OC_PROCESS(oc_crypto_worker_events, "");
+OC_PROCESS_THREAD(oc_crypto_worker_events, ev, data)
+{
+  (void)ev;
+  (void)data;
+  OC_PROCESS_POLLHANDLER(crypto_worker_complete_jobs());
+  OC_PROCESS_BEGIN();
+  while (oc_process_is_running(&(oc_crypto_worker_events))) {
+    OC_PROCESS_YIELD();
+  }
+  OC_PROCESS_END();
+}
+
+void
+oc_crypto_worker_shutdown(void)
+{
+  pthread_mutex_lock(&jobs_mutex);
+  stopping = true;
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&jobs_mutex);
+
+  for (int i = 0; i < num_workers; i++) {
+    pthread_join(workers[i].thread, NULL);
+    mbedtls_ctr_drbg_free(&workers[i].rng);
+    mbedtls_entropy_free(&workers[i].entropy);
+  }
+  num_workers = 0;
+
+  oc_list_init(pending_jobs);
+  oc_list_init(done_jobs);
+  stopping = false;
+}
+#endif /* OC_CRYPTO_WORKER */
+
+bool
+oc_crypto_worker_submit(oc_crypto_job_t *job, oc_crypto_job_cb_t work,
+                        oc_crypto_job_cb_t complete)
+{
+  if (job == NULL || work == NULL || complete == NULL) {
+    return false;
+  }
+  job->next = NULL;
+  job->work = work;
+  job->complete = complete;
+
+#ifdef OC_CRYPTO_WORKER
+  if (oc_process_is_running(&(oc_crypto_worker_events)) &&
+      (num_workers > 0 || crypto_worker_start())) {
+    pthread_mutex_lock(&jobs_mutex);
+    oc_list_add(pending_jobs, job);
+    pthread_cond_signal(&jobs_cond);
+    pthread_mutex_unlock(&jobs_mutex);
+    return true;
+  }
+  OC_WRN("crypto worker not available, running job on the event loop");
+#endif /* OC_CRYPTO_WORKER */
+
+  job->rng = oc_random_get_ctr_drbg_context();
+  work(job);
+  complete(job);
+  return true;
+}
@@ -0,0 +1,88 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/**
+  @brief worker threads for long running cryptographic computations
+  @file
+
+  With OC_CRYPTO_WORKER, jobs run on a small pool of threads so that e.g. the
+  PBKDF2 and EC computations of the SPAKE2+ handshake do not stall the event
+  loop. The completion callback of a job is always called from the event loop.
+  Without OC_CRYPTO_WORKER, jobs are run to completion by the caller.
+*/
+#ifndef OC_CRYPTO_WORKER_H
+#define OC_CRYPTO_WORKER_H
+
+#include "mbedtls/ctr_drbg.h"
+#include "util/oc_process.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct oc_crypto_job_t oc_crypto_job_t;
+
+/**
+ * @brief callback of a crypto job
+ */
+typedef void (*oc_crypto_job_cb_t)(oc_crypto_job_t *job);
+
+/**
+ * @brief a crypto job
+ *
+ * Embed as the first member of the structure holding the inputs and outputs
+ * of the computation. The job must stay valid until complete has been called.
+ */
+struct oc_crypto_job_t
+{
+  struct oc_crypto_job_t *next;  /**< internal: queue of the job */
+  oc_crypto_job_cb_t work;       /**< the computation, on a worker thread */
+  oc_crypto_job_cb_t complete;   /**< called from the event loop when done */
+  mbedtls_ctr_drbg_context *rng; /**< random generator to be used by work */
+};
+
+/**
+ * @brief run a job off the event loop
+ *
+ * work may only use the data of the job and job->rng, it must not touch the
+ * state of the stack. complete is called from the event loop afterwards, it
+ * may be called before this function returns.
+ *
+ * @param job the job
+ * @param work the computation
+ * @param complete called from the event loop when work has finished
+ * @return true when the job was accepted (or has already been run)
+ */
+bool oc_crypto_worker_submit(oc_crypto_job_t *job, oc_crypto_job_cb_t work,
+                             oc_crypto_job_cb_t complete);
+
+#ifdef OC_CRYPTO_WORKER
+/**
+ * @brief stop the worker threads
+ *
+ * Waits for running jobs to finish, jobs that have not completed yet are
+ * dropped without calling their completion callback.
+ */
+void oc_crypto_worker_shutdown(void);
+
+OC_PROCESS_NAME(oc_crypto_worker_events);
+#endif /* OC_CRYPTO_WORKER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OC_CRYPTO_WORKER_H */
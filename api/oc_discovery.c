@@ -26,6 +26,7 @@
 #include "oc_core_res.h"
 #include "oc_endpoint.h"
 #include "oc_knx_helpers.h"
+#include "oc_resource_index.h"
 
 #ifdef OC_SECURITY
 #include "security/oc_pstat.h"
@@ -37,6 +38,22 @@
 #endif
 #include <inttypes.h>
 
+#ifndef OC_WK_CACHE_ENTRIES
+#define OC_WK_CACHE_ENTRIES (4)
+#endif
+#ifndef OC_WK_CACHE_BODY_SIZE
+#define OC_WK_CACHE_BODY_SIZE (1024)
+#endif
+#ifndef OC_WK_CACHE_KEY_SIZE
+#define OC_WK_CACHE_KEY_SIZE (64)
+#endif
+#ifndef OC_WK_CACHE_SN_SIZE
+#define OC_WK_CACHE_SN_SIZE (20)
+#endif
+#ifndef OC_WK_CACHE_MAX_PARAMS
+#define OC_WK_CACHE_MAX_PARAMS (6)
+#endif
+
 int basic_resources[] = {
   OC_DEV, OC_KNX_K, OC_KNX_SWU, OC_KNX_SUB, OC_KNX_AUTH
 }; // must be in response if implemented and passed filtering
@@ -190,22 +207,32 @@ oc_filter_resource(const oc_resource_t *resource, oc_request_t *request,
                                truncate);
 }
 
+/* lists the app resources starting at *resource, when the page is full
+ * *resource is set to the resource after the last one listed. With rt or if
+ * queries only the resources selected by the resource index are visited. */
 bool
 oc_process_resources(oc_request_t *request, size_t device_index,
                      size_t *response_length, int *matches, int *skipped,
-                     int first_entry, int last_entry)
+                     int first_entry, int last_entry,
+                     const oc_resource_t **resource)
 {
-
-  const oc_resource_t *resource = oc_ri_get_app_resources();
-  for (; resource; resource = resource->next) {
-    if (resource->device != device_index ||
-        !(resource->properties & OC_DISCOVERABLE))
+  bool indexed = oc_resource_index_select(request);
+  for (; *resource; *resource = (*resource)->next) {
+    if (indexed) {
+      *resource = oc_resource_index_next_selected(*resource);
+      if (*resource == NULL) {
+        break;
+      }
+    }
+    if ((*resource)->device != device_index ||
+        !((*resource)->properties & OC_DISCOVERABLE))
       continue;
 
-    if (oc_filter_resource(resource, request, device_index, response_length,
+    if (oc_filter_resource(*resource, request, device_index, response_length,
                            skipped, first_entry, 0)) {
       (*matches)++;
       if (first_entry + (*matches) >= last_entry) {
+        *resource = (*resource)->next;
         return true;
       }
     }
@@ -259,12 +286,203 @@ frame_sn(char *serial_number, uint64_t iid, uint32_t ia)
   return response_length;
 }
 
+#if OC_WK_CACHE_ENTRIES > 0
+/* the rendered 2.05 responses of /.well-known/core, keyed by the accept
+ * option and the query with the parameters sorted by name. The responses only
+ * depend on these, the resources and the identity of the device (serial
+ * number, ia, iid), except for the programming mode (if.pm), individual
+ * address (if=urn:knx:ia.) and group address (d=) queries, which are never
+ * cached. */
+typedef struct wk_cache_entry_t
+{
+  uint32_t last_used; /* 0: entry not in use */
+  size_t device;
+  bool multicast;
+  oc_content_format_t accept;
+  uint32_t ia;
+  uint64_t iid;
+  char sn[OC_WK_CACHE_SN_SIZE];
+  char key[OC_WK_CACHE_KEY_SIZE];
+  size_t key_len;
+  int code;
+  oc_content_format_t content_format;
+  size_t length;
+  uint8_t body[OC_WK_CACHE_BODY_SIZE];
+} wk_cache_entry_t;
+
+static wk_cache_entry_t wk_cache[OC_WK_CACHE_ENTRIES];
+static uint32_t wk_cache_clock = 0;
+
+void
+oc_discovery_invalidate_cache(void)
+{
+  for (int i = 0; i < OC_WK_CACHE_ENTRIES; i++) {
+    wk_cache[i].last_used = 0;
+  }
+}
+
+typedef struct wk_query_param_t
+{
+  const char *key;
+  size_t key_len;
+  const char *value;
+  size_t value_len;
+} wk_query_param_t;
+
+static int
+wk_cache_compare_keys(const wk_query_param_t *a, const wk_query_param_t *b)
+{
+  size_t len = a->key_len < b->key_len ? a->key_len : b->key_len;
+  int cmp = memcmp(a->key, b->key, len);
+  if (cmp != 0) {
+    return cmp;
+  }
+  return (int)a->key_len - (int)b->key_len;
+}
+
+/* normalized query: parameters sorted by name, the order of parameters with
+ * the same name is kept as the handler uses the last one */
+static bool
+wk_cache_make_key(oc_request_t *request, char *key, size_t *key_len)
+{
+  wk_query_param_t params[OC_WK_CACHE_MAX_PARAMS];
+  int num_params = 0;
+  char *k, *v;
+  size_t k_len, v_len;
+
+  oc_init_query_iterator();
+  while (oc_iterate_query(request, &k, &k_len, &v, &v_len) > 0) {
+    if (num_params == OC_WK_CACHE_MAX_PARAMS) {
+      return false;
+    }
+    if (v == NULL) {
+      v_len = 0;
+    }
+    if ((k_len == 1 && k[0] == 'd') ||
+        (k_len == 2 && strncmp(k, "if", 2) == 0 &&
+         ((v_len >= 13 && strncmp(v, "urn:knx:if.pm", 13) == 0) ||
+          (v_len >= 11 && strncmp(v, "urn:knx:ia.", 11) == 0)))) {
+      return false;
+    }
+    wk_query_param_t param = { k, k_len, v, v_len };
+    int i = num_params++;
+    while (i > 0 && wk_cache_compare_keys(&params[i - 1], &param) > 0) {
+      params[i] = params[i - 1];
+      i--;
+    }
+    params[i] = param;
+  }
+
+  /* a query without known parameters is answered differently from no query */
+  size_t len = 0;
+  key[len++] = request->query_len > 0 ? '?' : '-';
+  for (int i = 0; i < num_params; i++) {
+    if (len + params[i].key_len + params[i].value_len + 2 >
+        OC_WK_CACHE_KEY_SIZE) {
+      return false;
+    }
+    memcpy(&key[len], params[i].key, params[i].key_len);
+    len += params[i].key_len;
+    key[len++] = '=';
+    if (params[i].value_len > 0) {
+      memcpy(&key[len], params[i].value, params[i].value_len);
+      len += params[i].value_len;
+    }
+    key[len++] = '&';
+  }
+  *key_len = len;
+  return true;
+}
+
+static bool
+wk_cache_matches(const wk_cache_entry_t *entry, oc_request_t *request,
+                 size_t device_index, bool multicast, const char *key,
+                 size_t key_len)
+{
+  if (entry->last_used == 0 || entry->device != device_index ||
+      entry->multicast != multicast || entry->accept != request->accept ||
+      entry->key_len != key_len ||
+      memcmp(entry->key, key, key_len) != 0) {
+    return false;
+  }
+  /* identity changes are seen here, they are set from several places */
+  oc_device_info_t *device = oc_core_get_device_info(device_index);
+  return device->ia == entry->ia && device->iid == entry->iid &&
+         strncmp(oc_string_checked(device->serialnumber), entry->sn,
+                 OC_WK_CACHE_SN_SIZE) == 0;
+}
+
+static bool
+wk_cache_send(oc_request_t *request, size_t device_index, bool multicast,
+              const char *key, size_t key_len)
+{
+  for (int i = 0; i < OC_WK_CACHE_ENTRIES; i++) {
+    wk_cache_entry_t *entry = &wk_cache[i];
+    if (!wk_cache_matches(entry, request, device_index, multicast, key,
+                          key_len)) {
+      continue;
+    }
+    oc_response_buffer_t *response_buffer = request->response->response_buffer;
+    if (entry->length > response_buffer->buffer_size) {
+      return false;
+    }
+    if (entry->length > 0) {
+      oc_rep_add_line_size_to_buffer((const char *)entry->body,
+                                     (int)entry->length);
+    }
+    response_buffer->response_length = entry->length;
+    response_buffer->code = entry->code;
+    response_buffer->content_format = entry->content_format;
+    entry->last_used = ++wk_cache_clock;
+    return true;
+  }
+  return false;
+}
+
 static void
-oc_wkcore_discovery_handler(oc_request_t *request,
-                            oc_interface_mask_t iface_mask, void *data)
+wk_cache_store(oc_request_t *request, size_t device_index, bool multicast,
+               const char *key, size_t key_len)
+{
+  oc_response_buffer_t *response_buffer = request->response->response_buffer;
+  oc_device_info_t *device = oc_core_get_device_info(device_index);
+  /* errors and ignored multicast requests are rendered again */
+  if (response_buffer->code != oc_status_code(OC_STATUS_OK) ||
+      response_buffer->response_length > OC_WK_CACHE_BODY_SIZE ||
+      oc_string_len(device->serialnumber) >= OC_WK_CACHE_SN_SIZE) {
+    return;
+  }
+
+  wk_cache_entry_t *entry = &wk_cache[0];
+  for (int i = 1; i < OC_WK_CACHE_ENTRIES; i++) {
+    if (wk_cache[i].last_used < entry->last_used) {
+      entry = &wk_cache[i];
+    }
+  }
+  entry->device = device_index;
+  entry->multicast = multicast;
+  entry->accept = request->accept;
+  entry->ia = device->ia;
+  entry->iid = device->iid;
+  strncpy(entry->sn, oc_string_checked(device->serialnumber),
+          OC_WK_CACHE_SN_SIZE);
+  memcpy(entry->key, key, key_len);
+  entry->key_len = key_len;
+  entry->code = response_buffer->code;
+  entry->content_format = response_buffer->content_format;
+  entry->length = response_buffer->response_length;
+  memcpy(entry->body, response_buffer->buffer, entry->length);
+  entry->last_used = ++wk_cache_clock;
+}
+#else  /* OC_WK_CACHE_ENTRIES > 0 */
+void
+oc_discovery_invalidate_cache(void)
+{
+}
+#endif /* OC_WK_CACHE_ENTRIES == 0 */
+
+static void
+wkcore_discovery_render(oc_request_t *request)
 {
-  (void)data;
-  (void)iface_mask;
   size_t response_length = 0;
   int matches = 0;
   int skipped = 0;
@@ -342,21 +560,33 @@ oc_wkcore_discovery_handler(oc_request_t *request,
     return;
   }
 
-  if (rt_len > 0 || if_len > 0) {
-    const oc_resource_t *my_resource = oc_ri_get_app_resources();
-    // Calculate total properties
-    for (; my_resource; my_resource = my_resource->next) {
-      if (my_resource->device != device_index ||
-          !(my_resource->properties & OC_DISCOVERABLE)) {
-        continue;
-      }
-      if (oc_string(my_resource->uri) != NULL) {
-        total++;
+  // continue where the previous page stopped
+  oc_page_cursor_t cursor;
+  bool resumed = check_if_query_pn_exist(request, &query_pn, NULL) &&
+                 oc_page_cursor_resume(request, query_pn, &cursor);
+  const oc_resource_t *app_resource = oc_ri_get_app_resources();
+
+  if (resumed) {
+    total = cursor.total;
+    app_resource = cursor.resource;
+    skipped = cursor.position;
+  } else {
+    if (rt_len > 0 || if_len > 0) {
+      const oc_resource_t *my_resource = oc_ri_get_app_resources();
+      // Calculate total properties
+      for (; my_resource; my_resource = my_resource->next) {
+        if (my_resource->device != device_index ||
+            !(my_resource->properties & OC_DISCOVERABLE)) {
+          continue;
+        }
+        if (oc_string(my_resource->uri) != NULL) {
+          total++;
+        }
       }
     }
+    total += sizeof(basic_resources) / sizeof(basic_resources[0]);
+    total += oc_count_functional_blocks(device_index);
   }
-  total += sizeof(basic_resources) / sizeof(basic_resources[0]);
-  total += oc_count_functional_blocks(device_index);
   last_entry = total;
 
   // handle query parameters: l=ps l=total
@@ -375,7 +605,7 @@ oc_wkcore_discovery_handler(oc_request_t *request,
   }
 
   // handle query with page number (pn)
-  if (check_if_query_pn_exist(request, &query_pn, NULL)) {
+  if (query_pn > -1) {
     query_match = true;
     first_entry += query_pn * PAGE_SIZE;
     if (first_entry >= last_entry) {
@@ -459,7 +689,9 @@ oc_wkcore_discovery_handler(oc_request_t *request,
           return;
         }
       } else {
-        if (skipped < first_entry) {
+        if (resumed) {
+          // a resumed page starts after this entry
+        } else if (skipped < first_entry) {
           skipped++;
         } else {
           response_length =
@@ -553,7 +785,7 @@ oc_wkcore_discovery_handler(oc_request_t *request,
                 strlen(oc_string(device->serialnumber))) == 0) {
       frame_ep = true;
     }
-    if (frame_ep) {
+    if (frame_ep && !resumed) {
       if (skipped < first_entry) {
         skipped++;
       } else {
@@ -593,11 +825,19 @@ oc_wkcore_discovery_handler(oc_request_t *request,
     PRINT("  oc_wkcore_discovery_handler rt='%.*s'\n", rt_len, rt_request);
     PRINT("  oc_wkcore_discovery_handler if='%.*s'\n", if_len, if_request);
     if (!finished) {
-      finished =
-        oc_process_resources(request, device, &response_length, &matches,
-                             &skipped, first_entry, last_entry);
+      finished = oc_process_resources(request, device, &response_length,
+                                      &matches, &skipped, first_entry,
+                                      last_entry, &app_resource);
     }
   }
+  // a next page that starts after the app resources skips the entries that
+  // follow them from here
+  if (finished) {
+    cursor.position = first_entry + matches;
+  } else {
+    app_resource = NULL;
+    cursor.position = skipped + matches;
+  }
 
   if (!finished) {
     finished =
@@ -618,8 +858,11 @@ oc_wkcore_discovery_handler(oc_request_t *request,
   if (matches > 0 && response_length > 0) {
     if (more_request_needed) {
       int next_page_num = query_pn > -1 ? query_pn + 1 : 1;
-      response_length += add_next_page_indicator(
-        oc_string(request->resource->uri), next_page_num);
+      cursor.resource = app_resource;
+      cursor.total = total;
+      response_length += add_next_page_indicator_with_cursor(
+        oc_string(request->resource->uri), next_page_num,
+        oc_page_cursor_store(request, next_page_num, &cursor));
     }
     PRINT("  oc_wkcore_discovery_handler response_length %d'\n",
           (int)response_length);
@@ -631,6 +874,31 @@ oc_wkcore_discovery_handler(oc_request_t *request,
   }
 }
 
+static void
+oc_wkcore_discovery_handler(oc_request_t *request,
+                            oc_interface_mask_t iface_mask, void *data)
+{
+  (void)data;
+  (void)iface_mask;
+#if OC_WK_CACHE_ENTRIES > 0
+  size_t device_index = request->resource->device;
+  bool multicast = request->origin && (request->origin->flags & MULTICAST) != 0;
+  char key[OC_WK_CACHE_KEY_SIZE];
+  size_t key_len = 0;
+  bool cacheable = wk_cache_make_key(request, key, &key_len);
+  if (cacheable &&
+      wk_cache_send(request, device_index, multicast, key, key_len)) {
+    return;
+  }
+  wkcore_discovery_render(request);
+  if (cacheable) {
+    wk_cache_store(request, device_index, multicast, key, key_len);
+  }
+#else  /* OC_WK_CACHE_ENTRIES > 0 */
+  wkcore_discovery_render(request);
+#endif /* OC_WK_CACHE_ENTRIES == 0 */
+}
+
 OC_CORE_CREATE_CONST_RESOURCE_FINAL(well_known_core, 0, "/.well-known/core",
                                     OC_IF_NONE, APPLICATION_LINK_FORMAT,
                                     OC_DISCOVERABLE,
@@ -33,6 +33,7 @@
 
 #ifdef OC_SPAKE
 #include "security/oc_spake2plus.h"
+#include "oc_crypto_worker.h"
 #endif
 
 #define TAGS_AS_STRINGS
@@ -639,6 +640,145 @@ oc_reset_g_received_notification()
   oc_new_string(&g_received_notification.st, "", strlen(""));
 }
 
+/*
+ * handles the s-mode message with the group object table of a device.
+ * returns false when the group address is not in the table.
+ */
+static bool
+oc_knx_k_handle_device(oc_request_t *request, oc_interface_mask_t iface_mask,
+                       size_t device_index, bool st_write, bool st_rep,
+                       bool st_read, bool *send_payload)
+{
+  oc_device_info_t *device = oc_core_get_device_info(device_index);
+  if (device == NULL || !oc_core_fp_select_device(device_index)) {
+    return false;
+  }
+  if (oc_is_device_in_runtime(device_index) == false) {
+    PRINT(" Device %u not in runtime state:%d - ignore message\n",
+          (unsigned)device_index, device->lsm_s);
+    return false;
+  }
+
+  int index = oc_core_find_group_object_table_index(g_received_notification.ga);
+  PRINT(" k : device %u index %d\n", (unsigned)device_index, index);
+  if (index == -1) {
+    return false;
+  }
+
+  // create the dummy request
+  oc_request_t new_request;
+  memset(&new_request, 0, sizeof(oc_request_t));
+  oc_response_buffer_t response_buffer;
+  memset(&response_buffer, 0, sizeof(oc_response_buffer_t));
+  oc_response_t response_obj;
+  memset(&response_obj, 0, sizeof(oc_response_t));
+
+  while (index != -1) {
+    oc_string_t myurl = oc_core_find_group_object_table_url_from_index(index);
+    PRINT(" k : url  %s\n", oc_string_checked(myurl));
+    if (oc_string_len(myurl) > 0) {
+      // get the resource to do the fake post on
+      const oc_resource_t *my_resource = oc_ri_get_app_resource_by_uri(
+        oc_string(myurl), oc_string_len(myurl), device_index);
+      if (my_resource == NULL) {
+        return true;
+      }
+
+      // check if the data is allowed to write or update
+      oc_cflag_mask_t cflags = oc_core_group_object_table_cflag_entries(index);
+      if (((cflags & OC_CFLAG_WRITE) > 0) && (st_write)) {
+        PRINT(" (case1) W-WRITE: index %d handled due to flags %d\n", index,
+              cflags);
+        // CASE 1:
+        // Received from bus: -st w, any ga
+        // @receiver : cflags = w->overwrite object value
+        // to be discussed:
+        // get value, since the w only should be send if the value is updated
+        // (e.g. different)
+        // calling the put handler, since datapoints are implementing GET/PUT
+
+        if (my_resource->put_handler.cb) {
+          oc_ri_new_request_from_request(&new_request, request,
+                                         &response_buffer, &response_obj);
+          new_request.request_payload = oc_s_mode_get_value(request);
+          new_request.uri_path = "k";
+          new_request.uri_path_len = 1;
+
+          my_resource->put_handler.cb(&new_request, iface_mask,
+                                      my_resource->put_handler.user_data);
+          if ((cflags & OC_CFLAG_TRANSMISSION) > 0) {
+            // Case 3) part 1
+            // @sender : updated object value + cflags = t
+            // Sent : -st w, sending association(1st assigned ga)
+            PRINT("  (case3) (W-WRITE) sending WRITE due to TRANSMIT flag \n");
+            oc_do_s_mode_with_scopes_for_device(
+              device_index, oc_s_mode_scopes, oc_s_mode_nr_scopes,
+              oc_string(myurl), "w");
+          }
+        }
+      }
+      if (((cflags & OC_CFLAG_UPDATE) > 0) && (st_rep)) {
+        PRINT(" (case2) RP-UPDATE: index %d handled due to flags %d\n", index,
+              cflags);
+        // Case 2)
+        // Received from bus: -st rp , any ga
+        // @receiver : cflags = u->overwrite object value
+        // calling the put handler, since datapoints are implementing GET/PUT
+        if (my_resource->put_handler.cb) {
+          oc_ri_new_request_from_request(&new_request, request,
+                                         &response_buffer, &response_obj);
+          new_request.request_payload = oc_s_mode_get_value(request);
+          new_request.uri_path = "k";
+          new_request.uri_path_len = 1;
+
+          my_resource->put_handler.cb(&new_request, iface_mask,
+                                      my_resource->put_handler.user_data);
+          if ((cflags & OC_CFLAG_TRANSMISSION) > 0) {
+            PRINT(
+              "   (case3) (RP-UPDATE) sending WRITE due to TRANSMIT flag \n");
+            // Case 3) part 2
+            // @sender : updated object value + cflags = t
+            // Sent : -st w, sending association(1st assigned ga)
+            oc_do_s_mode_with_scopes_for_device(
+              device_index, oc_s_mode_scopes, oc_s_mode_nr_scopes,
+              oc_string(myurl), "w");
+          }
+        }
+      }
+      if (((cflags & OC_CFLAG_READ) > 0) && (st_read)) {
+        PRINT(" (case4) (R-READ) index %d handled due to flags %d\n", index,
+              cflags);
+        *send_payload = true;
+        // Case 4)
+        // @sender: cflags = r
+        // Received from bus: -st r
+        // Sent: -st rp, sending association (1st assigned ga)
+        // specifically: do not check the transmission flag
+        PRINT("   (case3) (RP-UPDATE) sending RP due to READ flag \n");
+
+        if (my_resource->get_handler.cb) {
+          oc_ri_new_request_from_request(&new_request, request,
+                                         &response_buffer, &response_obj);
+          new_request.uri_path = oc_string(myurl);
+          new_request.uri_path_len = oc_string_len(myurl);
+          new_request.accept = request->accept;
+
+          my_resource->get_handler.cb(&new_request, iface_mask, NULL);
+        }
+        oc_do_s_mode_with_scopes_no_check_for_device(
+          device_index, oc_s_mode_scopes, oc_s_mode_nr_scopes,
+          oc_string(myurl), "a");
+      }
+    }
+    // get the next index in the table to get the url from.
+    // this stops when the returned index == -1
+    int new_index = oc_core_find_next_group_object_table_index(
+      g_received_notification.ga, index);
+    index = new_index;
+  }
+  return true;
+}
+
 /*
  {sia: 5678, es: {st: write, ga: 1, value: 100 }}
 */
@@ -790,12 +930,6 @@ oc_core_knx_k_post_handler(oc_request_t *request,
     }
   }
 
-  if (oc_is_device_in_runtime(device_index) == false) {
-    PRINT(" Device not in runtime state:%d - ignore message", device->lsm_s);
-    oc_send_cbor_response(request, OC_IGNORE);
-    return;
-  }
-
   bool st_write = false;
   bool st_rep = false;
   bool st_read = false;
@@ -827,133 +961,27 @@ oc_core_knx_k_post_handler(oc_request_t *request,
     st_read = true;
   }
 
-  int index = oc_core_find_group_object_table_index(g_received_notification.ga);
-  PRINT(" k : index %d\n", index);
-  if (index == -1) {
+  // the devices share the sockets: a multicast message is handled by all
+  // devices, a unicast message by the device of the resource
+  bool handled = false;
+  bool send_payload = false;
+  size_t selected = oc_core_fp_get_selected_device();
+  if (request->origin && (request->origin->flags & MULTICAST)) {
+    for (size_t i = 0; i < oc_core_get_num_devices(); i++) {
+      handled |= oc_knx_k_handle_device(request, iface_mask, i, st_write,
+                                        st_rep, st_read, &send_payload);
+    }
+  } else {
+    handled = oc_knx_k_handle_device(request, iface_mask, device_index,
+                                     st_write, st_rep, st_read, &send_payload);
+  }
+  oc_core_fp_select_device(selected);
+  if (!handled) {
     // if nothing is found (initially) then return a bad request.
     oc_send_cbor_response(request, OC_IGNORE);
     return;
   }
 
-  bool send_payload = false;
-
-  // create the dummy request
-  oc_request_t new_request;
-  memset(&new_request, 0, sizeof(oc_request_t));
-  oc_response_buffer_t response_buffer;
-  memset(&response_buffer, 0, sizeof(oc_response_buffer_t));
-  oc_response_t response_obj;
-  memset(&response_obj, 0, sizeof(oc_response_t));
-
-  while (index != -1) {
-    oc_string_t myurl = oc_core_find_group_object_table_url_from_index(index);
-    PRINT(" k : url  %s\n", oc_string_checked(myurl));
-    if (oc_string_len(myurl) > 0) {
-      // get the resource to do the fake post on
-      const oc_resource_t *my_resource = oc_ri_get_app_resource_by_uri(
-        oc_string(myurl), oc_string_len(myurl), device_index);
-      if (my_resource == NULL) {
-        return;
-      }
-
-      // check if the data is allowed to write or update
-      oc_cflag_mask_t cflags = oc_core_group_object_table_cflag_entries(index);
-      if (((cflags & OC_CFLAG_WRITE) > 0) && (st_write)) {
-        PRINT(" (case1) W-WRITE: index %d handled due to flags %d\n", index,
-              cflags);
-        // CASE 1:
-        // Received from bus: -st w, any ga
-        // @receiver : cflags = w->overwrite object value
-        // to be discussed:
-        // get value, since the w only should be send if the value is updated
-        // (e.g. different)
-        // calling the put handler, since datapoints are implementing GET/PUT
-
-        if (my_resource->put_handler.cb) {
-          oc_ri_new_request_from_request(&new_request, request,
-                                         &response_buffer, &response_obj);
-          new_request.request_payload = oc_s_mode_get_value(request);
-          new_request.uri_path = "k";
-          new_request.uri_path_len = 1;
-
-          my_resource->put_handler.cb(&new_request, iface_mask,
-                                      my_resource->put_handler.user_data);
-          if ((cflags & OC_CFLAG_TRANSMISSION) > 0) {
-            // Case 3) part 1
-            // @sender : updated object value + cflags = t
-            // Sent : -st w, sending association(1st assigned ga)
-            PRINT("  (case3) (W-WRITE) sending WRITE due to TRANSMIT flag \n");
-#ifdef OC_USE_MULTICAST_SCOPE_2
-            oc_do_s_mode_with_scope(2, oc_string(myurl), "w");
-#endif
-            oc_do_s_mode_with_scope(5, oc_string(myurl), "w");
-          }
-        }
-      }
-      if (((cflags & OC_CFLAG_UPDATE) > 0) && (st_rep)) {
-        PRINT(" (case2) RP-UPDATE: index %d handled due to flags %d\n", index,
-              cflags);
-        // Case 2)
-        // Received from bus: -st rp , any ga
-        // @receiver : cflags = u->overwrite object value
-        // calling the put handler, since datapoints are implementing GET/PUT
-        if (my_resource->put_handler.cb) {
-          oc_ri_new_request_from_request(&new_request, request,
-                                         &response_buffer, &response_obj);
-          new_request.request_payload = oc_s_mode_get_value(request);
-          new_request.uri_path = "k";
-          new_request.uri_path_len = 1;
-
-          my_resource->put_handler.cb(&new_request, iface_mask,
-                                      my_resource->put_handler.user_data);
-          if ((cflags & OC_CFLAG_TRANSMISSION) > 0) {
-            PRINT(
-              "   (case3) (RP-UPDATE) sending WRITE due to TRANSMIT flag \n");
-            // Case 3) part 2
-            // @sender : updated object value + cflags = t
-            // Sent : -st w, sending association(1st assigned ga)
-#ifdef OC_USE_MULTICAST_SCOPE_2
-            oc_do_s_mode_with_scope(2, oc_string(myurl), "w");
-#endif
-            oc_do_s_mode_with_scope(5, oc_string(myurl), "w");
-          }
-        }
-      }
-      if (((cflags & OC_CFLAG_READ) > 0) && (st_read)) {
-        PRINT(" (case4) (R-READ) index %d handled due to flags %d\n", index,
-              cflags);
-        send_payload = true;
-        // Case 4)
-        // @sender: cflags = r
-        // Received from bus: -st r
-        // Sent: -st rp, sending association (1st assigned ga)
-        // specifically: do not check the transmission flag
-        PRINT("   (case3) (RP-UPDATE) sending RP due to READ flag \n");
-
-        if (my_resource->get_handler.cb) {
-          oc_ri_new_request_from_request(&new_request, request,
-                                         &response_buffer, &response_obj);
-          new_request.uri_path = oc_string(myurl);
-          new_request.uri_path_len = oc_string_len(myurl);
-          new_request.accept = request->accept;
-
-          my_resource->get_handler.cb(&new_request, iface_mask, NULL);
-        }
-#ifdef OC_USE_MULTICAST_SCOPE_2
-        // oc_do_s_mode_with_scope_no_check(2, oc_string(myurl), "rp");
-        oc_do_s_mode_with_scope_no_check(2, oc_string(myurl), "a");
-#endif
-        // oc_do_s_mode_with_scope_no_check(5, oc_string(myurl), "rp");
-        oc_do_s_mode_with_scope_no_check(5, oc_string(myurl), "a");
-      }
-    }
-    // get the next index in the table to get the url from.
-    // this stops when the returned index == -1
-    int new_index = oc_core_find_next_group_object_table_index(
-      g_received_notification.ga, index);
-    index = new_index;
-  }
-
   // don't send anything back on a multi cast message
   if (request->origin && (request->origin->flags & MULTICAST)) {
     PRINT(" k : Multicast - not sending response\n");
@@ -1308,6 +1336,122 @@ static oc_separate_response_t spake_separate_rsp;
 static oc_event_callback_retval_t oc_core_knx_spake_separate_post_handler(
   void *req_p);
 
+#ifdef OC_SPAKE
+static void
+spake_reset_data(spake_data_t *data)
+{
+  memset(data->K_main, 0, sizeof(data->K_main));
+  mbedtls_ecp_point_free(&data->L);
+  mbedtls_ecp_point_free(&data->pub_y);
+  mbedtls_mpi_free(&data->w0);
+  mbedtls_mpi_free(&data->y);
+
+  mbedtls_ecp_point_init(&data->L);
+  mbedtls_ecp_point_init(&data->pub_y);
+  mbedtls_mpi_init(&data->w0);
+  mbedtls_mpi_init(&data->y);
+}
+#endif /* OC_SPAKE */
+
+static void
+spake_handshake_failed(void)
+{
+#ifdef OC_SPAKE
+  // be paranoid: wipe all global data after an error
+  spake_reset_data(&spake_data);
+#endif /* OC_SPAKE */
+
+  memset(g_pase.pa, 0, sizeof(g_pase.pa));
+  memset(g_pase.pb, 0, sizeof(g_pase.pb));
+  memset(g_pase.ca, 0, sizeof(g_pase.ca));
+  memset(g_pase.cb, 0, sizeof(g_pase.cb));
+  memset(g_pase.rnd, 0, sizeof(g_pase.rnd));
+  memset(g_pase.salt, 0, sizeof(g_pase.salt));
+  g_pase.it = 100000;
+
+#ifdef OC_SPAKE
+  increment_counter();
+#endif /* OC_SPAKE */
+  oc_send_separate_response(&spake_separate_rsp, OC_STATUS_BAD_REQUEST);
+}
+
+#ifdef OC_SPAKE
+/* inputs & outputs of the PBKDF2 and EC computations of the share (pb & cb),
+ * which run on a crypto worker */
+typedef struct spake_share_job_t
+{
+  oc_crypto_job_t job;
+  spake_data_t data;
+  char password[33]; /* copy, the password may be changed meanwhile */
+  uint8_t salt[32];
+  int it;
+  uint8_t pa[kPubKeySize];
+  uint8_t pb[kPubKeySize];
+  uint8_t cb[32];
+  bool have_w0_L;
+  int ret;
+} spake_share_job_t;
+
+static spake_share_job_t spake_share_job;
+static bool spake_share_busy = false;
+
+static void
+spake_share_work(oc_crypto_job_t *job)
+{
+  spake_share_job_t *share = (spake_share_job_t *)job;
+  share->ret = oc_spake_calc_responder_share(
+    &share->data, share->password, sizeof(share->salt), share->salt,
+    share->it, share->have_w0_L, share->pa, share->pb, share->cb, job->rng);
+}
+
+static void
+spake_share_complete(oc_crypto_job_t *job)
+{
+  spake_share_job_t *share = (spake_share_job_t *)job;
+  spake_share_busy = false;
+
+  if (share->ret == 0 && !share->have_w0_L) {
+    oc_spake_cache_w0_L(share->password, sizeof(share->salt), share->salt,
+                        share->it, &share->data.w0, &share->data.L);
+  }
+  memset(share->password, 0, sizeof(share->password));
+
+  if (!spake_separate_rsp.active) {
+    spake_reset_data(&share->data);
+    return;
+  }
+  oc_set_separate_response_buffer(&spake_separate_rsp);
+
+  if (share->ret != 0) {
+    OC_ERR("oc_spake_calc_responder_share failed with code %d", share->ret);
+    spake_reset_data(&share->data);
+    spake_handshake_failed();
+    return;
+  }
+
+  // hand the state over to the handshake, the next frame is the confirmation
+  spake_reset_data(&spake_data);
+  spake_data = share->data;
+  memset(share->data.K_main, 0, sizeof(share->data.K_main));
+  mbedtls_ecp_point_init(&share->data.L);
+  mbedtls_ecp_point_init(&share->data.pub_y);
+  mbedtls_mpi_init(&share->data.w0);
+  mbedtls_mpi_init(&share->data.y);
+  memcpy(g_pase.pb, share->pb, sizeof(g_pase.pb));
+  memcpy(g_pase.cb, share->cb, sizeof(g_pase.cb));
+
+  oc_rep_begin_root_object();
+  // pb (11)
+  oc_rep_i_set_byte_string(root, SPAKE_PB_SHARE_V, g_pase.pb,
+                           sizeof(g_pase.pb));
+  // cb (13)
+  oc_rep_i_set_byte_string(root, SPAKE_CB_CONFIRM_V, g_pase.cb,
+                           sizeof(g_pase.cb));
+  oc_rep_end_root_object();
+  oc_send_separate_response(&spake_separate_rsp, OC_STATUS_CHANGED);
+}
+#endif /* OC_SPAKE */
+
 static void
 oc_core_knx_spake_post_handler(oc_request_t *request,
                                oc_interface_mask_t iface_mask, void *data)
@@ -1338,6 +1482,12 @@ oc_core_knx_spake_post_handler(oc_request_t *request,
     request->response->response_buffer->max_age = get_seconds_until_unblocked();
     return;
   }
+  // the share of the previous frame is still being calculated
+  if (spake_share_busy) {
+    request->response->response_buffer->code =
+      oc_status_code(OC_STATUS_SERVICE_UNAVAILABLE);
+    return;
+  }
 #endif /* OC_SPAKE */
 
   oc_rep_t *rep = request->request_payload;
@@ -1465,66 +1615,22 @@ oc_core_knx_spake_separate_post_handler(void *req_p)
   }
 #ifdef OC_SPAKE
   else if (valid_request == SPAKE_PA_SHARE_P) {
-    // return changed, frame pb (11) & cb (13)
-
-    const char *password = oc_spake_get_password();
-    int ret;
-    mbedtls_mpi_free(&spake_data.w0);
-    mbedtls_ecp_point_free(&spake_data.L);
-    mbedtls_mpi_free(&spake_data.y);
-    mbedtls_ecp_point_free(&spake_data.pub_y);
-
-    mbedtls_mpi_init(&spake_data.w0);
-    mbedtls_ecp_point_init(&spake_data.L);
-    mbedtls_mpi_init(&spake_data.y);
-    mbedtls_ecp_point_init(&spake_data.pub_y);
-
-    ret = oc_spake_get_w0_L(password, sizeof(g_pase.salt), g_pase.salt,
-                            g_pase.it, &spake_data.w0, &spake_data.L);
-    if (ret != 0) {
-      OC_ERR("oc_spake_get_w0_L failed with code %d", ret);
-      goto error;
-    }
-
-    ret = oc_spake_gen_keypair(&spake_data.y, &spake_data.pub_y);
-    if (ret != 0) {
-      OC_ERR("oc_spake_gen_keypair failed with code %d", ret);
-      goto error;
-    }
-
-    // next step: calculate pB, encode it into the struct
-    mbedtls_ecp_point pB;
-    mbedtls_ecp_point_init(&pB);
-    if (ret = oc_spake_calc_shareV(&pB, &spake_data.pub_y, &spake_data.w0)) {
-      OC_ERR("oc_spake_calc_pB failed with code %d", ret);
-      mbedtls_ecp_point_free(&pB);
-      goto error;
-    }
-
-    if (ret = oc_spake_encode_pubkey(&pB, g_pase.pb)) {
-      OC_ERR("oc_spake_encode_pubkey failed with code %d", ret);
-      mbedtls_ecp_point_free(&pB);
-      goto error;
-    }
-
-    if (ret = oc_spake_calc_transcript_responder(&spake_data, g_pase.pa, &pB)) {
-      OC_ERR("oc_spake_calc_transcript_responder failed with code %d", ret);
-      mbedtls_ecp_point_free(&pB);
-      goto error;
-    }
-
-    oc_spake_calc_confirmV(spake_data.K_main, g_pase.cb, g_pase.pa);
-    mbedtls_ecp_point_free(&pB);
-
-    oc_rep_begin_root_object();
-    // pb (11)
-    oc_rep_i_set_byte_string(root, SPAKE_PB_SHARE_V, g_pase.pb,
-                             sizeof(g_pase.pb));
-    // cb (13)
-    oc_rep_i_set_byte_string(root, SPAKE_CB_CONFIRM_V, g_pase.cb,
-                             sizeof(g_pase.cb));
-    oc_rep_end_root_object();
-    oc_send_separate_response(&spake_separate_rsp, OC_STATUS_CHANGED);
+    // the share is calculated on a crypto worker, the response is sent from
+    // spake_share_complete
+    spake_share_job_t *job = &spake_share_job;
+    spake_reset_data(&spake_data);
+
+    strncpy(job->password, oc_spake_get_password(), sizeof(job->password) - 1);
+    memcpy(job->salt, g_pase.salt, sizeof(job->salt));
+    job->it = g_pase.it;
+    memcpy(job->pa, g_pase.pa, sizeof(job->pa));
+    job->have_w0_L =
+      oc_spake_lookup_w0_L(job->password, sizeof(job->salt), job->salt,
+                           job->it, &job->data.w0, &job->data.L) == 0;
+    job->ret = 0;
+
+    spake_share_busy = true;
+    oc_crypto_worker_submit(&job->job, spake_share_work, spake_share_complete);
     return OC_EVENT_DONE;
   } else if (valid_request == SPAKE_CA_CONFIRM_P) {
     // calculate expected cA
@@ -1563,16 +1669,7 @@ oc_core_knx_spake_separate_post_handler(void *req_p)
     oc_send_empty_separate_response(&spake_separate_rsp, OC_STATUS_CHANGED);
 
     // handshake completed successfully - clear state
-    memset(spake_data.K_main, 0, sizeof(spake_data.K_main));
-    mbedtls_ecp_point_free(&spake_data.L);
-    mbedtls_ecp_point_free(&spake_data.pub_y);
-    mbedtls_mpi_free(&spake_data.w0);
-    mbedtls_mpi_free(&spake_data.y);
-
-    mbedtls_ecp_point_init(&spake_data.L);
-    mbedtls_ecp_point_init(&spake_data.pub_y);
-    mbedtls_mpi_init(&spake_data.w0);
-    mbedtls_mpi_init(&spake_data.y);
+    spake_reset_data(&spake_data);
 
     memset(g_pase.pa, 0, sizeof(g_pase.pa));
     memset(g_pase.pb, 0, sizeof(g_pase.pb));
@@ -1584,31 +1681,8 @@ oc_core_knx_spake_separate_post_handler(void *req_p)
     return OC_EVENT_DONE;
   }
 error:
-  // be paranoid: wipe all global data after an error
-  memset(spake_data.K_main, 0, sizeof(spake_data.K_main));
-  mbedtls_ecp_point_free(&spake_data.L);
-  mbedtls_ecp_point_free(&spake_data.pub_y);
-  mbedtls_mpi_free(&spake_data.w0);
-  mbedtls_mpi_free(&spake_data.y);
-
-  mbedtls_ecp_point_init(&spake_data.L);
-  mbedtls_ecp_point_init(&spake_data.pub_y);
-  mbedtls_mpi_init(&spake_data.w0);
-  mbedtls_mpi_init(&spake_data.y);
-#endif /* OC_SPAKE */
-
-  memset(g_pase.pa, 0, sizeof(g_pase.pa));
-  memset(g_pase.pb, 0, sizeof(g_pase.pb));
-  memset(g_pase.ca, 0, sizeof(g_pase.ca));
-  memset(g_pase.cb, 0, sizeof(g_pase.cb));
-  memset(g_pase.rnd, 0, sizeof(g_pase.rnd));
-  memset(g_pase.salt, 0, sizeof(g_pase.salt));
-  g_pase.it = 100000;
-
-#ifdef OC_SPAKE
-  increment_counter();
 #endif /* OC_SPAKE */
-  oc_send_separate_response(&spake_separate_rsp, OC_STATUS_BAD_REQUEST);
+  spake_handshake_failed();
   return OC_EVENT_DONE;
 }
 
@@ -1638,6 +1712,9 @@ oc_initialise_spake_data()
   mbedtls_ecp_point_init(&spake_data.L);
   mbedtls_mpi_init(&spake_data.y);
   mbedtls_ecp_point_init(&spake_data.pub_y);
+  // a job dropped by a previous shutdown never completed
+  spake_reset_data(&spake_share_job.data);
+  spake_share_busy = false;
   // start SPAKE brute force protection timer
   oc_set_delayed_callback(NULL, decrement_counter, 10);
 }
@@ -38,7 +38,8 @@
 
 typedef struct broker_s_mode_userdata_t
 {
-  int ia;          /**< internal address of the destination */
+  size_t device_index; /**< the sending device */
+  int ia;              /**< internal address of the destination */
   char path[20];   /**< the path on the device designated with ia */
   uint32_t ga;     /**< group address to use */
   char rp_type[3]; /**< mode to send the message "w"  = 1  "r" = 2  "a" = 3
@@ -72,7 +73,25 @@ static void oc_send_s_mode(oc_endpoint_t *endpoint, char *path,
                            uint32_t sia_value, uint32_t group_address, char *rp,
                            uint8_t *value_data, int value_size);
 
-static int oc_s_mode_get_resource_value(const char *resource_url, char *rp,
+static void oc_send_s_mode_to(oc_endpoint_t *endpoints, int nr_endpoints,
+                              char *path, uint32_t sia_value,
+                              uint32_t group_address, char *rp,
+                              uint8_t *value_data, int value_size);
+
+/* maximum number of multicast scopes of a single s-mode message */
+#define S_MODE_MAX_SCOPES (4)
+
+const int oc_s_mode_scopes[] = {
+#ifdef OC_USE_MULTICAST_SCOPE_2
+  2,
+#endif
+  5
+};
+const int oc_s_mode_nr_scopes =
+  (int)(sizeof(oc_s_mode_scopes) / sizeof(oc_s_mode_scopes[0]));
+
+static int oc_s_mode_get_resource_value(size_t device_index,
+                                        const char *resource_url, char *rp,
                                         uint8_t *buf, int buf_size);
 
 // ----------------------------------------------------------------------------
@@ -366,11 +385,9 @@ discovery_ia_cb(const char *payload, int len, oc_endpoint_t *endpoint,
   PRINT("discovery_ia_cb\n");
   oc_endpoint_print(endpoint);
 
-  size_t device_index = 0;
-  oc_device_info_t *device = oc_core_get_device_info(device_index);
-  uint32_t sender_ia = device->ia;
-
   broker_s_mode_userdata_t *cb_data = (broker_s_mode_userdata_t *)user_data;
+  oc_device_info_t *device = oc_core_get_device_info(cb_data->device_index);
+  uint32_t sender_ia = device->ia;
 
   int value_size;
   if (cb_data->resource_url == NULL) {
@@ -380,8 +397,8 @@ discovery_ia_cb(const char *payload, int len, oc_endpoint_t *endpoint,
     return OC_STOP_DISCOVERY;
   }
 
-  value_size =
-    oc_s_mode_get_resource_value(cb_data->resource_url, "r", buffer, 100);
+  value_size = oc_s_mode_get_resource_value(
+    cb_data->device_index, cb_data->resource_url, "r", buffer, 100);
 
   oc_send_s_mode(endpoint, cb_data->path, sender_ia, cb_data->ga,
                  cb_data->rp_type, buffer, value_size);
@@ -394,8 +411,9 @@ discovery_ia_cb(const char *payload, int len, oc_endpoint_t *endpoint,
 }
 
 int
-oc_knx_client_do_broker_request(const char *resource_url, uint64_t iid,
-                                uint32_t ia, char *destination, char *rp)
+oc_knx_client_do_broker_request(size_t device_index, const char *resource_url,
+                                uint64_t iid, uint32_t ia, char *destination,
+                                char *rp)
 {
   char query[50] = "";
 
@@ -419,6 +437,7 @@ oc_knx_client_do_broker_request(const char *resource_url, uint64_t iid,
     (broker_s_mode_userdata_t *)malloc(sizeof(broker_s_mode_userdata_t));
   if (cb_data != NULL) {
     memset(cb_data, 0, sizeof(broker_s_mode_userdata_t));
+    cb_data->device_index = device_index;
     cb_data->ia = ia;
     strncpy(cb_data->rp_type, rp, 2);
     strncpy(cb_data->resource_url, resource_url, 20);
@@ -489,59 +508,102 @@ oc_s_mode_get_value(oc_request_t *request)
 }
 
 void
-oc_issue_s_mode(int scope, int sia_value, uint32_t grpid,
-                uint32_t group_address, uint64_t iid, char *rp,
-                uint8_t *value_data, int value_size)
+oc_issue_s_mode_with_scopes(const int *scopes, int nr_scopes, int sia_value,
+                            uint32_t grpid, uint32_t group_address,
+                            uint64_t iid, char *rp, uint8_t *value_data,
+                            int value_size)
 {
-  PRINT("  oc_issue_s_mode : scope %d\n", scope);
+  oc_endpoint_t group_mcast[S_MODE_MAX_SCOPES];
+  int i;
+
+  if (nr_scopes > S_MODE_MAX_SCOPES) {
+    OC_ERR("oc_issue_s_mode : too many scopes %d", nr_scopes);
+    nr_scopes = S_MODE_MAX_SCOPES;
+  }
+  if (nr_scopes <= 0) {
+    return;
+  }
+
+  for (i = 0; i < nr_scopes; i++) {
+    int scope = scopes[i];
+    PRINT("  oc_issue_s_mode : scope %d\n", scope);
 
 #ifdef S_MODE_ALL_COAP_NODES
 #ifdef OC_OSCORE
-  oc_make_ipv6_endpoint(group_mcast, IPV6 | MULTICAST | OSCORE, COAP_PORT, 0xff,
-                        -scope, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00, 0xfd);
+    oc_make_ipv6_endpoint(mcast, IPV6 | MULTICAST | OSCORE, COAP_PORT, 0xff,
+                          -scope, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+                          0xfd);
 #else
-  oc_make_ipv6_endpoint(group_mcast, IPV6 | DISCOVERY | MULTICAST, COAP_PORT,
-                        0xff, scope, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
-                        0xfd);
-  // oc_make_ipv6_endpoint(mcast, IPV6 | DISCOVERY | MULTICAST, 5683, 0xff,
-  // scope,
-  //                      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00, 0xfd);
+    oc_make_ipv6_endpoint(mcast, IPV6 | DISCOVERY | MULTICAST, COAP_PORT, 0xff,
+                          scope, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+                          0xfd);
 #endif
-
+    group_mcast[i] = mcast;
 #else
-  /* using group addressing */
-  oc_endpoint_t group_mcast;
-  memset(&group_mcast, 0, sizeof(group_mcast));
-  group_mcast =
-    oc_create_multicast_group_address(group_mcast, grpid, iid, scope);
+    /* using group addressing */
+    memset(&group_mcast[i], 0, sizeof(group_mcast[i]));
+    group_mcast[i] =
+      oc_create_multicast_group_address(group_mcast[i], grpid, iid, scope);
 #endif
-  // set the group_address to the group address, since this field is used
-  // to find the OSCORE context id
-  group_mcast.group_address = group_address;
+    // set the group_address to the group address, since this field is used
+    // to find the OSCORE context id
+    group_mcast[i].group_address = group_address;
+  }
 
   // new spec 1.1
-  oc_send_s_mode(&group_mcast, "/k", sia_value, group_address, rp, value_data,
-                 value_size);
+  oc_send_s_mode_to(group_mcast, nr_scopes, "/k", sia_value, group_address, rp,
+                    value_data, value_size);
+}
+
+void
+oc_issue_s_mode(int scope, int sia_value, uint32_t grpid,
+                uint32_t group_address, uint64_t iid, char *rp,
+                uint8_t *value_data, int value_size)
+{
+  oc_issue_s_mode_with_scopes(&scope, 1, sia_value, grpid, group_address, iid,
+                              rp, value_data, value_size);
 }
 
 static void
 oc_send_s_mode(oc_endpoint_t *endpoint, char *path, uint32_t sia_value,
                uint32_t group_address, char *rp, uint8_t *value_data,
                int value_size)
+{
+  oc_send_s_mode_to(endpoint, 1, path, sia_value, group_address, rp,
+                    value_data, value_size);
+}
+
+/* encodes the s-mode message once; with OSCORE it is also protected once and
+ * the same bytes are sent to every endpoint */
+static void
+oc_send_s_mode_to(oc_endpoint_t *endpoints, int nr_endpoints, char *path,
+                  uint32_t sia_value, uint32_t group_address, char *rp,
+                  uint8_t *value_data, int value_size)
 {
   char token[8];
+  oc_endpoint_t *endpoint = &endpoints[0];
+  int i;
 
   PRINT("  oc_send_s_mode : \n");
-  PRINT("  ");
-  PRINTipaddr(*endpoint);
-  PRINT("\n");
+  for (i = 0; i < nr_endpoints; i++) {
+    PRINT("  ");
+    PRINTipaddr(endpoints[i]);
+    PRINT("\n");
+  }
 
 #ifndef OC_OSCORE
+  /* nothing to share between the destinations without OSCORE */
+  for (i = 1; i < nr_endpoints; i++) {
+    oc_send_s_mode_to(&endpoints[i], 1, path, sia_value, group_address, rp,
+                      value_data, value_size);
+  }
   if (oc_init_post(path, endpoint, NULL, NULL, LOW_QOS, NULL)) {
 #else  /* OC_OSCORE */
   /* not sure if it is needed, the endpoint should already have the OSCORE flag
    * set */
-  endpoint->flags = endpoint->flags | OSCORE;
+  for (i = 0; i < nr_endpoints; i++) {
+    endpoints[i].flags = endpoints[i].flags | OSCORE;
+  }
   if (oc_init_multicast_update(endpoint, path, NULL)) {
 #endif /* OC_OSCORE */
     /*
@@ -585,7 +647,7 @@ oc_send_s_mode(oc_endpoint_t *endpoint, char *path, uint32_t sia_value,
     if (oc_do_post_ex(APPLICATION_CBOR, APPLICATION_CBOR)) {
       PRINT("  Sent POST request\n");
 #else
-    if (oc_do_multicast_update()) {
+    if (oc_do_multicast_update_to(&endpoints[1], (size_t)(nr_endpoints - 1))) {
       PRINT("  Sent oc_do_multicast_update update\n");
 #endif
     } else {
@@ -595,8 +657,8 @@ oc_send_s_mode(oc_endpoint_t *endpoint, char *path, uint32_t sia_value,
 }
 
 static int
-oc_s_mode_get_resource_value(const char *resource_url, char *rp, uint8_t *buf,
-                             int buf_size)
+oc_s_mode_get_resource_value(size_t device_index, const char *resource_url,
+                             char *rp, uint8_t *buf, int buf_size)
 {
   (void)rp;
   uint8_t buffer[50];
@@ -605,8 +667,8 @@ oc_s_mode_get_resource_value(const char *resource_url, char *rp, uint8_t *buf,
     return 0;
   }
 
-  const oc_resource_t *my_resource =
-    oc_ri_get_app_resource_by_uri(resource_url, strlen(resource_url), 0);
+  const oc_resource_t *my_resource = oc_ri_get_app_resource_by_uri(
+    resource_url, strlen(resource_url), device_index);
   if (my_resource == NULL) {
     PRINT(" oc_do_s_mode : error no URL found %s\n", resource_url);
     return 0;
@@ -664,10 +726,14 @@ oc_s_mode_get_resource_value(const char *resource_url, char *rp, uint8_t *buf,
 }
 
 void
-oc_do_s_mode_read(int64_t group_address)
+oc_do_s_mode_read_for_device(size_t device_index, int64_t group_address)
 {
-  size_t device_index = 0;
   oc_device_info_t *device = oc_core_get_device_info(device_index);
+  size_t selected = oc_core_fp_get_selected_device();
+  if (device == NULL || !oc_core_fp_select_device(device_index)) {
+    OC_ERR("oc_do_s_mode_read: no device %u", (unsigned)device_index);
+    return;
+  }
   uint32_t sia_value = device->ia;
   uint64_t iid = device->iid;
   uint32_t grpid = 0;
@@ -678,27 +744,34 @@ oc_do_s_mode_read(int64_t group_address)
   // find the grpid that belongs to the group address
   grpid = oc_find_grpid_in_recipient_table(group_address);
   if (grpid > 0) {
-#ifdef OC_USE_MULTICAST_SCOPE_2
-    oc_issue_s_mode(2, sia_value, grpid, group_address, iid, "r", 0, 0);
-#endif
-    oc_issue_s_mode(5, sia_value, grpid, group_address, iid, "r", 0, 0);
+    oc_issue_s_mode_with_scopes(oc_s_mode_scopes, oc_s_mode_nr_scopes,
+                                sia_value, grpid, group_address, iid, "r", 0,
+                                0);
   } else if (group_address > 0) {
-
-#ifdef OC_USE_MULTICAST_SCOPE_2
-    oc_issue_s_mode(2, sia_value, group_address, group_address, iid, "r", 0, 0);
-#endif
-    oc_issue_s_mode(5, sia_value, group_address, group_address, iid, "r", 0, 0);
+    oc_issue_s_mode_with_scopes(oc_s_mode_scopes, oc_s_mode_nr_scopes,
+                                sia_value, group_address, group_address, iid,
+                                "r", 0, 0);
   }
+  oc_core_fp_select_device(selected);
+}
+
+void
+oc_do_s_mode_read(int64_t group_address)
+{
+  oc_do_s_mode_read_for_device(oc_core_fp_get_selected_device(),
+                               group_address);
 }
 
 // note: this function does not check the transmit flag
 // the caller of this function needs to check if the flag is set.
-void
-oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
-                                  bool check)
+// the tables of device_index are selected
+static void
+oc_do_s_mode_with_scope_internal(size_t device_index, const int *scopes,
+                                 int nr_scopes, const char *resource_url,
+                                 char *rp, bool check)
 {
-  PRINT("oc_do_s_mode_with_scope_and_check\nscope = %d\nurl = %s\nrp=%s\n",
-        scope, resource_url, rp);
+  PRINT("oc_do_s_mode_with_scopes_and_check\nscopes = %d\nurl = %s\nrp=%s\n",
+        nr_scopes, resource_url, rp);
   int value_size;
   bool error = true;
   uint8_t buffer[50];
@@ -726,7 +799,6 @@ oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
   }
 
   // get the device
-  size_t device_index = 0;
   oc_device_info_t *device = oc_core_get_device_info(device_index);
   if (device == NULL) {
     PRINT(" oc_do_s_mode_with_scope_internal : device is NULL\n");
@@ -741,8 +813,8 @@ oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
     return;
   }
 
-  const oc_resource_t *my_resource =
-    oc_ri_get_app_resource_by_uri(resource_url, strlen(resource_url), 0);
+  const oc_resource_t *my_resource = oc_ri_get_app_resource_by_uri(
+    resource_url, strlen(resource_url), device_index);
   if (my_resource == NULL) {
     PRINT(" oc_do_s_mode_with_scope_internal : error no URL found %s\n",
           resource_url);
@@ -751,7 +823,8 @@ oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
 
   oc_notify_observers(my_resource);
 
-  value_size = oc_s_mode_get_resource_value(resource_url, rp, buffer, 50);
+  value_size =
+    oc_s_mode_get_resource_value(device_index, resource_url, rp, buffer, 50);
 
   // get the sender ia
   uint32_t sia_value = device->ia;
@@ -802,8 +875,8 @@ oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
                 oc_core_find_group_object_table_url_from_index(other_index);
               const char *other_url_char = oc_string(other_url);
               const oc_resource_t *other_resource =
-                oc_ri_get_app_resource_by_uri(other_url_char,
-                                              strlen(other_url_char), 0);
+                oc_ri_get_app_resource_by_uri(
+                  other_url_char, strlen(other_url_char), device_index);
               if (other_resource == NULL) {
                 other_index = oc_core_find_next_group_object_table_index(
                   group_address, other_index);
@@ -834,34 +907,31 @@ oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
               group_address, other_index);
           }
         }
+        // the compiled route contains the grpid and the list of unicast
+        // destinations (ia > 0) of the recipient table for this group address
+        const oc_group_route_t *route = oc_core_find_group_route(group_address);
         if (j == 0) {
           // issue the s-mode command, but only for the first ga entry
-          uint32_t grpid = oc_find_grpid_in_recipient_table(group_address);
+          uint32_t grpid = (route) ? route->grpid : 0;
           if (grpid > 0) {
-            oc_issue_s_mode(scope, sia_value, grpid, group_address, iid, rp,
-                            buffer, value_size);
+            oc_issue_s_mode_with_scopes(scopes, nr_scopes, sia_value, grpid,
+                                        group_address, iid, rp, buffer,
+                                        value_size);
           } else {
             // send to group address in multicast address
-            oc_issue_s_mode(scope, sia_value, group_address, group_address, iid,
-                            rp, buffer, value_size);
+            oc_issue_s_mode_with_scopes(scopes, nr_scopes, sia_value,
+                                        group_address, group_address, iid, rp,
+                                        buffer, value_size);
           }
         }
-        // the recipient table contains the list of destinations that will
-        // receive data. loop over the full recipient table and send a message
-        // if the group is there
-        for (int jr = 0; jr < oc_core_get_recipient_table_size(); jr++) {
-          bool found =
-            oc_core_check_recipient_index_on_group_address(jr, group_address);
-          if (found) {
-            char *url = oc_core_get_recipient_index_url_or_path(jr);
-            if (url) {
-              PRINT(" broker send: %s\n", url);
-              uint32_t ia = oc_core_get_recipient_ia(jr);
-              if (ia > 0) {
-                // ia == 0 is reserved, so only send with ia > 0
-                oc_knx_client_do_broker_request(resource_url, iid, ia, url, rp);
-              }
-            }
+        for (int r = 0; route && r < route->nr_recipients; r++) {
+          int jr = oc_core_get_group_route_recipient(route, r);
+          char *url = oc_core_get_recipient_index_url_or_path(jr);
+          if (url) {
+            PRINT(" broker send: %s\n", url);
+            uint32_t ia = oc_core_get_recipient_ia(jr);
+            oc_knx_client_do_broker_request(device_index, resource_url, iid,
+                                            ia, url, rp);
           }
         }
       }
@@ -872,19 +942,81 @@ oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
     index = oc_core_find_next_group_object_table_url(resource_url, index);
   }
 }
+
+static void
+oc_do_s_mode_with_scopes_and_check(size_t device_index, const int *scopes,
+                                   int nr_scopes, const char *resource_url,
+                                   char *rp, bool check)
+{
+  // the group tables of the device, without changing the selection of the
+  // caller
+  size_t selected = oc_core_fp_get_selected_device();
+  if (!oc_core_fp_select_device(device_index)) {
+    OC_ERR("oc_do_s_mode_with_scopes_and_check: no tables for device %u",
+           (unsigned)device_index);
+    return;
+  }
+  oc_do_s_mode_with_scope_internal(device_index, scopes, nr_scopes,
+                                   resource_url, rp, check);
+  oc_core_fp_select_device(selected);
+}
 // note: this function does not check the transmit flag
 // the caller of this function needs to check if the flag is set.
 void
 oc_do_s_mode_with_scope_no_check(int scope, const char *resource_url, char *rp)
 {
-  oc_do_s_mode_with_scope_and_check(scope, resource_url, rp, false);
+  oc_do_s_mode_with_scopes_and_check(oc_core_fp_get_selected_device(), &scope,
+                                     1, resource_url, rp, false);
 }
 
 // note: this function does check the transmit flag
 void
 oc_do_s_mode_with_scope(int scope, const char *resource_url, char *rp)
 {
-  oc_do_s_mode_with_scope_and_check(scope, resource_url, rp, true);
+  oc_do_s_mode_with_scopes_and_check(oc_core_fp_get_selected_device(), &scope,
+                                     1, resource_url, rp, true);
+}
+
+void
+oc_do_s_mode_with_scope_and_check(int scope, const char *resource_url, char *rp,
+                                  bool check)
+{
+  oc_do_s_mode_with_scopes_and_check(oc_core_fp_get_selected_device(), &scope,
+                                     1, resource_url, rp, check);
+}
+
+void
+oc_do_s_mode_with_scopes(const int *scopes, int nr_scopes,
+                         const char *resource_url, char *rp)
+{
+  oc_do_s_mode_with_scopes_and_check(oc_core_fp_get_selected_device(), scopes,
+                                     nr_scopes, resource_url, rp, true);
+}
+
+void
+oc_do_s_mode_with_scopes_no_check(const int *scopes, int nr_scopes,
+                                  const char *resource_url, char *rp)
+{
+  oc_do_s_mode_with_scopes_and_check(oc_core_fp_get_selected_device(), scopes,
+                                     nr_scopes, resource_url, rp, false);
+}
+
+void
+oc_do_s_mode_with_scopes_for_device(size_t device_index, const int *scopes,
+                                    int nr_scopes, const char *resource_url,
+                                    char *rp)
+{
+  oc_do_s_mode_with_scopes_and_check(device_index, scopes, nr_scopes,
+                                     resource_url, rp, true);
+}
+
+void
+oc_do_s_mode_with_scopes_no_check_for_device(size_t device_index,
+                                             const int *scopes, int nr_scopes,
+                                             const char *resource_url, char *rp)
+{
+  oc_do_s_mode_with_scopes_and_check(device_index, scopes, nr_scopes,
+                                     resource_url, rp, false);
 }
 
 // ----------------------------------------------------------------------------
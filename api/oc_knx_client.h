@@ -164,11 +164,25 @@ oc_rep_t *oc_s_mode_get_value(oc_request_t *request);
  *
  * Note: function does not check the flags on the resources
  *
+ * The s-mode functions without a device index send for the device of which
+ * a resource handler is being called, and for device 0 outside of the
+ * handlers (e.g. from a timer).
+ *
  * @see oc_do_s_mode_with_scope
+ * @see oc_do_s_mode_read_for_device
  * @param group_address the group address to invoke a read on
  */
 void oc_do_s_mode_read(int64_t group_address);
 
+/**
+ * @brief sends out an s-mode read request of a device, using the group
+ * tables and the individual address of that device.
+ *
+ * @param device_index the index of the sending device
+ * @param group_address the group address to invoke a read on
+ */
+void oc_do_s_mode_read_for_device(size_t device_index, int64_t group_address);
+
 /**
  * @brief sends (transmits) an s-mode message
  * the value comes from the GET of the resource indicated by the resource_url
@@ -215,6 +229,83 @@ void oc_do_s_mode_with_scope(int scope, const char *resource_url, char *rp);
 void oc_do_s_mode_with_scope_no_check(int scope, const char *resource_url,
                                       char *rp);
 
+/**
+ * @brief the multicast scopes s-mode messages of the stack are sent to:
+ * 2 (only with OC_USE_MULTICAST_SCOPE_2) and 5
+ */
+extern const int oc_s_mode_scopes[];
+
+/**
+ * @brief the number of entries in oc_s_mode_scopes
+ */
+extern const int oc_s_mode_nr_scopes;
+
+/**
+ * @brief sends (transmits) an s-mode message to several multicast scopes
+ *
+ * Same as oc_do_s_mode_with_scope, but the message is encoded (and OSCORE
+ * protected) only once, and the same bytes are sent to every scope. This
+ * consumes a single SSN for all scopes.
+ *
+ * Note: function does check the T flag on the resource
+ *
+ * @param scopes the multi-cast scopes, e.g. oc_s_mode_scopes
+ * @param nr_scopes the number of scopes
+ * @param resource_url URI of the resource (e.g. implemented on the device that
+ * is calling this function)
+ * @param rp the "st" value to send e.g. "w" | "rp" | "r"
+ */
+void oc_do_s_mode_with_scopes(const int *scopes, int nr_scopes,
+                              const char *resource_url, char *rp);
+
+/**
+ * @brief sends (transmits) an s-mode message to several multicast scopes,
+ * without checking the T flag on the resource
+ *
+ * @see oc_do_s_mode_with_scopes
+ * @param scopes the multi-cast scopes, e.g. oc_s_mode_scopes
+ * @param nr_scopes the number of scopes
+ * @param resource_url URI of the resource (e.g. implemented on the device that
+ * is calling this function)
+ * @param rp the "st" value to send e.g. "w" | "rp" | "r"
+ */
+void oc_do_s_mode_with_scopes_no_check(const int *scopes, int nr_scopes,
+                                       const char *resource_url, char *rp);
+
+/**
+ * @brief sends (transmits) an s-mode message of a device to several multicast
+ * scopes, using the group tables and the individual address of that device.
+ *
+ * Note: function does check the T flag on the resource
+ *
+ * @see oc_do_s_mode_with_scopes
+ * @param device_index the index of the device implementing the resource
+ * @param scopes the multi-cast scopes, e.g. oc_s_mode_scopes
+ * @param nr_scopes the number of scopes
+ * @param resource_url URI of the resource
+ * @param rp the "st" value to send e.g. "w" | "rp" | "r"
+ */
+void oc_do_s_mode_with_scopes_for_device(size_t device_index, const int *scopes,
+                                         int nr_scopes,
+                                         const char *resource_url, char *rp);
+
+/**
+ * @brief sends (transmits) an s-mode message of a device to several multicast
+ * scopes, without checking the T flag on the resource
+ *
+ * @see oc_do_s_mode_with_scopes_for_device
+ * @param device_index the index of the device implementing the resource
+ * @param scopes the multi-cast scopes, e.g. oc_s_mode_scopes
+ * @param nr_scopes the number of scopes
+ * @param resource_url URI of the resource
+ * @param rp the "st" value to send e.g. "w" | "rp" | "r"
+ */
+void oc_do_s_mode_with_scopes_no_check_for_device(size_t device_index,
+                                                  const int *scopes,
+                                                  int nr_scopes,
+                                                  const char *resource_url,
+                                                  char *rp);
+
 /** @} */ // end of doc_module_tag_s_mode_client
 
 #ifdef __cplusplus
@@ -22,79 +22,37 @@
 
 #include "oc_core_res.h"
 #include "oc_discovery.h"
+#include "oc_resource_index.h"
 #include <stdio.h>
 
 // -----------------------------------------------------------------------------
-// note this can be optimized.
-#define ARRAY_SIZE 50 // upto 50 data points in a functional block
-int g_int_array[2][ARRAY_SIZE];
-int g_array_size = 0;
-static int g_nr_functional_blocks = 0;
 
-int
-get_fp_from_dp(char *dpt)
-{
-  // char *dpt = oc_string(oc_dpt);
-  char *dot;
-
-  // dpa.352.51
-  // urn:knx:dpa.352
-  dot = strchr(dpt, '.');
-  if (dot) {
-    return atoi(dot + 1);
-  }
-
-  return -1;
-}
-
-bool
-is_in_g_array(int value, int instance)
+/* a functional block is listed when one of its discoverable resources has a
+ * data point type of it, for netip the types of the netip functional block
+ * are checked */
+static bool
+fb_group_is_listed(const oc_fb_group_t *group, bool netip)
 {
-  int i;
-  for (i = 0; i < g_array_size; i++) {
-    if (value == g_int_array[0][i] && instance == g_int_array[1][i]) {
+  for (size_t i = 0; i < group->num_members; i++) {
+    const oc_fb_member_t *member = &group->members[i];
+    if ((member->resource->properties & OC_DISCOVERABLE) &&
+        (netip ? member->netip : member->regular)) {
       return true;
     }
   }
   return false;
 }
 
-void
-store_in_array(int value, int instance)
-{
-  if (value == -1) {
-    return;
-  }
-  g_int_array[0][g_array_size] = value;    // functional block number
-  g_int_array[1][g_array_size] = instance; // instance of the functional block
-  g_array_size++;
-  // assert(g_array_size == ARRAY_SIZE);
-}
-
-// -----------------------------------------------------------------------------
 static int
 oc_core_count_dp_in_fb(size_t device_index, int instance, int fb_value)
 {
   int counter = 0;
-  int i;
 
-  const oc_resource_t *resource = oc_ri_get_app_resources();
-  for (; resource; resource = resource->next) {
-    if (resource->device != device_index ||
-        !(resource->properties & OC_DISCOVERABLE)) {
-      continue;
-    }
-    int instance_resource = resource->fb_instance;
-    oc_string_array_t types = resource->types;
-    for (i = 0; i < (int)oc_string_array_get_allocated_size(types); i++) {
-      char *t = oc_string_array_get_item(types, i);
-      if ((strncmp(t, ":dpa", 4) == 0) ||
-          (strncmp(t, "urn:knx:dpa", 11) == 0)) {
-        int fp_int = get_fp_from_dp(t);
-        if (fp_int == fb_value && instance_resource == instance) {
-          counter++;
-        }
-      }
+  const oc_fb_group_t *group =
+    oc_resource_index_find_fb(device_index, fb_value, instance);
+  for (size_t i = 0; group && i < group->num_members; i++) {
+    if (group->members[i].resource->properties & OC_DISCOVERABLE) {
+      counter += group->members[i].num_dp;
     }
   }
   return counter;
@@ -107,7 +65,6 @@ oc_core_fb_x_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   (void)data;
   (void)iface_mask;
   size_t response_length = 0;
-  int i;
   int matches = 0;
   int length;
 
@@ -160,7 +117,16 @@ oc_core_fb_x_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   PRINT("  instance: %d\n", instance);
   size_t device_index = request->resource->device;
 
-  total = oc_core_count_dp_in_fb(device_index, instance, fb_value);
+  // continue where the previous page stopped
+  oc_page_cursor_t cursor;
+  bool resumed = check_if_query_pn_exist(request, &query_pn, NULL) &&
+                 oc_page_cursor_resume(request, query_pn, &cursor);
+
+  if (resumed) {
+    total = cursor.total;
+  } else {
+    total = oc_core_count_dp_in_fb(device_index, instance, fb_value);
+  }
   last_entry = total;
 
   // handle query parameters: l=ps l=total
@@ -179,7 +145,7 @@ oc_core_fb_x_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   }
 
   // handle query with page number (pn)
-  if (check_if_query_pn_exist(request, &query_pn, NULL)) {
+  if (query_pn > -1) {
     first_entry += query_pn * PAGE_SIZE;
     if (first_entry >= last_entry) {
       oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
@@ -193,38 +159,35 @@ oc_core_fb_x_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
 
   // do the actual creation of the payload, e.g. the data points per functional
   // block instance
-  const oc_resource_t *resource = oc_ri_get_app_resources();
+  const oc_fb_group_t *group =
+    oc_resource_index_find_fb(device_index, fb_value, instance);
+  size_t member = 0;
   int skipped = 0;
-  for (; resource; resource = resource->next) {
-    if (resource->device != device_index ||
-        !(resource->properties & OC_DISCOVERABLE)) {
-      continue;
+  if (resumed && group) {
+    while (member < group->num_members &&
+           group->members[member].resource != cursor.resource) {
+      member++;
     }
-
-    bool frame_resource = false;
-    int instance_resource = resource->fb_instance;
-
-    oc_string_array_t types = resource->types;
-    for (i = 0; i < (int)oc_string_array_get_allocated_size(types); i++) {
-      char *t = oc_string_array_get_item(types, i);
-      if ((strncmp(t, ":dpa", 4) == 0) ||
-          (strncmp(t, "urn:knx:dpa", 11) == 0)) {
-        int fp_int = get_fp_from_dp(t);
-        if (fp_int == fb_value && instance_resource == instance) {
-          frame_resource = true;
-        }
-      }
+    if (member < group->num_members) {
+      skipped = cursor.position;
+    } else {
+      member = 0;
     }
-    if (frame_resource) {
-      if (skipped < first_entry) {
-        skipped++;
-      } else {
-        oc_add_resource_to_wk(resource, request, device_index, &response_length,
-                              1);
-        matches++;
-        if (matches >= PAGE_SIZE) {
-          break;
-        }
+  }
+  for (; group && member < group->num_members; member++) {
+    const oc_resource_t *resource = group->members[member].resource;
+    if (!(resource->properties & OC_DISCOVERABLE)) {
+      continue;
+    }
+    if (skipped < first_entry) {
+      skipped++;
+    } else {
+      oc_add_resource_to_wk(resource, request, device_index, &response_length,
+                            1);
+      matches++;
+      if (matches >= PAGE_SIZE) {
+        member++;
+        break;
       }
     }
   }
@@ -232,8 +195,22 @@ oc_core_fb_x_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   if (matches > 0) {
     if (more_request_needed) {
       int next_page_num = query_pn > -1 ? query_pn + 1 : 1;
-      response_length += add_next_page_indicator(
-        oc_string(request->resource->uri), next_page_num);
+      // the link points to the functional block that was requested, the
+      // cursor is only valid for that url
+      char url[40];
+      snprintf(url, sizeof(url), "%s%.*s",
+               (request->uri_path_len > 0 && request->uri_path[0] == '/')
+                 ? ""
+                 : "/",
+               (int)request->uri_path_len, request->uri_path);
+      cursor.resource = (group && member < group->num_members)
+                          ? group->members[member].resource
+                          : NULL;
+      cursor.position = first_entry + PAGE_SIZE;
+      cursor.total = total;
+      response_length += add_next_page_indicator_with_cursor(
+        url, next_page_num,
+        oc_page_cursor_store(request, next_page_num, &cursor));
     }
     oc_send_linkformat_response(request, OC_STATUS_OK, response_length);
   } else {
@@ -266,48 +243,24 @@ int
 oc_count_functional_blocks(size_t device_index)
 {
   int counter = 0;
-  int i;
   bool netip_added = false;
+  size_t num_groups;
 
-  if (g_nr_functional_blocks > 0) {
-    return g_nr_functional_blocks;
-  }
-
-  const oc_resource_t *resource = oc_ri_get_app_resources();
-  for (; resource; resource = resource->next) {
-    if (resource->device != device_index ||
-        !(resource->properties & OC_DISCOVERABLE)) {
+  const oc_fb_group_t *groups = oc_resource_index_get_fb_groups(&num_groups);
+  for (size_t i = 0; i < num_groups; i++) {
+    if (groups[i].device != device_index) {
       continue;
     }
-
-    oc_string_array_t types = resource->types;
-    for (i = 0; i < (int)oc_string_array_get_allocated_size(types); i++) {
-      char *t = oc_string_array_get_item(types, i);
-      if ((strncmp(t, ":dpa.11.", 8) == 0) ||
-          (strncmp(t, "urn:knx:dpa.11.", 15) == 0)) {
-        /* specific functional block iot_router : /f/netip */
-        if (netip_added == false) {
-          /* add only once */
-          counter++;
-          netip_added = true;
-        }
-      } else {
-        /* regular functional block, framing by functional block numbers &
-         * instances*/
-        if ((strncmp(t, ":dpa", 4) == 0) ||
-            (strncmp(t, "urn:knx:dpa", 11) == 0)) {
-          int fp_int = get_fp_from_dp(t);
-          int instance = resource->fb_instance;
-          if ((fp_int > 0) && (is_in_g_array(fp_int, instance) == false)) {
-            store_in_array(fp_int, instance);
-            counter++;
-          }
-        }
-      }
+    /* specific functional block iot_router : /f/netip, add only once */
+    if (!netip_added && fb_group_is_listed(&groups[i], true)) {
+      counter++;
+      netip_added = true;
+    }
+    if (fb_group_is_listed(&groups[i], false)) {
+      counter++;
     }
   }
-  g_nr_functional_blocks = counter;
-  return g_nr_functional_blocks;
+  return counter;
 }
 
 bool
@@ -366,64 +319,42 @@ oc_add_function_blocks_to_response(oc_request_t *request, size_t device_index,
   (void)request;
   int length = 0;
   char number[24];
-  int i;
+  size_t i;
   int original_matches = *matches;
-  int counter = 0;
-
-  bool netip_added = false;
-
-  const oc_resource_t *resource = oc_ri_get_app_resources();
-  for (; resource; resource = resource->next) {
-    if (resource->device != device_index ||
-        !(resource->properties & OC_DISCOVERABLE)) {
-      continue;
-    }
-
-    oc_string_array_t types = resource->types;
-    for (i = 0; i < (int)oc_string_array_get_allocated_size(types); i++) {
-      char *t = oc_string_array_get_item(types, i);
-      if ((strncmp(t, ":dpa.11.", 8) == 0) ||
-          (strncmp(t, "urn:knx:dpa.11.", 15) == 0)) {
-        /* specific functional block iot_router : /f/netip */
-        // add the functional block only once..
-        if (netip_added == false) {
-          if (*skipped < first_entry) {
-            (*skipped)++;
-          } else {
-            /* add only once, this is not the first entry, so add the ,\n */
-            if (*response_length > 0) {
-              length = oc_rep_add_line_to_buffer(",\n");
-              *response_length += length;
-            }
-            length =
-              oc_rep_add_line_to_buffer("</f/netip>;rt=\":fb.11\";ct=40");
-            *response_length += length;
-            (*matches)++;
-            netip_added = true;
-            counter++;
-          }
-        }
+  size_t num_groups;
+
+  const oc_fb_group_t *groups = oc_resource_index_get_fb_groups(&num_groups);
+  for (i = 0; i < num_groups; i++) {
+    /* specific functional block iot_router : /f/netip */
+    if (groups[i].device == device_index &&
+        fb_group_is_listed(&groups[i], true)) {
+      if (*skipped < first_entry) {
+        (*skipped)++;
       } else {
-        /* regular functional block, framing by functional block numbers &
-         * instances*/
-        if ((strncmp(t, ":dpa", 4) == 0) ||
-            (strncmp(t, "urn:knx:dpa", 11) == 0)) {
-          int fp_int = get_fp_from_dp(t);
-          int instance = resource->fb_instance;
-          if ((fp_int > 0) && (is_in_g_array(fp_int, instance) == false)) {
-            store_in_array(fp_int, instance);
-            counter++;
-          }
+        /* add only once, this is not the first entry, so add the ,\n */
+        if (*response_length > 0) {
+          length = oc_rep_add_line_to_buffer(",\n");
+          *response_length += length;
         }
+        length = oc_rep_add_line_to_buffer("</f/netip>;rt=\":fb.11\";ct=40");
+        *response_length += length;
+        (*matches)++;
       }
+      break;
     }
   }
 
-  for (i = 0; i < g_array_size; i++) {
+  /* regular functional blocks, framing by functional block numbers &
+   * instances */
+  for (i = 0; i < num_groups; i++) {
+    const oc_fb_group_t *group = &groups[i];
+    if (group->device != device_index || !fb_group_is_listed(group, false)) {
+      continue;
+    }
     if (*skipped < first_entry) {
       (*skipped)++;
     } else if (first_entry + (*matches) >= last_entry) {
-      return matches;
+      return true;
     } else {
       if (*response_length > 0) {
         /* frame the trailing comma */
@@ -433,14 +364,14 @@ oc_add_function_blocks_to_response(oc_request_t *request, size_t device_index,
 
       length = oc_rep_add_line_to_buffer("</f/");
       *response_length += length;
-      if (g_int_array[1][i] > 0) {
+      if (group->instance > 0) {
         // functional block with instance with 2 numbers, e.g. <functional
         // block>_<instance>
-        snprintf(number, 23, "%05d_%02d", g_int_array[0][i], g_int_array[1][i]);
-        // snprintf(number, 23, "%d_%d", g_int_array[0][i], g_int_array[1][i]);
+        snprintf(number, 23, "%05d_%02d", group->fb, group->instance);
+        // snprintf(number, 23, "%d_%d", group->fb, group->instance);
       } else {
         // functional block with no instance, e.g. defaulting to instance 0.
-        snprintf(number, 5, "%d", g_int_array[0][i]);
+        snprintf(number, 5, "%d", group->fb);
       }
       length = oc_rep_add_line_to_buffer(number);
       *response_length += length;
@@ -453,7 +384,7 @@ oc_add_function_blocks_to_response(oc_request_t *request, size_t device_index,
       length = oc_rep_add_line_to_buffer(":fb.");
       *response_length += length;
       // e.g. max functional block is 12345
-      snprintf(number, 6, "%d", g_int_array[0][i]);
+      snprintf(number, 6, "%d", group->fb);
       length = oc_rep_add_line_to_buffer(number);
       *response_length += length;
       length = oc_rep_add_line_to_buffer("\";");
@@ -467,10 +398,6 @@ oc_add_function_blocks_to_response(oc_request_t *request, size_t device_index,
   }
 
   if (*matches > original_matches) {
-    if (g_nr_functional_blocks == 0) {
-      // store the counter so that we only have to do this once
-      g_nr_functional_blocks = counter;
-    }
     return true;
   }
 
@@ -21,6 +21,8 @@
 #include "oc_helpers.h"
 #include "oc_knx_helpers.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
@@ -33,22 +35,311 @@
 #ifndef GOT_MAX_ENTRIES
 #define GOT_MAX_ENTRIES 20
 #endif
-static oc_group_object_table_t g_got[GOT_MAX_ENTRIES];
 
 #ifdef OC_PUBLISHER_TABLE
 #ifndef GPT_MAX_ENTRIES
 #define GPT_MAX_ENTRIES 20
 #endif
-static oc_group_rp_table_t g_gpt[GPT_MAX_ENTRIES];
 #endif /* OC_PUBLISHER_TABLE */
 
 #ifndef GRT_MAX_ENTRIES
 #define GRT_MAX_ENTRIES 20
 #endif
-static oc_group_rp_table_t g_grt[GRT_MAX_ENTRIES];
+
+#define FP_STORE_NAME_SIZE (32)
+
+/*
+ * The tables of a device, with the routing table compiled from them.
+ * The entries are allocated to the sizes of the device, see
+ * oc_core_fp_set_device_table_sizes.
+ * The index-based functions of this module work on the tables of the selected
+ * device (g_fp), see oc_core_fp_select_device; the functions added for
+ * multiple devices take the tables as argument.
+ */
+typedef struct oc_fp_tables_t
+{
+  size_t device_index;
+  oc_group_object_table_t *got;
+  int got_size;
+#ifdef OC_PUBLISHER_TABLE
+  oc_group_rp_table_t *gpt;
+  int gpt_size;
+#endif /* OC_PUBLISHER_TABLE */
+  oc_group_rp_table_t *grt;
+  int grt_size;
+
+  // compiled group address routing table, see oc_core_find_group_route
+  oc_group_route_t *routes;
+  int routes_len;
+  int *route_recipients;
+  bool routes_valid;
+} oc_fp_tables_t;
+
+/*
+ * The tables with entries of the maximum sizes, used for device 0 and without
+ * dynamic allocation for all devices.
+ */
+typedef struct oc_fp_static_tables_t
+{
+  oc_fp_tables_t tables;
+  oc_group_object_table_t got[GOT_MAX_ENTRIES];
+#ifdef OC_PUBLISHER_TABLE
+  oc_group_rp_table_t gpt[GPT_MAX_ENTRIES];
+#endif /* OC_PUBLISHER_TABLE */
+  oc_group_rp_table_t grt[GRT_MAX_ENTRIES];
+} oc_fp_static_tables_t;
+
+#ifdef OC_DYNAMIC_ALLOCATION
+// the tables of the other devices are allocated when the device is added,
+// indexed by device index
+static oc_fp_static_tables_t g_fp_tables_0;
+static oc_fp_tables_t **g_fp_tables = NULL;
+static size_t g_fp_tables_len = 0;
+#define FP_STATIC_TABLES_0 (&g_fp_tables_0)
+#else  /* OC_DYNAMIC_ALLOCATION */
+static oc_fp_static_tables_t g_fp_tables_pool[OC_MAX_NUM_DEVICES];
+#define FP_STATIC_TABLES_0 (&g_fp_tables_pool[0])
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+// the table sizes of the devices that are added next
+static int g_fp_got_size = GOT_MAX_ENTRIES;
+#ifdef OC_PUBLISHER_TABLE
+static int g_fp_gpt_size = GPT_MAX_ENTRIES;
+#endif /* OC_PUBLISHER_TABLE */
+static int g_fp_grt_size = GRT_MAX_ENTRIES;
+
+// the selected device
+static oc_fp_tables_t *g_fp = &FP_STATIC_TABLES_0->tables;
+static size_t g_fp_device = 0;
+
+// the tables of the selected device
+#define g_got (g_fp->got)
+#define g_gpt (g_fp->gpt)
+#define g_grt (g_fp->grt)
 
 // -----------------------------------------------------------------------------
 
+static void
+oc_fp_init_static_tables(oc_fp_static_tables_t *storage, size_t device_index)
+{
+  oc_fp_tables_t *tables = &storage->tables;
+  tables->device_index = device_index;
+  tables->got = storage->got;
+  tables->got_size = GOT_MAX_ENTRIES;
+#ifdef OC_PUBLISHER_TABLE
+  tables->gpt = storage->gpt;
+  tables->gpt_size = GPT_MAX_ENTRIES;
+#endif /* OC_PUBLISHER_TABLE */
+  tables->grt = storage->grt;
+  tables->grt_size = GRT_MAX_ENTRIES;
+}
+
+static oc_fp_tables_t *
+oc_fp_get_tables(size_t device_index)
+{
+  if (device_index == 0) {
+    return &FP_STATIC_TABLES_0->tables;
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (device_index < g_fp_tables_len) {
+    return g_fp_tables[device_index];
+  }
+#else  /* OC_DYNAMIC_ALLOCATION */
+  if (device_index < OC_MAX_NUM_DEVICES) {
+    return &g_fp_tables_pool[device_index].tables;
+  }
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  return NULL;
+}
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static void
+oc_fp_release_tables(oc_fp_tables_t *tables)
+{
+  if (tables == NULL) {
+    return;
+  }
+  free(tables->got);
+#ifdef OC_PUBLISHER_TABLE
+  free(tables->gpt);
+#endif /* OC_PUBLISHER_TABLE */
+  free(tables->grt);
+  free(tables);
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+/*
+ * sets up the tables of a device that is added, with the configured sizes.
+ * device 0 always has the maximum sizes.
+ */
+static oc_fp_tables_t *
+oc_fp_alloc_tables(size_t device_index)
+{
+  if (device_index == 0) {
+    oc_fp_init_static_tables(FP_STATIC_TABLES_0, 0);
+    return &FP_STATIC_TABLES_0->tables;
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (device_index >= g_fp_tables_len) {
+    oc_fp_tables_t **tables = (oc_fp_tables_t **)realloc(
+      g_fp_tables, (device_index + 1) * sizeof(oc_fp_tables_t *));
+    if (tables == NULL) {
+      return NULL;
+    }
+    memset(&tables[g_fp_tables_len], 0,
+           (device_index + 1 - g_fp_tables_len) * sizeof(oc_fp_tables_t *));
+    g_fp_tables = tables;
+    g_fp_tables_len = device_index + 1;
+  }
+  if (g_fp_tables[device_index] != NULL) {
+    return g_fp_tables[device_index];
+  }
+  oc_fp_tables_t *tables = (oc_fp_tables_t *)calloc(1, sizeof(oc_fp_tables_t));
+  if (tables == NULL) {
+    return NULL;
+  }
+  tables->device_index = device_index;
+  tables->got_size = g_fp_got_size;
+  tables->got = (oc_group_object_table_t *)calloc(
+    tables->got_size, sizeof(oc_group_object_table_t));
+  bool allocated = tables->got != NULL;
+#ifdef OC_PUBLISHER_TABLE
+  tables->gpt_size = g_fp_gpt_size;
+  tables->gpt = (oc_group_rp_table_t *)calloc(tables->gpt_size,
+                                              sizeof(oc_group_rp_table_t));
+  allocated = allocated && tables->gpt != NULL;
+#endif /* OC_PUBLISHER_TABLE */
+  tables->grt_size = g_fp_grt_size;
+  tables->grt = (oc_group_rp_table_t *)calloc(tables->grt_size,
+                                              sizeof(oc_group_rp_table_t));
+  allocated = allocated && tables->grt != NULL;
+  if (!allocated) {
+    oc_fp_release_tables(tables);
+    return NULL;
+  }
+  g_fp_tables[device_index] = tables;
+  return tables;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  if (device_index >= OC_MAX_NUM_DEVICES) {
+    return NULL;
+  }
+  // the entries are static, only the used part is limited
+  oc_fp_tables_t *tables = &g_fp_tables_pool[device_index].tables;
+  oc_fp_init_static_tables(&g_fp_tables_pool[device_index], device_index);
+  tables->got_size = g_fp_got_size;
+#ifdef OC_PUBLISHER_TABLE
+  tables->gpt_size = g_fp_gpt_size;
+#endif /* OC_PUBLISHER_TABLE */
+  tables->grt_size = g_fp_grt_size;
+  return tables;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+}
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static void
+oc_fp_free_tables(size_t device_index)
+{
+  if (device_index == 0 || device_index >= g_fp_tables_len) {
+    return;
+  }
+  oc_fp_release_tables(g_fp_tables[device_index]);
+  g_fp_tables[device_index] = NULL;
+  // release the index with the last device
+  for (size_t i = 1; i < g_fp_tables_len; i++) {
+    if (g_fp_tables[i] != NULL) {
+      return;
+    }
+  }
+  free(g_fp_tables);
+  g_fp_tables = NULL;
+  g_fp_tables_len = 0;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+bool
+oc_core_fp_set_device_table_sizes(int got_size, int gpt_size, int grt_size)
+{
+  if (got_size <= 0 || got_size > GOT_MAX_ENTRIES || grt_size <= 0 ||
+      grt_size > GRT_MAX_ENTRIES) {
+    return false;
+  }
+#ifdef OC_PUBLISHER_TABLE
+  if (gpt_size <= 0 || gpt_size > GPT_MAX_ENTRIES) {
+    return false;
+  }
+  g_fp_gpt_size = gpt_size;
+#else  /* OC_PUBLISHER_TABLE */
+  (void)gpt_size;
+#endif /* !OC_PUBLISHER_TABLE */
+  g_fp_got_size = got_size;
+  g_fp_grt_size = grt_size;
+  return true;
+}
+
+static void
+oc_fp_reset_device_table_sizes(void)
+{
+  g_fp_got_size = GOT_MAX_ENTRIES;
+#ifdef OC_PUBLISHER_TABLE
+  g_fp_gpt_size = GPT_MAX_ENTRIES;
+#endif /* OC_PUBLISHER_TABLE */
+  g_fp_grt_size = GRT_MAX_ENTRIES;
+}
+
+bool
+oc_core_fp_select_device(size_t device_index)
+{
+  oc_fp_tables_t *tables = oc_fp_get_tables(device_index);
+  if (tables == NULL) {
+    return false;
+  }
+  g_fp = tables;
+  g_fp_device = device_index;
+  return true;
+}
+
+size_t
+oc_core_fp_get_selected_device(void)
+{
+  return g_fp_device;
+}
+
+size_t
+oc_core_fp_get_device_tables_size(size_t device_index)
+{
+  const oc_fp_tables_t *tables = oc_fp_get_tables(device_index);
+  if (tables == NULL) {
+    return 0;
+  }
+  if (device_index == 0) {
+    return sizeof(oc_fp_static_tables_t);
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  size_t size = sizeof(oc_fp_tables_t);
+  size += tables->got_size * sizeof(oc_group_object_table_t);
+#ifdef OC_PUBLISHER_TABLE
+  size += tables->gpt_size * sizeof(oc_group_rp_table_t);
+#endif /* OC_PUBLISHER_TABLE */
+  size += tables->grt_size * sizeof(oc_group_rp_table_t);
+  return size;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  return sizeof(oc_fp_static_tables_t);
+#endif /* !OC_DYNAMIC_ALLOCATION */
+}
+
+// device 0 keeps the names of single device builds
+static void
+oc_fp_store_name(const oc_fp_tables_t *tables, char *filename,
+                 const char *store, int entry)
+{
+  if (tables->device_index == 0) {
+    snprintf(filename, FP_STORE_NAME_SIZE, "%s_%d", store, entry);
+  } else {
+    snprintf(filename, FP_STORE_NAME_SIZE, "%s_%u_%d", store,
+             (unsigned)tables->device_index, entry);
+  }
+}
+
 static void oc_print_group_rp_table_entry(int entry, char *Store,
                                           oc_group_rp_table_t *rp_table,
                                           int max_size);
@@ -75,6 +366,10 @@ static void oc_delete_group_rp_table_entry(int entry, char *Store,
                                            oc_group_rp_table_t *rp_table,
                                            int max_size);
 
+static void oc_free_group_routes(oc_fp_tables_t *tables);
+
+static void oc_free_group_memberships(void);
+
 // -----------------------------------------------------------------------------
 
 int
@@ -135,7 +430,7 @@ find_empty_slot_in_group_object_table(int id)
   }
 
   /* empty slot */
-  for (int i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->got_size; i++) {
     if (g_got[i].id == -1) {
       return i;
     }
@@ -146,9 +441,10 @@ find_empty_slot_in_group_object_table(int id)
 int
 oc_core_set_group_object_table(int index, oc_group_object_table_t entry)
 {
-  if (index >= oc_core_get_group_object_table_total_size()) {
+  if (index < 0 || index >= oc_core_get_group_object_table_total_size()) {
     OC_ERR("index too large index:%d %d", index,
            oc_core_get_group_object_table_total_size());
+    return -1;
   }
   g_got[index].cflags = entry.cflags;
   g_got[index].id = entry.id;
@@ -177,7 +473,7 @@ oc_core_set_group_object_table(int index, oc_group_object_table_t entry)
 int
 oc_core_get_group_object_table_total_size()
 {
-  return GOT_MAX_ENTRIES;
+  return g_fp->got_size;
 }
 
 oc_group_object_table_t *
@@ -186,7 +482,7 @@ oc_core_get_group_object_table_entry(int index)
   if (index < 0) {
     return NULL;
   }
-  if (index >= GOT_MAX_ENTRIES) {
+  if (index >= g_fp->got_size) {
     return NULL;
   }
   return &g_got[index];
@@ -195,7 +491,7 @@ oc_core_get_group_object_table_entry(int index)
 int
 oc_core_find_index_in_group_object_table_from_id(int id)
 {
-  for (int i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->got_size; i++) {
     if (g_got[i].id == id) {
       return i;
     }
@@ -207,7 +503,7 @@ int
 oc_core_find_group_object_table_index(uint32_t group_address)
 {
   int i, j;
-  for (i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (i = 0; i < g_fp->got_size; i++) {
 
     if (g_got[i].id > -1) {
       for (j = 0; j < g_got[i].ga_len; j++) {
@@ -229,7 +525,7 @@ oc_core_find_next_group_object_table_index(uint32_t group_address,
   }
 
   int i, j;
-  for (i = cur_index + 1; i < GOT_MAX_ENTRIES; i++) {
+  for (i = cur_index + 1; i < g_fp->got_size; i++) {
 
     if (g_got[i].id > -1) {
       for (j = 0; j < g_got[i].ga_len; j++) {
@@ -245,7 +541,7 @@ oc_core_find_next_group_object_table_index(uint32_t group_address,
 oc_string_t
 oc_core_find_group_object_table_url_from_index(int index)
 {
-  // if (index < GOT_MAX_ENTRIES) {
+  // if (index < g_fp->got_size) {
   return g_got[index].href;
   //}
   // return oc_string_t();
@@ -254,7 +550,7 @@ oc_core_find_group_object_table_url_from_index(int index)
 oc_cflag_mask_t
 oc_core_group_object_table_cflag_entries(int index)
 {
-  if (index < GOT_MAX_ENTRIES) {
+  if (index < g_fp->got_size) {
     return g_got[index].cflags;
   }
   return 0;
@@ -263,7 +559,7 @@ oc_core_group_object_table_cflag_entries(int index)
 int
 oc_core_find_group_object_table_number_group_entries(int index)
 {
-  if (index < GOT_MAX_ENTRIES) {
+  if (index < g_fp->got_size) {
     return g_got[index].ga_len;
   }
   return 0;
@@ -272,7 +568,7 @@ oc_core_find_group_object_table_number_group_entries(int index)
 int
 oc_core_find_group_object_table_group_entry(int index, int entry)
 {
-  if (index < GOT_MAX_ENTRIES) {
+  if (index < g_fp->got_size) {
     if (entry < g_got[index].ga_len) {
       return g_got[index].ga[entry];
     }
@@ -285,7 +581,7 @@ oc_core_find_group_object_table_url(const char *url)
 {
   int i;
   size_t url_len = strlen(url);
-  for (i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (i = 0; i < g_fp->got_size; i++) {
     if ((url_len == oc_string_len(g_got[i].href)) &&
         (strcmp(url, oc_string(g_got[i].href)) == 0)) {
       return i;
@@ -303,7 +599,7 @@ oc_core_find_next_group_object_table_url(const char *url, int cur_index)
 
   int i;
   size_t url_len = strlen(url);
-  for (i = cur_index + 1; i < GOT_MAX_ENTRIES; i++) {
+  for (i = cur_index + 1; i < g_fp->got_size; i++) {
     if ((url_len == oc_string_len(g_got[i].href)) &&
         (strcmp(url, oc_string(g_got[i].href)) == 0)) {
       return i;
@@ -316,7 +612,7 @@ int
 oc_core_find_nr_used_in_group_object_table()
 {
   int counter = 0;
-  for (int i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->got_size; i++) {
     if (g_got[i].id > -1) {
       counter++;
     }
@@ -329,7 +625,7 @@ int
 oc_core_find_nr_used_in_group_publisher_table()
 {
   int counter = 0;
-  for (int i = 0; i < GPT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->gpt_size; i++) {
     if (g_gpt[i].id > -1) {
       counter++;
     }
@@ -342,7 +638,7 @@ int
 oc_core_find_nr_used_in_group_recipient_table()
 {
   int counter = 0;
-  for (int i = 0; i < GRT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->grt_size; i++) {
     if (g_grt[i].id > -1) {
       counter++;
     }
@@ -385,8 +681,8 @@ oc_core_fp_g_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   bool ps_exists = false;
   bool total_exists = false;
   int total = oc_core_find_nr_used_in_group_object_table();
-  int first_entry = 0;              // inclusive
-  int last_entry = GOT_MAX_ENTRIES; // exclusive
+  int first_entry = 0;             // inclusive
+  int last_entry = g_fp->got_size; // exclusive
   // int query_ps = -1;
   int query_pn = -1;
   bool more_request_needed =
@@ -810,7 +1106,7 @@ int
 oc_core_find_publisher_table_index(uint32_t group_address)
 {
   int i, j;
-  for (i = 0; i < GPT_MAX_ENTRIES; i++) {
+  for (i = 0; i < g_fp->gpt_size; i++) {
 
     if (g_gpt[i].id > -1) {
       for (j = 0; j < g_gpt[i].ga_len; j++) {
@@ -843,8 +1139,8 @@ oc_core_fp_p_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   bool ps_exists = false;
   bool total_exists = false;
   int total = oc_core_find_nr_used_in_group_publisher_table();
-  int first_entry = 0;              // inclusive
-  int last_entry = GPT_MAX_ENTRIES; // exclusive
+  int first_entry = 0;             // inclusive
+  int last_entry = g_fp->gpt_size; // exclusive
   // int query_ps = -1;
   int query_pn = -1;
   bool more_request_needed =
@@ -979,6 +1275,7 @@ oc_core_fp_p_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
         }
       }
       g_gpt[index].id = id;
+      oc_core_invalidate_group_routes();
 
       bool id_only = true;
       int mandatory_items = 0; // Needs to be 2 for creating entry, i.e. id & ga
@@ -1063,13 +1360,11 @@ oc_core_fp_p_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
       if (id_only) {
         PRINT("  only found id in request, deleting entry at index: %d\n",
               index);
-        oc_delete_group_rp_table_entry(index, GPT_STORE, g_gpt,
-                                       GPT_MAX_ENTRIES);
+        oc_delete_group_rp_table_entry(index, GPT_STORE, g_gpt, g_fp->gpt_size);
       } else if (return_status == OC_STATUS_CREATED &&
                  (mandatory_items != 2 || !identifier_exists)) {
         PRINT("Mandatory items missing!\n");
-        oc_delete_group_rp_table_entry(index, GPT_STORE, g_gpt,
-                                       GPT_MAX_ENTRIES);
+        oc_delete_group_rp_table_entry(index, GPT_STORE, g_gpt, g_fp->gpt_size);
         oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
         return;
       } else {
@@ -1228,7 +1523,7 @@ oc_core_fp_p_x_del_handler(oc_request_t *request,
   }
 
   // delete the entry
-  oc_delete_group_rp_table_entry(index, GPT_STORE, g_gpt, GPT_MAX_ENTRIES);
+  oc_delete_group_rp_table_entry(index, GPT_STORE, g_gpt, g_fp->gpt_size);
 
   // make the change persistent
   oc_dump_group_rp_table_entry(index, GPT_STORE, g_gpt,
@@ -1274,8 +1569,8 @@ oc_core_fp_r_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   bool ps_exists = false;
   bool total_exists = false;
   int total = oc_core_find_nr_used_in_group_recipient_table();
-  int first_entry = 0;              // inclusive
-  int last_entry = GRT_MAX_ENTRIES; // exclusive
+  int first_entry = 0;             // inclusive
+  int last_entry = g_fp->grt_size; // exclusive
   // int query_ps = -1;
   int query_pn = -1;
   bool more_request_needed =
@@ -1416,6 +1711,7 @@ oc_core_fp_r_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
         g_grt[index].mt = 4;
       }
       g_grt[index].id = id;
+      oc_core_invalidate_group_routes();
 
       bool id_only = true;
       int mandatory_items = 0; // Needs to be 2 for creating entry, i.e. id & ga
@@ -1513,13 +1809,11 @@ oc_core_fp_r_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
       if (id_only) {
         PRINT("  only found id in request, deleting entry at index: %d\n",
               index);
-        oc_delete_group_rp_table_entry(index, GRT_STORE, g_grt,
-                                       GRT_MAX_ENTRIES);
+        oc_delete_group_rp_table_entry(index, GRT_STORE, g_grt, g_fp->grt_size);
       } else if (return_status == OC_STATUS_CREATED &&
                  (mandatory_items != 2 || !identifier_exists)) {
         PRINT("Mandatory items missing!\n");
-        oc_delete_group_rp_table_entry(index, GRT_STORE, g_grt,
-                                       GRT_MAX_ENTRIES);
+        oc_delete_group_rp_table_entry(index, GRT_STORE, g_grt, g_fp->grt_size);
         oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
         return;
       } else {
@@ -1533,11 +1827,10 @@ oc_core_fp_r_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
           OC_ERR("  path is longer than %d \n", (int)OC_MAX_URL_LENGTH);
         }
 
-        oc_print_group_rp_table_entry(index, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
+        oc_print_group_rp_table_entry(index, GRT_STORE, g_grt, g_fp->grt_size);
         if (do_save) {
           PRINT("  storing at %d\n", index);
-          oc_dump_group_rp_table_entry(index, GRT_STORE, g_grt,
-                                       GRT_MAX_ENTRIES);
+          oc_dump_group_rp_table_entry(index, GRT_STORE, g_grt, g_fp->grt_size);
         }
       }
     }
@@ -1589,7 +1882,7 @@ oc_core_fp_r_x_get_handler(oc_request_t *request,
     oc_string(request->resource->uri), oc_string_len(request->resource->uri),
     request->uri_path, request->uri_path_len);
   int index =
-    oc_core_find_index_in_rp_table_from_id(id, g_grt, GRT_MAX_ENTRIES);
+    oc_core_find_index_in_rp_table_from_id(id, g_grt, g_fp->grt_size);
 
   PRINT("  id:%d index = %d\n", id, index);
 
@@ -1659,7 +1952,7 @@ oc_core_fp_r_x_del_handler(oc_request_t *request,
     oc_string(request->resource->uri), oc_string_len(request->resource->uri),
     request->uri_path, request->uri_path_len);
   int index =
-    oc_core_find_index_in_rp_table_from_id(id, g_grt, GRT_MAX_ENTRIES);
+    oc_core_find_index_in_rp_table_from_id(id, g_grt, g_fp->grt_size);
 
   if (index == -1) {
     oc_send_response_no_format(request, OC_STATUS_NOT_FOUND);
@@ -1668,10 +1961,10 @@ oc_core_fp_r_x_del_handler(oc_request_t *request,
   PRINT("oc_core_fp_r_x_del_handler: deleting id %d at index %d\n", id, index);
 
   // delete the entry
-  oc_delete_group_rp_table_entry(index, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
+  oc_delete_group_rp_table_entry(index, GRT_STORE, g_grt, g_fp->grt_size);
 
   // make the change persistent
-  oc_dump_group_rp_table_entry(index, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
+  oc_dump_group_rp_table_entry(index, GRT_STORE, g_grt, g_fp->grt_size);
   oc_knx_increase_fingerprint();
 
   PRINT("oc_core_fp_r_x_del_handler - end\n");
@@ -1699,7 +1992,7 @@ bool
 oc_core_check_recipient_index_on_group_address(int index,
                                                uint32_t group_address)
 {
-  if (index >= GRT_MAX_ENTRIES) {
+  if (index >= g_fp->grt_size) {
     return -1;
   }
   if (group_address <= 0) {
@@ -1716,7 +2009,7 @@ oc_core_check_recipient_index_on_group_address(int index,
 uint32_t
 oc_core_get_recipient_ia(int index)
 {
-  if (index >= GRT_MAX_ENTRIES) {
+  if (index >= g_fp->grt_size) {
     return 0;
   }
 
@@ -1726,7 +2019,7 @@ oc_core_get_recipient_ia(int index)
 char *
 oc_core_get_recipient_index_url_or_path(int index)
 {
-  if (index >= GRT_MAX_ENTRIES) {
+  if (index >= g_fp->grt_size) {
     return NULL;
   }
 
@@ -1834,8 +2127,8 @@ oc_print_group_object_table_entry(int entry)
 void
 oc_dump_group_object_table_entry(int entry)
 {
-  char filename[20];
-  snprintf(filename, 20, "%s_%d", GOT_STORE, entry);
+  char filename[FP_STORE_NAME_SIZE];
+  oc_fp_store_name(g_fp, filename, GOT_STORE, entry);
 
   uint8_t *buf = malloc(OC_MAX_APP_DATA_SIZE);
   if (!buf)
@@ -1876,8 +2169,8 @@ void
 oc_load_group_object_table_entry(int entry)
 {
   long ret = 0;
-  char filename[20];
-  snprintf(filename, 20, "%s_%d", GOT_STORE, entry);
+  char filename[FP_STORE_NAME_SIZE];
+  oc_fp_store_name(g_fp, filename, GOT_STORE, entry);
 
   oc_rep_t *rep, *head;
 
@@ -1947,7 +2240,7 @@ void
 oc_load_group_object_table()
 {
   PRINT("Loading Group Object Table from Persistent storage\n");
-  for (int i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->got_size; i++) {
     oc_load_group_object_table_entry(i);
     oc_print_group_object_table_entry(i);
   }
@@ -1970,8 +2263,8 @@ oc_free_group_object_table_entry(int entry, bool init)
 void
 oc_delete_group_object_table_entry(int entry)
 {
-  char filename[20];
-  snprintf(filename, 20, "%s_%d", GOT_STORE, entry);
+  char filename[FP_STORE_NAME_SIZE];
+  oc_fp_store_name(g_fp, filename, GOT_STORE, entry);
   oc_storage_erase(filename);
 
   oc_free_group_object_table_entry(entry, false);
@@ -1981,7 +2274,7 @@ void
 oc_delete_group_object_table()
 {
   PRINT("Deleting Group Object Table from Persistent storage\n");
-  for (int i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->got_size; i++) {
     oc_delete_group_object_table_entry(i);
     oc_print_group_object_table_entry(i);
   }
@@ -1991,7 +2284,7 @@ void
 oc_free_group_object_table()
 {
   PRINT("Free Group Object Table\n");
-  for (int i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->got_size; i++) {
     oc_free_group_object_table_entry(i, false);
   }
 }
@@ -2071,8 +2364,8 @@ oc_dump_group_rp_table_entry(int entry, char *Store,
                              oc_group_rp_table_t *rp_table, int max_size)
 {
   (void)max_size;
-  char filename[20];
-  snprintf(filename, 20, "%s_%d", Store, entry);
+  char filename[FP_STORE_NAME_SIZE];
+  oc_fp_store_name(g_fp, filename, Store, entry);
   // PRINT("oc_dump_group_rp_table_entry %s, fname=%s\n", Store, filename);
 
   uint8_t *buf = malloc(RP_ENTRY_MAX_SIZE);
@@ -2129,8 +2422,8 @@ oc_load_group_rp_table_entry(int entry, char *Store,
 {
   (void)max_size;
   long ret = 0;
-  char filename[20];
-  snprintf(filename, 20, "%s_%d", Store, entry);
+  char filename[FP_STORE_NAME_SIZE];
+  oc_fp_store_name(g_fp, filename, Store, entry);
 
   oc_rep_t *rep, *head;
 
@@ -2141,6 +2434,7 @@ oc_load_group_rp_table_entry(int entry, char *Store,
 
   ret = oc_storage_read(filename, buf, OC_MAX_APP_DATA_SIZE);
   if (ret > 0) {
+    oc_core_invalidate_group_routes();
     struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0, 0 };
     oc_rep_set_pool(&rep_objects);
     int err = oc_parse_rep(buf, ret, &rep);
@@ -2223,9 +2517,9 @@ oc_load_rp_object_table()
 {
 
   PRINT("Loading Group Recipient Table from Persistent storage\n");
-  for (int i = 0; i < GRT_MAX_ENTRIES; i++) {
-    oc_load_group_rp_table_entry(i, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
-    oc_print_group_rp_table_entry(i, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
+  for (int i = 0; i < g_fp->grt_size; i++) {
+    oc_load_group_rp_table_entry(i, GRT_STORE, g_grt, g_fp->grt_size);
+    oc_print_group_rp_table_entry(i, GRT_STORE, g_grt, g_fp->grt_size);
   }
 
 #ifdef OC_PUBLISHER_TABLE
@@ -2246,6 +2540,7 @@ oc_free_group_rp_table_entry(int entry, char *Store,
 {
   (void)max_size;
   (void)Store;
+  oc_core_invalidate_group_routes();
   rp_table[entry].id = -1;
   rp_table[entry].ia = -1;
   rp_table[entry].iid = -1;
@@ -2265,8 +2560,8 @@ static void
 oc_delete_group_rp_table_entry(int entry, char *Store,
                                oc_group_rp_table_t *rp_table, int max_size)
 {
-  char filename[20];
-  snprintf(filename, 20, "%s_%d", Store, entry);
+  char filename[FP_STORE_NAME_SIZE];
+  oc_fp_store_name(g_fp, filename, Store, entry);
   oc_storage_erase(filename);
 
   oc_free_group_rp_table_entry(entry, Store, rp_table, max_size, false);
@@ -2276,9 +2571,9 @@ void
 oc_delete_group_rp_table()
 {
   PRINT("Deleting Group Recipient Table from Persistent storage\n");
-  for (int i = 0; i < GRT_MAX_ENTRIES; i++) {
-    oc_delete_group_rp_table_entry(i, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
-    oc_print_group_rp_table_entry(i, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
+  for (int i = 0; i < g_fp->grt_size; i++) {
+    oc_delete_group_rp_table_entry(i, GRT_STORE, g_grt, g_fp->grt_size);
+    oc_print_group_rp_table_entry(i, GRT_STORE, g_grt, g_fp->grt_size);
   }
 
 #ifdef OC_PUBLISHER_TABLE
@@ -2296,8 +2591,8 @@ void
 oc_free_group_rp_table()
 {
   PRINT("Free Group Recipient Table from Persistent storage\n");
-  for (int i = 0; i < GRT_MAX_ENTRIES; i++) {
-    oc_free_group_rp_table_entry(i, GRT_STORE, g_grt, GRT_MAX_ENTRIES, false);
+  for (int i = 0; i < g_fp->grt_size; i++) {
+    oc_free_group_rp_table_entry(i, GRT_STORE, g_grt, g_fp->grt_size, false);
   }
 
 #ifdef OC_PUBLISHER_TABLE
@@ -2307,6 +2602,7 @@ oc_free_group_rp_table()
                                  oc_core_get_publisher_table_size(), false);
   }
 #endif /*  OC_PUBLISHER_TABLE */
+  oc_free_group_routes(g_fp);
 }
 
 int
@@ -2350,6 +2646,8 @@ oc_core_add_rp_entry(int index, oc_group_rp_table_t *rp_table,
            rp_table_size);
   }
 
+  oc_core_invalidate_group_routes();
+
   // Store entries
   rp_table[index].id = entry.id;
   rp_table[index].iid = entry.iid;
@@ -2385,7 +2683,7 @@ oc_core_add_recipient_entry(int index, oc_group_rp_table_t entry)
 int
 oc_core_get_recipient_table_size()
 {
-  return GRT_MAX_ENTRIES;
+  return g_fp->grt_size;
 }
 
 oc_group_rp_table_t *
@@ -2394,7 +2692,7 @@ oc_core_get_recipient_table_entry(int index)
   if (index < 0) {
     return NULL;
   }
-  if (index >= GRT_MAX_ENTRIES) {
+  if (index >= g_fp->grt_size) {
     return NULL;
   }
   return &g_grt[index];
@@ -2404,7 +2702,7 @@ int
 oc_core_get_publisher_table_size()
 {
 #ifdef OC_PUBLISHER_TABLE
-  return GPT_MAX_ENTRIES;
+  return g_fp->gpt_size;
 #else
   return 0;
 #endif
@@ -2470,16 +2768,16 @@ oc_init_tables()
 {
 #ifdef OC_PUBLISHER_TABLE
   for (int i = 0; i < oc_core_get_publisher_table_size(); i++) {
-    // oc_delete_group_rp_table_entry(i, GPT_STORE, g_gpt, GPT_MAX_ENTRIES);
+    // oc_delete_group_rp_table_entry(i, GPT_STORE, g_gpt, g_fp->gpt_size);
     oc_free_group_rp_table_entry(i, GPT_STORE, g_gpt,
                                  oc_core_get_publisher_table_size(), true);
   }
 #endif /* OC_PUBLISHER_TABLE */
-  for (int i = 0; i < GRT_MAX_ENTRIES; i++) {
-    // oc_delete_group_rp_table_entry(i, GRT_STORE, g_grt, GRT_MAX_ENTRIES);
-    oc_free_group_rp_table_entry(i, GRT_STORE, g_grt, GRT_MAX_ENTRIES, true);
+  for (int i = 0; i < g_fp->grt_size; i++) {
+    // oc_delete_group_rp_table_entry(i, GRT_STORE, g_grt, g_fp->grt_size);
+    oc_free_group_rp_table_entry(i, GRT_STORE, g_grt, g_fp->grt_size, true);
   }
-  for (int i = 0; i < GOT_MAX_ENTRIES; i++) {
+  for (int i = 0; i < g_fp->got_size; i++) {
     oc_free_group_object_table_entry(i, true);
     // oc_delete_group_object_table_entry(i);
   }
@@ -2506,9 +2804,22 @@ oc_create_knx_fp_resources(size_t device_index)
     oc_create_fp_r_resource(OC_KNX_FP_R, device_index);
     oc_create_fp_r_x_resource(OC_KNX_FP_R_X, device_index);
   }
+  oc_fp_tables_t *tables = oc_fp_alloc_tables(device_index);
+  if (tables == NULL) {
+    OC_ERR("oc_create_knx_fp_resources: no tables for device %u",
+           (unsigned)device_index);
+    return;
+  }
+  PRINT("oc_create_knx_fp_resources: device %u got %d grt %d, %u bytes\n",
+        (unsigned)device_index, tables->got_size, tables->grt_size,
+        (unsigned)oc_core_fp_get_device_tables_size(device_index));
+
+  size_t selected = g_fp_device;
+  oc_core_fp_select_device(device_index);
   oc_init_tables();
   oc_load_group_object_table();
   oc_load_rp_object_table();
+  oc_core_fp_select_device(selected);
 
   // oc_register_group_multicasts();
 }
@@ -2516,8 +2827,25 @@ oc_create_knx_fp_resources(size_t device_index)
 void
 oc_free_knx_fp_resources(size_t device_index)
 {
+  size_t selected = g_fp_device;
+  if (!oc_core_fp_select_device(device_index)) {
+    return;
+  }
   oc_free_group_rp_table();
   oc_free_group_object_table();
+  if (device_index == 0) {
+    // shared by all devices
+    oc_free_group_memberships();
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  oc_fp_free_tables(device_index);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  if (device_index == 0) {
+    oc_fp_reset_device_table_sizes();
+  }
+  if (!oc_core_fp_select_device(selected)) {
+    oc_core_fp_select_device(0);
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -2556,7 +2884,7 @@ oc_add_points_in_group_object_table_to_response(oc_request_t *request,
   PRINT("oc_add_points_in_group_object_table_to_response %d\n", group_address);
 
   int index;
-  for (index = 0; index < GOT_MAX_ENTRIES; index++) {
+  for (index = 0; index < g_fp->got_size; index++) {
     if (g_got[index].id > -1) {
       if (is_in_array(group_address, g_got[index].ga, g_got[index].ga_len)) {
         // add the resource
@@ -2718,117 +3046,500 @@ oc_find_grpid_in_table(oc_group_rp_table_t *rp_table, int max_size,
 uint32_t
 oc_find_grpid_in_publisher_table(uint32_t group_address)
 {
-  return oc_find_grpid_in_table(g_gpt, oc_core_get_publisher_table_size(),
-                                group_address);
+  const oc_group_route_t *route = oc_core_find_group_route(group_address);
+  if (route) {
+    return route->pub_grpid;
+  }
+  return 0;
 }
 
 uint32_t
 oc_find_grpid_in_recipient_table(uint32_t group_address)
 {
-  return oc_find_grpid_in_table(g_grt, GRT_MAX_ENTRIES, group_address);
+  const oc_group_route_t *route = oc_core_find_group_route(group_address);
+  if (route) {
+    return route->grpid;
+  }
+  return 0;
 }
 
-void
-oc_register_group_multicasts()
+// -----------------------------------------------------------------------------
+
+static int
+oc_compare_ga(const void *a, const void *b)
 {
-  // installation id will be used as ULA prefix
-  oc_device_info_t *device = oc_core_get_device_info(0);
-  if (!device) {
-    PRINT("oc_register_group_multicasts: no device info\n");
+  uint32_t ga_a = *(const uint32_t *)a;
+  uint32_t ga_b = *(const uint32_t *)b;
+  if (ga_a < ga_b) {
+    return -1;
+  }
+  return (ga_a > ga_b) ? 1 : 0;
+}
+
+static oc_group_route_t *
+oc_lookup_group_route(const oc_fp_tables_t *tables, uint32_t group_address)
+{
+  int low = 0;
+  int high = tables->routes_len - 1;
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    if (tables->routes[mid].ga == group_address) {
+      return &tables->routes[mid];
+    }
+    if (tables->routes[mid].ga < group_address) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return NULL;
+}
+
+static void
+oc_free_group_routes(oc_fp_tables_t *tables)
+{
+  free(tables->routes);
+  free(tables->route_recipients);
+  tables->routes = NULL;
+  tables->route_recipients = NULL;
+  tables->routes_len = 0;
+  tables->routes_valid = false;
+}
+
+static int
+oc_count_ga_in_rp_table(oc_group_rp_table_t *rp_table, int max_size)
+{
+  int count = 0;
+  for (int i = 0; i < max_size; i++) {
+    if (rp_table[i].ga != NULL && rp_table[i].ga_len > 0) {
+      count += rp_table[i].ga_len;
+    }
+  }
+  return count;
+}
+
+static int
+oc_add_ga_of_rp_table(uint32_t *ga_list, int count,
+                      oc_group_rp_table_t *rp_table, int max_size)
+{
+  for (int i = 0; i < max_size; i++) {
+    if (rp_table[i].ga == NULL) {
+      continue;
+    }
+    for (int j = 0; j < rp_table[i].ga_len; j++) {
+      ga_list[count++] = rp_table[i].ga[j];
+    }
+  }
+  return count;
+}
+
+/*
+ * The route table is compiled in 3 steps:
+ * 1) collect all group addresses of /fp/r and /fp/p, sort and make them
+ *    unique, this gives the (sorted) list of routes
+ * 2) assign the grpid of the first table entry containing the group address
+ *    and count the unicast recipients per route
+ * 3) fill in the recipient indexes, grouped per route
+ */
+static void
+oc_compile_group_routes(oc_fp_tables_t *tables)
+{
+  oc_free_group_routes(tables);
+
+  int nr_ga = oc_count_ga_in_rp_table(tables->grt, tables->grt_size);
+#ifdef OC_PUBLISHER_TABLE
+  nr_ga += oc_count_ga_in_rp_table(tables->gpt, tables->gpt_size);
+#endif /* OC_PUBLISHER_TABLE */
+  if (nr_ga == 0) {
+    tables->routes_valid = true;
     return;
   }
-  int64_t installation_id = device->iid;
-  uint32_t port = device->mport;
 
-  PRINT("oc_register_group_multicasts: mport %d \n", port);
+  uint32_t *ga_list = (uint32_t *)malloc(nr_ga * sizeof(uint32_t));
+  if (ga_list == NULL) {
+    OC_ERR("oc_compile_group_routes: out of memory");
+    return;
+  }
+  int count = oc_add_ga_of_rp_table(ga_list, 0, tables->grt, tables->grt_size);
+#ifdef OC_PUBLISHER_TABLE
+  count = oc_add_ga_of_rp_table(ga_list, count, tables->gpt, tables->gpt_size);
+#endif /* OC_PUBLISHER_TABLE */
+  qsort(ga_list, count, sizeof(uint32_t), oc_compare_ga);
 
-  bool registered_pub = false;
-  bool pub_entry = false;
+  int nr_routes = 0;
+  for (int i = 0; i < count; i++) {
+    if (i == 0 || ga_list[i] != ga_list[i - 1]) {
+      ga_list[nr_routes++] = ga_list[i];
+    }
+  }
 
-  int index;
-  for (index = 0; index < oc_core_get_publisher_table_size(); index++) {
-    uint32_t grpid = g_gpt[index].grpid;
-    if (grpid > 0) {
-      pub_entry = true;
-      break;
+  tables->routes =
+    (oc_group_route_t *)calloc(nr_routes, sizeof(oc_group_route_t));
+  if (tables->routes == NULL) {
+    OC_ERR("oc_compile_group_routes: out of memory");
+    free(ga_list);
+    return;
+  }
+  for (int i = 0; i < nr_routes; i++) {
+    tables->routes[i].ga = ga_list[i];
+  }
+  tables->routes_len = nr_routes;
+  free(ga_list);
+
+  // loop backwards over the tables, so that the grpid of the first entry
+  // containing the group address is the one that is kept
+#ifdef OC_PUBLISHER_TABLE
+  for (int i = tables->gpt_size - 1; i >= 0; i--) {
+    const oc_group_rp_table_t *entry = &tables->gpt[i];
+    for (int j = 0; entry->ga && j < entry->ga_len; j++) {
+      oc_group_route_t *route = oc_lookup_group_route(tables, entry->ga[j]);
+      route->pub_grpid = entry->grpid;
+    }
+  }
+#endif /* OC_PUBLISHER_TABLE */
+  int nr_recipients = 0;
+  for (int i = tables->grt_size - 1; i >= 0; i--) {
+    const oc_group_rp_table_t *entry = &tables->grt[i];
+    for (int j = 0; entry->ga && j < entry->ga_len; j++) {
+      oc_group_route_t *route = oc_lookup_group_route(tables, entry->ga[j]);
+      route->grpid = entry->grpid;
+      // a group address listed twice in the same entry is sent only once
+      if (entry->ia > 0 && is_in_array(entry->ga[j], entry->ga, j) == false) {
+        route->nr_recipients++;
+        nr_recipients++;
+      }
     }
   }
-  if (pub_entry == true) {
-    for (index = 0; index < oc_core_get_publisher_table_size(); index++) {
-      int nr_entries = g_got[index].ga_len;
 
-      oc_cflag_mask_t cflags = g_got[index].cflags;
-      // check if the group address is used for receiving.
-      // e.g. WRITE or UPDATE
-      if (((cflags & OC_CFLAG_WRITE) > 0) || ((cflags & OC_CFLAG_UPDATE) > 0) ||
-          ((cflags & OC_CFLAG_READ) > 0)) {
+  if (nr_recipients > 0) {
+    tables->route_recipients = (int *)malloc(nr_recipients * sizeof(int));
+    if (tables->route_recipients == NULL) {
+      OC_ERR("oc_compile_group_routes: out of memory");
+      oc_free_group_routes(tables);
+      return;
+    }
+  }
+  int offset = 0;
+  for (int i = 0; i < tables->routes_len; i++) {
+    tables->routes[i].first = offset;
+    offset += tables->routes[i].nr_recipients;
+    tables->routes[i].nr_recipients = 0;
+  }
+  for (int i = 0; i < tables->grt_size; i++) {
+    const oc_group_rp_table_t *entry = &tables->grt[i];
+    if (entry->ia <= 0) {
+      continue;
+    }
+    for (int j = 0; entry->ga && j < entry->ga_len; j++) {
+      if (is_in_array(entry->ga[j], entry->ga, j) == false) {
+        oc_group_route_t *route = oc_lookup_group_route(tables, entry->ga[j]);
+        tables->route_recipients[route->first + route->nr_recipients++] = i;
+      }
+    }
+  }
 
-        for (int i = 0; i < nr_entries; i++) {
-          uint32_t grpid = oc_find_grpid_in_table(
-            g_gpt, oc_core_get_publisher_table_size(), g_got[index].ga[i]);
+  PRINT("oc_compile_group_routes: routes %d recipients %d\n",
+        tables->routes_len, nr_recipients);
+  tables->routes_valid = true;
+}
 
-          PRINT(" oc_register_group_multicasts index=%d i=%d grpid: %u "
-                "group_address: %d cflags=",
-                index, i, grpid, g_got[index].ga[i]);
-          oc_print_cflags(cflags);
+static const oc_group_route_t *
+oc_fp_find_group_route(oc_fp_tables_t *tables, uint32_t group_address)
+{
+  if (tables->routes_valid == false) {
+    oc_compile_group_routes(tables);
+  }
+  return oc_lookup_group_route(tables, group_address);
+}
 
-          if (grpid > 0) {
-            subscribe_group_to_multicast_with_port(grpid, installation_id, 2,
-                                                   port);
-            subscribe_group_to_multicast_with_port(grpid, installation_id, 5,
-                                                   port);
-          }
+const oc_group_route_t *
+oc_core_find_group_route(uint32_t group_address)
+{
+  return oc_fp_find_group_route(g_fp, group_address);
+}
+
+int
+oc_core_get_group_route_recipient(const oc_group_route_t *route, int entry)
+{
+  if (route == NULL || entry < 0 || entry >= route->nr_recipients) {
+    return -1;
+  }
+  return g_fp->route_recipients[route->first + entry];
+}
+
+void
+oc_core_invalidate_group_routes(void)
+{
+  g_fp->routes_valid = false;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef struct oc_group_membership_t
+{
+  int64_t iid;       /**< the installation id of the multicast address */
+  uint32_t port;     /**< the multicast port */
+  uint32_t group_nr; /**< the group number (grpid or group address) */
+  int refcount;      /**< number of group object table entries using it */
+} oc_group_membership_t;
+
+/*
+ * The joined group multicasts of all devices, sorted on installation id, port
+ * and group number. The sockets are shared by the devices, so a group that is
+ * used by several devices is joined once.
+ * Each group is joined with scope 2 and 5, using the installation id and
+ * multicast port of the device at the time of joining.
+ */
+static oc_group_membership_t *g_memberships = NULL;
+static int g_memberships_len = 0;
+
+static void
+oc_join_group_multicast(uint32_t group_nr, int64_t iid, uint32_t port)
+{
+  subscribe_group_to_multicast_with_port(group_nr, iid, 2, port);
+  subscribe_group_to_multicast_with_port(group_nr, iid, 5, port);
+}
+
+static void
+oc_leave_group_multicast(uint32_t group_nr, int64_t iid, uint32_t port)
+{
+  unsubscribe_group_to_multicast_with_port(group_nr, iid, 2, port);
+  unsubscribe_group_to_multicast_with_port(group_nr, iid, 5, port);
+}
+
+static int
+oc_compare_membership(const void *a, const void *b)
+{
+  const oc_group_membership_t *ma = (const oc_group_membership_t *)a;
+  const oc_group_membership_t *mb = (const oc_group_membership_t *)b;
+  if (ma->iid != mb->iid) {
+    return ma->iid < mb->iid ? -1 : 1;
+  }
+  if (ma->port != mb->port) {
+    return ma->port < mb->port ? -1 : 1;
+  }
+  if (ma->group_nr != mb->group_nr) {
+    return ma->group_nr < mb->group_nr ? -1 : 1;
+  }
+  return 0;
+}
+
+/*
+ * collects the group multicasts to listen to of the tables of a device, with
+ * duplicates. when memberships is NULL, only the number is returned.
+ */
+static int
+oc_collect_group_multicasts(oc_fp_tables_t *tables,
+                            oc_group_membership_t *memberships, int64_t iid,
+                            uint32_t port)
+{
+  bool pub_entry = false;
+#ifdef OC_PUBLISHER_TABLE
+  for (int index = 0; index < tables->gpt_size; index++) {
+    if (tables->gpt[index].grpid > 0) {
+      pub_entry = true;
+      break;
+    }
+  }
+#endif /* OC_PUBLISHER_TABLE */
+
+  int count = 0;
+  for (int index = 0; index < tables->got_size; index++) {
+    const oc_group_object_table_t *entry = &tables->got[index];
+    oc_cflag_mask_t cflags = entry->cflags;
+    // check if the group address is used for receiving.
+    // e.g. WRITE or UPDATE
+    if (((cflags & OC_CFLAG_WRITE) == 0) && ((cflags & OC_CFLAG_UPDATE) == 0) &&
+        ((cflags & OC_CFLAG_READ) == 0)) {
+      continue;
+    }
+    for (int i = 0; entry->ga && i < entry->ga_len; i++) {
+      uint32_t group_nr = entry->ga[i];
+      if (pub_entry) {
+        const oc_group_route_t *route =
+          oc_fp_find_group_route(tables, group_nr);
+        group_nr = route ? route->pub_grpid : 0;
+        if (group_nr == 0) {
+          continue;
         }
       }
+      if (memberships) {
+        memberships[count].iid = iid;
+        memberships[count].port = port;
+        memberships[count].group_nr = group_nr;
+        memberships[count].refcount = 1;
+      }
+      count++;
     }
   }
-  if (pub_entry == false) {
-    // register via group object table
-    int index;
-    for (index = 0; index < GOT_MAX_ENTRIES; index++) {
-      int nr_entries = g_got[index].ga_len;
-
-      oc_cflag_mask_t cflags = g_got[index].cflags;
-      // check if the group address is used for receiving.
-      // e.g. WRITE or UPDATE
-      if (((cflags & OC_CFLAG_WRITE) > 0) || ((cflags & OC_CFLAG_UPDATE) > 0) ||
-          ((cflags & OC_CFLAG_READ) > 0)) {
-
-        for (int i = 0; i < nr_entries; i++) {
-          PRINT(
-            " oc_register_group_multicasts index=%d i=%d group: %u  cflags=",
-            index, i, g_got[index].ga[i]);
-          oc_print_cflags(cflags);
-          subscribe_group_to_multicast_with_port(g_got[index].ga[i],
-                                                 installation_id, 2, port);
-          subscribe_group_to_multicast_with_port(g_got[index].ga[i],
-                                                 installation_id, 5, port);
-        }
+  return count;
+}
+
+/*
+ * collects the group multicasts of all devices, with duplicates.
+ * when memberships is NULL, only the number is returned.
+ */
+static int
+oc_collect_all_group_multicasts(oc_group_membership_t *memberships)
+{
+  int count = 0;
+  for (size_t device_index = 0; device_index < oc_core_get_num_devices();
+       device_index++) {
+    // installation id will be used as ULA prefix
+    oc_device_info_t *device = oc_core_get_device_info(device_index);
+    oc_fp_tables_t *tables = oc_fp_get_tables(device_index);
+    if (!device || !tables) {
+      continue;
+    }
+    oc_group_membership_t *next = memberships ? memberships + count : NULL;
+    count +=
+      oc_collect_group_multicasts(tables, next, device->iid, device->mport);
+  }
+  return count;
+}
+
+static void
+oc_free_group_memberships(void)
+{
+  free(g_memberships);
+  g_memberships = NULL;
+  g_memberships_len = 0;
+}
+
+void
+oc_register_group_multicasts()
+{
+  if (!oc_core_get_device_info(0)) {
+    PRINT("oc_register_group_multicasts: no device info\n");
+    return;
+  }
+
+  // the new membership set, reference counted by the number of uses in the
+  // group object tables
+  oc_group_membership_t *memberships = NULL;
+  int len = 0;
+  int nr_groups = oc_collect_all_group_multicasts(NULL);
+  if (nr_groups > 0) {
+    memberships = (oc_group_membership_t *)malloc(
+      nr_groups * sizeof(oc_group_membership_t));
+    if (memberships == NULL) {
+      OC_ERR("oc_register_group_multicasts: out of memory");
+      return;
+    }
+    oc_collect_all_group_multicasts(memberships);
+    qsort(memberships, nr_groups, sizeof(oc_group_membership_t),
+          oc_compare_membership);
+    for (int i = 0; i < nr_groups; i++) {
+      if (len > 0 &&
+          oc_compare_membership(&memberships[len - 1], &memberships[i]) == 0) {
+        memberships[len - 1].refcount++;
+      } else {
+        memberships[len++] = memberships[i];
       }
     }
   }
+
+  // diff the (sorted) current and new membership sets. the multicast
+  // addresses contain the installation id and port, so a changed installation
+  // id or port leaves the old and joins the new addresses
+  int joined = 0;
+  int left = 0;
+  int i = 0;
+  int j = 0;
+  while (i < g_memberships_len || j < len) {
+    int cmp = 0;
+    if (j >= len) {
+      cmp = -1;
+    } else if (i >= g_memberships_len) {
+      cmp = 1;
+    } else {
+      cmp = oc_compare_membership(&g_memberships[i], &memberships[j]);
+    }
+    if (cmp < 0) {
+      oc_leave_group_multicast(g_memberships[i].group_nr, g_memberships[i].iid,
+                               g_memberships[i].port);
+      left++;
+      i++;
+    } else if (cmp > 0) {
+      oc_join_group_multicast(memberships[j].group_nr, memberships[j].iid,
+                              memberships[j].port);
+      joined++;
+      j++;
+    } else {
+      // already joined
+      i++;
+      j++;
+    }
+  }
+
+  oc_free_group_memberships();
+  g_memberships = memberships;
+  g_memberships_len = len;
+
+  PRINT("oc_register_group_multicasts: groups %d joined %d left %d\n", len,
+        joined, left);
 }
 
 void
-oc_init_datapoints_at_initialization()
+oc_rejoin_group_multicasts()
+{
+  PRINT("oc_rejoin_group_multicasts: groups %d\n", g_memberships_len);
+  for (int i = 0; i < g_memberships_len; i++) {
+    oc_leave_group_multicast(g_memberships[i].group_nr, g_memberships[i].iid,
+                             g_memberships[i].port);
+    oc_join_group_multicast(g_memberships[i].group_nr, g_memberships[i].iid,
+                            g_memberships[i].port);
+  }
+  if (g_memberships_len == 0) {
+    // nothing joined yet, e.g. the tables were loaded before the network
+    oc_register_group_multicasts();
+  }
+}
+
+int
+oc_get_group_multicast_refcount(uint32_t group_nr)
+{
+  // the sum over all installation ids and ports
+  int refcount = 0;
+  for (int i = 0; i < g_memberships_len; i++) {
+    if (g_memberships[i].group_nr == group_nr) {
+      refcount += g_memberships[i].refcount;
+    }
+  }
+  return refcount;
+}
+
+int
+oc_init_datapoints_at_initialization_for_device(size_t device_index)
 {
+  oc_fp_tables_t *tables = oc_fp_get_tables(device_index);
+  int count = 0;
   int index;
-  PRINT("oc_init_datapoints_at_initialization\n");
-
-  for (index = 0; index < GOT_MAX_ENTRIES; index++) {
-    int nr_entries = g_got[index].ga_len;
-
-    if (nr_entries > 0) {
-      oc_cflag_mask_t cflags = g_got[index].cflags;
-      if ((cflags & OC_CFLAG_INIT) > 0) {
-        // Case 5)
-        // @sender : cflags = i After device restart(power up)
-        // Sent : -st r, sending association(1st assigned ga)
-        PRINT("oc_init_datapoints_at_initialization: index: %d issue read on "
-              "group address %d\n",
-              index, g_got[index].ga[0]);
-        oc_do_s_mode_read(g_got[index].ga[0]);
-      }
+  PRINT("oc_init_datapoints_at_initialization: device %u\n",
+        (unsigned)device_index);
+  if (tables == NULL) {
+    return 0;
+  }
+
+  for (index = 0; index < tables->got_size; index++) {
+    oc_group_object_table_t *entry = &tables->got[index];
+
+    if (entry->ga_len > 0 && (entry->cflags & OC_CFLAG_INIT) > 0) {
+      // Case 5)
+      // @sender : cflags = i After device restart(power up)
+      // Sent : -st r, sending association(1st assigned ga)
+      PRINT("oc_init_datapoints_at_initialization: index: %d issue read on "
+            "group address %d\n",
+            index, entry->ga[0]);
+      oc_do_s_mode_read_for_device(device_index, entry->ga[0]);
+      count++;
     }
   }
+  return count;
+}
+
+void
+oc_init_datapoints_at_initialization()
+{
+  oc_init_datapoints_at_initialization_for_device(g_fp_device);
 }
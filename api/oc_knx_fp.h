@@ -275,9 +275,35 @@ int find_empty_slot_in_group_object_table(int id);
  *
  * function is called when the device is (re)started in run-time mode (e.g.
  * state = "loaded")
+ *
+ * The joined multicast addresses are kept as a reference counted set.
+ * Only the difference with the previous call is applied: addresses that are
+ * no longer used are left, new addresses are joined and addresses that are
+ * used multiple times are joined only once.
+ * The group object tables of all devices are taken into account, each with
+ * the installation id and multicast port of its device.
  */
 void oc_register_group_multicasts();
 
+/**
+ * @brief join all registered multicast addresses again
+ *
+ * To be called when the network interfaces have changed, e.g. an interface
+ * came up.
+ *
+ * @see oc_register_group_multicasts
+ */
+void oc_rejoin_group_multicasts();
+
+/**
+ * @brief retrieve the number of group object table references to a joined
+ * multicast group
+ *
+ * @param group_nr the group number (grpid or group address)
+ * @return int the reference count, 0 when the group is not joined
+ */
+int oc_get_group_multicast_refcount(uint32_t group_nr);
+
 /**
  * @brief find the grpid from the group_address in the publisher table
  *
@@ -300,13 +326,75 @@ uint32_t oc_find_grpid_in_publisher_table(uint32_t group_address);
  */
 uint32_t oc_find_grpid_in_recipient_table(uint32_t group_address);
 
+/**
+ * @brief compiled routing information of a single group address
+ *
+ * The routing table is compiled from the recipient table (/fp/r) and the
+ * publisher table (/fp/p), and contains one entry per (unique) group address.
+ * It replaces the scans over the full tables on the s-mode publish path.
+ *
+ * @see oc_core_find_group_route
+ */
+typedef struct oc_group_route_t
+{
+  uint32_t ga;        /**< the group address */
+  uint32_t grpid;     /**< grpid of the first /fp/r entry with ga, or 0 */
+  uint32_t pub_grpid; /**< grpid of the first /fp/p entry with ga, or 0 */
+  int first;          /**< offset of the first recipient of this route */
+  int nr_recipients;  /**< number of unicast recipients (ia > 0) */
+} oc_group_route_t;
+
+/**
+ * @brief find the compiled route of a group address
+ *
+ * The routing table is (re)compiled on first use after the recipient or
+ * publisher table has been changed.
+ *
+ * @param group_address the group address
+ * @return const oc_group_route_t* the route or NULL when the group address is
+ * not used in the recipient or publisher table
+ */
+const oc_group_route_t *oc_core_find_group_route(uint32_t group_address);
+
+/**
+ * @brief retrieve the recipient table index of a recipient of a route
+ *
+ * @param route the route, retrieved with oc_core_find_group_route
+ * @param entry the recipient entry: 0 .. nr_recipients - 1
+ * @return int the index in the recipient table or -1
+ */
+int oc_core_get_group_route_recipient(const oc_group_route_t *route,
+                                      int entry);
+
+/**
+ * @brief invalidate the compiled routing table
+ *
+ * The stack calls this function on every change of /fp/r and /fp/p.
+ * Applications that change the tables directly (e.g. via
+ * oc_core_get_recipient_table_entry) must call this function afterwards.
+ */
+void oc_core_invalidate_group_routes(void);
+
 /**
  * @brief initializes the data points at initialization
  * e.g. sends out an read s-mode message when the I flag is set.
+ * Uses the tables of the selected device.
  *
+ * @see oc_init_datapoints_at_initialization_for_device
  */
 void oc_init_datapoints_at_initialization();
 
+/**
+ * @brief initializes the data points of a device at initialization
+ * e.g. sends out an read s-mode message for each entry of the group object
+ * table of the device that has the I flag set.
+ * The selected device is not changed.
+ *
+ * @param device_index the device index
+ * @return int the number of read s-mode messages issued
+ */
+int oc_init_datapoints_at_initialization_for_device(size_t device_index);
+
 /**
  * @brief find index belonging to the id
  *
@@ -600,6 +688,59 @@ void oc_create_knx_fp_resources(size_t device_index);
  */
 void oc_free_knx_fp_resources(size_t device_index);
 
+/**
+ * @brief select the device of which the tables (GOT, GPT, GRT) are used
+ *
+ * Each device has its own tables. The functions of this module that do not
+ * take a device index work on the tables of the selected device. The stack
+ * selects the device of a resource before calling its handlers, and restores
+ * the previous selection when they return. Device 0 is selected otherwise.
+ *
+ * @param device_index the device index
+ * @return true the device has been selected
+ * @return false the device has no tables, the selection is unchanged
+ */
+bool oc_core_fp_select_device(size_t device_index);
+
+/**
+ * @brief retrieve the selected device
+ *
+ * @return size_t the device index
+ * @see oc_core_fp_select_device
+ */
+size_t oc_core_fp_get_selected_device(void);
+
+/**
+ * @brief set the sizes of the tables (GOT, GPT, GRT) of the devices that are
+ * added next
+ *
+ * The tables of device 0 have the maximum sizes (GOT_MAX_ENTRIES,
+ * GPT_MAX_ENTRIES, GRT_MAX_ENTRIES). The tables of the other devices are
+ * allocated with the sizes set by this function when the device is added, so
+ * call it before oc_add_device. The sizes are the maximum sizes until this
+ * function is called, and again after the stack is shut down.
+ * Without OC_DYNAMIC_ALLOCATION the entries are static, the sizes only limit
+ * the number of entries that are used.
+ *
+ * @param got_size the number of group object table entries (1..GOT_MAX_ENTRIES)
+ * @param gpt_size the number of publisher table entries (1..GPT_MAX_ENTRIES),
+ * ignored without OC_PUBLISHER_TABLE
+ * @param grt_size the number of recipient table entries (1..GRT_MAX_ENTRIES)
+ * @return true the sizes are set
+ * @return false a size is out of range, the sizes are unchanged
+ */
+bool oc_core_fp_set_device_table_sizes(int got_size, int gpt_size,
+                                       int grt_size);
+
+/**
+ * @brief retrieve the memory used by the tables of a device
+ *
+ * @param device_index the device index
+ * @return size_t the size in bytes (excluding the group address arrays and
+ * urls of the entries), 0 when the device has no tables
+ */
+size_t oc_core_fp_get_device_tables_size(size_t device_index);
+
 /**
  * @brief create the group multi cast address
  * using the default port 5683
@@ -16,6 +16,9 @@
 
 #include "oc_api.h"
 #include "oc_knx_helpers.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
 int
 check_if_query_l_exist(oc_request_t *request, bool *ps_exists,
@@ -146,7 +149,14 @@ check_if_query_pn_exist(oc_request_t *request, int *pn_value, int *ps_value)
 int
 add_next_page_indicator(char *url, int next_page_num)
 {
-  // example : </p?pn=1>;rt="p.next";ct=40
+  return add_next_page_indicator_with_cursor(url, next_page_num, 0);
+}
+
+int
+add_next_page_indicator_with_cursor(char *url, int next_page_num,
+                                    uint32_t cursor)
+{
+  // example : </p?pn=1&pc=1f>;rt="p.next";ct=40
   int response_length = 0;
   int length;
   char next_page_str[20];
@@ -160,6 +170,11 @@ add_next_page_indicator(char *url, int next_page_num)
   response_length += length;
   length = oc_rep_add_line_to_buffer(next_page_str);
   response_length += length;
+  if (cursor != 0) {
+    snprintf(next_page_str, sizeof(next_page_str), "&pc=%" PRIx32, cursor);
+    length = oc_rep_add_line_to_buffer(next_page_str);
+    response_length += length;
+  }
   length = oc_rep_add_line_to_buffer(">;rt=\"");
   response_length += length;
   if (url[0] == '/') {
@@ -180,3 +195,126 @@ oc_frame_integer(int value)
   snprintf((char *)&string, 9, "%d", value);
   return oc_rep_add_line_to_buffer(string);
 }
+
+// ----------------------------------------------------------------------------
+
+#ifndef OC_PAGE_CURSORS
+#define OC_PAGE_CURSORS (4)
+#endif
+
+typedef struct page_cursor_entry_t
+{
+  uint32_t id; /* 0: entry not in use */
+  uint32_t generation;
+  const oc_resource_t *listing;
+  uint32_t query_hash;
+  int page_num;
+  oc_page_cursor_t cursor;
+} page_cursor_entry_t;
+
+static page_cursor_entry_t g_page_cursors[OC_PAGE_CURSORS];
+static uint32_t g_page_cursor_id = 0;
+
+static uint32_t
+page_cursor_hash(uint32_t hash, const char *data, size_t len)
+{
+  /* FNV-1a */
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* the path and the query of the listing, without pn and pc */
+static uint32_t
+page_cursor_query_hash(oc_request_t *request)
+{
+  uint32_t hash = 2166136261u;
+  char *key, *value;
+  size_t key_len, value_len;
+
+  hash = page_cursor_hash(hash, request->uri_path, request->uri_path_len);
+  oc_init_query_iterator();
+  while (oc_iterate_query(request, &key, &key_len, &value, &value_len) > 0) {
+    if (key_len == 2 &&
+        (strncmp(key, "pn", 2) == 0 || strncmp(key, "pc", 2) == 0)) {
+      continue;
+    }
+    hash = page_cursor_hash(hash, "&", 1);
+    hash = page_cursor_hash(hash, key, key_len);
+    if (value) {
+      hash = page_cursor_hash(hash, "=", 1);
+      hash = page_cursor_hash(hash, value, value_len);
+    }
+  }
+  return hash;
+}
+
+uint32_t
+oc_page_cursor_store(oc_request_t *request, int next_page_num,
+                     const oc_page_cursor_t *cursor)
+{
+  /* replace the oldest cursor */
+  page_cursor_entry_t *entry = &g_page_cursors[0];
+  for (int i = 1; i < OC_PAGE_CURSORS; i++) {
+    if (g_page_cursors[i].id < entry->id) {
+      entry = &g_page_cursors[i];
+    }
+  }
+  if (++g_page_cursor_id == 0) {
+    /* wrapped around, the ids of the stored cursors are no longer ordered */
+    memset(g_page_cursors, 0, sizeof(g_page_cursors));
+    entry = &g_page_cursors[0];
+    g_page_cursor_id = 1;
+  }
+  entry->id = g_page_cursor_id;
+  entry->generation = oc_ri_get_app_resources_generation();
+  entry->listing = request->resource;
+  entry->query_hash = page_cursor_query_hash(request);
+  entry->page_num = next_page_num;
+  entry->cursor = *cursor;
+  return entry->id;
+}
+
+bool
+oc_page_cursor_resume(oc_request_t *request, int page_num,
+                      oc_page_cursor_t *cursor)
+{
+  char *value = NULL;
+  int value_len = -1;
+
+  if (page_num < 1 || !oc_query_values_available(request)) {
+    return false;
+  }
+  oc_init_query_iterator();
+  if (oc_query_value_exists(request, "pc") < 0) {
+    return false;
+  }
+  oc_iterate_query_get_values(request, "pc", &value, &value_len);
+  if (value == NULL || value_len <= 0 || value_len > 8) {
+    return false;
+  }
+  char id_str[9];
+  memcpy(id_str, value, value_len);
+  id_str[value_len] = '\0';
+  uint32_t id = (uint32_t)strtoul(id_str, NULL, 16);
+  if (id == 0) {
+    return false;
+  }
+
+  for (int i = 0; i < OC_PAGE_CURSORS; i++) {
+    page_cursor_entry_t *entry = &g_page_cursors[i];
+    if (entry->id != id) {
+      continue;
+    }
+    if (entry->generation != oc_ri_get_app_resources_generation() ||
+        entry->listing != request->resource || entry->page_num != page_num ||
+        entry->query_hash != page_cursor_query_hash(request)) {
+      return false;
+    }
+    *cursor = entry->cursor;
+    return true;
+  }
+  return false;
+}
@@ -86,6 +86,58 @@ bool check_if_query_pn_exist(oc_request_t *request, int *pn_value,
  */
 int add_next_page_indicator(char *url, int next_page_num);
 
+/**
+ * @brief helper function to frame next page indicator with a continuation
+ * cursor
+ *
+ * example : </p?pn=1&pc=1f>;rt="p.next";ct=40
+ * @param url the url to be framed
+ * @param next_page_num the next page number to be framed
+ * @param cursor the cursor of the next page, 0 frames only the page number
+ * @return total bytes framed
+ */
+int add_next_page_indicator_with_cursor(char *url, int next_page_num,
+                                        uint32_t cursor);
+
+/**
+ * @brief position of a paged listing of the app resources
+ */
+typedef struct oc_page_cursor_t
+{
+  const oc_resource_t *resource; /**< next resource to list, NULL: the app
+                                    resources have all been listed */
+  int position;                  /**< number of entries before resource */
+  int total;                     /**< total number of entries */
+} oc_page_cursor_t;
+
+/**
+ * @brief store where the next page of a listing starts
+ *
+ * The cursor is valid for the same url and query (apart from pn and pc), for
+ * the next page only, and as long as no resources are added or removed.
+ *
+ * @param request the request of the current page
+ * @param next_page_num the page number of the next page
+ * @param cursor the position of the next page
+ * @return uint32_t the cursor id to frame in the next page link
+ */
+uint32_t oc_page_cursor_store(oc_request_t *request, int next_page_num,
+                              const oc_page_cursor_t *cursor);
+
+/**
+ * @brief resume a listing at the cursor (query parameter pc) of the request
+ *
+ * Without a (valid) cursor the listing has to skip to the page from the start
+ * of the list.
+ *
+ * @param request the request
+ * @param page_num the requested page number (query parameter pn)
+ * @param cursor the position of the page
+ * @return true the cursor is valid
+ */
+bool oc_page_cursor_resume(oc_request_t *request, int page_num,
+                           oc_page_cursor_t *cursor);
+
 /**
  * @brief helper function to frame an integer in the response:
  * @param value the value to be framed, max 9 chars
@@ -27,18 +27,19 @@
 
 bool
 oc_add_data_points_to_response(oc_request_t *request,
-                               const oc_resource_t *resource,
+                               const oc_resource_t **resource,
                                size_t device_index, size_t *response_length,
                                int matches, int page_size)
 {
   (void)request;
   int length = 0;
 
-  for (; resource && matches < page_size; resource = resource->next) {
-    if (resource->device != device_index) {
+  for (; *resource && matches < page_size; *resource = (*resource)->next) {
+    if ((*resource)->device != device_index) {
       continue;
     }
-    oc_add_resource_to_wk(resource, request, device_index, response_length, 1);
+    oc_add_resource_to_wk(*resource, request, device_index, response_length,
+                          1);
     matches++;
   }
 
@@ -83,14 +84,23 @@ oc_core_p_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
 
   size_t device_index = request->resource->device;
 
+  // continue where the previous page stopped
+  oc_page_cursor_t cursor;
+  bool resumed = check_if_query_pn_exist(request, &query_pn, NULL) &&
+                 oc_page_cursor_resume(request, query_pn, &cursor);
+
   const oc_resource_t *my_p = oc_ri_get_app_resources();
-  // Calculate total properties
-  for (; my_p; my_p = my_p->next) {
-    if (my_p->device != device_index) {
-      continue;
-    }
-    if (oc_string(my_p->uri) != NULL) {
-      total++;
+  if (resumed) {
+    total = cursor.total;
+  } else {
+    // Calculate total properties
+    for (; my_p; my_p = my_p->next) {
+      if (my_p->device != device_index) {
+        continue;
+      }
+      if (oc_string(my_p->uri) != NULL) {
+        total++;
+      }
     }
   }
   last_entry = total;
@@ -112,16 +122,20 @@ oc_core_p_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
 
   my_p = oc_ri_get_app_resources();
   // handle query with page number (pn)
-  if (check_if_query_pn_exist(request, &query_pn, NULL)) {
+  if (query_pn > -1) {
     first_entry = query_pn * PAGE_SIZE;
     if (first_entry >= last_entry) {
       oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
       return;
     }
 
-    // skip endpoints and return the next one
-    for (i = 0; i < first_entry; i++) {
-      my_p = my_p->next;
+    if (resumed) {
+      my_p = cursor.resource;
+    } else {
+      // skip endpoints and return the next one
+      for (i = 0; i < first_entry; i++) {
+        my_p = my_p->next;
+      }
     }
   }
 
@@ -130,13 +144,17 @@ oc_core_p_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   }
 
   bool added = oc_add_data_points_to_response(
-    request, my_p, device_index, &response_length, matches, PAGE_SIZE);
+    request, &my_p, device_index, &response_length, matches, PAGE_SIZE);
 
   if (added) {
     if (more_request_needed) {
       int next_page_num = query_pn > -1 ? query_pn + 1 : 1;
-      response_length += add_next_page_indicator(
-        oc_string(request->resource->uri), next_page_num);
+      cursor.resource = my_p;
+      cursor.position = first_entry + PAGE_SIZE;
+      cursor.total = total;
+      response_length += add_next_page_indicator_with_cursor(
+        oc_string(request->resource->uri), next_page_num,
+        oc_page_cursor_store(request, next_page_num, &cursor));
     }
     oc_send_linkformat_response(request, OC_STATUS_OK, response_length);
   } else {
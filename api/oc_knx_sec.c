@@ -39,10 +39,68 @@ uint64_t g_oscore_osndelay = 1000;
 #endif
 oc_auth_at_t g_at_entries[G_AT_MAX_ENTRIES];
 
+/** keys derived from the oscore parameters of the entries */
+static oc_at_derived_keys_t g_at_derived_keys[G_AT_MAX_ENTRIES];
+
+/** hash index from osc_id to the entry, rebuilt when an entry changed */
+#ifndef OC_AT_OSC_ID_BUCKETS
+#define OC_AT_OSC_ID_BUCKETS (32)
+#endif
+static int16_t g_at_osc_id_buckets[OC_AT_OSC_ID_BUCKETS];
+static int16_t g_at_osc_id_next[G_AT_MAX_ENTRIES];
+static bool g_at_osc_id_index_valid = false;
+
 // ----------------------------------------------------------------------------
 
 static void oc_at_dump_entry(size_t device_index, int entry);
 
+static uint32_t
+at_osc_id_hash(const uint8_t *osc_id, size_t osc_id_len)
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < osc_id_len; i++) {
+    hash ^= osc_id[i];
+    hash *= 16777619u;
+  }
+  return hash % OC_AT_OSC_ID_BUCKETS;
+}
+
+static void
+at_osc_id_index_build(void)
+{
+  for (int i = 0; i < OC_AT_OSC_ID_BUCKETS; i++) {
+    g_at_osc_id_buckets[i] = -1;
+  }
+  /* add in reverse, so that a chain lists the lowest index first, as the
+   * linear search did */
+  for (int i = G_AT_MAX_ENTRIES - 1; i >= 0; i--) {
+    size_t len = oc_byte_string_len(g_at_entries[i].osc_id);
+    g_at_osc_id_next[i] = -1;
+    if (len == 0) {
+      continue;
+    }
+    uint32_t bucket =
+      at_osc_id_hash((uint8_t *)oc_string(g_at_entries[i].osc_id), len);
+    g_at_osc_id_next[i] = g_at_osc_id_buckets[bucket];
+    g_at_osc_id_buckets[bucket] = (int16_t)i;
+  }
+  g_at_osc_id_index_valid = true;
+}
+
+/* call whenever the oscore parameters of an entry change */
+static void
+at_entry_changed(int index)
+{
+  g_at_osc_id_index_valid = false;
+  memset(&g_at_derived_keys[index], 0, sizeof(oc_at_derived_keys_t));
+#ifdef OC_OSCORE
+  /* recipient contexts are not recreated by oc_init_oscore_from_storage, drop
+   * them so that they are made again with the new parameters */
+  oc_oscore_free_contexts_at_id(index);
+#endif
+}
+
 // ----------------------------------------------------------------------------
 
 oc_at_profile_t
@@ -655,6 +713,7 @@ oc_core_auth_at_post_handler(oc_request_t *request,
                     oc_string_len(*at));
 
       bool id_only = true;
+      bool osc_updated = false;
       object = rep->value.object;
       while (object != NULL) {
         if (object->type == OC_REP_STRING_ARRAY) {
@@ -780,6 +839,7 @@ oc_core_auth_at_post_handler(oc_request_t *request,
                     oc_new_byte_string(&g_at_entries[index].osc_ms,
                                        oc_string(oscobject->value.string),
                                        oc_string_len(oscobject->value.string));
+                    osc_updated = true;
                     other_updated = true;
                   }
                   if (oscobject->iname == 6 && subobject_nr == 8 &&
@@ -789,6 +849,7 @@ oc_core_auth_at_post_handler(oc_request_t *request,
                     oc_new_byte_string(&g_at_entries[index].osc_contextid,
                                        oc_string(oscobject->value.string),
                                        oc_string_len(oscobject->value.string));
+                    osc_updated = true;
                     other_updated = true;
                   }
                   // if (oscobject->iname == 7 && subobject_nr == 8 &&
@@ -807,6 +868,7 @@ oc_core_auth_at_post_handler(oc_request_t *request,
                     oc_new_byte_string(&g_at_entries[index].osc_id,
                                        oc_string(oscobject->value.string),
                                        oc_string_len(oscobject->value.string));
+                    osc_updated = true;
                     other_updated = true;
                   }
                   if (oscobject->iname == 5 && subobject_nr == 8 &&
@@ -816,6 +878,7 @@ oc_core_auth_at_post_handler(oc_request_t *request,
                     oc_new_byte_string(&g_at_entries[index].osc_salt,
                                        oc_string(oscobject->value.string),
                                        oc_string_len(oscobject->value.string));
+                    osc_updated = true;
                     other_updated = true;
                   }
                 } /* type */
@@ -828,6 +891,9 @@ oc_core_auth_at_post_handler(oc_request_t *request,
         }
         object = object->next;
       } // while (inner object)
+      if (osc_updated) {
+        at_entry_changed(index);
+      }
       if (id_only) {
         PRINT("  only found id in request, deleting entry at index: %d\n",
               index);
@@ -1337,6 +1403,7 @@ oc_at_delete_entry(size_t device_index, int index)
   oc_new_byte_string(&g_at_entries[index].osc_rid, "", 0);
   oc_free_string(&g_at_entries[index].osc_id);
   oc_new_byte_string(&g_at_entries[index].osc_id, "", 0);
+  at_entry_changed(index);
   // dtls object
   oc_free_string(&g_at_entries[index].sub);
   oc_new_string(&g_at_entries[index].sub, "", 0);
@@ -1421,6 +1488,7 @@ oc_at_load_entry(int entry)
   char filename[20];
   oc_rep_t *rep, *head;
   snprintf(filename, 20, "%s_%d", AT_STORE, entry);
+  at_entry_changed(entry);
   uint8_t *buf = malloc(OC_MAX_APP_DATA_SIZE);
   if (!buf)
     return;
@@ -1566,6 +1634,7 @@ oc_core_set_at_table(size_t device_index, int index, oc_auth_at_t entry,
     oc_free_string(&g_at_entries[index].osc_id);
     oc_new_byte_string(&g_at_entries[index].osc_id, oc_string(entry.osc_id),
                        oc_byte_string_len(entry.osc_id));
+    at_entry_changed(index);
     // clean up existing entry
     if (g_at_entries[index].ga_len > 0) {
       int64_t *cur_arr = g_at_entries[index].ga;
@@ -1619,15 +1688,34 @@ int
 oc_core_find_at_entry_with_osc_id(size_t device_index, uint8_t *osc_id,
                                   size_t osc_id_len)
 {
-  for (int i = 0; i < G_AT_MAX_ENTRIES; i++) {
+  (void)device_index;
+  if (osc_id_len == 0) {
+    return -1;
+  }
+  if (!g_at_osc_id_index_valid) {
+    at_osc_id_index_build();
+  }
+  int i = g_at_osc_id_buckets[at_osc_id_hash(osc_id, osc_id_len)];
+  while (i >= 0) {
     if (oc_byte_string_len(g_at_entries[i].osc_id) == osc_id_len &&
         memcmp(oc_string(g_at_entries[i].osc_id), osc_id, osc_id_len) == 0) {
       return i;
     }
+    i = g_at_osc_id_next[i];
   }
   return -1;
 }
 
+oc_at_derived_keys_t *
+oc_core_get_at_derived_keys(size_t device_index, int index)
+{
+  (void)device_index;
+  if (index < 0 || index >= G_AT_MAX_ENTRIES) {
+    return NULL;
+  }
+  return &g_at_derived_keys[index];
+}
+
 int
 oc_core_find_at_entry_empty_slot(size_t device_index)
 {
@@ -2025,16 +2113,65 @@ oc_knx_contains_interface(oc_interface_mask_t calling_interfaces,
   return false;
 }
 
+#define ACL_METHOD_BIT(method) ((uint8_t)(1 << (method)))
+
+/* The decision for a request only depends on the method, on the uri and the
+ * interfaces of the resource, and on the scope of the auth/at entry that
+ * decrypted the request. The per resource parts are computed once and kept in
+ * the runtime data of the resource, so that checking a request is a few bit
+ * tests. They are computed again when the uri or the interfaces of the
+ * resource change, as these are the only inputs.
+ */
+static void
+acl_compute_resource_bits(const oc_resource_t *resource, uint8_t *acl_public,
+                          uint8_t *acl_methods)
+{
+  *acl_public = 0;
+  *acl_methods = 0;
+  for (int method = OC_GET; method <= OC_FETCH; method++) {
+    if (oc_is_resource_secure((oc_method_t)method, resource) == false) {
+      *acl_public |= ACL_METHOD_BIT(method);
+    }
+    if (oc_if_method_allowed_according_to_mask(resource->interfaces,
+                                               (oc_method_t)method)) {
+      *acl_methods |= ACL_METHOD_BIT(method);
+    }
+  }
+}
+
+static void
+acl_get_resource_bits(const oc_resource_t *resource, uint8_t *acl_public,
+                      uint8_t *acl_methods)
+{
+  oc_resource_data_t *data = resource->runtime_data;
+  if (data == NULL) {
+    acl_compute_resource_bits(resource, acl_public, acl_methods);
+    return;
+  }
+  if (!data->acl_valid || data->acl_interfaces != resource->interfaces ||
+      data->acl_uri != oc_string(resource->uri) ||
+      data->acl_uri_len != oc_string_len(resource->uri)) {
+    acl_compute_resource_bits(resource, &data->acl_public, &data->acl_methods);
+    data->acl_interfaces = resource->interfaces;
+    data->acl_uri = oc_string(resource->uri);
+    data->acl_uri_len = oc_string_len(resource->uri);
+    data->acl_valid = true;
+  }
+  *acl_public = data->acl_public;
+  *acl_methods = data->acl_methods;
+}
+
 static bool
 method_allowed(oc_method_t method, const oc_resource_t *resource,
                oc_endpoint_t *endpoint)
 {
-  if (oc_is_resource_secure(method, resource) == false) {
+  uint8_t acl_public, acl_methods;
+  acl_get_resource_bits(resource, &acl_public, &acl_methods);
+
+  if (acl_public & ACL_METHOD_BIT(method)) {
     // not a secure resource
     return true;
   }
-  PRINT("method allowed flags:");
-  PRINTipaddr_flags(*endpoint);
 #ifdef OC_OSCORE
   if ((endpoint->flags & OSCORE) == 0) {
     // not an OSCORE protected message, but OSCORE is enabled
@@ -2054,27 +2191,25 @@ method_allowed(oc_method_t method, const oc_resource_t *resource,
     // the message
     oc_interface_mask_t calling_interfaces =
       oc_at_get_interface_mask(0, endpoint->auth_at_index - 1);
-    // interfaces of the resource
-    oc_interface_mask_t resource_interfaces = resource->interfaces;
-    if (oc_knx_contains_interface(calling_interfaces, resource_interfaces) ==
-        false) {
+    if ((calling_interfaces & resource->interfaces) == 0) {
       PRINT("method_allowed : not allowed: request  %d : ", calling_interfaces);
       oc_print_interface(calling_interfaces);
       PRINT("\n");
       PRINT("method_allowed : not allowed: resource %d : ",
-            resource_interfaces);
-      oc_print_interface(resource_interfaces);
+            resource->interfaces);
+      oc_print_interface(resource->interfaces);
       PRINT("\n");
       OC_WRN(" resource %s call denied: %d  %d", oc_string(resource->uri),
-             calling_interfaces, resource_interfaces);
+             calling_interfaces, resource->interfaces);
 
       return false;
     }
   }
-
+#else
+  (void)endpoint;
 #endif
 
-  return oc_if_method_allowed_according_to_mask(resource->interfaces, method);
+  return (acl_methods & ACL_METHOD_BIT(method)) != 0;
 }
 
 bool
@@ -24,6 +24,7 @@
 #include <stddef.h>
 
 #include "oc_ri.h"
+#include "messaging/coap/oscore_constants.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -201,6 +202,34 @@ int oc_core_find_at_entry_with_context_id(size_t device_index,
 int oc_core_find_at_entry_with_osc_id(size_t device_index, uint8_t *osc_id,
                                       size_t osc_id_len);
 
+/**
+ * @brief OSCORE keys derived from an auth/at entry
+ *
+ * The keys only depend on the entry and the id context, so they are kept in
+ * RAM next to the table. Contexts that are made again for the same entry
+ * (e.g. recipient contexts that were evicted from the context cache) copy the
+ * keys instead of running HKDF. The keys are cleared when the entry changes.
+ */
+typedef struct oc_at_derived_keys_t
+{
+  bool valid;                             /**< keys have been derived */
+  uint8_t idctx[OSCORE_IDCTX_LEN];        /**< id context of the keys */
+  uint8_t idctx_len;                      /**< length of the id context */
+  uint8_t id_key[OSCORE_KEY_LEN];         /**< key derived from osc_id */
+  uint8_t rid_key[OSCORE_KEY_LEN];        /**< key derived from osc_rid */
+  uint8_t commoniv[OSCORE_COMMON_IV_LEN]; /**< derived common IV */
+} oc_at_derived_keys_t;
+
+/**
+ * @brief the derived OSCORE keys of an auth/at entry
+ *
+ * @param device_index The device index
+ * @param index the index in the table
+ * @return oc_at_derived_keys_t* the keys, NULL if index is out of range
+ */
+oc_at_derived_keys_t *oc_core_get_at_derived_keys(size_t device_index,
+                                                  int index);
+
 /**
  * @brief find empty slot
  *
@@ -16,6 +16,7 @@
 
 #include "oc_api.h"
 #include "api/oc_knx_swu.h"
+#include "api/oc_knx_swu_sink.h"
 #include "api/oc_knx_helpers.h"
 #include "oc_discovery.h"
 #include "oc_core_res.h"
@@ -540,6 +541,7 @@ oc_knx_swu_a_put_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   const uint8_t *payload = NULL;
   size_t len = 0;
 
+#ifndef OC_SWU_SINK
   static oc_separate_response_t s_delayed_response_swu;
 
   oc_swu_t *my_cb = oc_get_swu_cb();
@@ -547,6 +549,7 @@ oc_knx_swu_a_put_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
     oc_indicate_separate_response(request, &s_delayed_response_swu);
   else
     (void)s_delayed_response_swu;
+#endif /* !OC_SWU_SINK */
 
   PRINT("  oc_knx_swu_a_put_handler : Start\n");
 
@@ -582,12 +585,29 @@ oc_knx_swu_a_put_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
     oc_get_request_payload_raw(request, &payload, &len, &content_format);
   // PRINT("      raw buffer ok: %d len=%d\n", berr, len);
 
+#ifdef OC_SWU_SINK
+  /* the resource is streamed: the payload is the CoAP block at
+   * request->block_offset of the package block at po */
+  (void)berr;
+  if (block_offset < 0 || binary_size <= 0) {
+    oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
+    return;
+  }
+  if (oc_swu_sink_write(device_index, (size_t)binary_size,
+                        (size_t)block_offset + request->block_offset, payload,
+                        len) != 0) {
+    oc_send_response_no_format(request, OC_STATUS_INTERNAL_SERVER_ERROR);
+    return;
+  }
+  oc_send_cbor_response(request, OC_STATUS_OK);
+#else  /* OC_SWU_SINK */
   if (my_cb && my_cb->cb) {
     my_cb->cb(device_index, &s_delayed_response_swu, binary_size, block_offset,
               (uint8_t *)payload, len, my_cb->data);
   } else {
     oc_send_cbor_response(request, OC_STATUS_OK);
   }
+#endif /* !OC_SWU_SINK */
 
   PRINT("  oc_knx_swu_a_put_handler : End\n");
 }
@@ -609,20 +629,44 @@ oc_knx_swu_a_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
   // Triggers a software update query request (PULL on Software Update Server).
   // not implemented
   oc_rep_t *rep = request->request_payload;
+#ifdef OC_SWU_SINK
+  /* the resource is streamed, the payload has not been parsed */
+  const uint8_t *payload = NULL;
+  size_t len = 0;
+  oc_content_format_t content_format;
+  if (!oc_get_request_payload_raw(request, &payload, &len, &content_format) ||
+      oc_parse_rep(payload, (int)len, &rep) != 0) {
+    oc_free_rep(rep);
+    rep = NULL;
+  }
+#endif /* OC_SWU_SINK */
   if ((rep != NULL) && (rep->type == OC_REP_INT)) {
     PRINT("  oc_knx_swu_a_post_handler received : %d\n",
           (int)rep->value.integer);
+#ifdef OC_SWU_SINK
+    /* a download interrupted before this command is not continued */
+    oc_swu_sink_abort();
+#endif /* OC_SWU_SINK */
 
     oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
+  } else {
+    oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
   }
-
-  oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
+#ifdef OC_SWU_SINK
+  oc_free_rep(rep);
+#endif /* OC_SWU_SINK */
 }
 
+#ifdef OC_SWU_SINK
+/* the package blocks are written as they arrive, not collected in memory */
+#define SWU_A_PROPERTIES (OC_DISCOVERABLE | OC_BLOCK_STREAM)
+#else /* OC_SWU_SINK */
+#define SWU_A_PROPERTIES (OC_DISCOVERABLE)
+#endif /* !OC_SWU_SINK */
+
 OC_CORE_CREATE_CONST_RESOURCE_LINKED(knx_swu_pkgcmd, knx_swu_pkgbytes, 0,
                                      "/a/swu", OC_IF_SWU | OC_IF_D,
-                                     APPLICATION_CBOR, OC_DISCOVERABLE, 0,
+                                     APPLICATION_CBOR, SWU_A_PROPERTIES, 0,
                                      oc_knx_swu_a_put_handler,
                                      oc_knx_swu_a_post_handler, 0,
                                      "urn:knx:dpt.file", OC_SIZE_ZERO());
@@ -632,7 +676,7 @@ oc_create_knx_swu_a_resource(int resource_idx, size_t device)
 {
   OC_DBG("oc_create_knx_swu_a_resource\n");
   oc_core_populate_resource(resource_idx, device, "/a/swu", OC_IF_SWU | OC_IF_D,
-                            APPLICATION_CBOR, OC_DISCOVERABLE, 0,
+                            APPLICATION_CBOR, SWU_A_PROPERTIES, 0,
                             oc_knx_swu_a_put_handler, oc_knx_swu_a_post_handler,
                             0, 0);
 
@@ -0,0 +1,315 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "oc_knx_swu_sink.h"
+
+#ifdef OC_SWU_SINK
+#include "mbedtls/md.h"
+#include "oc_helpers.h"
+#include "port/oc_clock.h"
+#include "port/oc_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct swu_sink_t
+{
+  oc_string_t path;
+  int fd;
+  size_t device;
+  size_t package_size;
+  /* everything before offset has been written and hashed */
+  size_t offset;
+  oc_clock_time_t start;
+  /* the last block, or the end of the download */
+  oc_clock_time_t end;
+  oc_clock_time_t idle_timeout;
+  mbedtls_md_context_t sha256;
+  uint8_t expected[OC_SWU_SINK_DIGEST_SIZE];
+  bool has_expected;
+  uint8_t digest[OC_SWU_SINK_DIGEST_SIZE];
+  bool has_digest;
+  oc_swu_sink_done_cb_t done_cb;
+  void *done_data;
+} swu_sink_t;
+
+#define SWU_SINK_IDLE_TIMEOUT                                                  \
+  ((oc_clock_time_t)OC_SWU_SINK_IDLE_TIMEOUT * OC_CLOCK_SECOND)
+
+static swu_sink_t g_sink = { .fd = -1, .idle_timeout = SWU_SINK_IDLE_TIMEOUT };
+
+void
+oc_swu_sink_set_path(const char *path)
+{
+  oc_free_string(&g_sink.path);
+  if (path) {
+    oc_new_string(&g_sink.path, path, strlen(path));
+  }
+}
+
+void
+oc_swu_sink_set_digest(const uint8_t *digest)
+{
+  g_sink.has_expected = (digest != NULL);
+  if (digest) {
+    memcpy(g_sink.expected, digest, OC_SWU_SINK_DIGEST_SIZE);
+  }
+}
+
+bool
+oc_swu_sink_get_digest(uint8_t *digest)
+{
+  if (!g_sink.has_digest) {
+    return false;
+  }
+  memcpy(digest, g_sink.digest, OC_SWU_SINK_DIGEST_SIZE);
+  return true;
+}
+
+void
+oc_swu_sink_set_done_cb(oc_swu_sink_done_cb_t cb, void *data)
+{
+  g_sink.done_cb = cb;
+  g_sink.done_data = data;
+}
+
+void
+oc_swu_sink_set_idle_timeout(uint16_t seconds)
+{
+  g_sink.idle_timeout = (oc_clock_time_t)seconds * OC_CLOCK_SECOND;
+}
+
+static const char *
+swu_sink_path(void)
+{
+  if (oc_string_len(g_sink.path) > 0) {
+    return oc_string(g_sink.path);
+  }
+  return OC_SWU_SINK_PATH;
+}
+
+static void
+swu_sink_close(void)
+{
+  if (g_sink.fd >= 0) {
+    close(g_sink.fd);
+    g_sink.fd = -1;
+  }
+  mbedtls_md_free(&g_sink.sha256);
+}
+
+static void
+swu_sink_fail(oc_swu_result_t result)
+{
+  OC_ERR("software update package not written: %d", (int)result);
+  swu_sink_close();
+  g_sink.end = oc_clock_time();
+  oc_swu_set_result(result);
+  oc_swu_set_state(OC_SWU_STATE_IDLE);
+  if (g_sink.done_cb) {
+    g_sink.done_cb(g_sink.device, result, swu_sink_path(), g_sink.done_data);
+  }
+}
+
+static bool
+swu_sink_start(size_t device, size_t package_size)
+{
+  g_sink.fd = open(swu_sink_path(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (g_sink.fd < 0) {
+    OC_ERR("could not open %s: %d", swu_sink_path(), errno);
+    return false;
+  }
+  /* reserve the space up front: running out of it shows at the first block
+   * instead of the last, and the file is not fragmented by the appends */
+  if (posix_fallocate(g_sink.fd, 0, (off_t)package_size) != 0) {
+    OC_ERR("could not allocate %u bytes for the package",
+           (unsigned)package_size);
+    close(g_sink.fd);
+    g_sink.fd = -1;
+    return false;
+  }
+  mbedtls_md_init(&g_sink.sha256);
+  if (mbedtls_md_setup(&g_sink.sha256,
+                       mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0) != 0 ||
+      mbedtls_md_starts(&g_sink.sha256) != 0) {
+    OC_ERR("could not set up the package digest");
+    swu_sink_close();
+    return false;
+  }
+  g_sink.device = device;
+  g_sink.package_size = package_size;
+  g_sink.offset = 0;
+  g_sink.has_digest = false;
+  g_sink.start = g_sink.end = oc_clock_time();
+  oc_swu_set_package_bytes(0);
+  oc_swu_set_result(OC_SWU_RESULT_INIT);
+  oc_swu_set_state(OC_SWU_STATE_DOWNLOADING);
+  return true;
+}
+
+static bool
+swu_sink_pwrite(const uint8_t *data, size_t len, size_t offset)
+{
+  while (len > 0) {
+    ssize_t written = pwrite(g_sink.fd, data, len, (off_t)offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      OC_ERR("could not write the package: %d", errno);
+      return false;
+    }
+    data += written;
+    len -= (size_t)written;
+    offset += (size_t)written;
+  }
+  return true;
+}
+
+static void
+swu_sink_finish(void)
+{
+  int ret = mbedtls_md_finish(&g_sink.sha256, g_sink.digest);
+  if (ret != 0 || fsync(g_sink.fd) != 0) {
+    swu_sink_fail(OC_SWU_RESULT_ERR_FLASH);
+    return;
+  }
+  swu_sink_close();
+  g_sink.end = oc_clock_time();
+  g_sink.has_digest = true;
+
+  oc_swu_sink_stats_t stats;
+  oc_swu_sink_get_stats(&stats);
+  PRINT("software update package written: %u bytes in %u ms (%u bytes/s)\n",
+        (unsigned)stats.bytes_written, (unsigned)stats.elapsed_ms,
+        (unsigned)stats.bytes_per_second);
+
+  oc_swu_result_t result = OC_SWU_RESULT_SUCCESS;
+  if (g_sink.has_expected &&
+      memcmp(g_sink.digest, g_sink.expected, OC_SWU_SINK_DIGEST_SIZE) != 0) {
+    OC_ERR("software update package digest mismatch");
+    result = OC_SWU_RESULT_ERR_ICF;
+  }
+  oc_swu_set_result(result);
+  oc_swu_set_state(result == OC_SWU_RESULT_SUCCESS ? OC_SWU_STATE_DOWNLOADED
+                                                   : OC_SWU_STATE_IDLE);
+  if (g_sink.done_cb) {
+    g_sink.done_cb(g_sink.device, result, swu_sink_path(), g_sink.done_data);
+  }
+}
+
+int
+oc_swu_sink_write(size_t device, size_t package_size, size_t offset,
+                  const uint8_t *data, size_t len)
+{
+  if (device != 0) {
+    /* there is one package file and one /swu state */
+    OC_ERR("software update block for device %u", (unsigned)device);
+    return -1;
+  }
+  /* a block at offset 0 is most likely a retransmission of the first block,
+   * only a client that comes back with another package or after a while
+   * starts over */
+  bool restart = offset == 0 && (package_size != g_sink.package_size ||
+                                 oc_clock_time() - g_sink.end >
+                                   g_sink.idle_timeout);
+  if (g_sink.fd >= 0 && restart) {
+    OC_WRN("software update download restarted");
+    swu_sink_close();
+  }
+  if (g_sink.fd < 0) {
+    if (!restart && g_sink.has_digest && package_size == g_sink.package_size &&
+        offset + len <= g_sink.offset) {
+      /* retransmission of a block of the package just completed */
+      return 0;
+    }
+    if (offset != 0 || package_size == 0) {
+      OC_ERR("software update block at %u without a download in progress",
+             (unsigned)offset);
+      return -1;
+    }
+    if (!swu_sink_start(device, package_size)) {
+      oc_swu_set_result(OC_SWU_RESULT_ERR_FLASH);
+      return -1;
+    }
+  }
+  if (package_size != g_sink.package_size) {
+    OC_ERR("software update block of another package (%u bytes)",
+           (unsigned)package_size);
+    swu_sink_fail(OC_SWU_RESULT_ERR_CONN);
+    return -1;
+  }
+  if (offset > g_sink.offset) {
+    /* the digest is computed as the blocks arrive, there can be no gap */
+    OC_ERR("software update block at %u, expected %u", (unsigned)offset,
+           (unsigned)g_sink.offset);
+    swu_sink_fail(OC_SWU_RESULT_ERR_CONN);
+    return -1;
+  }
+  /* skip what has been written before (retransmission) */
+  size_t skip = g_sink.offset - offset;
+  if (skip >= len) {
+    return 0;
+  }
+  data += skip;
+  len -= skip;
+  if (len > g_sink.package_size - g_sink.offset) {
+    OC_ERR("software update block beyond the package size");
+    swu_sink_fail(OC_SWU_RESULT_ERR_FLASH);
+    return -1;
+  }
+
+  if (!swu_sink_pwrite(data, len, g_sink.offset)) {
+    swu_sink_fail(OC_SWU_RESULT_ERR_FLASH);
+    return -1;
+  }
+  if (mbedtls_md_update(&g_sink.sha256, data, len) != 0) {
+    swu_sink_fail(OC_SWU_RESULT_ERR_SUF);
+    return -1;
+  }
+  g_sink.offset += len;
+  g_sink.end = oc_clock_time();
+  oc_swu_set_package_bytes((int)g_sink.offset);
+
+  if (g_sink.offset == g_sink.package_size) {
+    swu_sink_finish();
+  }
+  return 0;
+}
+
+void
+oc_swu_sink_abort(void)
+{
+  if (g_sink.fd >= 0) {
+    swu_sink_fail(OC_SWU_RESULT_ERR_CONN);
+  }
+}
+
+void
+oc_swu_sink_get_stats(oc_swu_sink_stats_t *stats)
+{
+  oc_clock_time_t elapsed = g_sink.end - g_sink.start;
+  stats->package_size = g_sink.package_size;
+  stats->bytes_written = g_sink.offset;
+  stats->elapsed_ms = (uint32_t)((elapsed * 1000) / OC_CLOCK_SECOND);
+  stats->bytes_per_second = 0;
+  if (elapsed > 0) {
+    stats->bytes_per_second =
+      (uint32_t)(((uint64_t)g_sink.offset * OC_CLOCK_SECOND) / elapsed);
+  }
+}
+#endif /* OC_SWU_SINK */
@@ -0,0 +1,168 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/**
+  @brief software update package writer
+  @file
+
+  With OC_SWU_SINK, the blocks of a software update package that are PUT to
+  /a/swu are written by the stack: at their offset into a file that is
+  preallocated to the package size, while a SHA-256 of the package is
+  computed. The blocks are handed over as they arrive (see OC_BLOCK_STREAM),
+  so the memory use does not depend on the package size. /swu/pkgbytes reports
+  the number of bytes written, /swu/result the outcome of the integrity check.
+*/
+#ifndef OC_KNX_SWU_SINK_H
+#define OC_KNX_SWU_SINK_H
+
+#include "oc_ri.h"
+#include "api/oc_knx_swu.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef OC_SWU_SINK
+#ifndef OC_SWU_SINK_PATH
+#define OC_SWU_SINK_PATH "swu_package.bin"
+#endif /* OC_SWU_SINK_PATH */
+
+#ifndef OC_SWU_SINK_IDLE_TIMEOUT
+/**
+ * @brief seconds without a block after which offset 0 restarts the download
+ */
+#define OC_SWU_SINK_IDLE_TIMEOUT (60)
+#endif /* OC_SWU_SINK_IDLE_TIMEOUT */
+
+/**
+ * @brief size of the package digest (SHA-256)
+ */
+#define OC_SWU_SINK_DIGEST_SIZE (32)
+
+/**
+ * @brief progress of the package download
+ */
+typedef struct oc_swu_sink_stats_t
+{
+  size_t package_size;       /**< size of the package */
+  size_t bytes_written;      /**< bytes written (in order) */
+  uint32_t elapsed_ms;       /**< time since the first block */
+  uint32_t bytes_per_second; /**< average throughput */
+} oc_swu_sink_stats_t;
+
+/**
+ * @brief callback invoked when a package has been written completely
+ *
+ * @param device the device index
+ * @param result OC_SWU_RESULT_SUCCESS, or the error e.g.
+ * OC_SWU_RESULT_ERR_ICF when the digest does not match
+ * @param path the file holding the package
+ * @param data the user supplied data
+ */
+typedef void (*oc_swu_sink_done_cb_t)(size_t device, oc_swu_result_t result,
+                                      const char *path, void *data);
+
+/**
+ * @brief set the file the package is written to
+ *
+ * The default is OC_SWU_SINK_PATH. Takes effect with the next package.
+ *
+ * @param path the file name
+ */
+void oc_swu_sink_set_path(const char *path);
+
+/**
+ * @brief set the expected digest of the next package
+ *
+ * Without a digest the package is accepted as it is, the computed digest is
+ * available through oc_swu_sink_get_digest.
+ *
+ * @param digest the SHA-256 of the package, NULL to clear
+ */
+void oc_swu_sink_set_digest(const uint8_t *digest);
+
+/**
+ * @brief get the digest of the last complete package
+ *
+ * @param digest receives OC_SWU_SINK_DIGEST_SIZE bytes
+ * @return true when a package has been completed
+ */
+bool oc_swu_sink_get_digest(uint8_t *digest);
+
+/**
+ * @brief set the idle timeout of a download
+ *
+ * A block at offset 0 that arrives after the download has been idle for this
+ * long starts the package over. The default is OC_SWU_SINK_IDLE_TIMEOUT.
+ *
+ * @param seconds the timeout in seconds
+ */
+void oc_swu_sink_set_idle_timeout(uint16_t seconds);
+
+/**
+ * @brief set the callback invoked when a package has been written
+ *
+ * @param cb the callback
+ * @param data the user supplied data passed to cb
+ */
+void oc_swu_sink_set_done_cb(oc_swu_sink_done_cb_t cb, void *data);
+
+/**
+ * @brief write a block of the package
+ *
+ * The blocks have to arrive in order, a block that has been written before is
+ * ignored. A block at offset 0 starts a new package when there is no download
+ * in progress, when its package size differs from the one in progress, or
+ * when no block has arrived for the idle timeout; otherwise it is taken as a
+ * retransmission. The package size is required to start a package, a later
+ * block with another package size aborts the download in progress.
+ * Only device 0 is supported, there is one package file.
+ * When the last byte of the package has been written, the file is synced and
+ * closed and the digest is checked.
+ *
+ * @param device the device index
+ * @param package_size the size of the package (pkgs)
+ * @param offset the offset of the block in the package
+ * @param data the block
+ * @param len the size of the block
+ * @return int 0 on success, -1 on error (the download is aborted)
+ */
+int oc_swu_sink_write(size_t device, size_t package_size, size_t offset,
+                      const uint8_t *data, size_t len);
+
+/**
+ * @brief abort the download in progress, if any
+ *
+ * Called when a command is posted to /a/swu, the next block at offset 0
+ * starts a new package.
+ */
+void oc_swu_sink_abort(void);
+
+/**
+ * @brief get the progress of the current or last download
+ *
+ * @param stats the progress
+ */
+void oc_swu_sink_get_stats(oc_swu_sink_stats_t *stats);
+#endif /* OC_SWU_SINK */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OC_KNX_SWU_SINK_H */
@@ -356,8 +356,10 @@ oc_main_init(const oc_handler_t *handler)
     app_callbacks->requests_entry();
   }
   // do initialization of the data points according the I flag in
-  // in the group object table
-  oc_init_datapoints_at_initialization();
+  // in the group object table of each device
+  for (size_t device = 0; device < oc_core_get_num_devices(); device++) {
+    oc_init_datapoints_at_initialization_for_device(device);
+  }
 #endif
 
   // note - only advertising for the first device
@@ -19,9 +19,22 @@
 #include "oc_events.h"
 #include "oc_signal_event_loop.h"
 #include "port/oc_connectivity.h"
-#include "util/oc_list.h"
+#include "util/oc_atomic.h"
+#include "util/oc_mpsc_ring.h"
+
+#ifndef OC_NETWORK_EVENT_QUEUE_SIZE
+#define OC_NETWORK_EVENT_QUEUE_SIZE (128)
+#endif /* OC_NETWORK_EVENT_QUEUE_SIZE */
+
+#if (OC_NETWORK_EVENT_QUEUE_SIZE & (OC_NETWORK_EVENT_QUEUE_SIZE - 1)) != 0
+#error "OC_NETWORK_EVENT_QUEUE_SIZE must be a power of 2"
+#endif
+
+/* received messages, pushed by the network threads and popped by the event
+ * loop */
+OC_MPSC_RING(network_events, OC_NETWORK_EVENT_QUEUE_SIZE);
+static oc_network_event_stats_t network_event_stats;
 
-OC_LIST(network_events);
 #ifdef OC_NETWORK_MONITOR
 static bool interface_up, interface_down;
 #endif /* OC_NETWORK_MONITOR */
@@ -29,13 +42,19 @@ static bool interface_up, interface_down;
 static void
 oc_process_network_event(void)
 {
-  oc_network_event_handler_mutex_lock();
-  oc_message_t *message = (oc_message_t *)oc_list_pop(network_events);
+  uint32_t queued = oc_mpsc_ring_size(&network_events);
+  if (queued > network_event_stats.max_queued) {
+    network_event_stats.max_queued = queued;
+  }
+  /* no lock is held while the messages are dispatched, the network threads
+   * can keep queueing in the meantime */
+  oc_message_t *message = (oc_message_t *)oc_mpsc_ring_pop(&network_events);
   while (message != NULL) {
     oc_recv_message(message);
-    message = oc_list_pop(network_events);
+    message = (oc_message_t *)oc_mpsc_ring_pop(&network_events);
   }
 #ifdef OC_NETWORK_MONITOR
+  oc_network_event_handler_mutex_lock();
   if (interface_up) {
     oc_process_post(&oc_network_events, oc_events[INTERFACE_UP], NULL);
     interface_up = false;
@@ -44,8 +63,8 @@ oc_process_network_event(void)
     oc_process_post(&oc_network_events, oc_events[INTERFACE_DOWN], NULL);
     interface_down = false;
   }
-#endif /* OC_NETWORK_MONITOR */
   oc_network_event_handler_mutex_unlock();
+#endif /* OC_NETWORK_MONITOR */
 }
 
 OC_PROCESS(oc_network_events, "");
@@ -74,14 +93,31 @@ oc_network_event(oc_message_t *message)
     oc_message_unref(message);
     return;
   }
-  oc_network_event_handler_mutex_lock();
-  oc_list_add(network_events, message);
-  oc_network_event_handler_mutex_unlock();
+  if (!oc_mpsc_ring_push(&network_events, message)) {
+    OC_ATOMIC_INCREMENT32(network_event_stats.dropped);
+    OC_WRN("network event queue full, dropping message");
+    oc_network_event_handler_mutex_lock();
+    oc_message_unref(message);
+    oc_network_event_handler_mutex_unlock();
+  } else {
+    OC_ATOMIC_INCREMENT32(network_event_stats.received);
+  }
 
   oc_process_poll(&(oc_network_events));
   _oc_signal_event_loop();
 }
 
+void
+oc_network_event_get_stats(oc_network_event_stats_t *stats)
+{
+  if (stats == NULL) {
+    return;
+  }
+  stats->received = OC_ATOMIC_LOAD32(network_event_stats.received);
+  stats->dropped = OC_ATOMIC_LOAD32(network_event_stats.dropped);
+  stats->max_queued = network_event_stats.max_queued;
+}
+
 #ifdef OC_NETWORK_MONITOR
 void
 oc_network_interface_event(oc_interface_event_t event)
@@ -14,6 +14,7 @@
 // limitations under the License.
 */
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "oc_replay.h"
 
@@ -22,11 +23,49 @@
 #include "oc_config.h"
 #include "messaging/coap/constants.h"
 #include "oc_api.h"
+#include "security/oc_oscore_context.h"
 
+/* maximum number of replay windows, one per (sender, KID, KID context).
+ * With OC_DYNAMIC_ALLOCATION the store starts at OC_REPLAY_RECORDS_INITIAL
+ * and doubles when full, up to this limit; after that the least recently used
+ * window is evicted.
+ */
 #ifndef OC_MAX_REPLAY_RECORDS
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_MAX_REPLAY_RECORDS (1024)
+#else /* OC_DYNAMIC_ALLOCATION */
 #define OC_MAX_REPLAY_RECORDS (20)
+#endif /* !OC_DYNAMIC_ALLOCATION */
 #endif
 
+#if OC_MAX_REPLAY_RECORDS > 65535
+#error "OC_MAX_REPLAY_RECORDS must fit in 16 bits"
+#endif
+
+#ifndef OC_REPLAY_RECORDS_INITIAL
+#define OC_REPLAY_RECORDS_INITIAL (32)
+#endif
+
+/* number of hash buckets of the static store, power of 2 */
+#ifndef OC_REPLAY_HASH_SIZE
+#define OC_REPLAY_HASH_SIZE (32)
+#endif
+
+#if (OC_REPLAY_HASH_SIZE & (OC_REPLAY_HASH_SIZE - 1)) != 0
+#error "OC_REPLAY_HASH_SIZE must be a power of 2"
+#endif
+
+/* width of the replay window in bits, multiple of 32 */
+#ifndef OC_REPLAY_WINDOW_SIZE
+#define OC_REPLAY_WINDOW_SIZE (128)
+#endif
+
+#if OC_REPLAY_WINDOW_SIZE == 0 || (OC_REPLAY_WINDOW_SIZE % 32) != 0
+#error "OC_REPLAY_WINDOW_SIZE must be a non zero multiple of 32"
+#endif
+
+#define REPLAY_WINDOW_WORDS (OC_REPLAY_WINDOW_SIZE / 32)
+
 #ifndef OC_MAX_MESSAGE_RECORDS
 #define OC_MAX_MESSAGE_RECORDS (2)
 #endif
@@ -35,16 +74,39 @@
 #define OC_REPLAY_RECORD_TIMEOUT (5)
 #endif
 
-static struct oc_replay_record
+/* Records are linked by index + 1, so that 0 means "none" and the zero
+ * initialised static store is valid without an init call.
+ */
+struct oc_replay_record
 {
-  uint64_t rx_ssn;        /// most recent received SSN of client
-  oc_string_t rx_kid;     /// byte string holding the KID of the client
-  oc_string_t rx_kid_ctx; /// byte string holding the KID context of the client.
-                          /// can be null
-  oc_clock_time_t time;   /// time of last received packet
-  uint32_t window; /// bitfield indicating received SSNs through bit position
-  bool in_use;     /// whether this structure is in use & has valid data
-} replay_records[OC_MAX_REPLAY_RECORDS] = { 0 };
+  oc_rwin_t rwin; /// most recent received SSN and address of the sender
+  uint32_t window[REPLAY_WINDOW_WORDS]; /// bit i: SSN rwin.ssn - i received
+  uint16_t hash_next; /// next record in the bucket, or in the free list
+  uint16_t lru_prev;  /// more recently used record
+  uint16_t lru_next;  /// less recently used record
+  uint8_t kid_len;
+  uint8_t kid[OSCORE_CTXID_LEN];
+  uint8_t kid_ctx_len;
+  uint8_t kid_ctx[OSCORE_IDCTX_LEN];
+  bool in_use; /// whether this structure is in use & has valid data
+};
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static struct oc_replay_record *replay_records;
+static uint16_t *replay_buckets;
+static size_t replay_capacity;
+static size_t replay_bucket_count;
+#else  /* OC_DYNAMIC_ALLOCATION */
+static struct oc_replay_record replay_records[OC_MAX_REPLAY_RECORDS];
+static uint16_t replay_buckets[OC_REPLAY_HASH_SIZE];
+static const size_t replay_capacity = OC_MAX_REPLAY_RECORDS;
+static const size_t replay_bucket_count = OC_REPLAY_HASH_SIZE;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+static size_t replay_high_water; /// slots handed out at least once
+static uint16_t replay_free;     /// head of the free list
+static uint16_t lru_head;        /// most recently used record
+static uint16_t lru_tail;        /// least recently used record
+static oc_replay_stats_t replay_stats;
 
 static struct oc_cached_message_record
 {
@@ -53,71 +115,359 @@ static struct oc_cached_message_record
   struct oc_message_s *message;
 } message_records[OC_MAX_MESSAGE_RECORDS] = { 0 };
 
+typedef struct replay_key_t
+{
+  uint8_t sender_address[16];
+  const uint8_t *kid;
+  size_t kid_len;
+  const uint8_t *kid_ctx;
+  size_t kid_ctx_len;
+} replay_key_t;
+
+#define REC(i) (&replay_records[(i)-1])
+
+static uint32_t
+replay_hash(const replay_key_t *key)
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  size_t i;
+  for (i = 0; i < sizeof(key->sender_address); i++) {
+    hash = (hash ^ key->sender_address[i]) * 16777619u;
+  }
+  for (i = 0; i < key->kid_len; i++) {
+    hash = (hash ^ key->kid[i]) * 16777619u;
+  }
+  hash = (hash ^ 0xff) * 16777619u;
+  for (i = 0; i < key->kid_ctx_len; i++) {
+    hash = (hash ^ key->kid_ctx[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static uint16_t *
+replay_bucket(const replay_key_t *key)
+{
+  return &replay_buckets[replay_hash(key) & (replay_bucket_count - 1)];
+}
+
+static bool
+record_matches(const struct oc_replay_record *rec, const replay_key_t *key)
+{
+  return rec->kid_len == key->kid_len && rec->kid_ctx_len == key->kid_ctx_len &&
+         memcmp(rec->rwin.sender_address, key->sender_address,
+                sizeof(key->sender_address)) == 0 &&
+         memcmp(rec->kid, key->kid, key->kid_len) == 0 &&
+         memcmp(rec->kid_ctx, key->kid_ctx, key->kid_ctx_len) == 0;
+}
+
+static replay_key_t
+record_key(const struct oc_replay_record *rec)
+{
+  replay_key_t key;
+  memcpy(key.sender_address, rec->rwin.sender_address,
+         sizeof(key.sender_address));
+  key.kid = rec->kid;
+  key.kid_len = rec->kid_len;
+  key.kid_ctx = rec->kid_ctx;
+  key.kid_ctx_len = rec->kid_ctx_len;
+  return key;
+}
+
+static void
+lru_unlink(uint16_t i)
+{
+  struct oc_replay_record *rec = REC(i);
+  if (rec->lru_prev) {
+    REC(rec->lru_prev)->lru_next = rec->lru_next;
+  } else {
+    lru_head = rec->lru_next;
+  }
+  if (rec->lru_next) {
+    REC(rec->lru_next)->lru_prev = rec->lru_prev;
+  } else {
+    lru_tail = rec->lru_prev;
+  }
+  rec->lru_prev = 0;
+  rec->lru_next = 0;
+}
+
+static void
+lru_push_front(uint16_t i)
+{
+  struct oc_replay_record *rec = REC(i);
+  rec->lru_prev = 0;
+  rec->lru_next = lru_head;
+  if (lru_head) {
+    REC(lru_head)->lru_prev = i;
+  } else {
+    lru_tail = i;
+  }
+  lru_head = i;
+}
+
+static void
+lru_touch(uint16_t i)
+{
+  if (lru_head != i) {
+    lru_unlink(i);
+    lru_push_front(i);
+  }
+}
+
 // make record available for reuse
 static void
-free_record(struct oc_replay_record *rec)
+free_record(uint16_t i)
 {
-  // bounds check
-  if (replay_records <= rec && rec < replay_records + OC_MAX_REPLAY_RECORDS) {
-    rec->rx_ssn = 0;
-    rec->window = 0;
-    oc_free_string(&rec->rx_kid);
-    oc_free_string(&rec->rx_kid_ctx);
-    rec->time = 0;
-    rec->in_use = false;
+  struct oc_replay_record *rec = REC(i);
+  replay_key_t key = record_key(rec);
+  uint16_t *link = replay_bucket(&key);
+  while (*link != 0 && *link != i) {
+    link = &REC(*link)->hash_next;
+  }
+  if (*link == i) {
+    *link = rec->hash_next;
   }
+  lru_unlink(i);
+  memset(rec, 0, sizeof(*rec));
+  rec->hash_next = replay_free;
+  replay_free = i;
+  replay_stats.records--;
 }
 
-// get the first available record
-static struct oc_replay_record *
-get_empty_record()
+#ifdef OC_DYNAMIC_ALLOCATION
+static bool
+replay_grow(void)
 {
-  for (size_t i = 0; i < OC_MAX_REPLAY_RECORDS; ++i) {
-    if (!replay_records[i].in_use)
-      return replay_records + i;
+  if (replay_capacity >= OC_MAX_REPLAY_RECORDS) {
+    return false;
+  }
+  size_t capacity = replay_capacity ? replay_capacity * 2
+                                    : (size_t)OC_REPLAY_RECORDS_INITIAL;
+  if (capacity > OC_MAX_REPLAY_RECORDS) {
+    capacity = OC_MAX_REPLAY_RECORDS;
+  }
+  size_t bucket_count = 1;
+  while (bucket_count < capacity) {
+    bucket_count <<= 1;
   }
 
-  struct oc_replay_record *oldest_rec = replay_records;
+  uint16_t *buckets = NULL;
+  if (bucket_count != replay_bucket_count) {
+    buckets = (uint16_t *)calloc(bucket_count, sizeof(uint16_t));
+    if (!buckets) {
+      OC_ERR("out of memory for replay windows (%d)", (int)capacity);
+      return false;
+    }
+  }
+  struct oc_replay_record *records = (struct oc_replay_record *)realloc(
+    replay_records, capacity * sizeof(struct oc_replay_record));
+  if (!records) {
+    OC_ERR("out of memory for replay windows (%d)", (int)capacity);
+    free(buckets);
+    return false;
+  }
+  replay_records = records;
+  memset(replay_records + replay_capacity, 0,
+         (capacity - replay_capacity) * sizeof(struct oc_replay_record));
+  replay_capacity = capacity;
+
+  if (buckets) {
+    free(replay_buckets);
+    replay_buckets = buckets;
+    replay_bucket_count = bucket_count;
+    uint16_t i;
+    for (i = 1; i <= replay_high_water; i++) {
+      struct oc_replay_record *rec = REC(i);
+      if (rec->in_use) {
+        replay_key_t key = record_key(rec);
+        uint16_t *bucket = replay_bucket(&key);
+        rec->hash_next = *bucket;
+        *bucket = i;
+      }
+    }
+  }
+  OC_DBG("replay window store resized to %d records", (int)capacity);
+  return true;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+// get an available record, evicting the least recently used one if needed
+static uint16_t
+get_empty_record(void)
+{
+  if (replay_free) {
+    uint16_t i = replay_free;
+    replay_free = REC(i)->hash_next;
+    REC(i)->hash_next = 0;
+    return i;
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (replay_high_water == replay_capacity) {
+    replay_grow();
+  }
+#endif /* OC_DYNAMIC_ALLOCATION */
+  if (replay_high_water < replay_capacity) {
+    return (uint16_t)++replay_high_water;
+  }
+  if (lru_tail == 0) {
+    return 0;
+  }
 
-  for (size_t i = 1; i < OC_MAX_REPLAY_RECORDS; ++i) {
-    if (replay_records[i].time < oldest_rec->time)
-      oldest_rec = replay_records + i;
+  replay_stats.evictions++;
+  free_record(lru_tail);
+  return get_empty_record();
+}
+
+static uint16_t
+get_record(const replay_key_t *key)
+{
+  if (key->kid_len == 0 || replay_capacity == 0) {
+    return 0;
   }
-  free_record(oldest_rec);
-  return oldest_rec;
+
+  uint16_t i = *replay_bucket(key);
+  while (i != 0 && !record_matches(REC(i), key)) {
+    i = REC(i)->hash_next;
+  }
+  return i;
 }
 
-// find record with KID and CTX
-static struct oc_replay_record *
-get_record(oc_string_t rx_kid, oc_string_t rx_kid_ctx)
+static bool
+key_from_strings(replay_key_t *key, oc_string_t rx_kid,
+                 oc_string_t rx_kid_ctx)
 {
-  if (oc_byte_string_len(rx_kid) == 0)
-    return NULL;
+  memset(key->sender_address, 0, sizeof(key->sender_address));
+  key->kid = oc_cast(rx_kid, uint8_t);
+  key->kid_len = oc_byte_string_len(rx_kid);
+  key->kid_ctx = oc_cast(rx_kid_ctx, uint8_t);
+  key->kid_ctx_len = oc_byte_string_len(rx_kid_ctx);
+  return key->kid_len <= OSCORE_CTXID_LEN &&
+         key->kid_ctx_len <= OSCORE_IDCTX_LEN;
+}
 
-  for (size_t i = 0; i < OC_MAX_REPLAY_RECORDS; ++i) {
-    struct oc_replay_record *rec = replay_records + i;
+static void
+key_from_endpoint(replay_key_t *key, const oc_endpoint_t *endpoint)
+{
+  memset(key->sender_address, 0, sizeof(key->sender_address));
+#ifdef OC_IPV4
+  if (endpoint->flags & IPV4) {
+    memcpy(key->sender_address, endpoint->addr.ipv4.address,
+           sizeof(endpoint->addr.ipv4.address));
+  } else
+#endif /* OC_IPV4 */
+  {
+    memcpy(key->sender_address, endpoint->addr.ipv6.address,
+           sizeof(key->sender_address));
+  }
+  key->kid = endpoint->kid;
+  key->kid_len = endpoint->kid_len;
+  key->kid_ctx = endpoint->kid_ctx;
+  key->kid_ctx_len = endpoint->kid_ctx_len;
+}
+
+static bool
+window_test(const uint32_t *window, uint64_t bit)
+{
+  return (window[bit / 32] & ((uint32_t)1 << (bit % 32))) != 0;
+}
 
-    if (rec->in_use) {
-      bool rx_kid_match = oc_byte_string_cmp(rx_kid, rec->rx_kid) == 0;
-      bool null_contexts = oc_byte_string_len(rx_kid_ctx) == 0 &&
-                           oc_byte_string_len(rec->rx_kid_ctx) == 0;
-      bool contexts_match =
-        oc_byte_string_cmp(rx_kid_ctx, rec->rx_kid_ctx) == 0;
+static void
+window_set(uint32_t *window, uint64_t bit)
+{
+  window[bit / 32] |= (uint32_t)1 << (bit % 32);
+}
 
-      if (rx_kid_match && (null_contexts || contexts_match))
-        return rec;
+// slide the window, so that bit i moves to bit i + shift
+static void
+window_shift(uint32_t *window, uint64_t shift)
+{
+  if (shift >= OC_REPLAY_WINDOW_SIZE) {
+    memset(window, 0, REPLAY_WINDOW_WORDS * sizeof(uint32_t));
+    return;
+  }
+  size_t words = (size_t)(shift / 32);
+  unsigned bits = (unsigned)(shift % 32);
+  size_t i;
+  for (i = REPLAY_WINDOW_WORDS; i-- > 0;) {
+    uint32_t v = 0;
+    if (i >= words) {
+      v = window[i - words] << bits;
+      if (bits != 0 && i > words) {
+        v |= window[i - words - 1] >> (32 - bits);
+      }
     }
+    window[i] = v;
   }
-  return NULL;
 }
 
-// return true if SSN of device identified by KID & KID_CTX is within replay
+static void
+add_record(uint64_t rx_ssn, const replay_key_t *key)
+{
+  if (key->kid_len == 0) {
+    return;
+  }
+  uint16_t i = get_record(key);
+
+  if (i == 0) {
+    i = get_empty_record();
+    if (i == 0) {
+      return;
+    }
+    struct oc_replay_record *rec = REC(i);
+    memcpy(rec->rwin.sender_address, key->sender_address,
+           sizeof(key->sender_address));
+    memcpy(rec->kid, key->kid, key->kid_len);
+    rec->kid_len = (uint8_t)key->kid_len;
+    memcpy(rec->kid_ctx, key->kid_ctx, key->kid_ctx_len);
+    rec->kid_ctx_len = (uint8_t)key->kid_ctx_len;
+    rec->in_use = true;
+    uint16_t *bucket = replay_bucket(key);
+    rec->hash_next = *bucket;
+    *bucket = i;
+    lru_push_front(i);
+    replay_stats.records++;
+  } else {
+    lru_touch(i);
+  }
+
+  struct oc_replay_record *rec = REC(i);
+  rec->rwin.ssn = rx_ssn;
+  memset(rec->window, 0, sizeof(rec->window));
+  rec->window[0] = 1;
+}
+
+#if OC_TRUST_FIRST_MCAST
+// find the highest SSN recorded for the kid and kid context of the key, from
+// any sender address: the address is not authenticated, so a frame replayed
+// from another address must not open a fresh window
+static bool
+kid_high_water(const replay_key_t *key, uint64_t *ssn)
+{
+  bool found = false;
+  uint16_t i;
+  for (i = 1; i <= replay_high_water; i++) {
+    const struct oc_replay_record *rec = REC(i);
+    if (rec->in_use && rec->kid_len == key->kid_len &&
+        rec->kid_ctx_len == key->kid_ctx_len &&
+        memcmp(rec->kid, key->kid, key->kid_len) == 0 &&
+        memcmp(rec->kid_ctx, key->kid_ctx, key->kid_ctx_len) == 0) {
+      if (!found || rec->rwin.ssn > *ssn) {
+        *ssn = rec->rwin.ssn;
+      }
+      found = true;
+    }
+  }
+  return found;
+}
+#endif /* OC_TRUST_FIRST_MCAST */
+
+// return true if SSN of the sender identified by the key is within the replay
 // window
 //    if it is, update SSN within replay record
 // return false if no entry found, or if SSN is outside replay window
-bool
-oc_replay_check_client(uint64_t rx_ssn, oc_string_t rx_kid,
-                       oc_string_t rx_kid_ctx, bool is_mcast)
+static bool
+check_record(uint64_t rx_ssn, const replay_key_t *key, bool is_mcast)
 {
   /*
   With CoAP over UDP, you cannot guarantee messages are received in order.
@@ -155,76 +505,93 @@ oc_replay_check_client(uint64_t rx_ssn, oc_string_t rx_kid,
   ssn = 9
   bitfield = 0b1000'1111
 
+  The bitfield is OC_REPLAY_WINDOW_SIZE bits wide, stored in 32 bit words.
   */
 
-  struct oc_replay_record *rec = get_record(rx_kid, rx_kid_ctx);
-  if (rec == NULL) {
+  uint16_t i = get_record(key);
+  if (i == 0) {
+    replay_stats.unknown++;
 #if OC_TRUST_FIRST_MCAST
     if (is_mcast) {
-      oc_replay_add_client(rx_ssn, rx_kid, rx_kid_ctx);
+      uint64_t high_water;
+      if (kid_high_water(key, &high_water) && rx_ssn <= high_water) {
+        OC_DBG("replay check: new sender, ssn at or below %" PRIu64,
+               high_water);
+        replay_stats.replayed++;
+        return false;
+      }
+      add_record(rx_ssn, key);
+      replay_stats.accepted++;
       return true;
-    } else {
-      return false;
     }
 #else
-    return false;
+    (void)is_mcast;
 #endif
+    return false;
   }
   // received message matched existing record, so this record is useful &
-  // should be kept around - thus we update the time here
-  rec->time = oc_clock_time();
-  PRINT("new ssn = %llx\n", rx_ssn);
-  PRINT("record ssn = %llx\n", rec->rx_ssn);
-  PRINT("KEYID = %s\n", oc_string(rx_kid));
-  PRINT("REC->WIN before: %llx\n", rec->window);
-
-  int64_t ssn_diff = rec->rx_ssn - rx_ssn;
-
-  if (ssn_diff >= 0) {
-    PRINT("ssn_diff = %llx >= 0\n", ssn_diff);
+  // should be kept around - thus it becomes the most recently used one
+  lru_touch(i);
+  struct oc_replay_record *rec = REC(i);
+  OC_DBG("replay check: ssn %" PRIu64 ", record ssn %" PRIu64, rx_ssn,
+         rec->rwin.ssn);
+
+  if (rx_ssn <= rec->rwin.ssn) {
+    uint64_t ssn_diff = rec->rwin.ssn - rx_ssn;
     // ensure it is not too old
-    if (ssn_diff > sizeof(rec->window) * 8) {
-      PRINT("false reason 1: too old\n");
+    if (ssn_diff >= OC_REPLAY_WINDOW_SIZE) {
+      OC_DBG("replay check: too old");
+      replay_stats.replayed++;
       return false;
     }
 
     // received SSN is within the window - see if it has been received before
-    if (rec->window & ((uint32_t)1 << ssn_diff)) {
+    if (window_test(rec->window, ssn_diff)) {
       // received before, so this is a replay
-      PRINT("false reason 2: is replay\n");
-      return false;
-    } else {
-      // not received before, so remember that this SSN has been seen before
-      rec->window |= (uint32_t)1 << ssn_diff;
-      PRINT("true 1\n");
-      return true;
-    }
-  } else {
-    PRINT("ssn_diff = dec: %d, hex: %llx\n", ssn_diff, ssn_diff);
-    uint64_t rplwdo = oc_oscore_get_rplwdo();
-    PRINT("replwdo = %llx\n", rplwdo);
-    if (-ssn_diff <= rplwdo) {
-      PRINT("-ssn_diff <= rplwdo, shifting bitfield by %d\n", ssn_diff);
-      // slide the window and accept the packet
-      rec->rx_ssn = rx_ssn;
-      // ssn_diff is negative in this side of the if
-      // note that shifting by an amount greater than the size of the type
-      // is undefined behaviour, so we must zero the window manually here
-      if (-ssn_diff >= sizeof(rec->window) * 8)
-        rec->window = 0;
-      else
-        rec->window = rec->window << (-ssn_diff);
-
-      // set bit 1, indicating ssn rec->rx_ssn has been received
-      rec->window |= 1;
-      PRINT("REC->WIN before: %llx\n", rec->window);
-      PRINT("true 2\n");
-      return true;
-    } else {
-      PRINT("false reason 3: out of window\n");
+      OC_DBG("replay check: is replay");
+      replay_stats.replayed++;
       return false;
     }
+    // not received before, so remember that this SSN has been seen before
+    window_set(rec->window, ssn_diff);
+    replay_stats.accepted++;
+    return true;
+  }
+
+  uint64_t ssn_ahead = rx_ssn - rec->rwin.ssn;
+  uint64_t rplwdo = oc_oscore_get_rplwdo();
+  if (ssn_ahead > rplwdo) {
+    OC_DBG("replay check: %" PRIu64 " ahead, out of window %" PRIu64,
+           ssn_ahead, rplwdo);
+    replay_stats.out_of_window++;
+    return false;
+  }
+  // slide the window and accept the packet
+  rec->rwin.ssn = rx_ssn;
+  window_shift(rec->window, ssn_ahead);
+  // set bit 0, indicating ssn rec->rwin.ssn has been received
+  window_set(rec->window, 0);
+  replay_stats.accepted++;
+  return true;
+}
+
+bool
+oc_replay_check_client(uint64_t rx_ssn, oc_string_t rx_kid,
+                       oc_string_t rx_kid_ctx, bool is_mcast)
+{
+  replay_key_t key;
+  if (!key_from_strings(&key, rx_kid, rx_kid_ctx)) {
+    return false;
   }
+  return check_record(rx_ssn, &key, is_mcast);
+}
+
+bool
+oc_replay_check_endpoint(uint64_t rx_ssn, const oc_endpoint_t *endpoint)
+{
+  replay_key_t key;
+  key_from_endpoint(&key, endpoint);
+  return check_record(rx_ssn, &key, (endpoint->flags & MULTICAST) != 0);
 }
 
 // update replay record if match found
@@ -233,31 +600,63 @@ void
 oc_replay_add_client(uint64_t rx_ssn, oc_string_t rx_kid,
                      oc_string_t rx_kid_ctx)
 {
-  struct oc_replay_record *rec = get_record(rx_kid, rx_kid_ctx);
-
-  if (!rec) {
-    rec = get_empty_record();
-    oc_byte_string_copy(&rec->rx_kid, rx_kid);
-    oc_byte_string_copy(&rec->rx_kid_ctx, rx_kid_ctx);
-    rec->in_use = true;
+  replay_key_t key;
+  if (key_from_strings(&key, rx_kid, rx_kid_ctx)) {
+    add_record(rx_ssn, &key);
   }
+}
 
-  rec->rx_ssn = rx_ssn;
-  rec->window = 1;
-  rec->time = oc_clock_time();
+void
+oc_replay_add_endpoint(uint64_t rx_ssn, const oc_endpoint_t *endpoint)
+{
+  replay_key_t key;
+  key_from_endpoint(&key, endpoint);
+  add_record(rx_ssn, &key);
 }
 
 void
 oc_replay_free_client(oc_string_t rx_kid)
 {
-  for (size_t i = 0; i < OC_MAX_REPLAY_RECORDS; ++i) {
-    struct oc_replay_record *rec = replay_records + i;
-    if (oc_byte_string_cmp(rx_kid, rec->rx_kid) == 0) {
-      free_record(rec);
+  size_t kid_len = oc_byte_string_len(rx_kid);
+  uint16_t i;
+  for (i = 1; i <= replay_high_water; i++) {
+    struct oc_replay_record *rec = REC(i);
+    if (rec->in_use && rec->kid_len == kid_len &&
+        memcmp(rec->kid, oc_cast(rx_kid, uint8_t), kid_len) == 0) {
+      free_record(i);
     }
   }
 }
 
+void
+oc_replay_free_all(void)
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(replay_records);
+  free(replay_buckets);
+  replay_records = NULL;
+  replay_buckets = NULL;
+  replay_capacity = 0;
+  replay_bucket_count = 0;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  memset(replay_records, 0, sizeof(replay_records));
+  memset(replay_buckets, 0, sizeof(replay_buckets));
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  replay_high_water = 0;
+  replay_free = 0;
+  lru_head = 0;
+  lru_tail = 0;
+  replay_stats.records = 0;
+}
+
+void
+oc_replay_get_stats(oc_replay_stats_t *stats)
+{
+  if (stats) {
+    *stats = replay_stats;
+  }
+}
+
 struct oc_message_s *
 oc_replay_find_msg_by_token(uint16_t token_len, uint8_t *token)
 {
@@ -22,6 +22,20 @@ extern "C" {
 
 #include "oc_helpers.h"
 #include "oc_buffer.h"
+#include "oc_endpoint.h"
+
+/**
+ * @brief statistics of the replay window store
+ */
+typedef struct oc_replay_stats_t
+{
+  uint32_t records;       /**< replay windows in use */
+  uint32_t accepted;      /**< frames accepted */
+  uint32_t replayed;      /**< frames rejected as replayed or too old */
+  uint32_t out_of_window; /**< frames rejected as too far ahead (rplwdo) */
+  uint32_t unknown;       /**< frames from senders without a replay window */
+  uint32_t evictions;     /**< windows evicted to make room for a sender */
+} oc_replay_stats_t;
 
 /**
  * @brief Add a synchronised client
@@ -54,6 +68,31 @@ void oc_replay_add_client(uint64_t rx_ssn, oc_string_t rx_kid,
 bool oc_replay_check_client(uint64_t rx_ssn, oc_string_t rx_kid,
                             oc_string_t rx_kid_ctx, bool is_mcast);
 
+/**
+ * @brief Add a synchronised sender, identified by the source address, KID and
+ * KID context of the received message
+ *
+ * Senders sharing a group key (same KID and KID context) each get their own
+ * replay window, so that their sequence numbers do not interfere.
+ *
+ * @param rx_ssn Sender Sequence Number of newly received OSCORE request
+ * @param endpoint the endpoint of the received (decrypted) request
+ */
+void oc_replay_add_endpoint(uint64_t rx_ssn, const oc_endpoint_t *endpoint);
+
+/**
+ * @brief Check if a sender is synchronised, see oc_replay_check_client()
+ *
+ * The window is selected by source address, KID and KID context of the
+ * endpoint. Multicast is taken from the endpoint flags.
+ *
+ * @param rx_ssn Sender Sequence Number of newly received OSCORE request
+ * @param endpoint the endpoint of the received (decrypted) request
+ * @return true the frame with the given SSN may be accepted
+ * @return false the sender is not synchronised or the frame is a replay
+ */
+bool oc_replay_check_endpoint(uint64_t rx_ssn, const oc_endpoint_t *endpoint);
+
 /**
  * @brief Free all clients with a given KID. Should be used whenever the
  * corresponding access token is deleted
@@ -62,6 +101,22 @@ bool oc_replay_check_client(uint64_t rx_ssn, oc_string_t rx_kid,
  */
 void oc_replay_free_client(oc_string_t rx_kid);
 
+/**
+ * @brief Free all replay windows, e.g. at shutdown
+ */
+void oc_replay_free_all(void);
+
+/**
+ * @brief retrieve the statistics of the replay window store
+ *
+ * The store holds up to OC_MAX_REPLAY_RECORDS windows of
+ * OC_REPLAY_WINDOW_SIZE bits; the least recently used window is evicted when
+ * it is full.
+ *
+ * @param stats the statistics (output)
+ */
+void oc_replay_get_stats(oc_replay_stats_t *stats);
+
 /**
  * @brief Mark a message to be retained for retransmission
  *
@@ -0,0 +1,381 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "oc_resource_index.h"
+#include "oc_api.h"
+#include "port/oc_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef OC_SERVER
+
+/* a string of a resource: one of its types or its interface */
+typedef struct index_entry_t
+{
+  const char *str;
+  size_t len;
+  size_t ordinal;
+} index_entry_t;
+
+static struct
+{
+  bool valid;
+  uint32_t generation;
+  size_t num_resources;
+  const oc_resource_t **resources; /* by ordinal, in list order */
+  uint8_t *selected;               /* bit per ordinal */
+  uint8_t *scratch;                /* bit per ordinal */
+  size_t num_types;
+  index_entry_t *types;      /* sorted by string, then ordinal */
+  index_entry_t *interfaces; /* sorted by string, then ordinal */
+  size_t num_groups;
+  oc_fb_group_t *groups;
+  oc_fb_member_t *members;
+} g_index;
+
+void
+oc_resource_index_free(void)
+{
+  free(g_index.resources);
+  free(g_index.selected);
+  free(g_index.types);
+  free(g_index.interfaces);
+  free(g_index.groups);
+  free(g_index.members);
+  memset(&g_index, 0, sizeof(g_index));
+}
+
+static int
+entry_compare(const void *a, const void *b)
+{
+  const index_entry_t *ea = (const index_entry_t *)a;
+  const index_entry_t *eb = (const index_entry_t *)b;
+  int cmp = memcmp(ea->str, eb->str, ea->len < eb->len ? ea->len : eb->len);
+  if (cmp != 0) {
+    return cmp;
+  }
+  if (ea->len != eb->len) {
+    return ea->len < eb->len ? -1 : 1;
+  }
+  if (ea->ordinal != eb->ordinal) {
+    return ea->ordinal < eb->ordinal ? -1 : 1;
+  }
+  return 0;
+}
+
+/* data point types: ":dpa.352.51" or "urn:knx:dpa.352.51", the functional
+ * block number is the number after the first dot */
+static bool
+is_dpa_type(const char *t)
+{
+  return strncmp(t, ":dpa", 4) == 0 || strncmp(t, "urn:knx:dpa", 11) == 0;
+}
+
+static int
+dpa_fb_number(const char *t)
+{
+  const char *dot = strchr(t, '.');
+  return dot ? atoi(dot + 1) : -1;
+}
+
+static bool
+is_netip_type(const char *t)
+{
+  return strncmp(t, ":dpa.11.", 8) == 0 ||
+         strncmp(t, "urn:knx:dpa.11.", 15) == 0;
+}
+
+static oc_fb_group_t *
+find_group(size_t device, int fb, int instance)
+{
+  for (size_t i = 0; i < g_index.num_groups; i++) {
+    oc_fb_group_t *group = &g_index.groups[i];
+    if (group->device == device && group->fb == fb &&
+        group->instance == instance) {
+      return group;
+    }
+  }
+  return NULL;
+}
+
+static void
+build_fb_groups(void)
+{
+  /* first pass: the groups in order of appearance, reserve a member slot for
+   * every data point type so that the members of a group are contiguous */
+  for (size_t r = 0; r < g_index.num_resources; r++) {
+    const oc_resource_t *resource = g_index.resources[r];
+    for (size_t i = 0; i < oc_string_array_get_allocated_size(resource->types);
+         i++) {
+      const char *t = oc_string_array_get_item(resource->types, i);
+      int fb = is_dpa_type(t) ? dpa_fb_number(t) : -1;
+      if (fb < 0) {
+        continue;
+      }
+      oc_fb_group_t *group =
+        find_group(resource->device, fb, resource->fb_instance);
+      if (group == NULL) {
+        group = &g_index.groups[g_index.num_groups++];
+        group->device = resource->device;
+        group->fb = fb;
+        group->instance = resource->fb_instance;
+        group->num_members = 0;
+        group->members = NULL;
+      }
+      group->num_members++;
+    }
+  }
+
+  oc_fb_member_t *next = g_index.members;
+  for (size_t g = 0; g < g_index.num_groups; g++) {
+    g_index.groups[g].members = next;
+    next += g_index.groups[g].num_members;
+    g_index.groups[g].num_members = 0;
+  }
+
+  /* second pass: one member per resource */
+  for (size_t r = 0; r < g_index.num_resources; r++) {
+    const oc_resource_t *resource = g_index.resources[r];
+    for (size_t i = 0; i < oc_string_array_get_allocated_size(resource->types);
+         i++) {
+      const char *t = oc_string_array_get_item(resource->types, i);
+      int fb = is_dpa_type(t) ? dpa_fb_number(t) : -1;
+      if (fb < 0) {
+        continue;
+      }
+      oc_fb_group_t *group =
+        find_group(resource->device, fb, resource->fb_instance);
+      oc_fb_member_t *member =
+        (oc_fb_member_t *)&group->members[group->num_members];
+      if (group->num_members == 0 || member[-1].resource != resource) {
+        member->resource = resource;
+        member->num_dp = 0;
+        member->regular = false;
+        member->netip = false;
+        group->num_members++;
+      } else {
+        member--;
+      }
+      member->num_dp++;
+      if (is_netip_type(t)) {
+        member->netip = true;
+      } else if (fb > 0) {
+        member->regular = true;
+      }
+    }
+  }
+}
+
+static bool
+index_update(void)
+{
+  uint32_t generation = oc_ri_get_app_resources_generation();
+  if (g_index.valid && g_index.generation == generation) {
+    return true;
+  }
+  oc_resource_index_free();
+
+  size_t num_resources = 0, num_types = 0, num_dpa = 0;
+  const oc_resource_t *resource = oc_ri_get_app_resources();
+  for (; resource; resource = resource->next) {
+    num_resources++;
+    for (size_t i = 0; i < oc_string_array_get_allocated_size(resource->types);
+         i++) {
+      num_types++;
+      if (is_dpa_type(oc_string_array_get_item(resource->types, i))) {
+        num_dpa++;
+      }
+    }
+  }
+
+  size_t bitmap_size = (num_resources + 7) / 8;
+  g_index.resources = (const oc_resource_t **)malloc(
+    (num_resources + 1) * sizeof(const oc_resource_t *));
+  g_index.selected = (uint8_t *)calloc(1, 2 * bitmap_size + 1);
+  g_index.types =
+    (index_entry_t *)malloc((num_types + 1) * sizeof(index_entry_t));
+  g_index.interfaces =
+    (index_entry_t *)malloc((num_resources + 1) * sizeof(index_entry_t));
+  g_index.groups =
+    (oc_fb_group_t *)malloc((num_dpa + 1) * sizeof(oc_fb_group_t));
+  g_index.members =
+    (oc_fb_member_t *)malloc((num_dpa + 1) * sizeof(oc_fb_member_t));
+  if (!g_index.resources || !g_index.selected || !g_index.types ||
+      !g_index.interfaces || !g_index.groups || !g_index.members) {
+    OC_ERR("could not allocate the resource index");
+    oc_resource_index_free();
+    return false;
+  }
+  g_index.scratch = g_index.selected + bitmap_size;
+
+  resource = oc_ri_get_app_resources();
+  for (; resource; resource = resource->next) {
+    size_t ordinal = g_index.num_resources++;
+    g_index.resources[ordinal] = resource;
+    if (resource->runtime_data) {
+      resource->runtime_data->index_ordinal = ordinal;
+    }
+    for (size_t i = 0; i < oc_string_array_get_allocated_size(resource->types);
+         i++) {
+      index_entry_t *entry = &g_index.types[g_index.num_types++];
+      entry->str = oc_string_array_get_item(resource->types, i);
+      entry->len = oc_string_array_get_item_size(resource->types, i);
+      entry->ordinal = ordinal;
+    }
+    index_entry_t *entry = &g_index.interfaces[ordinal];
+    entry->str = get_interface_string(resource->interfaces);
+    entry->len = strlen(entry->str);
+    entry->ordinal = ordinal;
+  }
+  qsort(g_index.types, g_index.num_types, sizeof(index_entry_t),
+        entry_compare);
+  qsort(g_index.interfaces, g_index.num_resources, sizeof(index_entry_t),
+        entry_compare);
+  build_fb_groups();
+
+  g_index.generation = generation;
+  g_index.valid = true;
+  OC_DBG("resource index: %d resources, %d types, %d functional blocks",
+         (int)g_index.num_resources, (int)g_index.num_types,
+         (int)g_index.num_groups);
+  return true;
+}
+
+/* sets the bits of the entries equal to key, or starting with key */
+static void
+mark_entries(const index_entry_t *entries, size_t num, const char *key,
+             size_t key_len, bool prefix, uint8_t *bits)
+{
+  index_entry_t probe = { key, key_len, 0 };
+  size_t low = 0, high = num;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (entry_compare(&entries[mid], &probe) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  for (; low < num; low++) {
+    const index_entry_t *entry = &entries[low];
+    if (entry->len < key_len || memcmp(entry->str, key, key_len) != 0 ||
+        (!prefix && entry->len != key_len)) {
+      break;
+    }
+    bits[entry->ordinal / 8] |= (uint8_t)(1 << (entry->ordinal % 8));
+  }
+}
+
+/* marks the resources that may match the values of the query parameter key,
+ * the same way as oc_filter_resource_by_rt (skip == 0: exact match or prefix
+ * up to the wild card) and oc_filter_resource_by_if (skip == 8: prefix of
+ * the value after "urn:knx:", a wild card matches everything).
+ * returns false when the parameter does not restrict the resources. */
+static bool
+mark_query(oc_request_t *request, const char *key, size_t skip,
+           const index_entry_t *entries, size_t num, uint8_t *bits)
+{
+  bool restricted = false, more_query_params = false;
+  char *value = NULL;
+  int value_len = -1;
+
+  memset(bits, 0, (g_index.num_resources + 7) / 8);
+  oc_init_query_iterator();
+  do {
+    more_query_params =
+      oc_iterate_query_get_values(request, key, &value, &value_len);
+    if (value_len > (int)skip) {
+      const char *wildcard = memchr(value, '*', value_len);
+      if (wildcard != NULL && (skip > 0 || wildcard == value)) {
+        return false;
+      }
+      size_t len = wildcard ? (size_t)(wildcard - value) : (size_t)value_len;
+      mark_entries(entries, num, value + skip, len - skip,
+                   skip > 0 || wildcard != NULL, bits);
+      restricted = true;
+    }
+  } while (more_query_params);
+  return restricted;
+}
+
+bool
+oc_resource_index_select(oc_request_t *request)
+{
+  if (request->query_len == 0 || !index_update()) {
+    return false;
+  }
+  size_t bitmap_size = (g_index.num_resources + 7) / 8;
+  bool by_rt = mark_query(request, "rt", 0, g_index.types, g_index.num_types,
+                          g_index.selected);
+  bool by_if = mark_query(request, "if", 8, g_index.interfaces,
+                          g_index.num_resources, g_index.scratch);
+  if (by_rt && by_if) {
+    for (size_t i = 0; i < bitmap_size; i++) {
+      g_index.selected[i] &= g_index.scratch[i];
+    }
+  } else if (by_if) {
+    memcpy(g_index.selected, g_index.scratch, bitmap_size);
+  }
+  return by_rt || by_if;
+}
+
+const oc_resource_t *
+oc_resource_index_next_selected(const oc_resource_t *resource)
+{
+  if (resource == NULL) {
+    return NULL;
+  }
+  size_t ordinal =
+    resource->runtime_data ? resource->runtime_data->index_ordinal : 0;
+  if (!g_index.valid || ordinal >= g_index.num_resources ||
+      g_index.resources[ordinal] != resource) {
+    /* not indexed, let the caller check it */
+    return resource;
+  }
+  for (; ordinal < g_index.num_resources; ordinal++) {
+    uint8_t bits = g_index.selected[ordinal / 8];
+    if (bits == 0 && ordinal % 8 == 0) {
+      ordinal += 7;
+      continue;
+    }
+    if (bits & (1 << (ordinal % 8))) {
+      return g_index.resources[ordinal];
+    }
+  }
+  return NULL;
+}
+
+const oc_fb_group_t *
+oc_resource_index_get_fb_groups(size_t *num_groups)
+{
+  *num_groups = 0;
+  if (!index_update() || g_index.num_groups == 0) {
+    return NULL;
+  }
+  *num_groups = g_index.num_groups;
+  return g_index.groups;
+}
+
+const oc_fb_group_t *
+oc_resource_index_find_fb(size_t device_index, int fb, int instance)
+{
+  if (!index_update()) {
+    return NULL;
+  }
+  return find_group(device_index, fb, instance);
+}
+
+#endif /* OC_SERVER */
@@ -0,0 +1,119 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/**
+  @brief index of the application resources
+  @file
+
+  The application resources are indexed by resource type, by interface and by
+  functional block (number and instance) of their data point types, so that
+  filtered discovery and the /f listings only visit the matching resources.
+  The index is built on first use after resources have been added or removed,
+  or their types, interfaces or functional block instance changed (see
+  oc_ri_get_app_resources_generation). Properties that may change at run
+  time (e.g. OC_DISCOVERABLE) are not part of the index and must still be
+  checked by the caller.
+*/
+#ifndef OC_RESOURCE_INDEX_H
+#define OC_RESOURCE_INDEX_H
+
+#include "oc_ri.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef OC_SERVER
+/**
+ * @brief a resource that implements (part of) a functional block
+ */
+typedef struct oc_fb_member_t
+{
+  const oc_resource_t *resource; /**< the resource */
+  int num_dp;   /**< number of data point types of the functional block */
+  bool regular; /**< has data point types of a regular functional block */
+  bool netip;   /**< has data point types of the netip functional block */
+} oc_fb_member_t;
+
+/**
+ * @brief a functional block instance of a device
+ *
+ * Functional blocks are ordered by first appearance in the list of resources,
+ * the members are in list order.
+ */
+typedef struct oc_fb_group_t
+{
+  size_t device;                 /**< device index */
+  int fb;                        /**< functional block number */
+  int instance;                  /**< functional block instance */
+  size_t num_members;            /**< number of resources */
+  const oc_fb_member_t *members; /**< the resources */
+} oc_fb_group_t;
+
+/**
+ * @brief select the resources that may match the rt and if queries
+ *
+ * The selection is a superset of the resources accepted by
+ * oc_filter_resource_by_rt and oc_filter_resource_by_if.
+ *
+ * @param request the request with the query
+ * @return true when a selection was made, false when all resources have to be
+ * visited (no rt or if query, or no index available)
+ */
+bool oc_resource_index_select(oc_request_t *request);
+
+/**
+ * @brief next selected resource
+ *
+ * @param resource the resource to start from, included in the search
+ * @return const oc_resource_t* the first selected resource from resource on,
+ * NULL when there is none
+ */
+const oc_resource_t *oc_resource_index_next_selected(
+  const oc_resource_t *resource);
+
+/**
+ * @brief the functional blocks of all devices
+ *
+ * @param num_groups the number of functional blocks
+ * @return const oc_fb_group_t* the functional blocks, NULL when there are
+ * none or no index could be built
+ */
+const oc_fb_group_t *oc_resource_index_get_fb_groups(size_t *num_groups);
+
+/**
+ * @brief find a functional block instance
+ *
+ * @param device_index the device index
+ * @param fb functional block number
+ * @param instance functional block instance
+ * @return const oc_fb_group_t* the functional block or NULL
+ */
+const oc_fb_group_t *oc_resource_index_find_fb(size_t device_index, int fb,
+                                               int instance);
+
+/**
+ * @brief release the memory of the index
+ */
+void oc_resource_index_free(void);
+#endif /* OC_SERVER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OC_RESOURCE_INDEX_H */
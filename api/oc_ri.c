@@ -24,6 +24,7 @@
 #include "util/oc_memb.h"
 #include "util/oc_process.h"
 
+#include "messaging/coap/coap_index.h"
 #include "messaging/coap/constants.h"
 #include "messaging/coap/engine.h"
 #include "messaging/coap/oc_coap.h"
@@ -38,6 +39,7 @@
 #include "oc_discovery.h"
 #include "oc_events.h"
 #include "oc_network_events.h"
+#include "oc_crypto_worker.h"
 #ifdef OC_TCP
 #include "oc_session_events.h"
 #endif /* OC_TCP */
@@ -45,7 +47,10 @@
 #include "oc_ri.h"
 #include "oc_uuid.h"
 
+#include "oc_knx_fp.h"
 #include "oc_knx_sec.h"
+#include "oc_replay.h"
+#include "oc_resource_index.h"
 
 #ifdef OC_BLOCK_WISE
 #include "oc_blockwise.h"
@@ -61,6 +66,8 @@ OC_LIST(app_resources);
 OC_LIST(observe_callbacks);
 OC_MEMB(app_resources_s, oc_resource_t, OC_MAX_APP_RESOURCES);
 OC_MEMB(app_resource_datas_s, oc_resource_data_t, OC_MAX_APP_RESOURCES);
+/* bumped whenever resources are added to or removed from app_resources */
+static uint32_t app_resources_generation = 0;
 #endif /* OC_SERVER */
 
 #ifdef OC_CLIENT
@@ -377,6 +384,19 @@ oc_ri_get_app_resources(void)
   return oc_list_head(app_resources);
 }
 
+uint32_t
+oc_ri_get_app_resources_generation(void)
+{
+  return app_resources_generation;
+}
+
+void
+oc_ri_app_resources_changed(void)
+{
+  app_resources_generation++;
+  oc_discovery_invalidate_cache();
+}
+
 bool
 oc_ri_is_app_resource_valid(const oc_resource_t *resource)
 {
@@ -598,11 +618,17 @@ start_processes(void)
 #ifdef OC_TCP
   oc_process_start(&oc_session_events, NULL);
 #endif /* OC_TCP */
+#ifdef OC_CRYPTO_WORKER
+  oc_process_start(&oc_crypto_worker_events, NULL);
+#endif /* OC_CRYPTO_WORKER */
 }
 
 static void
 stop_processes(void)
 {
+#ifdef OC_CRYPTO_WORKER
+  oc_process_exit(&oc_crypto_worker_events);
+#endif /* OC_CRYPTO_WORKER */
 #ifdef OC_TCP
   oc_process_exit(&oc_session_events);
 #endif /* OC_TCP */
@@ -722,6 +748,7 @@ oc_ri_delete_resource(const oc_resource_t *_resource)
   if (oc_list_remove2(app_resources, resource) == NULL) {
     return true;
   }
+  oc_ri_app_resources_changed();
 
   if (resource->runtime_data->num_observers > 0) {
     coap_remove_observer_by_resource(resource);
@@ -755,6 +782,7 @@ oc_ri_delete_resource_block(const oc_resource_t *_resource)
                             (void *)dummy_resource) == NULL) {
     return true;
   }
+  oc_ri_app_resources_changed();
 
   for (; _resource != dummy_resource; _resource = _resource->next) {
     if (_resource->is_const)
@@ -792,6 +820,7 @@ oc_ri_add_resource(oc_resource_t *resource)
 
   if (valid) {
     oc_list_add(app_resources, resource);
+    oc_ri_app_resources_changed();
   }
 
   return valid;
@@ -820,6 +849,7 @@ oc_ri_add_resource_block(const oc_resource_t *resource)
 
   if (valid) {
     oc_list_add_block(app_resources, (void *)resource);
+    oc_ri_app_resources_changed();
   }
 
   return valid;
@@ -880,6 +910,22 @@ oc_ri_remove_timed_event_callback(void *cb_data, oc_trigger_t event_callback)
   }
 }
 
+bool
+oc_ri_has_timed_event_callback(const void *cb_data,
+                               oc_trigger_t event_callback)
+{
+  const oc_event_callback_t *event_cb =
+    (oc_event_callback_t *)oc_list_head(timed_callbacks);
+
+  while (event_cb != NULL) {
+    if (event_cb->data == cb_data && event_cb->callback == event_callback) {
+      return true;
+    }
+    event_cb = event_cb->next;
+  }
+  return false;
+}
+
 void
 oc_ri_add_timed_event_callback_ticks(void *cb_data, oc_trigger_t event_callback,
                                      oc_clock_time_t ticks)
@@ -936,16 +982,6 @@ check_event_callbacks(void)
   poll_event_callback_timers(timed_callbacks, &event_callbacks_s);
 }
 
-#ifdef OC_SERVER
-static oc_event_callback_retval_t
-oc_observe_notification_delayed(void *data)
-{
-  (void)data;
-  coap_notify_observers((oc_resource_t *)data, NULL, NULL);
-  return OC_EVENT_DONE;
-}
-#endif
-
 #ifdef OC_SERVER
 static oc_event_callback_retval_t
 periodic_observe_handler(void *data)
@@ -1075,12 +1111,46 @@ oc_ri_get_interface_mask(char *iface, size_t if_len)
   return iface_mask;
 }
 
+const oc_resource_t *
+oc_ri_get_resource_by_uri(const char *uri, size_t uri_len, size_t device)
+{
+  for (int i = 0; i < OC_NUM_CORE_RESOURCES_PER_DEVICE; i++) {
+    const oc_resource_t *resource = oc_core_get_resource_by_index(i, device);
+    if (oc_string_len(resource->uri) == (uri_len + 1) &&
+        strncmp((const char *)oc_string(resource->uri) + 1, uri, uri_len) ==
+          0) {
+      return resource;
+    }
+    if (oc_uri_contains_wildcard(oc_string(resource->uri))) {
+      int len_resource = (int)oc_string_len(resource->uri);
+      // incoming URL should be equal or larger than the one with the wild
+      // card comparison should match to what ever is in front of the last
+      // char.
+      if (((int)(uri_len + 1) >= len_resource) &&
+          strncmp((const char *)oc_string(resource->uri) + 1, uri,
+                  (size_t)len_resource - 2) == 0) {
+        return resource;
+      }
+    }
+  }
+
+#ifdef OC_SERVER
+  /* Check against list of declared application resources.
+   */
+  return oc_ri_get_app_resource_by_uri(uri, uri_len, device);
+#else  /* OC_SERVER */
+  return NULL;
+#endif /* !OC_SERVER */
+}
+
 #ifdef OC_BLOCK_WISE
 bool
 oc_ri_invoke_coap_entity_handler(void *request, void *response,
                                  oc_blockwise_state_t **request_state,
                                  oc_blockwise_state_t **response_state,
-                                 uint16_t block2_size, oc_endpoint_t *endpoint)
+                                 uint16_t block2_size,
+                                 oc_block_stream_t *stream,
+                                 oc_endpoint_t *endpoint)
 #else  /* OC_BLOCK_WISE */
 bool
 oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
@@ -1133,6 +1203,8 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
   request_obj.origin = endpoint;
   request_obj._payload = NULL;
   request_obj._payload_len = 0;
+  request_obj.block_offset = 0;
+  request_obj.block_more = false;
 
   /* Initialize interface selector. */
   oc_interface_mask_t iface_query = 0, iface_mask = 0;
@@ -1173,7 +1245,13 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
   const uint8_t *payload = NULL;
   int payload_len = 0;
 #ifdef OC_BLOCK_WISE
-  if (*request_state) {
+  /* a streamed request is handed over block by block, in the CoAP packet */
+  bool more_blocks = false;
+  if (stream) {
+    payload_len = coap_get_payload(request, &payload);
+    request_obj.block_offset = stream->offset;
+    request_obj.block_more = more_blocks = stream->more;
+  } else if (*request_state) {
     payload = (*request_state)->buffer;
     payload_len = (*request_state)->payload_size;
   }
@@ -1199,7 +1277,12 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
 #endif /* OC_DYNAMIC_ALLOCATION */
   oc_rep_set_pool(&rep_objects);
 
+#ifdef OC_BLOCK_WISE
+  if (payload_len > 0 && !stream &&
+      (cf == APPLICATION_CBOR || cf == APPLICATION_OSCORE)) {
+#else  /* OC_BLOCK_WISE */
   if (payload_len > 0 && (cf == APPLICATION_CBOR || cf == APPLICATION_OSCORE)) {
+#endif /* !OC_BLOCK_WISE */
     /* Attempt to parse request payload using tinyCBOR via oc_rep helper
      * functions. The result of this parse is a tree of oc_rep_t structures
      * which will reflect the schema of the payload.
@@ -1217,47 +1300,15 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
     }
   }
 
-  const oc_resource_t *resource, *cur_resource = NULL;
+  const oc_resource_t *cur_resource = NULL;
 
   /* If there were no errors thus far, attempt to locate the specific
    * resource object that will handle the request using the request uri.
    */
-  /* Check against list of declared core resources.
-   */
   if (!bad_request) {
-    int i;
-    int len_resource;
-    for (i = 0; i < OC_NUM_CORE_RESOURCES_PER_DEVICE; i++) {
-      resource = oc_core_get_resource_by_index(i, endpoint->device);
-      if (oc_string_len(resource->uri) == (uri_path_len + 1) &&
-          strncmp((const char *)oc_string(resource->uri) + 1, uri_path,
-                  uri_path_len) == 0) {
-        request_obj.resource = cur_resource = resource;
-        break;
-      }
-      if (oc_uri_contains_wildcard(oc_string(resource->uri))) {
-        len_resource = (int)oc_string_len(resource->uri);
-        // incoming URL should be equal or larger than the one with the wild
-        // card comparison should match to what ever is in front of the last
-        // char.
-        if (((int)(uri_path_len + 1) >= len_resource) &&
-            strncmp((const char *)oc_string(resource->uri) + 1, uri_path,
-                    (size_t)len_resource - 2) == 0) {
-          request_obj.resource = cur_resource = resource;
-          break;
-        }
-      }
-    }
-  }
-
-#ifdef OC_SERVER
-  /* Check against list of declared application resources.
-   */
-  if (!cur_resource && !bad_request) {
     request_obj.resource = cur_resource =
-      oc_ri_get_app_resource_by_uri(uri_path, uri_path_len, endpoint->device);
+      oc_ri_get_resource_by_uri(uri_path, uri_path_len, endpoint->device);
   }
-#endif /* OC_SERVER */
 
   if (cur_resource) {
     /* If there was no interface selection, pick the "default interface". */
@@ -1282,7 +1333,11 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
 /* Alloc response_state. It also affects request_obj.response.
  */
 #ifdef OC_BLOCK_WISE
-  if (cur_resource && !bad_request) {
+  if (stream) {
+    /* the response block is written into the CoAP message */
+    response_buffer.buffer = stream->buffer;
+    response_buffer.buffer_size = stream->buffer_size;
+  } else if (cur_resource && !bad_request) {
     if (!(*response_state)) {
       OC_DBG("creating new block-wise response state");
       *response_state = oc_blockwise_alloc_response_buffer(
@@ -1340,6 +1395,11 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
          * its handler for the requested method. If it has not
          * implemented that method, then return a 4.05 response.
          */
+        /* The handlers use the group tables of the device of the resource,
+         * the previous selection is restored when they return.
+         */
+        size_t selected_device = oc_core_fp_get_selected_device();
+        oc_core_fp_select_device(cur_resource->device);
         if (method == OC_GET && cur_resource->get_handler.cb) {
           cur_resource->get_handler.cb(&request_obj, iface_mask,
                                        cur_resource->get_handler.user_data);
@@ -1355,10 +1415,14 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
         } else {
           method_impl = false;
         }
+        oc_core_fp_select_device(selected_device);
       }
   }
 
 #if defined(OC_BLOCK_WISE)
+  if (stream) {
+    stream->more = request_obj.block_more;
+  }
   oc_blockwise_scrub_buffers(false);
 #endif
 
@@ -1512,14 +1576,20 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
        * altered the resource state, so attempt to notify all observers
        * of that resource with the change.
        */
+#ifdef OC_BLOCK_WISE
+      /* a streamed request changes the resource once all blocks are in */
       if (cur_resource && (method == OC_PUT || method == OC_POST) &&
+          !more_blocks &&
           response_buffer.code < oc_status_code(OC_STATUS_BAD_REQUEST)) {
+#else  /* OC_BLOCK_WISE */
+      if (cur_resource && (method == OC_PUT || method == OC_POST) &&
+          response_buffer.code < oc_status_code(OC_STATUS_BAD_REQUEST)) {
+#endif /* !OC_BLOCK_WISE */
         // check this with s-mode
         if ((endpoint->flags & MULTICAST) == 0) {
           // only handle observe when not doing multicast
-          PRINT(" adding callback\n");
-          oc_ri_add_timed_event_callback_ticks(
-            (void *)cur_resource, &oc_observe_notification_delayed, 0);
+          coap_notify_observers_delayed(cur_resource,
+                                        OC_OBSERVE_COALESCE_WINDOW_TICKS);
         } else {
           PRINT(" not adding callback\n");
         }
@@ -1528,8 +1598,13 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
 #endif /* OC_SERVER */
       if (response_buffer.response_length > 0) {
 #ifdef OC_BLOCK_WISE
-        (*response_state)->payload_size =
-          (uint32_t)response_buffer.response_length;
+        if (stream) {
+          coap_set_payload(response, response_buffer.buffer,
+                           response_buffer.response_length);
+        } else {
+          (*response_state)->payload_size =
+            (uint32_t)response_buffer.response_length;
+        }
 #else  /* OC_BLOCK_WISE */
       coap_set_payload(response, response_buffer.buffer,
                        response_buffer.response_length);
@@ -1568,6 +1643,9 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
 static void
 free_client_cb(oc_client_cb_t *cb)
 {
+  coap_index_remove_ptr(COAP_INDEX_CLIENT_CB, cb, cb);
+  coap_index_remove_mid(COAP_INDEX_CLIENT_CB_MID, cb->mid, cb);
+  coap_index_remove(COAP_INDEX_CLIENT_CB_TOKEN, cb->token, cb->token_len, cb);
   oc_list_remove(client_cbs, cb);
 #ifdef OC_BLOCK_WISE
   oc_blockwise_scrub_buffers_for_client_cb(cb);
@@ -1613,10 +1691,29 @@ notify_client_cb_503(oc_client_cb_t *cb)
   free_client_cb(cb);
 }
 
+static bool
+client_cb_can_be_freed(const void *obj, const void *ctx)
+{
+  (void)ctx;
+  const oc_client_cb_t *cb = (const oc_client_cb_t *)obj;
+  return !cb->multicast && !cb->discovery && cb->ref_count == 0;
+}
+
 void
 oc_ri_free_client_cbs_by_mid(uint16_t mid)
 {
-  oc_client_cb_t *cb = (oc_client_cb_t *)oc_list_head(client_cbs), *next;
+  oc_client_cb_t *cb;
+  if (coap_index_is_complete()) {
+    while ((cb = (oc_client_cb_t *)coap_index_find(
+              COAP_INDEX_CLIENT_CB_MID, &mid, sizeof(mid),
+              client_cb_can_be_freed, NULL)) != NULL) {
+      cb->ref_count = 1;
+      notify_client_cb_503(cb);
+    }
+    return;
+  }
+  oc_client_cb_t *next;
+  cb = (oc_client_cb_t *)oc_list_head(client_cbs);
   while (cb != NULL) {
     next = cb->next;
     if (!cb->multicast && !cb->discovery && cb->ref_count == 0 &&
@@ -1647,9 +1744,31 @@ oc_ri_free_client_cbs_by_endpoint(oc_endpoint_t *endpoint)
   }
 }
 
+void
+oc_ri_client_cb_set_mid(oc_client_cb_t *cb, uint16_t mid)
+{
+  coap_index_remove_mid(COAP_INDEX_CLIENT_CB_MID, cb->mid, cb);
+  cb->mid = mid;
+  coap_index_add_mid(COAP_INDEX_CLIENT_CB_MID, cb->mid, cb);
+}
+
+void
+oc_ri_client_cb_set_token(oc_client_cb_t *cb, const uint8_t *token,
+                          uint8_t token_len)
+{
+  coap_index_remove(COAP_INDEX_CLIENT_CB_TOKEN, cb->token, cb->token_len, cb);
+  memcpy(cb->token, token, token_len);
+  cb->token_len = token_len;
+  coap_index_add(COAP_INDEX_CLIENT_CB_TOKEN, cb->token, cb->token_len, cb);
+}
+
 oc_client_cb_t *
 oc_ri_find_client_cb_by_mid(uint16_t mid)
 {
+  if (coap_index_is_complete()) {
+    return (oc_client_cb_t *)coap_index_find(COAP_INDEX_CLIENT_CB_MID, &mid,
+                                             sizeof(mid), NULL, NULL);
+  }
   oc_client_cb_t *cb = oc_list_head(client_cbs);
   while (cb) {
     if (cb->mid == mid)
@@ -1662,6 +1781,10 @@ oc_ri_find_client_cb_by_mid(uint16_t mid)
 oc_client_cb_t *
 oc_ri_find_client_cb_by_token(uint8_t *token, uint8_t token_len)
 {
+  if (coap_index_is_complete()) {
+    return (oc_client_cb_t *)coap_index_find(COAP_INDEX_CLIENT_CB_TOKEN, token,
+                                             token_len, NULL, NULL);
+  }
   oc_client_cb_t *cb = oc_list_head(client_cbs);
   while (cb != NULL) {
     if (cb->token_len == token_len && memcmp(cb->token, token, token_len) == 0)
@@ -1674,6 +1797,10 @@ oc_ri_find_client_cb_by_token(uint8_t *token, uint8_t token_len)
 bool
 oc_ri_is_client_cb_valid(oc_client_cb_t *client_cb)
 {
+  if (coap_index_is_complete()) {
+    return coap_index_find(COAP_INDEX_CLIENT_CB, &client_cb, sizeof(void *),
+                           NULL, NULL) != NULL;
+  }
   oc_client_cb_t *cb = oc_list_head(client_cbs);
   while (cb != NULL) {
     if (cb == client_cb) {
@@ -1937,6 +2064,9 @@ oc_ri_alloc_client_cb(const char *uri, oc_endpoint_t *endpoint,
   //    (handler.discovery != NULL)) {
   oc_list_add(client_cbs, cb);
   //}
+  coap_index_add_ptr(COAP_INDEX_CLIENT_CB, cb, cb);
+  coap_index_add_mid(COAP_INDEX_CLIENT_CB_MID, cb->mid, cb);
+  coap_index_add(COAP_INDEX_CLIENT_CB_TOKEN, cb->token, cb->token_len, cb);
 
   return cb;
 }
@@ -1956,17 +2086,26 @@ oc_ri_shutdown(void)
 #ifdef OC_BLOCK_WISE
   oc_blockwise_scrub_buffers(true);
 #endif /* OC_BLOCK_WISE */
+#ifdef OC_REQUEST_HISTORY
+  oc_coap_free_history();
+#endif /* OC_REQUEST_HISTORY */
 
   while (oc_main_poll() != 0)
     ;
 
+#ifdef OC_CRYPTO_WORKER
+  oc_crypto_worker_shutdown();
+#endif /* OC_CRYPTO_WORKER */
   stop_processes();
 
   oc_process_shutdown();
 
 #ifdef OC_SERVER
   oc_ri_delete_all_app_resources();
+  oc_resource_index_free();
 #endif /* OC_SERVER */
+  coap_index_free();
+  oc_replay_free_all();
 
   oc_random_destroy();
 }
@@ -29,6 +29,7 @@
 #endif /* OC_DYNAMIC_ALLOCATION */
 
 #include "oc_core_res.h"
+#include "oc_discovery.h"
 
 static size_t query_iterator;
 
@@ -303,6 +304,7 @@ oc_new_resource(const char *name, const char *uri, uint8_t num_resource_types,
       resource->observe_period_seconds = 0;
       resource->runtime_data = data;
       resource->runtime_data->num_observers = 0;
+      resource->runtime_data->acl_valid = false;
       resource->properties = OC_DISCOVERABLE;
       *(bool *)&resource->is_const = false;
       oc_populate_resource_object(resource, name, uri, num_resource_types,
@@ -329,6 +331,7 @@ oc_resource_bind_resource_interface(oc_resource_t *resource,
   }
 
   resource->interfaces |= iface_mask;
+  oc_ri_app_resources_changed();
 }
 
 void
@@ -343,6 +346,7 @@ oc_resource_bind_resource_type(oc_resource_t *resource, const char *type)
     return;
   }
   oc_string_array_add_item(resource->types, (char *)type);
+  oc_ri_app_resources_changed();
 }
 
 void
@@ -402,6 +406,7 @@ oc_resource_set_discoverable(oc_resource_t *resource, bool state)
     resource->properties |= OC_DISCOVERABLE;
   else
     resource->properties &= ~OC_DISCOVERABLE;
+  oc_discovery_invalidate_cache();
 }
 
 void
@@ -438,6 +443,24 @@ oc_resource_set_periodic_observable(oc_resource_t *resource, uint16_t seconds)
   resource->observe_period_seconds = seconds;
 }
 
+void
+oc_resource_set_block_stream(oc_resource_t *resource, bool state)
+{
+  if (resource == NULL) {
+    OC_ERR("oc_resource_set_block_stream: resource is NULL");
+    return;
+  }
+  if (resource->is_const) {
+    OC_ERR("oc_resource_set_block_stream: resource data is const");
+    return;
+  }
+
+  if (state)
+    resource->properties |= OC_BLOCK_STREAM;
+  else
+    resource->properties &= ~OC_BLOCK_STREAM;
+}
+
 void
 oc_resource_set_function_block_instance(oc_resource_t *resource,
                                         uint8_t instance)
@@ -451,6 +474,7 @@ oc_resource_set_function_block_instance(oc_resource_t *resource,
     return;
   }
   resource->fb_instance = instance;
+  oc_ri_app_resources_changed();
 }
 
 void
@@ -686,6 +710,11 @@ oc_send_empty_separate_response(oc_separate_response_t *handle,
 int
 oc_notify_observers(const oc_resource_t *resource)
 {
+#if OC_OBSERVE_COALESCE_WINDOW_MS > 0
+  return coap_notify_observers_delayed(resource,
+                                       OC_OBSERVE_COALESCE_WINDOW_TICKS);
+#else  /* OC_OBSERVE_COALESCE_WINDOW_MS > 0 */
   return coap_notify_observers(resource, NULL, NULL);
+#endif /* OC_OBSERVE_COALESCE_WINDOW_MS == 0 */
 }
 #endif /* OC_SERVER */
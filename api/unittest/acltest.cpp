@@ -0,0 +1,122 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+
+#include "api/oc_knx_sec.h"
+#include "oc_api.h"
+
+#ifdef OC_OSCORE
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+class TestAcl : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    ASSERT_EQ(0, oc_main_init(&handler));
+    resource = oc_new_resource("acl", "/p/acl", 0, 0);
+    ASSERT_NE(nullptr, resource);
+    oc_resource_bind_resource_interface(resource, OC_IF_D);
+    ASSERT_TRUE(oc_add_resource(resource));
+    memset(&unprotected, 0, sizeof(unprotected));
+    unprotected.flags = IPV6;
+    memset(&decrypted, 0, sizeof(decrypted));
+    decrypted.flags = (enum transport_flags)(IPV6 | OSCORE | OSCORE_DECRYPTED);
+  }
+
+  void TearDown() override
+  {
+    oc_delete_resource(resource);
+    oc_main_shutdown();
+  }
+
+  bool allowed(oc_method_t method, oc_endpoint_t *endpoint)
+  {
+    return oc_knx_sec_check_acl(method, resource, endpoint);
+  }
+
+  // as the resource is populated, the uri is not copied
+  void set_uri(const char *uri)
+  {
+    resource->uri.next = NULL;
+    resource->uri.ptr = (char *)uri;
+    resource->uri.size = strlen(uri) + 1;
+  }
+
+  oc_resource_t *resource;
+  oc_endpoint_t unprotected;
+  oc_endpoint_t decrypted;
+};
+
+TEST_F(TestAcl, PublicMethodsAfterUriChange)
+{
+  EXPECT_FALSE(allowed(OC_GET, &unprotected));
+  EXPECT_FALSE(allowed(OC_POST, &unprotected));
+
+  // the spake resource takes unprotected POSTs
+  set_uri("/.well-known/knx/spake");
+  EXPECT_TRUE(allowed(OC_POST, &unprotected));
+  EXPECT_FALSE(allowed(OC_GET, &unprotected));
+
+  // and .well-known/core unprotected GETs
+  set_uri("/.well-known/core");
+  EXPECT_TRUE(allowed(OC_GET, &unprotected));
+  EXPECT_FALSE(allowed(OC_POST, &unprotected));
+
+  set_uri("/p/acl");
+  EXPECT_FALSE(allowed(OC_GET, &unprotected));
+  EXPECT_FALSE(allowed(OC_POST, &unprotected));
+}
+
+TEST_F(TestAcl, SecureMethodsAfterInterfaceChange)
+{
+  // if.d only allows GET
+  EXPECT_TRUE(allowed(OC_GET, &decrypted));
+  EXPECT_FALSE(allowed(OC_PUT, &decrypted));
+  EXPECT_FALSE(allowed(OC_POST, &decrypted));
+
+  // if.p adds PUT
+  oc_resource_bind_resource_interface(resource, OC_IF_P);
+  EXPECT_TRUE(allowed(OC_GET, &decrypted));
+  EXPECT_TRUE(allowed(OC_PUT, &decrypted));
+  EXPECT_FALSE(allowed(OC_POST, &decrypted));
+
+  // interfaces written directly, without the bind function
+  resource->interfaces = OC_IF_O;
+  EXPECT_TRUE(allowed(OC_GET, &decrypted));
+  EXPECT_FALSE(allowed(OC_PUT, &decrypted));
+  EXPECT_TRUE(allowed(OC_POST, &decrypted));
+
+  // secure methods stay secure for messages that are not protected
+  EXPECT_FALSE(allowed(OC_GET, &unprotected));
+}
+#endif /* OC_OSCORE */
@@ -0,0 +1,99 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "oc_api.h"
+#include "oc_buffer.h"
+
+#ifdef OC_DIRECT_DISPATCH
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+class TestDirectDispatch : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    ASSERT_EQ(0, oc_main_init(&handler));
+  }
+
+  void TearDown() override { oc_main_shutdown(); }
+
+  // a non-confirmable GET to the loopback address
+  static oc_message_t *new_message(void)
+  {
+    oc_message_t *message = oc_allocate_message();
+    if (message == NULL) {
+      return NULL;
+    }
+    message->endpoint.flags = IPV6;
+    message->endpoint.addr.ipv6.address[15] = 1;
+    message->endpoint.addr.ipv6.port = 5683;
+    message->data[0] = 0x50;
+    message->data[1] = 0x01;
+    message->data[2] = 0x00;
+    message->data[3] = 0x01;
+    message->length = 4;
+    return message;
+  }
+};
+
+TEST_F(TestDirectDispatch, SentTwiceBeforeGoingOut)
+{
+  oc_message_t *first = new_message();
+  oc_message_t *second = new_message();
+  ASSERT_NE(nullptr, first);
+  ASSERT_NE(nullptr, second);
+  // one reference for each send, the test keeps the one of the allocation
+  oc_message_add_ref(first);
+  oc_message_add_ref(first);
+  oc_message_add_ref(second);
+
+  oc_send_message(first);
+  oc_send_message(second);
+  // the first message again, while it is queued in front of the second
+  oc_send_message(first);
+  EXPECT_EQ(2, first->ref_count);
+  EXPECT_EQ(2, second->ref_count);
+
+  // both go out once, the queue is neither cut nor looped
+  oc_main_poll();
+  EXPECT_EQ(1, first->ref_count);
+  EXPECT_EQ(1, second->ref_count);
+
+  // sent again after it went out, it is queued again
+  oc_message_add_ref(first);
+  oc_send_message(first);
+  oc_main_poll();
+  EXPECT_EQ(1, first->ref_count);
+
+  oc_message_unref(first);
+  oc_message_unref(second);
+}
+#endif /* OC_DIRECT_DISPATCH */
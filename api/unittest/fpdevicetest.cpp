@@ -0,0 +1,251 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "api/oc_knx_fp.h"
+#include "oc_api.h"
+#include "oc_core_res.h"
+#include "port/oc_storage.h"
+
+#define FP_TEST_STORE "./fpdevicetest_creds"
+#define FP_TEST_IID (5)
+#define FP_TEST_GOT_SIZE (4)
+#define FP_TEST_GPT_SIZE (2)
+#define FP_TEST_GRT_SIZE (3)
+
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  // device 1 gets small tables
+  if (!oc_core_fp_set_device_table_sizes(FP_TEST_GOT_SIZE, FP_TEST_GPT_SIZE,
+                                         FP_TEST_GRT_SIZE)) {
+    return -1;
+  }
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000002", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+class TestFpDevices : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    oc_storage_config(FP_TEST_STORE);
+    ASSERT_EQ(0, oc_main_init(&handler));
+    ASSERT_EQ(2u, oc_core_get_num_devices());
+    for (size_t device = 0; device < 2; device++) {
+      // the same installation and port: the groups of both devices map on
+      // the same multicast addresses
+      oc_core_set_device_iid(device, FP_TEST_IID);
+    }
+  }
+
+  void TearDown() override
+  {
+    for (size_t device = 0; device < 2; device++) {
+      oc_core_fp_select_device(device);
+      oc_delete_group_object_table();
+    }
+    oc_core_fp_select_device(0);
+    oc_main_shutdown();
+  }
+
+  // sets a group object table entry of the selected device
+  static void set_got_entry(int index, const char *href,
+                            oc_cflag_mask_t cflags, uint32_t ga0, uint32_t ga1)
+  {
+    uint32_t ga[2] = { ga0, ga1 };
+    oc_group_object_table_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.id = index + 1;
+    oc_new_string(&entry.href, href, strlen(href));
+    entry.cflags = cflags;
+    entry.ga_len = 2;
+    entry.ga = ga;
+    oc_core_set_group_object_table(index, entry);
+    oc_free_string(&entry.href);
+  }
+
+  // the url of a group object table entry of the selected device
+  static std::string got_url(int index)
+  {
+    oc_string_t url = oc_core_find_group_object_table_url_from_index(index);
+    return std::string(oc_string(url), oc_string_len(url));
+  }
+
+  static bool stored(const char *name)
+  {
+    uint8_t buf[256];
+    return oc_storage_read(name, buf, sizeof(buf)) > 0;
+  }
+};
+
+TEST_F(TestFpDevices, OverlappingGroupObjectTables)
+{
+  // group address 2 is used by both devices
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+  set_got_entry(0, "/p/a", OC_CFLAG_WRITE, 1, 2);
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  set_got_entry(0, "/p/b", (oc_cflag_mask_t)(OC_CFLAG_WRITE | OC_CFLAG_READ),
+                2, 3);
+
+  // each device only sees its own table
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+  EXPECT_EQ(0, oc_core_find_group_object_table_index(1));
+  EXPECT_EQ(0, oc_core_find_group_object_table_index(2));
+  EXPECT_EQ(-1, oc_core_find_group_object_table_index(3));
+  EXPECT_EQ("/p/a", got_url(0));
+  EXPECT_EQ(OC_CFLAG_WRITE, oc_core_group_object_table_cflag_entries(0));
+
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  EXPECT_EQ(1u, oc_core_fp_get_selected_device());
+  EXPECT_EQ(-1, oc_core_find_group_object_table_index(1));
+  EXPECT_EQ(0, oc_core_find_group_object_table_index(2));
+  EXPECT_EQ(0, oc_core_find_group_object_table_index(3));
+  EXPECT_EQ("/p/b", got_url(0));
+
+  // an unknown device leaves the selection as it is
+  EXPECT_FALSE(oc_core_fp_select_device(2));
+  EXPECT_EQ(1u, oc_core_fp_get_selected_device());
+}
+
+#ifdef OC_USE_STORAGE
+TEST_F(TestFpDevices, StoreNames)
+{
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+  set_got_entry(0, "/p/a", OC_CFLAG_WRITE, 1, 2);
+  oc_dump_group_object_table_entry(0);
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  set_got_entry(0, "/p/b", OC_CFLAG_WRITE, 2, 3);
+  oc_dump_group_object_table_entry(0);
+
+  // device 0 keeps the names of single device builds
+  EXPECT_TRUE(stored("GOT_STORE_0"));
+  EXPECT_TRUE(stored("GOT_STORE_1_0"));
+
+  // each device loads its own entry
+  set_got_entry(0, "/p/x", OC_CFLAG_WRITE, 7, 8);
+  oc_load_group_object_table_entry(0);
+  EXPECT_EQ("/p/b", got_url(0));
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+  set_got_entry(0, "/p/x", OC_CFLAG_WRITE, 7, 8);
+  oc_load_group_object_table_entry(0);
+  EXPECT_EQ("/p/a", got_url(0));
+
+  // deleting the entry of device 1 leaves the one of device 0
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  oc_delete_group_object_table_entry(0);
+  EXPECT_FALSE(stored("GOT_STORE_1_0"));
+  EXPECT_TRUE(stored("GOT_STORE_0"));
+}
+#endif /* OC_USE_STORAGE */
+
+TEST_F(TestFpDevices, MergedMemberships)
+{
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+  set_got_entry(0, "/p/a", OC_CFLAG_WRITE, 1, 2);
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  set_got_entry(0, "/p/b", OC_CFLAG_UPDATE, 2, 3);
+  // not used for receiving
+  set_got_entry(1, "/p/c", OC_CFLAG_TRANSMISSION, 4, 5);
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+
+  // the group used by both devices is joined once, referenced twice
+  oc_register_group_multicasts();
+  EXPECT_EQ(1, oc_get_group_multicast_refcount(1));
+  EXPECT_EQ(2, oc_get_group_multicast_refcount(2));
+  EXPECT_EQ(1, oc_get_group_multicast_refcount(3));
+  EXPECT_EQ(0, oc_get_group_multicast_refcount(4));
+  // the selection of the caller is kept
+  EXPECT_EQ(0u, oc_core_fp_get_selected_device());
+
+  // the group stays joined for device 0
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  oc_delete_group_object_table_entry(0);
+  oc_register_group_multicasts();
+  EXPECT_EQ(1u, oc_core_fp_get_selected_device());
+  EXPECT_EQ(1, oc_get_group_multicast_refcount(1));
+  EXPECT_EQ(1, oc_get_group_multicast_refcount(2));
+  EXPECT_EQ(0, oc_get_group_multicast_refcount(3));
+}
+
+TEST_F(TestFpDevices, InitReadsPerDevice)
+{
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+  set_got_entry(0, "/p/a", OC_CFLAG_WRITE, 1, 2);
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  set_got_entry(0, "/p/b", (oc_cflag_mask_t)(OC_CFLAG_READ | OC_CFLAG_INIT),
+                2, 3);
+  set_got_entry(1, "/p/c", (oc_cflag_mask_t)(OC_CFLAG_READ | OC_CFLAG_INIT),
+                4, 5);
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+
+  // each device reads the entries of its own table
+  EXPECT_EQ(0, oc_init_datapoints_at_initialization_for_device(0));
+  EXPECT_EQ(2, oc_init_datapoints_at_initialization_for_device(1));
+  EXPECT_EQ(0, oc_init_datapoints_at_initialization_for_device(2));
+  // the selection of the caller is kept
+  EXPECT_EQ(0u, oc_core_fp_get_selected_device());
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  EXPECT_EQ(2, oc_init_datapoints_at_initialization_for_device(1));
+  EXPECT_EQ(1u, oc_core_fp_get_selected_device());
+}
+
+TEST_F(TestFpDevices, TableSizes)
+{
+  ASSERT_TRUE(oc_core_fp_select_device(1));
+  EXPECT_EQ(FP_TEST_GOT_SIZE, oc_core_get_group_object_table_total_size());
+  EXPECT_EQ(FP_TEST_GRT_SIZE, oc_core_get_recipient_table_size());
+#ifdef OC_PUBLISHER_TABLE
+  EXPECT_EQ(FP_TEST_GPT_SIZE, oc_core_get_publisher_table_size());
+#endif /* OC_PUBLISHER_TABLE */
+
+  // the entries past the size of the device are not there
+  set_got_entry(FP_TEST_GOT_SIZE - 1, "/p/a", OC_CFLAG_WRITE, 1, 2);
+  EXPECT_EQ(FP_TEST_GOT_SIZE - 1, oc_core_find_group_object_table_index(1));
+  EXPECT_EQ(nullptr, oc_core_get_group_object_table_entry(FP_TEST_GOT_SIZE));
+  EXPECT_EQ(nullptr, oc_core_get_recipient_table_entry(FP_TEST_GRT_SIZE));
+  oc_group_object_table_t entry;
+  memset(&entry, 0, sizeof(entry));
+  EXPECT_EQ(-1, oc_core_set_group_object_table(FP_TEST_GOT_SIZE, entry));
+
+  // device 0 has the maximum sizes
+  ASSERT_TRUE(oc_core_fp_select_device(0));
+  EXPECT_LT(FP_TEST_GOT_SIZE, oc_core_get_group_object_table_total_size());
+  EXPECT_LT(FP_TEST_GRT_SIZE, oc_core_get_recipient_table_size());
+#ifdef OC_DYNAMIC_ALLOCATION
+  EXPECT_LT(oc_core_fp_get_device_tables_size(1),
+            oc_core_fp_get_device_tables_size(0));
+  EXPECT_EQ(0u, oc_core_fp_get_device_tables_size(2));
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+  EXPECT_FALSE(oc_core_fp_set_device_table_sizes(0, 1, 1));
+  EXPECT_FALSE(oc_core_fp_set_device_table_sizes(1, 1, 0));
+}
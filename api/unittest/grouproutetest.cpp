@@ -0,0 +1,233 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "api/oc_knx_fp.h"
+#include "oc_api.h"
+#include "oc_core_res.h"
+
+// the group addresses used in the tables, and some that are not
+#define MAX_TEST_GA (12)
+
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+class TestGroupRoutes : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    ASSERT_EQ(0, oc_main_init(&handler));
+  }
+
+  void TearDown() override
+  {
+    oc_delete_group_rp_table();
+    oc_main_shutdown();
+  }
+
+  static oc_group_rp_table_t make_entry(int id, int ia, uint32_t grpid,
+                                        std::vector<uint32_t> &ga)
+  {
+    oc_group_rp_table_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.id = id;
+    entry.ia = ia;
+    entry.grpid = grpid;
+    entry.ga = ga.data();
+    entry.ga_len = (int)ga.size();
+    return entry;
+  }
+
+  static void add_recipient(int index, int ia, uint32_t grpid,
+                            std::vector<uint32_t> ga)
+  {
+    oc_group_rp_table_t entry = make_entry(index + 1, ia, grpid, ga);
+    // oc_core_add_recipient_entry does not copy the ia
+    oc_core_get_recipient_table_entry(index)->ia = ia;
+    oc_core_add_recipient_entry(index, entry);
+  }
+
+  static bool has_ga(const oc_group_rp_table_t *entry, uint32_t ga)
+  {
+    for (int i = 0; entry->ga && i < entry->ga_len; i++) {
+      if (entry->ga[i] == ga) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // the lookups over the full tables that the routes replace
+  static uint32_t scan_grpid(uint32_t ga)
+  {
+    for (int i = 0; i < oc_core_get_recipient_table_size(); i++) {
+      oc_group_rp_table_t *entry = oc_core_get_recipient_table_entry(i);
+      if (has_ga(entry, ga)) {
+        return entry->grpid;
+      }
+    }
+    return 0;
+  }
+
+  static uint32_t scan_pub_grpid(uint32_t ga)
+  {
+    for (int i = 0; i < oc_core_get_publisher_table_size(); i++) {
+      oc_group_rp_table_t *entry = oc_core_get_publisher_table_entry(i);
+      if (entry && has_ga(entry, ga)) {
+        return entry->grpid;
+      }
+    }
+    return 0;
+  }
+
+  static std::vector<int> scan_recipients(uint32_t ga)
+  {
+    std::vector<int> recipients;
+    for (int i = 0; i < oc_core_get_recipient_table_size(); i++) {
+      oc_group_rp_table_t *entry = oc_core_get_recipient_table_entry(i);
+      if (entry->ia > 0 && has_ga(entry, ga)) {
+        recipients.push_back(i);
+      }
+    }
+    return recipients;
+  }
+
+  // compares the compiled routes with the scans, for all test group addresses
+  static void expect_routes_match_tables()
+  {
+    for (uint32_t ga = 1; ga <= MAX_TEST_GA; ga++) {
+      const oc_group_route_t *route = oc_core_find_group_route(ga);
+      std::vector<int> recipients = scan_recipients(ga);
+      EXPECT_EQ(scan_grpid(ga), oc_find_grpid_in_recipient_table(ga))
+        << "ga " << ga;
+      EXPECT_EQ(scan_pub_grpid(ga), oc_find_grpid_in_publisher_table(ga))
+        << "ga " << ga;
+      if (route == NULL) {
+        EXPECT_TRUE(recipients.empty()) << "ga " << ga;
+        EXPECT_EQ(0u, scan_grpid(ga)) << "ga " << ga;
+        continue;
+      }
+      EXPECT_EQ(ga, route->ga);
+      std::vector<int> compiled;
+      for (int r = 0; r < route->nr_recipients; r++) {
+        compiled.push_back(oc_core_get_group_route_recipient(route, r));
+      }
+      EXPECT_EQ(recipients, compiled) << "ga " << ga;
+      EXPECT_EQ(-1,
+                oc_core_get_group_route_recipient(route, route->nr_recipients));
+    }
+  }
+};
+
+TEST_F(TestGroupRoutes, Empty)
+{
+  EXPECT_EQ(nullptr, oc_core_find_group_route(1));
+  expect_routes_match_tables();
+}
+
+TEST_F(TestGroupRoutes, MatchesTables)
+{
+  // ga 2 is used by three entries, the grpid of the first one is used
+  add_recipient(0, 0, 100, { 1, 2 });
+  add_recipient(1, 5, 200, { 2, 3 });
+  add_recipient(2, 6, 300, { 2, 4, 4 });
+  // an entry without group addresses
+  add_recipient(3, 7, 400, {});
+  add_recipient(5, 8, 500, { 9 });
+#ifdef OC_PUBLISHER_TABLE
+  std::vector<uint32_t> pub_ga = { 3, 10 };
+  oc_core_add_publisher_entry(0, make_entry(1, 0, 600, pub_ga));
+#endif /* OC_PUBLISHER_TABLE */
+
+  expect_routes_match_tables();
+
+  const oc_group_route_t *route = oc_core_find_group_route(2);
+  ASSERT_NE(nullptr, route);
+  EXPECT_EQ(100u, route->grpid);
+  EXPECT_EQ(2, route->nr_recipients);
+  // a group address listed twice in an entry is sent to once
+  route = oc_core_find_group_route(4);
+  ASSERT_NE(nullptr, route);
+  EXPECT_EQ(1, route->nr_recipients);
+}
+
+TEST_F(TestGroupRoutes, RecompileAfterAdd)
+{
+  add_recipient(0, 5, 100, { 1 });
+  expect_routes_match_tables();
+  EXPECT_EQ(nullptr, oc_core_find_group_route(7));
+
+  // the added entry is routed without any explicit invalidation
+  add_recipient(1, 6, 200, { 1, 7 });
+  expect_routes_match_tables();
+  const oc_group_route_t *route = oc_core_find_group_route(7);
+  ASSERT_NE(nullptr, route);
+  EXPECT_EQ(200u, route->grpid);
+  route = oc_core_find_group_route(1);
+  ASSERT_NE(nullptr, route);
+  EXPECT_EQ(2, route->nr_recipients);
+
+  // an entry overwritten with other group addresses
+  add_recipient(1, 6, 200, { 8 });
+  expect_routes_match_tables();
+  EXPECT_EQ(nullptr, oc_core_find_group_route(7));
+}
+
+TEST_F(TestGroupRoutes, RecompileAfterDelete)
+{
+  add_recipient(0, 5, 100, { 1, 2 });
+  add_recipient(1, 6, 200, { 2, 3 });
+  expect_routes_match_tables();
+
+  // an application that changes an entry directly invalidates the routes
+  oc_group_rp_table_t *entry = oc_core_get_recipient_table_entry(0);
+  free(entry->ga);
+  entry->ga = NULL;
+  entry->ga_len = 0;
+  entry->id = -1;
+  oc_core_invalidate_group_routes();
+  expect_routes_match_tables();
+  EXPECT_EQ(nullptr, oc_core_find_group_route(1));
+  const oc_group_route_t *route = oc_core_find_group_route(2);
+  ASSERT_NE(nullptr, route);
+  EXPECT_EQ(200u, route->grpid);
+  EXPECT_EQ(1, route->nr_recipients);
+
+  // deleting the tables drops all routes
+  oc_delete_group_rp_table();
+  expect_routes_match_tables();
+  EXPECT_EQ(nullptr, oc_core_find_group_route(2));
+  EXPECT_EQ(nullptr, oc_core_find_group_route(3));
+}
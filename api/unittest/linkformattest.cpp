@@ -162,6 +162,56 @@ TEST_F(TestLinkFormat, LF_zero)
   EXPECT_EQ(0, nr_entries);
 }
 
+TEST_F(TestLinkFormat, LF_iterator)
+{
+  const char payload[] =
+    "<coap://[fe80::1]:60054/p/a>;rt=\"urn:knx:dpa.352.51\";if=if.a;ct=60,\n"
+    "<coap://[fe80::1]:60054/p/b>;rt=\"a,b;c\";rtx=1;obs\n";
+  int len = strlen(payload);
+  const char *param;
+  int param_len;
+
+  oc_lf_iterator_t it;
+  oc_lf_entry_t entry;
+  oc_lf_iterator_init(&it, payload, len);
+
+  ASSERT_TRUE(oc_lf_iterator_next(&it, &entry));
+  check_string("coap://[fe80::1]:60054/p/a", entry.uri, entry.uri_len);
+  EXPECT_TRUE(oc_lf_entry_get_param(&entry, "if", &param, &param_len));
+  check_string("if.a", param, param_len);
+  EXPECT_TRUE(oc_lf_entry_get_param(&entry, "ct", &param, &param_len));
+  check_string("60", param, param_len);
+
+  // the quoted value holds the delimiters
+  ASSERT_TRUE(oc_lf_iterator_next(&it, &entry));
+  check_string("coap://[fe80::1]:60054/p/b", entry.uri, entry.uri_len);
+  EXPECT_TRUE(oc_lf_entry_get_param(&entry, "rt", &param, &param_len));
+  check_string("\"a,b;c\"", param, param_len);
+  EXPECT_TRUE(oc_lf_entry_get_param(&entry, "obs", &param, &param_len));
+  EXPECT_EQ(0, param_len);
+  EXPECT_FALSE(oc_lf_entry_get_param(&entry, "ct", &param, &param_len));
+
+  EXPECT_FALSE(oc_lf_iterator_next(&it, &entry));
+  EXPECT_EQ(2, oc_lf_number_of_entries(payload, len));
+}
+
+TEST_F(TestLinkFormat, LF_get_line)
+{
+  const char payload[] = "<coap://[fe80::1]:60054/p/a>;ct=60 \t,\n"
+                         "<coap://[fe80::1]:60054/p/b>;obs\t\r\n";
+  int len = strlen(payload);
+  const char *line;
+  int line_len;
+
+  // the trailing whitespace is not part of the entry
+  EXPECT_EQ(1, oc_lf_get_line(payload, len, 0, &line, &line_len));
+  check_string("<coap://[fe80::1]:60054/p/a>;ct=60", line, line_len);
+  EXPECT_EQ(1, oc_lf_get_line(payload, len, 1, &line, &line_len));
+  check_string("<coap://[fe80::1]:60054/p/b>;obs", line, line_len);
+  EXPECT_EQ(0, oc_lf_get_line(payload, len, 2, &line, &line_len));
+  EXPECT_EQ(0, line_len);
+}
+
 TEST_F(TestLinkFormat, EP_SN1)
 {
   const char payload[] = "\"knx://sn.123456ab knx://ia.20a\"";
@@ -0,0 +1,106 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "util/oc_mpsc_ring.h"
+
+#define RING_SIZE (8)
+#define NUM_PRODUCERS (4)
+#define ITEMS_PER_PRODUCER (200000)
+
+// items are encoded as (producer << 24 | sequence number) + 1, never NULL
+static void *
+ring_item(uintptr_t producer, uintptr_t seq)
+{
+  return (void *)(((producer << 24) | seq) + 1);
+}
+
+TEST(MpscRing, EmptyAndFull)
+{
+  oc_mpsc_ring_slot_t slots[RING_SIZE] = {};
+  oc_mpsc_ring_t ring = { slots, RING_SIZE - 1, 0, 0 };
+
+  EXPECT_EQ(nullptr, oc_mpsc_ring_pop(&ring));
+  for (uintptr_t i = 0; i < RING_SIZE; i++) {
+    EXPECT_TRUE(oc_mpsc_ring_push(&ring, ring_item(0, i)));
+  }
+  EXPECT_FALSE(oc_mpsc_ring_push(&ring, ring_item(0, RING_SIZE)));
+  EXPECT_EQ((uint32_t)RING_SIZE, oc_mpsc_ring_size(&ring));
+
+  // a popped slot can be used again, in the next lap
+  EXPECT_EQ(ring_item(0, 0), oc_mpsc_ring_pop(&ring));
+  EXPECT_TRUE(oc_mpsc_ring_push(&ring, ring_item(0, RING_SIZE)));
+  for (uintptr_t i = 1; i <= RING_SIZE; i++) {
+    EXPECT_EQ(ring_item(0, i), oc_mpsc_ring_pop(&ring));
+  }
+  EXPECT_EQ(nullptr, oc_mpsc_ring_pop(&ring));
+  EXPECT_EQ(0u, oc_mpsc_ring_size(&ring));
+}
+
+TEST(MpscRing, MultipleProducers)
+{
+  oc_mpsc_ring_slot_t slots[RING_SIZE] = {};
+  oc_mpsc_ring_t ring = { slots, RING_SIZE - 1, 0, 0 };
+
+  std::vector<std::thread> producers;
+  for (uintptr_t p = 0; p < NUM_PRODUCERS; p++) {
+    producers.emplace_back([&ring, p]() {
+      for (uintptr_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+        // the ring is small, so it is full most of the time
+        while (!oc_mpsc_ring_push(&ring, ring_item(p, i))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // each item arrives once, in order per producer
+  uintptr_t next[NUM_PRODUCERS] = {};
+  int received = 0;
+  bool in_order = true;
+  while (received < NUM_PRODUCERS * ITEMS_PER_PRODUCER) {
+    void *item = oc_mpsc_ring_pop(&ring);
+    if (item == nullptr) {
+      std::this_thread::yield();
+      continue;
+    }
+    uintptr_t value = (uintptr_t)item - 1;
+    uintptr_t p = value >> 24;
+    received++;
+    if (p >= NUM_PRODUCERS) {
+      in_order = false;
+      continue;
+    }
+    if ((value & 0xffffff) != next[p]) {
+      in_order = false;
+    }
+    next[p] = (value & 0xffffff) + 1;
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_TRUE(in_order);
+  for (int p = 0; p < NUM_PRODUCERS; p++) {
+    EXPECT_EQ((uintptr_t)ITEMS_PER_PRODUCER, next[p]);
+  }
+  EXPECT_EQ(nullptr, oc_mpsc_ring_pop(&ring));
+}
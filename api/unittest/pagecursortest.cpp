@@ -0,0 +1,245 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "api/oc_knx_helpers.h"
+#include "oc_api.h"
+#include "oc_core_res.h"
+#include "oc_rep.h"
+
+#ifndef OC_PAGE_CURSORS
+#define OC_PAGE_CURSORS (4)
+#endif
+
+#define RT_PAGED "urn:knx:dpa.352.51"
+// more than a page
+#define NUM_PAGED (PAGE_SIZE + 5)
+
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+static void
+dummy_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
+              void *user_data)
+{
+  (void)request;
+  (void)iface_mask;
+  (void)user_data;
+}
+
+class TestPageCursor : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    ASSERT_EQ(0, oc_main_init(&handler));
+    // the resources keep pointers to the uris
+    uris.reserve(NUM_PAGED);
+  }
+
+  void TearDown() override
+  {
+    for (oc_resource_t *res : resources) {
+      oc_delete_resource(res);
+    }
+    resources.clear();
+    uris.clear();
+    oc_main_shutdown();
+  }
+
+  void add_resources(int count)
+  {
+    for (int i = 0; i < count; i++) {
+      char uri[20];
+      snprintf(uri, sizeof(uri), "/p/r%02d", (int)uris.size());
+      uris.push_back(uri);
+      oc_resource_t *res = oc_new_resource("r", uris.back().c_str(), 1, 0);
+      ASSERT_NE(nullptr, res);
+      oc_resource_bind_resource_type(res, RT_PAGED);
+      oc_resource_bind_resource_interface(res, OC_IF_O);
+      oc_resource_set_discoverable(res, true);
+      oc_resource_set_request_handler(res, OC_GET, dummy_handler, NULL);
+      ASSERT_TRUE(oc_add_resource(res));
+      resources.push_back(res);
+    }
+  }
+
+  // sets up request as a unicast GET of /.well-known/core
+  void make_request(const char *query)
+  {
+    memset(&response_buffer, 0, sizeof(response_buffer));
+    response_buffer.buffer = buffer;
+    response_buffer.buffer_size = sizeof(buffer);
+    memset(&response, 0, sizeof(response));
+    response.response_buffer = &response_buffer;
+    memset(&origin, 0, sizeof(origin));
+    origin.flags = IPV6;
+    memset(&request, 0, sizeof(request));
+    request.origin = &origin;
+    request.resource = oc_core_get_resource_by_index(WELLKNOWNCORE, 0);
+    request.uri_path = ".well-known/core";
+    request.uri_path_len = strlen(request.uri_path);
+    request.query = query;
+    request.query_len = strlen(query);
+    request.accept = APPLICATION_LINK_FORMAT;
+    request.response = &response;
+  }
+
+  std::string get(const std::string &query)
+  {
+    make_request(query.c_str());
+    oc_rep_new(buffer, sizeof(buffer));
+    request.resource->get_handler.cb(&request, OC_IF_NONE, NULL);
+    return std::string((const char *)buffer, response_buffer.response_length);
+  }
+
+  // the uris of the test resources in a response
+  static std::vector<std::string> listed(const std::string &body)
+  {
+    std::vector<std::string> found;
+    for (size_t pos = body.find("</p/r"); pos != std::string::npos;
+         pos = body.find("</p/r", pos + 1)) {
+      found.push_back(body.substr(pos + 1, body.find('>', pos) - pos - 1));
+    }
+    return found;
+  }
+
+  // the pc value of the next page link, empty without one
+  static std::string next_cursor(const std::string &body)
+  {
+    size_t pos = body.find("&pc=");
+    if (pos == std::string::npos) {
+      return "";
+    }
+    pos += 4;
+    return body.substr(pos, body.find('>', pos) - pos);
+  }
+
+  static std::string cursor_query(const char *query, int page_num,
+                                  uint32_t id)
+  {
+    char text[40];
+    snprintf(text, sizeof(text), "&pn=%d&pc=%" PRIx32, page_num, id);
+    return std::string(query) + text;
+  }
+
+  uint32_t store(const char *query, int next_page_num, int position)
+  {
+    make_request(query);
+    oc_page_cursor_t cursor = { resources.empty() ? NULL : resources[0],
+                                position, NUM_PAGED };
+    return oc_page_cursor_store(&request, next_page_num, &cursor);
+  }
+
+  bool resume(const std::string &query, int page_num, oc_page_cursor_t *cursor)
+  {
+    make_request(query.c_str());
+    return oc_page_cursor_resume(&request, page_num, cursor);
+  }
+
+  std::vector<std::string> uris;
+  std::vector<oc_resource_t *> resources;
+  uint8_t buffer[4096];
+  oc_response_buffer_t response_buffer;
+  oc_response_t response;
+  oc_endpoint_t origin;
+  oc_request_t request;
+};
+
+TEST_F(TestPageCursor, MultiPageListing)
+{
+  add_resources(NUM_PAGED);
+
+  std::string page0 = get("rt=" RT_PAGED);
+  std::vector<std::string> uris0 = listed(page0);
+  ASSERT_EQ((size_t)PAGE_SIZE, uris0.size());
+  EXPECT_EQ("/p/r00", uris0.front());
+  std::string pc = next_cursor(page0);
+  ASSERT_NE("", pc);
+
+  // the next page continues at the cursor
+  std::vector<std::string> uris1 =
+    listed(get("rt=" RT_PAGED "&pn=1&pc=" + pc));
+  ASSERT_EQ((size_t)(NUM_PAGED - PAGE_SIZE), uris1.size());
+  EXPECT_EQ("/p/r20", uris1.front());
+  EXPECT_EQ("/p/r24", uris1.back());
+
+  // without the cursor the page is the same, skipping from the start
+  EXPECT_EQ(uris1, listed(get("rt=" RT_PAGED "&pn=1")));
+}
+
+TEST_F(TestPageCursor, StaleOrUnknownCursor)
+{
+  add_resources(2);
+  uint32_t id = store("rt=" RT_PAGED, 1, 20);
+  ASSERT_NE(0u, id);
+
+  oc_page_cursor_t cursor;
+  ASSERT_TRUE(resume(cursor_query("rt=" RT_PAGED, 1, id), 1, &cursor));
+  EXPECT_EQ(resources[0], cursor.resource);
+  EXPECT_EQ(20, cursor.position);
+  EXPECT_EQ(NUM_PAGED, cursor.total);
+
+  // only for the page it was made for
+  EXPECT_FALSE(resume(cursor_query("rt=" RT_PAGED, 2, id), 2, &cursor));
+  // and for the same query
+  EXPECT_FALSE(resume(cursor_query("rt=other", 1, id), 1, &cursor));
+  // unknown ids, or no id at all
+  EXPECT_FALSE(resume(cursor_query("rt=" RT_PAGED, 1, id + 1), 1, &cursor));
+  EXPECT_FALSE(resume("rt=" RT_PAGED "&pn=1&pc=0", 1, &cursor));
+  EXPECT_FALSE(resume("rt=" RT_PAGED "&pn=1&pc=xyz", 1, &cursor));
+  EXPECT_FALSE(resume("rt=" RT_PAGED "&pn=1", 1, &cursor));
+
+  // adding a resource makes the cursor stale
+  add_resources(1);
+  EXPECT_FALSE(resume(cursor_query("rt=" RT_PAGED, 1, id), 1, &cursor));
+}
+
+TEST_F(TestPageCursor, ExhaustedSlots)
+{
+  uint32_t ids[OC_PAGE_CURSORS + 1];
+  for (int i = 0; i <= OC_PAGE_CURSORS; i++) {
+    ids[i] = store("rt=" RT_PAGED, 1, i);
+  }
+
+  // the oldest cursor made room for the last one
+  oc_page_cursor_t cursor;
+  EXPECT_FALSE(resume(cursor_query("rt=" RT_PAGED, 1, ids[0]), 1, &cursor));
+  for (int i = 1; i <= OC_PAGE_CURSORS; i++) {
+    ASSERT_TRUE(resume(cursor_query("rt=" RT_PAGED, 1, ids[i]), 1, &cursor));
+    EXPECT_EQ(i, cursor.position);
+  }
+}
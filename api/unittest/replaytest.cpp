@@ -129,4 +129,72 @@ TEST(ReplayProtection, RplWdo)
   // fake an update to the replay window upper bound
   g_oscore_replaywindow = 64;
   EXPECT_TRUE(oc_replay_check_client(55, kid, empty, false));
-}
\ No newline at end of file
+}
+
+static oc_endpoint_t
+group_sender(uint8_t host)
+{
+  oc_endpoint_t ep = {};
+  ep.flags = (enum transport_flags)(IPV6 | MULTICAST);
+  ep.addr.ipv6.address[0] = 0xfe;
+  ep.addr.ipv6.address[1] = 0x80;
+  ep.addr.ipv6.address[15] = host;
+  ep.kid_len = 2;
+  ep.kid[0] = 'g';
+  ep.kid[1] = 'k';
+  return ep;
+}
+
+TEST(ReplayProtection, SendersSharingGroupKey)
+{
+  oc_endpoint_t a = group_sender(1);
+  oc_endpoint_t b = group_sender(2);
+
+  oc_replay_add_endpoint(100, &a);
+  oc_replay_add_endpoint(10, &b);
+
+  // each sender has its own window, despite the shared KID
+  EXPECT_TRUE(oc_replay_check_endpoint(11, &b));
+  EXPECT_TRUE(oc_replay_check_endpoint(101, &a));
+  EXPECT_FALSE(oc_replay_check_endpoint(11, &b));
+  EXPECT_FALSE(oc_replay_check_endpoint(100, &a));
+}
+
+TEST(ReplayProtection, WideWindow)
+{
+  oc_endpoint_t a = group_sender(3);
+
+  oc_replay_add_endpoint(100, &a);
+  // frames further back than 32 are still tracked
+  EXPECT_TRUE(oc_replay_check_endpoint(40, &a));
+  EXPECT_FALSE(oc_replay_check_endpoint(40, &a));
+  // slide the window across a word boundary
+  EXPECT_TRUE(oc_replay_check_endpoint(130, &a));
+  EXPECT_FALSE(oc_replay_check_endpoint(40, &a));
+  EXPECT_FALSE(oc_replay_check_endpoint(100, &a));
+  EXPECT_TRUE(oc_replay_check_endpoint(99, &a));
+}
+
+#ifdef OC_TRUST_FIRST_MCAST
+TEST(ReplayProtection, GroupFrameFromNewAddress)
+{
+  oc_endpoint_t a = group_sender(4);
+  a.kid[0] = 'o';
+  oc_endpoint_t b = group_sender(5);
+  b.kid[0] = 'n';
+  oc_endpoint_t c = group_sender(6);
+  c.kid[0] = 'n';
+
+  // the first frame of an unknown sender is trusted
+  EXPECT_TRUE(oc_replay_check_endpoint(200, &b));
+  // the same frame, replayed from another address
+  EXPECT_FALSE(oc_replay_check_endpoint(200, &c));
+  EXPECT_FALSE(oc_replay_check_endpoint(150, &c));
+  // a newer frame of that address is trusted
+  EXPECT_TRUE(oc_replay_check_endpoint(201, &c));
+  EXPECT_FALSE(oc_replay_check_endpoint(201, &c));
+
+  // senders of another group key are not affected
+  EXPECT_TRUE(oc_replay_check_endpoint(5, &a));
+}
+#endif /* OC_TRUST_FIRST_MCAST */
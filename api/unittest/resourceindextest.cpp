@@ -0,0 +1,160 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+#include "api/oc_resource_index.h"
+#include "oc_api.h"
+#include "oc_ri.h"
+
+#define RT_A "urn:knx:dpa.352.51"
+#define RT_B "urn:knx:dpa.353.52"
+
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+class TestResourceIndex : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    ASSERT_EQ(0, oc_main_init(&handler));
+  }
+
+  void TearDown() override
+  {
+    for (oc_resource_t *res : resources) {
+      oc_delete_resource(res);
+    }
+    resources.clear();
+    oc_main_shutdown();
+  }
+
+  oc_resource_t *add_resource(const char *uri, const char *rt)
+  {
+    oc_resource_t *res = oc_new_resource("idx", uri, 2, 0);
+    if (res == NULL) {
+      return NULL;
+    }
+    if (rt) {
+      oc_resource_bind_resource_type(res, rt);
+    }
+    oc_add_resource(res);
+    resources.push_back(res);
+    return res;
+  }
+
+  // the resources the index selects for the query
+  static std::vector<const oc_resource_t *> select(const char *query)
+  {
+    oc_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.query = query;
+    request.query_len = strlen(query);
+    std::vector<const oc_resource_t *> selected;
+    if (!oc_resource_index_select(&request)) {
+      return selected;
+    }
+    const oc_resource_t *res =
+      oc_resource_index_next_selected(oc_ri_get_app_resources());
+    for (; res; res = oc_resource_index_next_selected(res->next)) {
+      selected.push_back(res);
+    }
+    return selected;
+  }
+
+  static const oc_resource_t *by_uri(const char *uri)
+  {
+    return oc_ri_get_app_resource_by_uri(uri, strlen(uri), 0);
+  }
+
+  std::vector<oc_resource_t *> resources;
+};
+
+TEST_F(TestResourceIndex, TypeBoundAfterAdd)
+{
+  oc_resource_t *a = add_resource("/p/a", RT_A);
+  oc_resource_t *b = add_resource("/p/b", NULL);
+  ASSERT_NE(nullptr, a);
+  ASSERT_NE(nullptr, b);
+  std::vector<const oc_resource_t *> expected = { a };
+  EXPECT_EQ(expected, select("rt=" RT_A));
+  EXPECT_TRUE(select("rt=" RT_B).empty());
+
+  // the index is built again for a type bound to a listed resource
+  oc_resource_bind_resource_type(b, RT_B);
+  expected = { b };
+  EXPECT_EQ(expected, select("rt=" RT_B));
+  oc_resource_bind_resource_type(a, RT_B);
+  expected = { a, b };
+  EXPECT_EQ(expected, select("rt=" RT_B));
+  expected = { a };
+  EXPECT_EQ(expected, select("rt=" RT_A));
+
+  EXPECT_EQ(a, by_uri("/p/a"));
+  EXPECT_EQ(b, by_uri("p/b"));
+}
+
+TEST_F(TestResourceIndex, InterfaceBoundAfterAdd)
+{
+  oc_resource_t *a = add_resource("/p/a", RT_A);
+  ASSERT_NE(nullptr, a);
+  EXPECT_TRUE(select("if=urn:knx:if.o").empty());
+
+  oc_resource_bind_resource_interface(a, OC_IF_O);
+  std::vector<const oc_resource_t *> expected = { a };
+  EXPECT_EQ(expected, select("if=urn:knx:if.o"));
+  EXPECT_EQ(expected, select("rt=" RT_A "&if=urn:knx:if.o"));
+}
+
+TEST_F(TestResourceIndex, InstanceSetAfterAdd)
+{
+  oc_resource_t *a = add_resource("/p/a", RT_A);
+  ASSERT_NE(nullptr, a);
+  const oc_fb_group_t *group = oc_resource_index_find_fb(0, 352, 0);
+  ASSERT_NE(nullptr, group);
+  ASSERT_EQ(1u, group->num_members);
+  EXPECT_EQ(a, group->members[0].resource);
+
+  oc_resource_set_function_block_instance(a, 2);
+  EXPECT_EQ(nullptr, oc_resource_index_find_fb(0, 352, 0));
+  group = oc_resource_index_find_fb(0, 352, 2);
+  ASSERT_NE(nullptr, group);
+  EXPECT_EQ(a, group->members[0].resource);
+
+  // a resource added late is found by uri and in the index
+  oc_resource_t *b = add_resource("/p/b", RT_A);
+  ASSERT_NE(nullptr, b);
+  EXPECT_EQ(b, by_uri("/p/b"));
+  std::vector<const oc_resource_t *> expected = { a, b };
+  EXPECT_EQ(expected, select("rt=" RT_A));
+  EXPECT_NE(nullptr, oc_resource_index_find_fb(0, 352, 0));
+}
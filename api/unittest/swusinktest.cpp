@@ -0,0 +1,219 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "api/oc_knx_swu_sink.h"
+
+#ifdef OC_SWU_SINK
+#include "mbedtls/md.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include <vector>
+
+#define PACKAGE_FILE "swusinktest_package.bin"
+#define PACKAGE_SIZE (1000)
+#define BLOCK_SIZE (256)
+
+class TestSwuSink : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    for (size_t i = 0; i < PACKAGE_SIZE; i++) {
+      package.push_back((uint8_t)(i * 7 + 3));
+    }
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), package.data(),
+               package.size(), digest);
+    done_calls = 0;
+    done_result = OC_SWU_RESULT_INIT;
+    oc_swu_sink_set_path(PACKAGE_FILE);
+    oc_swu_sink_set_digest(digest);
+    oc_swu_sink_set_done_cb(done_cb, this);
+  }
+
+  void TearDown() override
+  {
+    oc_swu_sink_abort();
+    oc_swu_sink_set_idle_timeout(OC_SWU_SINK_IDLE_TIMEOUT);
+    oc_swu_sink_set_done_cb(NULL, NULL);
+    oc_swu_sink_set_digest(NULL);
+    oc_swu_sink_set_path(NULL);
+    unlink(PACKAGE_FILE);
+  }
+
+  static void done_cb(size_t device, oc_swu_result_t result, const char *path,
+                      void *data)
+  {
+    (void)device;
+    (void)path;
+    TestSwuSink *test = (TestSwuSink *)data;
+    test->done_calls++;
+    test->done_result = result;
+  }
+
+  int write_block(size_t offset, size_t package_size = PACKAGE_SIZE)
+  {
+    size_t len = package_size - offset;
+    if (len > BLOCK_SIZE) {
+      len = BLOCK_SIZE;
+    }
+    return oc_swu_sink_write(0, package_size, offset, &package[offset], len);
+  }
+
+  void write_package(size_t package_size = PACKAGE_SIZE)
+  {
+    for (size_t offset = 0; offset < package_size; offset += BLOCK_SIZE) {
+      EXPECT_EQ(0, write_block(offset, package_size));
+    }
+  }
+
+  std::vector<uint8_t> read_file()
+  {
+    std::ifstream file(PACKAGE_FILE, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+  }
+
+  std::vector<uint8_t> package;
+  uint8_t digest[OC_SWU_SINK_DIGEST_SIZE];
+  int done_calls;
+  oc_swu_result_t done_result;
+};
+
+TEST_F(TestSwuSink, InOrder)
+{
+  for (size_t offset = 0; offset < PACKAGE_SIZE; offset += BLOCK_SIZE) {
+    EXPECT_EQ(0, write_block(offset));
+  }
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_SUCCESS, done_result);
+  EXPECT_EQ(package, read_file());
+
+  uint8_t computed[OC_SWU_SINK_DIGEST_SIZE];
+  EXPECT_TRUE(oc_swu_sink_get_digest(computed));
+  EXPECT_EQ(0, memcmp(digest, computed, OC_SWU_SINK_DIGEST_SIZE));
+
+  oc_swu_sink_stats_t stats;
+  oc_swu_sink_get_stats(&stats);
+  EXPECT_EQ((size_t)PACKAGE_SIZE, stats.package_size);
+  EXPECT_EQ((size_t)PACKAGE_SIZE, stats.bytes_written);
+}
+
+TEST_F(TestSwuSink, Retransmit)
+{
+  EXPECT_EQ(0, write_block(0));
+  EXPECT_EQ(0, write_block(BLOCK_SIZE));
+  // a block written before is ignored, the first one does not restart
+  EXPECT_EQ(0, write_block(0));
+  EXPECT_EQ(0, write_block(BLOCK_SIZE));
+  // a block overlapping the written part is written from the first new byte
+  EXPECT_EQ(0, oc_swu_sink_write(0, PACKAGE_SIZE, BLOCK_SIZE + 10,
+                                 &package[BLOCK_SIZE + 10], BLOCK_SIZE));
+  for (size_t offset = 2 * BLOCK_SIZE + 10; offset < PACKAGE_SIZE;
+       offset += BLOCK_SIZE) {
+    EXPECT_EQ(0, write_block(offset));
+  }
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_SUCCESS, done_result);
+  EXPECT_EQ(package, read_file());
+
+  // the last and the first block again, after the package is complete
+  EXPECT_EQ(0, write_block(PACKAGE_SIZE - BLOCK_SIZE));
+  EXPECT_EQ(0, write_block(0));
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(package, read_file());
+}
+
+TEST_F(TestSwuSink, Gap)
+{
+  EXPECT_EQ(0, write_block(0));
+  EXPECT_EQ(-1, write_block(2 * BLOCK_SIZE));
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_ERR_CONN, done_result);
+
+  // the download is gone, the next block is not taken
+  EXPECT_EQ(-1, write_block(BLOCK_SIZE));
+  EXPECT_EQ(1, done_calls);
+}
+
+TEST_F(TestSwuSink, DigestMismatch)
+{
+  package[PACKAGE_SIZE / 2] ^= 0xff;
+  for (size_t offset = 0; offset < PACKAGE_SIZE; offset += BLOCK_SIZE) {
+    EXPECT_EQ(0, write_block(offset));
+  }
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_ERR_ICF, done_result);
+}
+
+TEST_F(TestSwuSink, RestartAfterIdle)
+{
+  oc_swu_sink_set_idle_timeout(0);
+  EXPECT_EQ(0, write_block(0));
+  EXPECT_EQ(0, write_block(BLOCK_SIZE));
+  usleep(10000);
+  // the client comes back and starts over at offset 0
+  write_package();
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_SUCCESS, done_result);
+  EXPECT_EQ(package, read_file());
+}
+
+TEST_F(TestSwuSink, RestartWithOtherPackage)
+{
+  EXPECT_EQ(0, write_block(0));
+  EXPECT_EQ(0, write_block(BLOCK_SIZE));
+  // offset 0 of a package of another size is a new download
+  oc_swu_sink_set_digest(NULL);
+  write_package(PACKAGE_SIZE / 2);
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_SUCCESS, done_result);
+  EXPECT_EQ(std::vector<uint8_t>(package.begin(),
+                                 package.begin() + PACKAGE_SIZE / 2),
+            read_file());
+}
+
+TEST_F(TestSwuSink, RestartAfterAbort)
+{
+  EXPECT_EQ(0, write_block(0));
+  EXPECT_EQ(0, write_block(BLOCK_SIZE));
+  oc_swu_sink_abort();
+  EXPECT_EQ(1, done_calls);
+  write_package();
+  EXPECT_EQ(2, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_SUCCESS, done_result);
+  EXPECT_EQ(package, read_file());
+}
+
+TEST_F(TestSwuSink, OtherDevice)
+{
+  EXPECT_EQ(-1, oc_swu_sink_write(1, PACKAGE_SIZE, 0, package.data(),
+                                  BLOCK_SIZE));
+  EXPECT_EQ(0, done_calls);
+}
+
+TEST_F(TestSwuSink, Abort)
+{
+  EXPECT_EQ(0, write_block(0));
+  oc_swu_sink_abort();
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(OC_SWU_RESULT_ERR_CONN, done_result);
+  EXPECT_EQ(-1, write_block(BLOCK_SIZE));
+}
+#endif /* OC_SWU_SINK */
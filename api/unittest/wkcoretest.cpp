@@ -0,0 +1,213 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "api/oc_knx_dev.h"
+#include "oc_api.h"
+#include "oc_core_res.h"
+#include "oc_discovery.h"
+#include "oc_rep.h"
+
+#ifndef OC_WK_CACHE_ENTRIES
+#define OC_WK_CACHE_ENTRIES (4)
+#endif
+
+#define RT_A "urn:knx:dpa.352.51"
+#define RT_B "urn:knx:dpa.353.52"
+
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+static void
+dummy_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
+              void *user_data)
+{
+  (void)request;
+  (void)iface_mask;
+  (void)user_data;
+}
+
+class TestWkCore : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    ASSERT_EQ(0, oc_main_init(&handler));
+    oc_discovery_invalidate_cache();
+    res_a = add_resource("/p/a", RT_A);
+    ASSERT_NE(nullptr, res_a);
+  }
+
+  void TearDown() override
+  {
+    oc_delete_resource(res_a);
+    oc_main_shutdown();
+  }
+
+  static oc_resource_t *add_resource(const char *uri, const char *rt)
+  {
+    oc_resource_t *res = oc_new_resource("wk", uri, 1, 0);
+    if (res == NULL) {
+      return NULL;
+    }
+    oc_resource_bind_resource_type(res, rt);
+    oc_resource_bind_resource_interface(res, OC_IF_O);
+    oc_resource_set_discoverable(res, true);
+    oc_resource_set_request_handler(res, OC_GET, dummy_handler, NULL);
+    oc_add_resource(res);
+    return res;
+  }
+
+  // changes the uri without telling the cache, as the uri is not copied
+  static void set_uri(oc_resource_t *res, const char *uri)
+  {
+    res->uri.next = NULL;
+    res->uri.ptr = (char *)uri;
+    res->uri.size = strlen(uri) + 1;
+  }
+
+  // a unicast GET of /.well-known/core, returns the body
+  std::string get(const char *query)
+  {
+    oc_response_buffer_t response_buffer;
+    memset(&response_buffer, 0, sizeof(response_buffer));
+    response_buffer.buffer = buffer;
+    response_buffer.buffer_size = sizeof(buffer);
+    oc_response_t response;
+    memset(&response, 0, sizeof(response));
+    response.response_buffer = &response_buffer;
+    oc_endpoint_t origin;
+    memset(&origin, 0, sizeof(origin));
+    origin.flags = IPV6;
+    oc_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.origin = &origin;
+    request.resource = oc_core_get_resource_by_index(WELLKNOWNCORE, 0);
+    request.uri_path = ".well-known/core";
+    request.uri_path_len = strlen(request.uri_path);
+    request.query = query;
+    request.query_len = strlen(query);
+    request.accept = APPLICATION_LINK_FORMAT;
+    request.response = &response;
+
+    oc_rep_new(buffer, sizeof(buffer));
+    request.resource->get_handler.cb(&request, OC_IF_NONE, NULL);
+    code = response_buffer.code;
+    return std::string((const char *)buffer, response_buffer.response_length);
+  }
+
+  static bool lists(const std::string &body, const char *uri)
+  {
+    return body.find(std::string("<") + uri + ">") != std::string::npos;
+  }
+
+  oc_resource_t *res_a;
+  uint8_t buffer[2048];
+  int code;
+};
+
+#if OC_WK_CACHE_ENTRIES > 0
+TEST_F(TestWkCore, CacheHit)
+{
+  std::string body = get("rt=" RT_A);
+  EXPECT_EQ(oc_status_code(OC_STATUS_OK), code);
+  EXPECT_TRUE(lists(body, "/p/a"));
+
+  // a change the cache is not told about is not seen: the response is cached
+  set_uri(res_a, "/p/x");
+  EXPECT_EQ(body, get("rt=" RT_A));
+  EXPECT_EQ(oc_status_code(OC_STATUS_OK), code);
+
+  oc_discovery_invalidate_cache();
+  body = get("rt=" RT_A);
+  EXPECT_FALSE(lists(body, "/p/a"));
+  EXPECT_TRUE(lists(body, "/p/x"));
+}
+
+TEST_F(TestWkCore, InvalidatedByResourceChanges)
+{
+  EXPECT_FALSE(lists(get("rt=" RT_A), "/p/b"));
+
+  oc_resource_t *res_b = add_resource("/p/b", RT_A);
+  ASSERT_NE(nullptr, res_b);
+  std::string body = get("rt=" RT_A);
+  EXPECT_TRUE(lists(body, "/p/a"));
+  EXPECT_TRUE(lists(body, "/p/b"));
+
+  oc_resource_set_discoverable(res_b, false);
+  body = get("rt=" RT_A);
+  EXPECT_TRUE(lists(body, "/p/a"));
+  EXPECT_FALSE(lists(body, "/p/b"));
+
+  oc_resource_set_discoverable(res_b, true);
+  EXPECT_TRUE(lists(get("rt=" RT_A), "/p/b"));
+
+  oc_delete_resource(res_b);
+  body = get("rt=" RT_A);
+  EXPECT_TRUE(lists(body, "/p/a"));
+  EXPECT_FALSE(lists(body, "/p/b"));
+}
+
+TEST_F(TestWkCore, KeyedOnQuery)
+{
+  oc_resource_t *res_b = add_resource("/p/b", RT_B);
+  ASSERT_NE(nullptr, res_b);
+
+  std::string body_a = get("rt=" RT_A);
+  std::string body_b = get("rt=" RT_B);
+  EXPECT_TRUE(lists(body_a, "/p/a"));
+  EXPECT_FALSE(lists(body_a, "/p/b"));
+  EXPECT_FALSE(lists(body_b, "/p/a"));
+  EXPECT_TRUE(lists(body_b, "/p/b"));
+
+  // the order of the parameters does not matter
+  std::string body = get("rt=" RT_A "&if=urn:knx:if.o");
+  EXPECT_TRUE(lists(body, "/p/a"));
+  set_uri(res_a, "/p/x");
+  EXPECT_EQ(body, get("if=urn:knx:if.o&rt=" RT_A));
+
+  oc_delete_resource(res_b);
+}
+
+TEST_F(TestWkCore, ProgrammingModeNotCached)
+{
+  oc_knx_device_set_programming_mode(0, true);
+  get("if=urn:knx:if.pm");
+  EXPECT_EQ(oc_status_code(OC_STATUS_OK), code);
+
+  // answered again from the current programming mode
+  oc_knx_device_set_programming_mode(0, false);
+  EXPECT_EQ("", get("if=urn:knx:if.pm"));
+  EXPECT_EQ(oc_status_code(OC_STATUS_NOT_FOUND), code);
+}
+#endif /* OC_WK_CACHE_ENTRIES > 0 */
@@ -464,9 +464,9 @@ static void
 issue_requests_s_mode(void)
 {
   PRINT("issue_requests_s_mode: Demo \n\n");
+  static const int scopes[] = { 2, 5 };
 
-  oc_do_s_mode_with_scope(2, "p/o_1_1", "w");
-  oc_do_s_mode_with_scope(5, "p/o_1_1", "w");
+  oc_do_s_mode_with_scopes(scopes, 2, "p/o_1_1", "w");
 }
 
 #ifndef NO_MAIN
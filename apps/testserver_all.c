@@ -1054,15 +1054,11 @@ issue_requests(void *data)
   g_counter++;
 
   PRINT("  issue_requests_s_mode: issue\n");
+  static const int scopes[] = { 2, 5 };
 
-  oc_do_s_mode_with_scope(2, "/p/a", "w");
-  oc_do_s_mode_with_scope(5, "/p/a", "w");
-
-  oc_do_s_mode_with_scope(2, "/p/b", "w");
-  oc_do_s_mode_with_scope(5, "/p/b", "w");
-
-  oc_do_s_mode_with_scope(2, "/p/c", "w");
-  oc_do_s_mode_with_scope(5, "/p/c", "w");
+  oc_do_s_mode_with_scopes(scopes, 2, "/p/a", "w");
+  oc_do_s_mode_with_scopes(scopes, 2, "/p/b", "w");
+  oc_do_s_mode_with_scopes(scopes, 2, "/p/c", "w");
 
   PRINT("---------------> s_mode loop %d\n", g_counter);
   if (g_counter == 10) {
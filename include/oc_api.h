@@ -734,6 +734,32 @@ void oc_resource_set_observable(oc_resource_t *resource, bool state);
 void oc_resource_set_periodic_observable(oc_resource_t *resource,
                                          uint16_t seconds);
 
+/**
+ * Let the request handlers of the resource process block-wise transfers one
+ * block at a time, instead of receiving and producing the whole payload in a
+ * buffer of OC_MAX_APP_DATA_SIZE.
+ *
+ * For a request with a payload, the handler is called for every block, with
+ * the raw block as payload (see oc_get_request_payload_raw),
+ * request->block_offset set to the offset of the block and request->block_more
+ * set when more blocks follow. Without a response of the handler, the next
+ * block is requested. A response with an error code aborts the transfer. The
+ * handler responds to the last block as usual.
+ *
+ * For a request without a payload, request->block_offset is the offset of the
+ * requested response block. The handler writes at most one block (the size of
+ * the response buffer) and sets request->block_more when the response
+ * continues after it.
+ *
+ * @note the payload of a streamed request is not parsed, request_payload is
+ *       always NULL
+ *
+ * @param[in] resource the resource
+ * @param[in] state true to stream block-wise transfers, false to reassemble
+ *                  them
+ */
+void oc_resource_set_block_stream(oc_resource_t *resource, bool state);
+
 /**
  * Specify a request_callback for GET, PUT, POST, and DELETE methods
  *
@@ -1238,6 +1264,10 @@ void oc_send_empty_separate_response(oc_separate_response_t *handle,
  * @note no need to call oc_notify_observers about resource changes that
  *       result from a PUT, or POST oc_request_callback_t.
  *
+ * The resource is not read when it has no observers. When built with
+ * OC_OBSERVE_COALESCE_WINDOW_MS > 0 the notification is sent at the end of
+ * the window, changes made within the window are reported by it.
+ *
  * @param[in] resource the oc_resource_t that has a modified property
  *
  * @return
@@ -1315,6 +1345,19 @@ bool oc_do_wk_discovery_all(const char *uri_query, int scope,
  */
 int oc_lf_number_of_entries(const char *payload, int payload_len);
 
+/**
+ * @brief link format parser, retrieve an entry
+ *
+ * @param payload The link-format response
+ * @param payload_len The length of the response
+ * @param entry The index of entries, starting with 0.
+ * @param line The pointer to store the entry, without the trailing comma
+ * @param line_len The length of the entry
+ * @return int 1 success full
+ */
+int oc_lf_get_line(const char *payload, int payload_len, int entry,
+                   const char **line, int *line_len);
+
 /**
  * @brief link format parser, retrieve the URL of an entry.
  *
@@ -1342,6 +1385,71 @@ int oc_lf_get_entry_uri(const char *payload, int payload_len, int entry,
 int oc_lf_get_entry_param(const char *payload, int payload_len, int entry,
                           const char *param, const char **p_out, int *p_len);
 
+/**
+ * @brief an entry of a link-format response
+ *
+ * The fields point into the payload, nothing is copied.
+ */
+typedef struct oc_lf_entry_t
+{
+  const char *uri;    /**< the URI, without the angle brackets */
+  int uri_len;        /**< the length of the URI */
+  const char *params; /**< the parameters, starting with ';' */
+  int params_len;     /**< the length of the parameters */
+} oc_lf_entry_t;
+
+/**
+ * @brief link format parser state, see oc_lf_iterator_init
+ */
+typedef struct oc_lf_iterator_t
+{
+  const char *payload; /**< the link-format response */
+  int payload_len;     /**< the length of the response */
+  int pos;             /**< the start of the next entry */
+} oc_lf_iterator_t;
+
+/**
+ * @brief link format parser, iterate over the entries of a response
+ *
+ * The entries are found in a single pass over the payload:
+ * @code
+ * oc_lf_iterator_t it;
+ * oc_lf_entry_t entry;
+ * oc_lf_iterator_init(&it, payload, payload_len);
+ * while (oc_lf_iterator_next(&it, &entry)) {
+ *   oc_lf_entry_get_param(&entry, "rt", &rt, &rt_len);
+ * }
+ * @endcode
+ *
+ * @param it the iterator
+ * @param payload The link-format response
+ * @param payload_len The length of the response
+ */
+void oc_lf_iterator_init(oc_lf_iterator_t *it, const char *payload,
+                         int payload_len);
+
+/**
+ * @brief link format parser, retrieve the next entry
+ *
+ * @param it the iterator
+ * @param entry the entry
+ * @return true when an entry was found, false at the end of the response
+ */
+bool oc_lf_iterator_next(oc_lf_iterator_t *it, oc_lf_entry_t *entry);
+
+/**
+ * @brief link format parser, retrieve a parameter value of an entry
+ *
+ * @param entry the entry
+ * @param param The parameter name, e.g. "rt"
+ * @param p_out The pointer to store the value, e.g. "\"blah\"" (including
+ * the quotes of a quoted value)
+ * @param p_len The length of the value
+ * @return true when the entry has the parameter
+ */
+bool oc_lf_entry_get_param(const oc_lf_entry_t *entry, const char *param,
+                           const char **p_out, int *p_len);
+
 /**
  * @brief issues a get request with accept-content CBOR
  *
@@ -1629,6 +1737,21 @@ bool oc_init_multicast_update(oc_endpoint_t *mcast, const char *uri,
  */
 bool oc_do_multicast_update(void);
 
+/**
+ * @brief initiate the multi-cast update to several destinations
+ *
+ * The message is serialized and OSCORE protected once, the same bytes are
+ * sent to the multicast address given in oc_init_multicast_update() and to
+ * each of the destinations, e.g. the same group in another multicast scope.
+ *
+ * @param destinations the additional multicast destinations
+ * @param nr_destinations the number of additional destinations
+ * @return true the update has been handed to the network layer
+ * @return false the update could not be serialized or protected
+ */
+bool oc_do_multicast_update_to(const oc_endpoint_t *destinations,
+                               size_t nr_destinations);
+
 /**
  * Free a list of endpoints from the oc_endpoint_t
  *
@@ -30,6 +30,18 @@
 extern "C" {
 #endif
 
+/**
+ * @brief a block of a streamed transfer (OC_BLOCK_STREAM)
+ *
+ */
+typedef struct oc_block_stream_t
+{
+  uint32_t offset;    /**< offset of the block in the payload */
+  bool more;          /**< more blocks follow */
+  uint8_t *buffer;    /**< buffer for the response block */
+  size_t buffer_size; /**< size of the buffer */
+} oc_block_stream_t;
+
 /**
  * @brief role of the transfer
  *
@@ -65,6 +77,7 @@ typedef struct oc_blockwise_state_s
   uint8_t token_len;             /**< token length */
   uint16_t mid;                  /**< the message id */
   void *client_cb;               /**< client callback */
+  bool is_response;              /**< buffer is a response buffer */
 #endif                           /* OC_CLIENT */
 } oc_blockwise_state_t;
 
@@ -91,6 +104,34 @@ typedef struct oc_blockwise_response_state_s
 #endif                 /* OC_CLIENT */
 } oc_blockwise_response_state_t;
 
+#ifdef OC_CLIENT
+/**
+ * @brief change the message id of the transfer
+ *
+ * @param buffer the block transfer
+ * @param mid the message id
+ */
+void oc_blockwise_set_mid(oc_blockwise_state_t *buffer, uint16_t mid);
+
+/**
+ * @brief change the token of the transfer
+ *
+ * @param buffer the block transfer
+ * @param token the token
+ * @param token_len the token length
+ */
+void oc_blockwise_set_token(oc_blockwise_state_t *buffer, const uint8_t *token,
+                            uint8_t token_len);
+
+/**
+ * @brief set the client callback of the transfer
+ *
+ * @param buffer the block transfer
+ * @param client_cb the client callback
+ */
+void oc_blockwise_set_client_cb(oc_blockwise_state_t *buffer, void *client_cb);
+#endif /* OC_CLIENT */
+
 /**
  * @brief find the block wise request based on mid
  *
@@ -195,6 +236,23 @@ oc_blockwise_state_t *oc_blockwise_alloc_request_buffer(
   const char *href, size_t href_len, oc_endpoint_t *endpoint,
   oc_method_t method, oc_blockwise_role_t role);
 
+/**
+ * @brief allocate the state of a streamed request
+ *
+ * For resources with OC_BLOCK_STREAM: the state tracks the offset of the next
+ * block, the blocks are handed to the resource one at a time and are not
+ * reassembled, so there is no payload buffer.
+ *
+ * @param href the href
+ * @param href_len the href length
+ * @param endpoint the endpoint
+ * @param method the CoAP method
+ * @return oc_blockwise_state_t*
+ */
+oc_blockwise_state_t *oc_blockwise_alloc_request_stream(
+  const char *href, size_t href_len, oc_endpoint_t *endpoint,
+  oc_method_t method);
+
 /**
  * @brief allocate the response buffer
  *
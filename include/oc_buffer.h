@@ -25,6 +25,7 @@
 #include "util/oc_memb.h"
 #include "util/oc_process.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +40,18 @@ OC_PROCESS_NAME(message_buffer_handler);
  */
 oc_message_t *oc_allocate_message(void);
 
+/**
+ * @brief allocate a message for receiving size bytes
+ *
+ * With OC_MESSAGE_SIZE_CLASSES the data of the message is taken from the
+ * smallest buffer size class that fits, the capacity is in message->size.
+ * Otherwise this is the same as oc_allocate_message.
+ *
+ * @param size the number of bytes that will be received
+ * @return oc_message_t* the allocated message
+ */
+oc_message_t *oc_allocate_message_with_size(size_t size);
+
 /**
  * @brief set callback for memory availability
  *
@@ -66,6 +66,15 @@ bool oc_add_resource_to_wk(const oc_resource_t *resource, oc_request_t *request,
                            size_t device_index, size_t *response_length,
                            int truncate);
 
+/**
+ * @brief drop the cached /.well-known/core responses
+ *
+ * Called when resources are added or removed and when a resource is made
+ * (un)discoverable. Changes of the identity of the device (serial number, ia,
+ * iid) are detected by the cache itself.
+ */
+void oc_discovery_invalidate_cache(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@
 
 #include "port/oc_network_events_mutex.h"
 #include "util/oc_process.h"
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,6 +68,26 @@ typedef struct oc_message_s oc_message_t;
  */
 void oc_network_event(oc_message_t *message);
 
+/**
+ * @brief statistics of the queue between the network thread(s) and the
+ * event loop
+ */
+typedef struct oc_network_event_stats_t
+{
+  uint32_t received;   /**< messages queued for the event loop */
+  uint32_t dropped;    /**< messages dropped because the queue was full */
+  uint32_t max_queued; /**< highest number of messages seen in the queue */
+} oc_network_event_stats_t;
+
+/**
+ * @brief retrieve the statistics of the network event queue
+ *
+ * The size of the queue is set with OC_NETWORK_EVENT_QUEUE_SIZE (power of 2)
+ *
+ * @param stats the statistics (output)
+ */
+void oc_network_event_get_stats(oc_network_event_stats_t *stats);
+
 /**
  * @brief initiate network event
  *
@@ -139,7 +139,8 @@ typedef enum {
   OC_OBSERVABLE = (1 << 1),   /**< observable */
   OC_SECURE = (1 << 4),       /**< secure */
   OC_PERIODIC = (1 << 6),     /**< periodical update */
-  OC_SECURE_MCAST = (1 << 8)  /**< secure multi cast (OSCORE) */
+  OC_SECURE_MCAST = (1 << 8), /**< secure multi cast (OSCORE) */
+  OC_BLOCK_STREAM = (1 << 9)  /**< handlers process the payload per block */
 } oc_resource_properties_t;
 
 /**
@@ -424,6 +425,12 @@ typedef struct oc_request_t
   oc_content_format_t
     accept; /**< accept header, e.g the format to be returned on the request */
   oc_response_t *response; /**< pointer to the response */
+  /** OC_BLOCK_STREAM: offset of the request payload, or of the requested
+   * response block when the request has no payload */
+  uint32_t block_offset;
+  /** OC_BLOCK_STREAM: more request blocks follow, to be set by the handler
+   * when the response continues after the block it wrote */
+  bool block_more;
 } oc_request_t;
 
 /**
@@ -472,6 +479,13 @@ typedef struct oc_properties_cb_t
 typedef struct oc_resource_data_t
 {
   uint8_t num_observers; /**< amount of observers */
+  bool acl_valid;        /**< acl_public & acl_methods are up to date */
+  uint8_t acl_public;    /**< methods without security (1 << oc_method_t) */
+  uint8_t acl_methods;   /**< methods allowed by the interfaces */
+  oc_interface_mask_t acl_interfaces; /**< interfaces the ACL bits are for */
+  const char *acl_uri;                /**< uri the ACL bits are for */
+  size_t acl_uri_len;                 /**< length of that uri */
+  size_t index_ordinal; /**< position in the resource index */
 } oc_resource_data_t;
 
 /**
@@ -580,6 +594,16 @@ void oc_ri_add_timed_event_callback_ticks(void *cb_data,
 void oc_ri_remove_timed_event_callback(void *cb_data,
                                        oc_trigger_t event_callback);
 
+/**
+ * @brief check whether a timed event callback is scheduled
+ *
+ * @param cb_data the timed event callback info
+ * @param event_callback the callback
+ * @return true when the callback is scheduled with cb_data
+ */
+bool oc_ri_has_timed_event_callback(const void *cb_data,
+                                    oc_trigger_t event_callback);
+
 /**
  * @brief convert the (internal) status code to coap status as integer
  *
@@ -610,6 +634,19 @@ const oc_resource_t *oc_ri_get_app_resource_by_uri(const char *uri,
                                                    size_t uri_len,
                                                    size_t device);
 
+/**
+ * @brief retrieve the core or application resource that handles the uri
+ *
+ * Core resources are matched first, including the ones with a wildcard uri.
+ *
+ * @param uri the uri of the resource, without leading '/'
+ * @param uri_len the length of the uri
+ * @param device the device index
+ * @return const oc_resource_t* the resource or NULL
+ */
+const oc_resource_t *oc_ri_get_resource_by_uri(const char *uri, size_t uri_len,
+                                               size_t device);
+
 /**
  * @brief retrieve list of resources
  *
@@ -618,6 +655,26 @@ const oc_resource_t *oc_ri_get_app_resource_by_uri(const char *uri,
 const oc_resource_t *oc_ri_get_app_resources(void);
 
 #ifdef OC_SERVER
+/**
+ * @brief generation of the list of resources
+ *
+ * Changes whenever resources are added or removed, or when the types, the
+ * interfaces or the functional block instance of a resource change, so that
+ * positions in the list and the resource index can be kept between requests.
+ *
+ * @return uint32_t the generation
+ */
+uint32_t oc_ri_get_app_resources_generation(void);
+
+/**
+ * @brief mark the list of resources as changed
+ *
+ * Increments the generation and drops the cached discovery responses. Called
+ * by the functions that add or remove resources or change their types,
+ * interfaces or functional block instance.
+ */
+void oc_ri_app_resources_changed(void);
+
 /**
  * @brief allocate a resource structure
  *
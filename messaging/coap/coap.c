@@ -63,6 +63,8 @@
 /*- Variables ---------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 static uint16_t current_mid = 0;
+static coap_frame_template_t frame_templates[COAP_MAX_FRAME_TEMPLATES];
+static uint8_t next_frame_template = 0;
 
 coap_status_t coap_status_code = COAP_NO_ERROR;
 /*---------------------------------------------------------------------------*/
@@ -816,6 +818,18 @@ coap_oscore_parse_options(void *packet, uint8_t *data, uint32_t data_len,
       coap_pkt->block2_num =
         coap_parse_int_option(current_option, option_length);
       coap_pkt->block2_more = (coap_pkt->block2_num & 0x08) >> 3;
+#ifdef OC_TCP
+      if (coap_pkt->transport_type == COAP_TRANSPORT_TCP &&
+          (coap_pkt->block2_num & 0x07) == COAP_BERT_SZX) {
+        coap_pkt->block2_bert = 1;
+        coap_pkt->block2_num >>= 4;
+        coap_pkt->block2_size = COAP_BERT_UNIT_SIZE;
+        coap_pkt->block2_offset = coap_pkt->block2_num * COAP_BERT_UNIT_SIZE;
+        OC_DBG("  Block2 [%lu%s (BERT)]", (unsigned long)coap_pkt->block2_num,
+               coap_pkt->block2_more ? "+" : "");
+        break;
+      }
+#endif /* OC_TCP */
       coap_pkt->block2_size = 16 << (coap_pkt->block2_num & 0x07);
       coap_pkt->block2_offset = (coap_pkt->block2_num & ~0x0000000F)
                                 << (coap_pkt->block2_num & 0x07);
@@ -830,6 +844,18 @@ coap_oscore_parse_options(void *packet, uint8_t *data, uint32_t data_len,
       coap_pkt->block1_num =
         coap_parse_int_option(current_option, option_length);
       coap_pkt->block1_more = (coap_pkt->block1_num & 0x08) >> 3;
+#ifdef OC_TCP
+      if (coap_pkt->transport_type == COAP_TRANSPORT_TCP &&
+          (coap_pkt->block1_num & 0x07) == COAP_BERT_SZX) {
+        coap_pkt->block1_bert = 1;
+        coap_pkt->block1_num >>= 4;
+        coap_pkt->block1_size = COAP_BERT_UNIT_SIZE;
+        coap_pkt->block1_offset = coap_pkt->block1_num * COAP_BERT_UNIT_SIZE;
+        OC_DBG("  Block1 [%lu%s (BERT)]", (unsigned long)coap_pkt->block1_num,
+               coap_pkt->block1_more ? "+" : "");
+        break;
+      }
+#endif /* OC_TCP */
       coap_pkt->block1_size = 16 << (coap_pkt->block1_num & 0x07);
       coap_pkt->block1_offset = (coap_pkt->block1_num & ~0x0000000F)
                                 << (coap_pkt->block1_num & 0x07);
@@ -1200,7 +1226,8 @@ coap_send_message(oc_message_t *message)
   if (message->endpoint.flags & TCP) {
     tcp_csm_state_t state = oc_tcp_get_csm_state(&message->endpoint);
     if (state == CSM_NONE) {
-      coap_send_csm_message(&message->endpoint, OC_PDU_SIZE, 0);
+      coap_send_csm_message(&message->endpoint, OC_PDU_SIZE,
+                            COAP_SIGNAL_BLOCKWISE_TRANSFER);
     }
   }
 #endif /* OC_TCP */
@@ -1216,6 +1243,99 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   return coap_oscore_serialize_message(packet, buffer, true, true, false);
 }
 /*---------------------------------------------------------------------------*/
+static bool
+frame_template_build(coap_frame_template_t *frame, coap_message_type_t type,
+                     uint8_t code, const char *path, size_t path_len,
+                     oc_content_format_t content_format)
+{
+  coap_packet_t packet[1];
+  uint8_t header[COAP_MAX_HEADER_SIZE];
+
+  coap_udp_init_message(packet, type, code, 0);
+  coap_set_header_uri_path(packet, path, path_len);
+  coap_set_header_content_format(packet, content_format);
+  coap_set_header_accept(packet, content_format);
+  /* no token and no payload: the options follow the fixed header */
+  size_t len = coap_serialize_message(packet, header);
+  if (len <= COAP_HEADER_LEN ||
+      len - COAP_HEADER_LEN > sizeof(frame->options)) {
+    return false;
+  }
+  frame->type = type;
+  frame->code = code;
+  frame->content_format = content_format;
+  frame->path_len = (uint8_t)path_len;
+  memcpy(frame->path, path, path_len);
+  frame->options_len = (uint8_t)(len - COAP_HEADER_LEN);
+  memcpy(frame->options, header + COAP_HEADER_LEN, frame->options_len);
+  return true;
+}
+
+const coap_frame_template_t *
+coap_get_frame_template(coap_message_type_t type, uint8_t code,
+                        const char *path, size_t path_len,
+                        oc_content_format_t content_format)
+{
+  if (path_len > COAP_FRAME_TEMPLATE_MAX_PATH) {
+    return NULL;
+  }
+  int i;
+  for (i = 0; i < COAP_MAX_FRAME_TEMPLATES; i++) {
+    const coap_frame_template_t *frame = &frame_templates[i];
+    if (frame->options_len > 0 && frame->type == type && frame->code == code &&
+        frame->content_format == content_format &&
+        frame->path_len == path_len &&
+        memcmp(frame->path, path, path_len) == 0) {
+      return frame;
+    }
+  }
+
+  /* replace the oldest template */
+  coap_frame_template_t *frame = &frame_templates[next_frame_template];
+  frame->options_len = 0;
+  if (!frame_template_build(frame, type, code, path, path_len,
+                            content_format)) {
+    return NULL;
+  }
+  next_frame_template = (next_frame_template + 1) % COAP_MAX_FRAME_TEMPLATES;
+  return frame;
+}
+
+size_t
+coap_serialize_frame(const coap_frame_template_t *frame, uint16_t mid,
+                     const uint8_t *token, uint8_t token_len,
+                     const uint8_t *payload, size_t payload_len,
+                     uint8_t *buffer)
+{
+  size_t header_len = COAP_HEADER_LEN + token_len + frame->options_len;
+  if (payload_len > 0) {
+    header_len += COAP_PAYLOAD_MARKER_LEN;
+  }
+  if (token_len > COAP_TOKEN_LEN || header_len > COAP_MAX_HEADER_SIZE) {
+    OC_ERR("Serialized header length %u exceeds COAP_MAX_HEADER_SIZE %u",
+           (unsigned int)header_len, COAP_MAX_HEADER_SIZE);
+    return 0;
+  }
+
+  uint8_t *option = buffer;
+  *option++ = (uint8_t)(
+    (COAP_HEADER_VERSION_MASK & 1 << COAP_HEADER_VERSION_POSITION) |
+    (COAP_HEADER_TYPE_MASK & frame->type << COAP_HEADER_TYPE_POSITION) |
+    (COAP_HEADER_TOKEN_LEN_MASK & token_len << COAP_HEADER_TOKEN_LEN_POSITION));
+  *option++ = frame->code;
+  *option++ = (uint8_t)(mid >> 8);
+  *option++ = (uint8_t)mid;
+  memcpy(option, token, token_len);
+  option += token_len;
+  memcpy(option, frame->options, frame->options_len);
+  option += frame->options_len;
+  if (payload_len > 0) {
+    *option++ = 0xFF;
+    memmove(option, payload, payload_len);
+  }
+  return header_len + payload_len;
+}
+/*---------------------------------------------------------------------------*/
 coap_status_t
 coap_udp_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 {
@@ -1722,6 +1842,31 @@ coap_set_header_block2(void *packet, uint32_t num, uint8_t more, uint16_t size)
   coap_pkt->block2_num = num;
   coap_pkt->block2_more = more ? 1 : 0;
   coap_pkt->block2_size = size;
+  coap_pkt->block2_bert = 0;
+
+  SET_OPTION(coap_pkt, COAP_OPTION_BLOCK2);
+  return 1;
+}
+
+int
+coap_get_header_block2_bert(void *packet)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
+
+  return IS_OPTION(coap_pkt, COAP_OPTION_BLOCK2) && coap_pkt->block2_bert;
+}
+int
+coap_set_header_block2_bert(void *packet, uint32_t num, uint8_t more)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
+
+  if (num > 0x0FFFFF) {
+    return 0;
+  }
+  coap_pkt->block2_num = num;
+  coap_pkt->block2_more = more ? 1 : 0;
+  coap_pkt->block2_size = COAP_BERT_UNIT_SIZE;
+  coap_pkt->block2_bert = 1;
 
   SET_OPTION(coap_pkt, COAP_OPTION_BLOCK2);
   return 1;
@@ -1768,6 +1913,31 @@ coap_set_header_block1(void *packet, uint32_t num, uint8_t more, uint16_t size)
   coap_pkt->block1_num = num;
   coap_pkt->block1_more = more;
   coap_pkt->block1_size = size;
+  coap_pkt->block1_bert = 0;
+
+  SET_OPTION(coap_pkt, COAP_OPTION_BLOCK1);
+  return 1;
+}
+
+int
+coap_get_header_block1_bert(void *packet)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
+
+  return IS_OPTION(coap_pkt, COAP_OPTION_BLOCK1) && coap_pkt->block1_bert;
+}
+int
+coap_set_header_block1_bert(void *packet, uint32_t num, uint8_t more)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
+
+  if (num > 0x0FFFFF) {
+    return 0;
+  }
+  coap_pkt->block1_num = num;
+  coap_pkt->block1_more = more ? 1 : 0;
+  coap_pkt->block1_size = COAP_BERT_UNIT_SIZE;
+  coap_pkt->block1_bert = 1;
 
   SET_OPTION(coap_pkt, COAP_OPTION_BLOCK1);
   return 1;
@@ -133,10 +133,12 @@ typedef struct
   uint8_t block2_more;
   uint16_t block2_size;
   uint32_t block2_offset;
+  uint8_t block2_bert; /* SZX 7 over TCP, block2_size is the BERT unit */
   uint32_t block1_num;
   uint8_t block1_more;
   uint16_t block1_size;
   uint32_t block1_offset;
+  uint8_t block1_bert; /* SZX 7 over TCP, block1_size is the BERT unit */
   uint32_t size2;
   uint32_t size1;
   size_t uri_query_len;
@@ -215,7 +217,11 @@ typedef struct
     if (coap_pkt->field##_more) {                                              \
       block |= 0x8;                                                            \
     }                                                                          \
-    block |= 0xF & coap_log_2(coap_pkt->field##_size / 16);                    \
+    if (coap_pkt->field##_bert) {                                              \
+      block |= COAP_BERT_SZX;                                                  \
+    } else {                                                                   \
+      block |= 0xF & coap_log_2(coap_pkt->field##_size / 16);                  \
+    }                                                                          \
     option_length +=                                                           \
       coap_serialize_int_option(number, current_number, option, block);        \
     if (option) {                                                              \
@@ -227,6 +233,19 @@ typedef struct
     current_number = number;                                                   \
   }
 
+/* precomputed options of a UDP request with a Uri-Path, Content-Format and
+ * Accept, for requests that differ only in mid, token and payload */
+typedef struct coap_frame_template_t
+{
+  coap_message_type_t type;
+  uint8_t code;
+  oc_content_format_t content_format;
+  uint8_t path_len;
+  char path[COAP_FRAME_TEMPLATE_MAX_PATH];
+  uint8_t options_len;
+  uint8_t options[2 * COAP_FRAME_TEMPLATE_MAX_PATH + 8];
+} coap_frame_template_t;
+
 /** stores error code */
 extern coap_status_t coap_status_code;
 /** stores human-readable payload */
@@ -238,6 +257,16 @@ uint16_t coap_get_mid(void);
 void coap_udp_init_message(void *packet, coap_message_type_t type, uint8_t code,
                            uint16_t mid);
 size_t coap_serialize_message(void *packet, uint8_t *buffer);
+/* the cached template for the request, NULL when the path is too long */
+const coap_frame_template_t *coap_get_frame_template(
+  coap_message_type_t type, uint8_t code, const char *path, size_t path_len,
+  oc_content_format_t content_format);
+/* serialize a request from a template, the payload may be in buffer already
+ * (at COAP_MAX_HEADER_SIZE) */
+size_t coap_serialize_frame(const coap_frame_template_t *frame, uint16_t mid,
+                            const uint8_t *token, uint8_t token_len,
+                            const uint8_t *payload, size_t payload_len,
+                            uint8_t *buffer);
 size_t coap_oscore_serialize_message(void *packet, uint8_t *buffer, bool inner,
                                      bool outer, bool oscore);
 void coap_send_message(oc_message_t *message);
@@ -330,6 +359,13 @@ int coap_get_header_block1(void *packet, uint32_t *num, uint8_t *more,
 int coap_set_header_block1(void *packet, uint32_t num, uint8_t more,
                            uint16_t size);
 
+/* BERT (RFC 8323): SZX 7 on a reliable transport, the block number counts
+ * COAP_BERT_UNIT_SIZE bytes and a message carries one or more units */
+int coap_get_header_block2_bert(void *packet);
+int coap_set_header_block2_bert(void *packet, uint32_t num, uint8_t more);
+int coap_get_header_block1_bert(void *packet);
+int coap_set_header_block1_bert(void *packet, uint32_t num, uint8_t more);
+
 int coap_get_header_size2(void *packet, uint32_t *size);
 int coap_set_header_size2(void *packet, uint32_t size);
 
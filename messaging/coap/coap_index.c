@@ -0,0 +1,289 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "coap_index.h"
+#include "oc_config.h"
+#include "port/oc_log.h"
+#include <string.h>
+#ifdef OC_DYNAMIC_ALLOCATION
+#include <stdlib.h>
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+/* number of slots of the table, a power of 2. with dynamic allocation this
+ * is the initial size, the table doubles when it is 3/4 full */
+#ifndef COAP_INDEX_SIZE
+#define COAP_INDEX_SIZE (64)
+#endif /* COAP_INDEX_SIZE */
+
+#if (COAP_INDEX_SIZE & (COAP_INDEX_SIZE - 1)) != 0
+#error "COAP_INDEX_SIZE must be a power of 2"
+#endif
+
+/* number of objects that could not be added and are kept on the side, so
+ * that their removal is recognized. with dynamic allocation this is the
+ * initial size */
+#ifndef COAP_INDEX_MISSING_SIZE
+#define COAP_INDEX_MISSING_SIZE (16)
+#endif /* COAP_INDEX_MISSING_SIZE */
+
+#define COAP_INDEX_MAX_KEY_LEN (8)
+
+typedef struct coap_index_entry_t
+{
+  void *obj; /* NULL: slot is empty */
+  uint32_t hash;
+  uint32_t seq; /* insertion order, to return the oldest of equal keys */
+  uint8_t kind;
+  uint8_t key_len;
+  uint8_t key[COAP_INDEX_MAX_KEY_LEN];
+} coap_index_entry_t;
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static coap_index_entry_t *index_table;
+static size_t index_size;
+#else  /* OC_DYNAMIC_ALLOCATION */
+static coap_index_entry_t index_table[COAP_INDEX_SIZE];
+static const size_t index_size = COAP_INDEX_SIZE;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+static size_t index_used;
+static uint32_t index_seq;
+/* the objects that could not be added */
+#ifdef OC_DYNAMIC_ALLOCATION
+static coap_index_entry_t *index_missing;
+static size_t index_missing_size;
+#else  /* OC_DYNAMIC_ALLOCATION */
+static coap_index_entry_t index_missing[COAP_INDEX_MISSING_SIZE];
+static const size_t index_missing_size = COAP_INDEX_MISSING_SIZE;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+static size_t index_missing_len;
+/* an object could not be added nor recorded as missing, the index stays
+ * incomplete until it is freed */
+static bool index_lost;
+
+static uint32_t
+index_hash(uint8_t kind, const uint8_t *key, size_t key_len)
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  hash = (hash ^ kind) * 16777619u;
+  for (size_t i = 0; i < key_len; i++) {
+    hash = (hash ^ key[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static bool
+index_entry_matches(const coap_index_entry_t *entry, uint32_t hash,
+                    uint8_t kind, const uint8_t *key, size_t key_len)
+{
+  return entry->hash == hash && entry->kind == kind &&
+         entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0;
+}
+
+static void
+index_insert(const coap_index_entry_t *entry)
+{
+  size_t mask = index_size - 1;
+  size_t i = entry->hash & mask;
+  while (index_table[i].obj != NULL) {
+    i = (i + 1) & mask;
+  }
+  index_table[i] = *entry;
+  index_used++;
+}
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static bool
+index_resize(size_t new_size)
+{
+  coap_index_entry_t *old = index_table;
+  size_t old_size = index_size;
+  coap_index_entry_t *table =
+    (coap_index_entry_t *)calloc(new_size, sizeof(coap_index_entry_t));
+  if (table == NULL) {
+    OC_ERR("out of memory for the exchange index (%d)", (int)new_size);
+    return false;
+  }
+  index_table = table;
+  index_size = new_size;
+  index_used = 0;
+  for (size_t i = 0; i < old_size; i++) {
+    if (old[i].obj != NULL) {
+      index_insert(&old[i]);
+    }
+  }
+  free(old);
+  return true;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+static void
+index_add_missing(const coap_index_entry_t *entry)
+{
+  if (index_missing_len == index_missing_size) {
+#ifdef OC_DYNAMIC_ALLOCATION
+    size_t new_size = index_missing_size == 0 ? COAP_INDEX_MISSING_SIZE
+                                              : index_missing_size * 2;
+    coap_index_entry_t *missing = (coap_index_entry_t *)realloc(
+      index_missing, new_size * sizeof(coap_index_entry_t));
+    if (missing != NULL) {
+      index_missing = missing;
+      index_missing_size = new_size;
+    }
+#endif /* OC_DYNAMIC_ALLOCATION */
+    if (index_missing_len == index_missing_size) {
+      index_lost = true;
+      return;
+    }
+  }
+  index_missing[index_missing_len++] = *entry;
+}
+
+/* returns true when the object was one of the missing objects */
+static bool
+index_remove_missing(uint32_t hash, uint8_t kind, const uint8_t *key,
+                     size_t key_len, const void *obj)
+{
+  for (size_t i = 0; i < index_missing_len; i++) {
+    if (index_missing[i].obj == obj &&
+        index_entry_matches(&index_missing[i], hash, kind, key, key_len)) {
+      index_missing[i] = index_missing[--index_missing_len];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+coap_index_add(coap_index_kind_t kind, const void *key, size_t key_len,
+               void *obj)
+{
+  if (obj == NULL || key_len > COAP_INDEX_MAX_KEY_LEN) {
+    return false;
+  }
+  coap_index_entry_t entry;
+  entry.obj = obj;
+  entry.kind = (uint8_t)kind;
+  entry.key_len = (uint8_t)key_len;
+  memcpy(entry.key, key, key_len);
+  entry.hash = index_hash(entry.kind, entry.key, key_len);
+  entry.seq = index_seq++;
+  /* keep the load at or below 3/4, so that probing ends at an empty slot */
+  if (index_used + 1 > index_size - index_size / 4) {
+#ifdef OC_DYNAMIC_ALLOCATION
+    if (!index_resize(index_size == 0 ? COAP_INDEX_SIZE : index_size * 2))
+#endif /* OC_DYNAMIC_ALLOCATION */
+    {
+      OC_WRN("exchange index full, falling back to list lookups");
+      index_add_missing(&entry);
+      return false;
+    }
+  }
+  index_insert(&entry);
+  return true;
+}
+
+void
+coap_index_remove(coap_index_kind_t kind, const void *key, size_t key_len,
+                  const void *obj)
+{
+  if (key_len > COAP_INDEX_MAX_KEY_LEN) {
+    return;
+  }
+  uint32_t hash = index_hash((uint8_t)kind, key, key_len);
+  if (index_remove_missing(hash, (uint8_t)kind, key, key_len, obj) ||
+      index_size == 0) {
+    return;
+  }
+  size_t mask = index_size - 1;
+  size_t i = hash & mask;
+  while (index_table[i].obj != obj ||
+         !index_entry_matches(&index_table[i], hash, (uint8_t)kind, key,
+                              key_len)) {
+    if (index_table[i].obj == NULL) {
+      /* not in the index */
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  /* move back the entries of the probe sequence that follows the slot */
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (index_table[j].obj == NULL) {
+      break;
+    }
+    size_t k = index_table[j].hash & mask;
+    /* the entry can move to slot i when its home is not in (i, j] */
+    bool in_range = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+    if (!in_range) {
+      index_table[i] = index_table[j];
+      i = j;
+    }
+  }
+  index_table[i].obj = NULL;
+  index_used--;
+}
+
+void *
+coap_index_find(coap_index_kind_t kind, const void *key, size_t key_len,
+                coap_index_match_t match, const void *ctx)
+{
+  if (index_size == 0 || key_len > COAP_INDEX_MAX_KEY_LEN) {
+    return NULL;
+  }
+  size_t mask = index_size - 1;
+  uint32_t hash = index_hash((uint8_t)kind, key, key_len);
+  coap_index_entry_t *found = NULL;
+  for (size_t i = hash & mask; index_table[i].obj != NULL;
+       i = (i + 1) & mask) {
+    coap_index_entry_t *entry = &index_table[i];
+    if (!index_entry_matches(entry, hash, (uint8_t)kind, key, key_len)) {
+      continue;
+    }
+    if (found != NULL && (int32_t)(entry->seq - found->seq) > 0) {
+      continue;
+    }
+    if (match == NULL || match(entry->obj, ctx)) {
+      found = entry;
+    }
+  }
+  return found ? found->obj : NULL;
+}
+
+bool
+coap_index_is_complete(void)
+{
+  return index_missing_len == 0 && !index_lost;
+}
+
+void
+coap_index_free(void)
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(index_table);
+  index_table = NULL;
+  index_size = 0;
+  free(index_missing);
+  index_missing = NULL;
+  index_missing_size = 0;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  memset(index_table, 0, sizeof(index_table));
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  index_used = 0;
+  index_missing_len = 0;
+  index_lost = false;
+}
@@ -0,0 +1,132 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/**
+  @brief index of the exchanges (transactions, client callbacks, block-wise
+  buffers, observers) by message ID, token or pointer
+  @file
+
+  One open addressing hash table shared by all exchange types, so that
+  response matching does not walk the lists of the exchanges.
+  The owner of an object adds it to the index when it is created, updates the
+  index whenever it changes the key (e.g. a new MID) and removes it before the
+  object is freed.
+  When an object could not be added (table full), coap_index_is_complete()
+  returns false and the lookups fall back to walking the lists.
+*/
+#ifndef COAP_INDEX_H
+#define COAP_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief object type and key type of an index entry
+ */
+typedef enum {
+  COAP_INDEX_TRANSACTION_MID = 0,
+  COAP_INDEX_TRANSACTION_TOKEN,
+  COAP_INDEX_CLIENT_CB,
+  COAP_INDEX_CLIENT_CB_MID,
+  COAP_INDEX_CLIENT_CB_TOKEN,
+  COAP_INDEX_BLOCKWISE_REQUEST_MID,
+  COAP_INDEX_BLOCKWISE_REQUEST_TOKEN,
+  COAP_INDEX_BLOCKWISE_REQUEST_CLIENT_CB,
+  COAP_INDEX_BLOCKWISE_RESPONSE_MID,
+  COAP_INDEX_BLOCKWISE_RESPONSE_TOKEN,
+  COAP_INDEX_BLOCKWISE_RESPONSE_CLIENT_CB,
+  COAP_INDEX_OBSERVER_MID,
+  COAP_INDEX_OBSERVER_TOKEN
+} coap_index_kind_t;
+
+/**
+ * @brief additional filter on the objects found by key
+ *
+ * @param obj the object
+ * @param ctx the context given to coap_index_find
+ * @return true the object matches
+ */
+typedef bool (*coap_index_match_t)(const void *obj, const void *ctx);
+
+/**
+ * @brief add an object to the index
+ *
+ * @param kind the kind of entry
+ * @param key the key (mid, token or pointer), at most 8 bytes
+ * @param key_len the length of the key
+ * @param obj the object
+ * @return true added
+ * @return false index full, lookups fall back to the lists
+ */
+bool coap_index_add(coap_index_kind_t kind, const void *key, size_t key_len,
+                    void *obj);
+
+/**
+ * @brief remove an object from the index
+ *
+ * @param kind the kind of entry
+ * @param key the key the object was added with
+ * @param key_len the length of the key
+ * @param obj the object
+ */
+void coap_index_remove(coap_index_kind_t kind, const void *key,
+                       size_t key_len, const void *obj);
+
+/**
+ * @brief find the object that was added first with the key
+ *
+ * @param kind the kind of entry
+ * @param key the key
+ * @param key_len the length of the key
+ * @param match additional filter (can be NULL)
+ * @param ctx context for the filter
+ * @return void* the object, NULL if not found
+ */
+void *coap_index_find(coap_index_kind_t kind, const void *key, size_t key_len,
+                      coap_index_match_t match, const void *ctx);
+
+/**
+ * @brief are all objects in the index
+ *
+ * @return true lookups can use the index
+ * @return false an object could not be added, lookups walk the lists
+ */
+bool coap_index_is_complete(void);
+
+/**
+ * @brief free the index
+ */
+void coap_index_free(void);
+
+/* convenience wrappers for message IDs and pointers */
+#define coap_index_add_mid(kind, mid, obj)                                     \
+  coap_index_add((kind), &(mid), sizeof(uint16_t), (obj))
+#define coap_index_remove_mid(kind, mid, obj)                                  \
+  coap_index_remove((kind), &(mid), sizeof(uint16_t), (obj))
+#define coap_index_add_ptr(kind, ptr, obj)                                     \
+  coap_index_add((kind), &(ptr), sizeof(void *), (obj))
+#define coap_index_remove_ptr(kind, ptr, obj)                                  \
+  coap_index_remove((kind), &(ptr), sizeof(void *), (obj))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COAP_INDEX_H */
@@ -72,8 +72,6 @@ coap_send_csm_message(oc_endpoint_t *endpoint, uint32_t max_message_size,
       OC_ERR("coap_signal_set_blockwise_transfer failed");
       return 0;
     }
-    // Add this line below to remain until we start supporting BERT
-    max_message_size = 1152;
   }
 #endif /* OC_BLOCK_WISE */
 
@@ -222,12 +220,22 @@ handle_coap_signal_message(void *packet, oc_endpoint_t *endpoint)
 
   OC_DBG("Coap signal message received.(code: %d)", coap_pkt->code);
   if (coap_pkt->code == CSM_7_01) {
+    /* a later CSM updates the options of the connection */
+    uint32_t max_message_size = OC_TCP_DEFAULT_MAX_MESSAGE_SIZE;
+    uint8_t blockwise_transfer = 0;
+    coap_signal_get_max_msg_size(coap_pkt, &max_message_size);
+    coap_signal_get_blockwise_transfer(coap_pkt, &blockwise_transfer);
+    oc_tcp_update_csm_options(endpoint, max_message_size,
+                              blockwise_transfer == 1);
+    OC_DBG("peer CSM: Max-Message-Size %u, block-wise transfer %u",
+           (unsigned)max_message_size, (unsigned)blockwise_transfer);
+
     tcp_csm_state_t state = oc_tcp_get_csm_state(endpoint);
     if (state == CSM_DONE) {
-      // TODO: max-message-size, blockwise_transfer handling
       return COAP_NO_ERROR;
     } else if (state == CSM_NONE) {
-      coap_send_csm_message(endpoint, OC_PDU_SIZE, 0);
+      coap_send_csm_message(endpoint, OC_PDU_SIZE,
+                            COAP_SIGNAL_BLOCKWISE_TRANSFER);
     }
     oc_tcp_update_csm_state(endpoint, CSM_DONE);
   } else if (coap_pkt->code == PING_7_02) {
@@ -250,6 +258,44 @@ handle_coap_signal_message(void *packet, oc_endpoint_t *endpoint)
   return COAP_NO_ERROR;
 }
 
+#ifdef OC_OSCORE
+#define COAP_TCP_HEADROOM (2 * COAP_MAX_HEADER_SIZE)
+#else /* OC_OSCORE */
+#define COAP_TCP_HEADROOM (COAP_MAX_HEADER_SIZE)
+#endif /* !OC_OSCORE */
+
+uint32_t
+coap_tcp_get_max_payload_size(oc_endpoint_t *endpoint)
+{
+  uint32_t max_message_size;
+  bool bert;
+  oc_tcp_get_csm_options(endpoint, &max_message_size, &bert);
+  max_message_size = MIN(max_message_size, (uint32_t)OC_PDU_SIZE);
+  if (max_message_size <= COAP_TCP_HEADROOM) {
+    return 0;
+  }
+  return max_message_size - COAP_TCP_HEADROOM;
+}
+
+uint32_t
+coap_tcp_get_bert_size(oc_endpoint_t *endpoint)
+{
+#ifdef OC_BLOCK_WISE
+  uint32_t max_message_size;
+  bool bert;
+  if (oc_tcp_get_csm_options(endpoint, &max_message_size, &bert) != 0 ||
+      !bert) {
+    return 0;
+  }
+  uint32_t units =
+    coap_tcp_get_max_payload_size(endpoint) / COAP_BERT_UNIT_SIZE;
+  return units * COAP_BERT_UNIT_SIZE;
+#else  /* OC_BLOCK_WISE */
+  (void)endpoint;
+  return 0;
+#endif /* !OC_BLOCK_WISE */
+}
+
 int
 coap_signal_get_max_msg_size(void *packet, uint32_t *size)
 {
@@ -46,6 +46,13 @@ typedef enum {
   COAP_SIGNAL_OPTION_BAD_CSM = 2,            /* 0-2 B */
 } coap_signal_option_t;
 
+/* the Block-Wise-Transfer option offered in our CSM */
+#ifdef OC_BLOCK_WISE
+#define COAP_SIGNAL_BLOCKWISE_TRANSFER (1)
+#else /* OC_BLOCK_WISE */
+#define COAP_SIGNAL_BLOCKWISE_TRANSFER (0)
+#endif /* !OC_BLOCK_WISE */
+
 int coap_send_csm_message(oc_endpoint_t *endpoint, uint32_t max_message_size,
                           uint8_t blockwise_transfer_option);
 int coap_send_ping_message(oc_endpoint_t *endpoint, uint8_t custody_option,
@@ -73,6 +80,14 @@ int coap_signal_get_hold_off(void *packet, uint32_t *time_seconds);
 int coap_signal_set_hold_off(void *packet, uint32_t time_seconds);
 int coap_signal_get_bad_csm(void *packet, uint16_t *opt);
 int coap_signal_set_bad_csm(void *packet, uint16_t opt);
+
+/* largest payload of a message to the peer, limited by its CSM and by the
+ * size of our message buffers */
+uint32_t coap_tcp_get_max_payload_size(oc_endpoint_t *endpoint);
+/* payload of a BERT message to the peer, a multiple of COAP_BERT_UNIT_SIZE,
+ * 0 when the peer did not offer block-wise transfer or when no BERT unit fits
+ * in a message */
+uint32_t coap_tcp_get_bert_size(oc_endpoint_t *endpoint);
 #endif /* OC_TCP */
 
 #ifdef __cplusplus
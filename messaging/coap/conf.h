@@ -78,6 +78,15 @@ extern "C" {
 #endif /* !OC_BLOCK_WISE */
 #endif /* COAP_MAX_HEADER_SIZE */
 
+/* Number of cached request headers (see coap_get_frame_template) and the
+ * longest Uri-Path they are kept for */
+#ifndef COAP_MAX_FRAME_TEMPLATES
+#define COAP_MAX_FRAME_TEMPLATES (4)
+#endif /* COAP_MAX_FRAME_TEMPLATES */
+#ifndef COAP_FRAME_TEMPLATE_MAX_PATH
+#define COAP_FRAME_TEMPLATE_MAX_PATH (32)
+#endif /* COAP_FRAME_TEMPLATE_MAX_PATH */
+
 /* Number of observer slots (each takes abot xxx bytes) */
 #ifndef COAP_MAX_OBSERVERS
 #define COAP_MAX_OBSERVERS                                                     \
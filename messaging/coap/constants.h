@@ -94,6 +94,8 @@ extern "C" {
   2 /* | len:0xF0 tkl:0x0F | .... | code |                                     \
      */
 #define COAP_TCP_MAX_EXTENDED_LENGTH_LEN 4
+#define COAP_BERT_SZX 7          /**< Block option SZX of BERT (RFC 8323) */
+#define COAP_BERT_UNIT_SIZE 1024 /**< bytes per block number with BERT */
 #define COAP_PAYLOAD_MARKER_LEN 1 /* 0xFF */
 
 #define COAP_TCP_HEADER_LEN_MASK 0xF0
@@ -82,54 +82,305 @@ OC_PROCESS(coap_engine, "CoAP Engine");
 extern bool oc_ri_invoke_coap_entity_handler(
   void *request, void *response, oc_blockwise_state_t **request_state,
   oc_blockwise_state_t **response_state, uint16_t block2_size,
-  oc_endpoint_t *endpoint);
+  oc_block_stream_t *stream, oc_endpoint_t *endpoint);
 #else  /* OC_BLOCK_WISE */
 extern bool oc_ri_invoke_coap_entity_handler(void *request, void *response,
                                              uint8_t *buffer,
                                              oc_endpoint_t *endpoint);
 #endif /* !OC_BLOCK_WISE */
 
+#ifndef OC_ECHO_FRESHNESS_TIME
+#define OC_ECHO_FRESHNESS_TIME (10 * OC_CLOCK_CONF_TICKS_PER_SECOND)
+#endif
+
+#ifdef OC_BLOCK_WISE
+/* Block options are answered in the form they were received in, BERT
+ * (RFC 8323) or with a block size */
+static void
+set_header_block1(coap_packet_t *packet, uint32_t num, uint8_t more,
+                  uint16_t size, bool bert)
+{
+  if (bert) {
+    coap_set_header_block1_bert(packet, num, more);
+  } else {
+    coap_set_header_block1(packet, num, more, size);
+  }
+}
+
+static void
+set_header_block2(coap_packet_t *packet, uint32_t num, uint8_t more,
+                  uint16_t size, bool bert)
+{
+  if (bert) {
+    coap_set_header_block2_bert(packet, num, more);
+  } else {
+    coap_set_header_block2(packet, num, more, size);
+  }
+}
+#endif /* OC_BLOCK_WISE */
+
 #ifdef OC_REQUEST_HISTORY
-// The size of the array used to de-duplicate CoAP messages.
-// A value of 25 means that the message ID & device counter
-// are compared to the ones in the last 25 messages. If a
-// match is found, the message is dropped as it must be
-// a duplicate.
-#define OC_REQUEST_HISTORY_SIZE (75)
-/*
-static uint16_t history[OC_REQUEST_HISTORY_SIZE];
-static uint8_t history_dev[OC_REQUEST_HISTORY_SIZE];
-*/
-static uint8_t idx;
+// De-duplication of CoAP messages.
+// The message ID, device, port and address of the received messages are kept
+// in a hash table (open addressing, linear probing) for EXCHANGE_LIFETIME.
+// A message that matches an entry that did not expire yet is a duplicate.
+// OC_REQUEST_HISTORY_SIZE is the (initial) number of slots, a power of 2.
+// At most 3/4 of the slots are used, the default of 128 slots keeps at least
+// the 75 messages of the former history.
+// With dynamic allocation the table grows up to OC_REQUEST_HISTORY_MAX_SIZE
+// slots, when it is full the entry in the way of the new one is evicted.
+#ifndef OC_REQUEST_HISTORY_SIZE
+#define OC_REQUEST_HISTORY_SIZE (128)
+#endif /* OC_REQUEST_HISTORY_SIZE */
+#ifndef OC_REQUEST_HISTORY_MAX_SIZE
+#define OC_REQUEST_HISTORY_MAX_SIZE (4096)
+#endif /* OC_REQUEST_HISTORY_MAX_SIZE */
+
+#if (OC_REQUEST_HISTORY_SIZE & (OC_REQUEST_HISTORY_SIZE - 1)) != 0 ||         \
+  (OC_REQUEST_HISTORY_MAX_SIZE & (OC_REQUEST_HISTORY_MAX_SIZE - 1)) != 0
+#error "OC_REQUEST_HISTORY_SIZE/MAX_SIZE must be a power of 2"
+#endif
 
-static struct
+#define OC_REQUEST_HISTORY_LIFETIME                                            \
+  ((oc_clock_time_t)OC_EXCHANGE_LIFETIME * OC_CLOCK_SECOND)
+
+typedef struct coap_history_entry_t
 {
+  oc_clock_time_t expires; /* 0: slot is empty */
   uint16_t mid;
   uint16_t port;
   uint8_t dev;
   uint8_t address[16];
-} history[OC_REQUEST_HISTORY_SIZE];
+} coap_history_entry_t;
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static coap_history_entry_t *history;
+static size_t history_size;
+#else  /* OC_DYNAMIC_ALLOCATION */
+static coap_history_entry_t history[OC_REQUEST_HISTORY_SIZE];
+static const size_t history_size = OC_REQUEST_HISTORY_SIZE;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+static size_t history_used;
+static uint32_t history_evictions;
+/* nothing expires before this time, no need to purge the table */
+static oc_clock_time_t history_next_expiry;
+
+static size_t
+history_hash(uint16_t mid, uint8_t device, uint16_t port,
+             const uint8_t address[16])
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < 16; i++) {
+    hash = (hash ^ address[i]) * 16777619u;
+  }
+  hash = (hash ^ (mid & 0xff)) * 16777619u;
+  hash = (hash ^ (mid >> 8)) * 16777619u;
+  hash = (hash ^ (port & 0xff)) * 16777619u;
+  hash = (hash ^ (port >> 8)) * 16777619u;
+  hash = (hash ^ device) * 16777619u;
+  return (size_t)hash;
+}
 
-#ifndef OC_ECHO_FRESHNESS_TIME
-#define OC_ECHO_FRESHNESS_TIME (10 * OC_CLOCK_CONF_TICKS_PER_SECOND)
-#endif
+static size_t
+history_home(const coap_history_entry_t *entry)
+{
+  return history_hash(entry->mid, entry->dev, entry->port, entry->address) &
+         (history_size - 1);
+}
+
+/* removes the entry in slot i, moving back the entries of the probe sequence
+ * that follows it so that no tombstones are needed */
+static void
+history_remove(size_t i)
+{
+  size_t mask = history_size - 1;
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (history[j].expires == 0) {
+      break;
+    }
+    size_t k = history_home(&history[j]);
+    /* the entry can move to slot i when its home is not in (i, j] */
+    bool in_range = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+    if (!in_range) {
+      history[i] = history[j];
+      i = j;
+    }
+  }
+  history[i].expires = 0;
+  history_used--;
+}
+
+static void
+history_purge(oc_clock_time_t now)
+{
+  oc_clock_time_t next_expiry = 0;
+  for (size_t i = 0; i < history_size; i++) {
+    while (history[i].expires != 0 && history[i].expires <= now) {
+      history_remove(i);
+    }
+    if (history[i].expires != 0 &&
+        (next_expiry == 0 || history[i].expires < next_expiry)) {
+      next_expiry = history[i].expires;
+    }
+  }
+  history_next_expiry = next_expiry;
+}
+
+static void
+history_insert(const coap_history_entry_t *entry)
+{
+  size_t mask = history_size - 1;
+  size_t i = history_home(entry);
+  while (history[i].expires != 0) {
+    i = (i + 1) & mask;
+  }
+  history[i] = *entry;
+  history_used++;
+}
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static bool
+history_resize(size_t new_size)
+{
+  coap_history_entry_t *old = history;
+  size_t old_size = history_size;
+  coap_history_entry_t *table =
+    (coap_history_entry_t *)calloc(new_size, sizeof(coap_history_entry_t));
+  if (table == NULL) {
+    OC_ERR("out of memory for the request history (%d)", (int)new_size);
+    return false;
+  }
+  history = table;
+  history_size = new_size;
+  history_used = 0;
+  for (size_t i = 0; i < old_size; i++) {
+    if (old[i].expires != 0) {
+      history_insert(&old[i]);
+    }
+  }
+  free(old);
+  OC_DBG("request history resized to %d slots", (int)new_size);
+  return true;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+/* keeps the load of the table at or below 3/4, so that probing always ends
+ * at an empty slot */
+static void
+history_make_room(size_t home, oc_clock_time_t now)
+{
+  if (history_used + 1 <= history_size - history_size / 4) {
+    return;
+  }
+  if (history_next_expiry != 0 && history_next_expiry <= now) {
+    history_purge(now);
+    if (history_used + 1 <= history_size - history_size / 4) {
+      return;
+    }
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (history_size < OC_REQUEST_HISTORY_MAX_SIZE &&
+      history_resize(history_size * 2)) {
+    return;
+  }
+#endif /* OC_DYNAMIC_ALLOCATION */
+  /* evict the first entry of the probe sequence of the new entry */
+  size_t i = home;
+  while (history[i].expires == 0) {
+    i = (i + 1) & (history_size - 1);
+  }
+  history_remove(i);
+  history_evictions++;
+  OC_DBG("request history full, evicted entry (%u)",
+         (unsigned)history_evictions);
+}
+
+static coap_history_entry_t *
+history_find(uint16_t mid, uint8_t device, uint16_t port,
+             const uint8_t address[16], size_t home, oc_clock_time_t now)
+{
+  size_t mask = history_size - 1;
+  for (size_t i = home; history[i].expires != 0; i = (i + 1) & mask) {
+    coap_history_entry_t *entry = &history[i];
+    if (entry->mid == mid && entry->dev == device && entry->port == port &&
+        entry->expires > now && memcmp(entry->address, address, 16) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
 
 bool
 oc_coap_check_if_duplicate(uint16_t mid, uint8_t device, uint16_t port,
                            uint8_t address[16])
 {
-  size_t i;
-  for (i = 0; i < OC_REQUEST_HISTORY_SIZE; i++) {
-    if (history[i].mid == mid && history[i].dev == device &&
-        history[i].port == port &&
-        (memcmp(history[i].address, address, 16) == 0)) {
-      OC_DBG("dropping duplicate request");
-      OC_DBG("message ID: %d, history[%d]: %d", mid, (int)i, history[i]);
-      return true;
-    }
+  if (history_size == 0) {
+    return false;
+  }
+  size_t home = history_hash(mid, device, port, address) & (history_size - 1);
+  if (history_find(mid, device, port, address, home, oc_clock_time()) !=
+      NULL) {
+    OC_DBG("dropping duplicate request, message ID: %d", mid);
+    return true;
+  }
+  return false;
+}
+
+bool
+oc_coap_check_and_add_to_history(uint16_t mid, uint8_t device, uint16_t port,
+                                 uint8_t address[16])
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (history == NULL && !history_resize(OC_REQUEST_HISTORY_SIZE)) {
+    return false;
+  }
+#endif /* OC_DYNAMIC_ALLOCATION */
+  oc_clock_time_t now = oc_clock_time();
+  size_t hash = history_hash(mid, device, port, address);
+  size_t home = hash & (history_size - 1);
+  if (history_find(mid, device, port, address, home, now) != NULL) {
+    OC_DBG("dropping duplicate request, message ID: %d", mid);
+    return true;
+  }
+  history_make_room(home, now);
+  /* the table may have been resized */
+  home = hash & (history_size - 1);
+
+  coap_history_entry_t entry;
+  entry.expires = now + OC_REQUEST_HISTORY_LIFETIME;
+  entry.mid = mid;
+  entry.dev = device;
+  entry.port = port;
+  memcpy(entry.address, address, 16);
+  history_insert(&entry);
+  if (history_next_expiry == 0) {
+    history_next_expiry = entry.expires;
   }
   return false;
 }
+
+uint32_t
+oc_coap_history_evictions(void)
+{
+  return history_evictions;
+}
+
+void
+oc_coap_free_history(void)
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(history);
+  history = NULL;
+  history_size = 0;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  memset(history, 0, sizeof(history));
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  history_used = 0;
+  history_next_expiry = 0;
+}
 #endif /* OC_REQUEST_HISTORY */
 
 static void
@@ -225,9 +476,14 @@ coap_receive(oc_message_t *msg)
            block2_size = (uint16_t)OC_BLOCK_SIZE;
   uint8_t block1_more = 0, block2_more = 0;
   bool block1 = false, block2 = false;
+  /* BERT: the block numbers count COAP_BERT_UNIT_SIZE bytes and the
+   * payload of a message is one or more units */
+  bool block1_bert = false, block2_bert = false;
 
 #ifdef OC_BLOCK_WISE
   oc_blockwise_state_t *request_buffer = NULL, *response_buffer = NULL;
+  oc_block_stream_t stream = { 0 };
+  bool streaming = false;
 #endif /* OC_BLOCK_WISE */
 
 #ifdef OC_CLIENT
@@ -283,9 +539,18 @@ coap_receive(oc_message_t *msg)
                                &block2_offset))
       block2 = true;
 
+#ifdef OC_TCP
+    block1_bert = block1 && coap_get_header_block1_bert(message);
+    block2_bert = block2 && coap_get_header_block2_bert(message);
+#endif /* OC_TCP */
+
 #ifdef OC_BLOCK_WISE
-    block1_size = MIN(block1_size, (uint16_t)OC_BLOCK_SIZE);
-    block2_size = MIN(block2_size, (uint16_t)OC_BLOCK_SIZE);
+    if (!block1_bert) {
+      block1_size = MIN(block1_size, (uint16_t)OC_BLOCK_SIZE);
+    }
+    if (!block2_bert) {
+      block2_size = MIN(block2_size, (uint16_t)OC_BLOCK_SIZE);
+    }
 #endif /* OC_BLOCK_WISE */
 
 #ifdef OC_TCP
@@ -344,10 +609,9 @@ coap_receive(oc_message_t *msg)
 
           // a little bit naughty - modify the old client callback to refer to
           // the new (retransmitted) packet
-          client_cb->mid = retransmitted_pkt->mid;
-          client_cb->token_len = retransmitted_pkt->token_len;
-          memcpy(client_cb->token, retransmitted_pkt->token,
-                 client_cb->token_len);
+          oc_ri_client_cb_set_mid(client_cb, retransmitted_pkt->mid);
+          oc_ri_client_cb_set_token(client_cb, retransmitted_pkt->token,
+                                    retransmitted_pkt->token_len);
 
           new_transaction->message = oc_internal_allocate_outgoing_message();
           new_transaction->message->endpoint = transaction->message->endpoint;
@@ -406,10 +670,9 @@ coap_receive(oc_message_t *msg)
 
             // a little bit naughty - modify the old client callback to refer to
             // the new (retransmitted) packet
-            client_cb->mid = retransmitted_pkt->mid;
-            client_cb->token_len = retransmitted_pkt->token_len;
-            memcpy(client_cb->token, retransmitted_pkt->token,
-                   client_cb->token_len);
+            oc_ri_client_cb_set_mid(client_cb, retransmitted_pkt->mid);
+            oc_ri_client_cb_set_token(client_cb, retransmitted_pkt->token,
+                                      retransmitted_pkt->token_len);
 
             // add reference to original message so that it is not freed while
             // we still need it
@@ -474,17 +737,12 @@ coap_receive(oc_message_t *msg)
                                 message->mid);
         } else {
 #ifdef OC_REQUEST_HISTORY
-          if (oc_coap_check_if_duplicate(message->mid,
-                                         (uint8_t)msg->endpoint.device,
-                                         msg->endpoint.addr.ipv6.port,
-                                         msg->endpoint.addr.ipv6.address)) {
+          if (oc_coap_check_and_add_to_history(
+                message->mid, (uint8_t)msg->endpoint.device,
+                msg->endpoint.addr.ipv6.port,
+                msg->endpoint.addr.ipv6.address)) {
             return 0;
           }
-          history[idx].mid = message->mid;
-          history[idx].dev = (uint8_t)msg->endpoint.device;
-          history[idx].port = msg->endpoint.addr.ipv6.port;
-          memcpy(history[idx].address, msg->endpoint.addr.ipv6.address, 16);
-          idx = (idx + 1) % OC_REQUEST_HISTORY_SIZE;
 #endif /* OC_REQUEST_HISTORY */
           // TODO
           //          if (href_len == 7 && memcmp(href, "oic/res", 7) == 0) {
@@ -525,22 +783,12 @@ coap_receive(oc_message_t *msg)
 
 #if defined(OC_REPLAY_PROTECTION) && defined(OC_OSCORE)
       bool client_is_sync = true;
-      oc_string_t kid = { 0 };
-      oc_string_t kid_ctx = { 0 };
       uint64_t ssn;
 
       if (msg->endpoint.flags & OSCORE_DECRYPTED) {
-        oc_new_byte_string(&kid, msg->endpoint.kid, msg->endpoint.kid_len);
-        oc_new_byte_string(&kid_ctx, msg->endpoint.kid_ctx,
-                           msg->endpoint.kid_ctx_len);
         oscore_read_piv(msg->endpoint.request_piv,
                         msg->endpoint.request_piv_len, &ssn);
-
-        if (msg->endpoint.flags & MULTICAST) {
-          client_is_sync = oc_replay_check_client(ssn, kid, kid_ctx, true);
-        } else {
-          client_is_sync = oc_replay_check_client(ssn, kid, kid_ctx, false);
-        }
+        client_is_sync = oc_replay_check_endpoint(ssn, &msg->endpoint);
       }
 
       // Server-side logic for sending responses with an echo option,
@@ -605,7 +853,7 @@ coap_receive(oc_message_t *msg)
         } else {
           // message received with fresh echo, add to seen senders list
           OC_DBG("Included Echo is Fresh! Adding SSN to list...");
-          oc_replay_add_client(ssn, kid, kid_ctx);
+          oc_replay_add_endpoint(ssn, &msg->endpoint);
         }
       }
 #endif
@@ -619,6 +867,70 @@ coap_receive(oc_message_t *msg)
         const uint8_t *incoming_block;
         uint32_t incoming_block_len =
           (uint32_t)coap_get_payload(message, &incoming_block);
+        const oc_resource_t *resource =
+          oc_ri_get_resource_by_uri(href, href_len, msg->endpoint.device);
+        if (resource && (resource->properties & OC_BLOCK_STREAM)) {
+          OC_DBG("processing block of a streamed transfer");
+          if (block1) {
+            request_buffer = oc_blockwise_find_request_buffer(
+              href, href_len, &msg->endpoint, message->code, message->uri_query,
+              message->uri_query_len, OC_BLOCKWISE_SERVER);
+            if (request_buffer && block1_more &&
+                block1_offset < request_buffer->next_block_offset) {
+              // UDP transfer can duplicate messages, the block has already
+              // been handed to the resource.
+              response->code = CONTINUE_2_31;
+              set_header_block1(response, block1_num, block1_more, block1_size,
+                                block1_bert);
+              goto send_message;
+            }
+            if (!request_buffer && block1_num == 0) {
+              if (oc_drop_command(msg->endpoint.device) &&
+                  message->code >= COAP_GET && message->code <= COAP_DELETE) {
+                OC_WRN("cannot process new request during closing TLS "
+                       "sessions");
+                goto init_reset_message;
+              }
+              request_buffer = oc_blockwise_alloc_request_stream(
+                href, href_len, &msg->endpoint, message->code);
+              if (request_buffer && message->uri_query_len > 0) {
+                oc_new_string(&request_buffer->uri_query, message->uri_query,
+                              message->uri_query_len);
+              }
+            }
+            if (!request_buffer ||
+                block1_offset != request_buffer->next_block_offset ||
+                (!block1_bert && incoming_block_len > block1_size) ||
+                (block1_bert && block1_more &&
+                 incoming_block_len % COAP_BERT_UNIT_SIZE != 0)) {
+              OC_ERR("could not continue streamed request");
+              if (request_buffer) {
+                oc_blockwise_free_request_buffer(request_buffer);
+                request_buffer = NULL;
+              }
+              goto init_reset_message;
+            }
+            request_buffer->next_block_offset += incoming_block_len;
+            if (!block1_more) {
+              oc_blockwise_free_request_buffer(request_buffer);
+              request_buffer = NULL;
+            }
+            stream.offset = block1_offset;
+            stream.more = block1_more;
+          } else {
+            if (oc_drop_command(msg->endpoint.device) &&
+                message->code >= COAP_GET && message->code <= COAP_DELETE) {
+              OC_WRN("cannot process new request during closing TLS sessions");
+              goto init_reset_message;
+            }
+            stream.offset = block2_offset;
+            stream.more = false;
+          }
+          stream.buffer = transaction->message->data + COAP_MAX_HEADER_SIZE;
+          stream.buffer_size = block2_size;
+          streaming = true;
+          goto request_handler;
+        }
         if (block1) {
           OC_DBG("processing block1 option");
           request_buffer = oc_blockwise_find_request_buffer(
@@ -657,26 +969,33 @@ coap_receive(oc_message_t *msg)
             OC_DBG("processing incoming block");
             if (oc_blockwise_handle_block(
                   request_buffer, block1_offset, incoming_block,
-                  MIN((uint16_t)incoming_block_len, block1_size))) {
+                  block1_bert
+                    ? incoming_block_len
+                    : MIN((uint16_t)incoming_block_len, block1_size))) {
               if (block1_more) {
                 OC_DBG(
                   "more blocks expected; issuing request for the next block");
                 response->code = CONTINUE_2_31;
-                coap_set_header_block1(response, block1_num, block1_more,
-                                       block1_size);
+                set_header_block1(response, block1_num, block1_more,
+                                  block1_size, block1_bert);
                 request_buffer->ref_count = 1;
                 goto send_message;
               } else {
                 OC_DBG("received all blocks for payload");
-                if (message->type == COAP_TYPE_CON) {
-                  coap_send_empty_response(COAP_TYPE_ACK, message->mid, NULL, 0,
-                                           0, &msg->endpoint);
+#ifdef OC_TCP
+                if (!(msg->endpoint.flags & TCP))
+#endif /* OC_TCP */
+                {
+                  if (message->type == COAP_TYPE_CON) {
+                    coap_send_empty_response(COAP_TYPE_ACK, message->mid, NULL,
+                                             0, 0, &msg->endpoint);
+                  }
+                  coap_udp_init_message(response, COAP_TYPE_CON, CONTENT_2_05,
+                                        coap_get_mid());
+                  coap_transaction_set_mid(transaction, response->mid);
                 }
-                coap_udp_init_message(response, COAP_TYPE_CON, CONTENT_2_05,
-                                      coap_get_mid());
-                transaction->mid = response->mid;
-                coap_set_header_block1(response, block1_num, block1_more,
-                                       block1_size);
+                set_header_block1(response, block1_num, block1_more,
+                                  block1_size, block1_bert);
                 // TODO
                 //                coap_set_header_accept(response,
                 //                APPLICATION_CBOR);
@@ -695,8 +1014,17 @@ coap_receive(oc_message_t *msg)
             href, href_len, &msg->endpoint, message->code, message->uri_query,
             message->uri_query_len, OC_BLOCKWISE_SERVER);
 
+          /* the payload of the requested block */
+          uint32_t block2_payload = block2_size;
+#ifdef OC_TCP
+          if (block2_bert) {
+            block2_payload = MAX(coap_tcp_get_bert_size(&msg->endpoint),
+                                 (uint32_t)COAP_BERT_UNIT_SIZE);
+          }
+#endif /* OC_TCP */
+
           if (response_buffer && (response_buffer->next_block_offset -
-                                  block2_offset) > block2_size) {
+                                  block2_offset) > block2_payload) {
             // UDP transfer can duplicate messages and we want to avoid
             // terminate BWT, so we drop the message.
             OC_DBG("dropped message because message was already provided for "
@@ -709,28 +1037,34 @@ coap_receive(oc_message_t *msg)
             OC_DBG("continuing ongoing block-wise transfer");
             uint32_t payload_size = 0;
             const void *payload = oc_blockwise_dispatch_block(
-              response_buffer, block2_offset, block2_size, &payload_size);
+              response_buffer, block2_offset, block2_payload, &payload_size);
             if (payload) {
               OC_DBG("dispatching next block");
               uint8_t more = (response_buffer->next_block_offset <
                               response_buffer->payload_size)
                                ? 1
                                : 0;
-              if (more == 0) {
-                if (message->type == COAP_TYPE_CON) {
-                  coap_send_empty_response(COAP_TYPE_ACK, message->mid, NULL, 0,
-                                           0, &msg->endpoint);
+#ifdef OC_TCP
+              if (!(msg->endpoint.flags & TCP))
+#endif /* OC_TCP */
+              {
+                if (more == 0) {
+                  if (message->type == COAP_TYPE_CON) {
+                    coap_send_empty_response(COAP_TYPE_ACK, message->mid, NULL,
+                                             0, 0, &msg->endpoint);
+                  }
+                  coap_udp_init_message(response, COAP_TYPE_CON, CONTENT_2_05,
+                                        coap_get_mid());
+                  coap_transaction_set_mid(transaction, response->mid);
+                  // TODO
+                  // coap_set_header_accept(response, APPLICATION_CBOR);
                 }
-                coap_udp_init_message(response, COAP_TYPE_CON, CONTENT_2_05,
-                                      coap_get_mid());
-                transaction->mid = response->mid;
-                // TODO
-                // coap_set_header_accept(response, APPLICATION_CBOR);
               }
               coap_set_header_content_format(
                 response, response_buffer->return_content_type);
               coap_set_payload(response, payload, payload_size);
-              coap_set_header_block2(response, block2_num, more, block2_size);
+              set_header_block2(response, block2_num, more, block2_size,
+                                block2_bert);
               oc_blockwise_response_state_t *response_state =
                 (oc_blockwise_response_state_t *)response_buffer;
               coap_set_header_etag(response, response_state->etag,
@@ -854,9 +1188,9 @@ coap_receive(oc_message_t *msg)
 #endif /* !OC_BLOCK_WISE */
 #ifdef OC_BLOCK_WISE
       request_handler:
-        if (oc_ri_invoke_coap_entity_handler(message, response, &request_buffer,
-                                             &response_buffer, block2_size,
-                                             &msg->endpoint)) {
+        if (oc_ri_invoke_coap_entity_handler(
+              message, response, &request_buffer, &response_buffer,
+              block2_size, streaming ? &stream : NULL, &msg->endpoint)) {
 #else  /* OC_BLOCK_WISE */
         if (oc_ri_invoke_coap_entity_handler(message, response,
                                              transaction->message->data +
@@ -864,39 +1198,91 @@ coap_receive(oc_message_t *msg)
                                              &msg->endpoint)) {
 #endif /* !OC_BLOCK_WISE */
 #ifdef OC_BLOCK_WISE
-          uint32_t payload_size = 0;
-#ifdef OC_TCP
-          if (msg->endpoint.flags & TCP) {
-            const void *payload = oc_blockwise_dispatch_block(
-              response_buffer, 0, response_buffer->payload_size + 1,
-              &payload_size);
-            if (payload && response_buffer->payload_size > 0) {
-              coap_set_payload(response, payload, payload_size);
+          if (streaming) {
+            if (block1 && block1_more) {
+              if (response->code < BAD_REQUEST_4_00) {
+                response->code = CONTINUE_2_31;
+                set_header_block1(response, block1_num, block1_more,
+                                  block1_size, block1_bert);
+              } else {
+                oc_blockwise_free_request_buffer(request_buffer);
+                request_buffer = NULL;
+              }
+            } else {
+              if (block1) {
+                set_header_block1(response, block1_num, 0, block1_size,
+                                  block1_bert);
+              }
+              if (block2 || stream.more) {
+                set_header_block2(response, block2_num, stream.more,
+                                  block2_size, block2_bert);
+              }
             }
-            response_buffer->ref_count = 0;
           } else {
-#endif /* OC_TCP */
-            const void *payload = oc_blockwise_dispatch_block(
-              response_buffer, 0, block2_size, &payload_size);
-            if (payload) {
-              coap_set_payload(response, payload, payload_size);
+            uint32_t payload_size = 0;
+#ifdef OC_TCP
+            /* BERT when the peer asked for it, or when the response does not
+             * fit in a message to the peer */
+            uint32_t bert_size = 0;
+            if (msg->endpoint.flags & TCP) {
+              bert_size = coap_tcp_get_bert_size(&msg->endpoint);
+              if (!block2_bert &&
+                  response_buffer->payload_size <=
+                    coap_tcp_get_max_payload_size(&msg->endpoint)) {
+                bert_size = 0;
+              } else if (block2_bert) {
+                bert_size = MAX(bert_size, (uint32_t)COAP_BERT_UNIT_SIZE);
+              }
             }
-            if (block2 || response_buffer->payload_size > block2_size) {
-              coap_set_header_block2(
-                response, 0,
-                (response_buffer->payload_size > block2_size) ? 1 : 0,
-                block2_size);
+            if (bert_size > 0) {
+              const void *payload = oc_blockwise_dispatch_block(
+                response_buffer, 0, bert_size, &payload_size);
+              if (payload) {
+                coap_set_payload(response, payload, payload_size);
+              }
+              uint8_t more =
+                (response_buffer->payload_size > bert_size) ? 1 : 0;
+              coap_set_header_block2_bert(response, 0, more);
               coap_set_header_size2(response, response_buffer->payload_size);
               oc_blockwise_response_state_t *response_state =
                 (oc_blockwise_response_state_t *)response_buffer;
               coap_set_header_etag(response, response_state->etag,
                                    COAP_ETAG_LEN);
-            } else {
+              if (!more) {
+                response_buffer->ref_count = 0;
+              }
+            } else if (msg->endpoint.flags & TCP) {
+              const void *payload = oc_blockwise_dispatch_block(
+                response_buffer, 0, response_buffer->payload_size + 1,
+                &payload_size);
+              if (payload && response_buffer->payload_size > 0) {
+                coap_set_payload(response, payload, payload_size);
+              }
               response_buffer->ref_count = 0;
-            }
+            } else {
+#endif /* OC_TCP */
+              const void *payload = oc_blockwise_dispatch_block(
+                response_buffer, 0, block2_size, &payload_size);
+              if (payload) {
+                coap_set_payload(response, payload, payload_size);
+              }
+              if (block2 || response_buffer->payload_size > block2_size) {
+                coap_set_header_block2(
+                  response, 0,
+                  (response_buffer->payload_size > block2_size) ? 1 : 0,
+                  block2_size);
+                coap_set_header_size2(response, response_buffer->payload_size);
+                oc_blockwise_response_state_t *response_state =
+                  (oc_blockwise_response_state_t *)response_buffer;
+                coap_set_header_etag(response, response_state->etag,
+                                     COAP_ETAG_LEN);
+              } else {
+                response_buffer->ref_count = 0;
+              }
 #ifdef OC_TCP
-          }
+            }
 #endif /* OC_TCP */
+          }
 #endif /* OC_BLOCK_WISE */
         }
 #ifdef OC_BLOCK_WISE
@@ -962,7 +1348,14 @@ coap_receive(oc_message_t *msg)
         uint32_t payload_size = 0;
         const void *payload = 0;
 
-        if (block1) {
+        if (block1_bert) {
+          /* BERT: the next message continues where the acknowledged one
+           * ended and has the same size */
+          uint32_t next_offset = request_buffer->next_block_offset;
+          payload = oc_blockwise_dispatch_block(
+            request_buffer, next_offset, next_offset - block1_offset,
+            &payload_size);
+        } else if (block1) {
           payload = oc_blockwise_dispatch_block(request_buffer,
                                                 block1_offset + block1_size,
                                                 block1_size, &payload_size);
@@ -983,8 +1376,15 @@ coap_receive(oc_message_t *msg)
           transaction =
             coap_new_transaction(response_mid, NULL, 0, &msg->endpoint);
           if (transaction) {
-            coap_udp_init_message(response, COAP_TYPE_CON, client_cb->method,
-                                  response_mid);
+#ifdef OC_TCP
+            if (msg->endpoint.flags & TCP) {
+              coap_tcp_init_message(response, client_cb->method);
+            } else
+#endif /* OC_TCP */
+            {
+              coap_udp_init_message(response, COAP_TYPE_CON, client_cb->method,
+                                    response_mid);
+            }
             uint8_t more =
               (request_buffer->next_block_offset < request_buffer->payload_size)
                 ? 1
@@ -992,7 +1392,13 @@ coap_receive(oc_message_t *msg)
             coap_set_header_uri_path(response, oc_string(client_cb->uri),
                                      oc_string_len(client_cb->uri));
             coap_set_payload(response, payload, payload_size);
-            if (block1) {
+            if (block1_bert) {
+              coap_set_header_block1_bert(
+                response,
+                (request_buffer->next_block_offset - payload_size) /
+                  COAP_BERT_UNIT_SIZE,
+                more);
+            } else if (block1) {
               coap_set_header_block1(response, block1_num + 1, more,
                                      block1_size);
             } else {
@@ -1005,7 +1411,7 @@ coap_receive(oc_message_t *msg)
             // coap_set_header_accept(response, APPLICATION_CBOR);
             // coap_set_header_content_format(response,
             // APPLICATION_CBOR);
-            request_buffer->mid = response_mid;
+            oc_blockwise_set_mid(request_buffer, response_mid);
             goto send_message;
           }
         } else {
@@ -1029,7 +1435,7 @@ coap_receive(oc_message_t *msg)
           if (response_buffer) {
             OC_DBG("created new response buffer for uri %s",
                    oc_string_checked(response_buffer->href));
-            response_buffer->client_cb = client_cb;
+            oc_blockwise_set_client_cb(response_buffer, client_cb);
           }
         }
       } else {
@@ -1062,16 +1468,30 @@ coap_receive(oc_message_t *msg)
             transaction =
               coap_new_transaction(response_mid, NULL, 0, &msg->endpoint);
             if (transaction) {
-              coap_udp_init_message(response, COAP_TYPE_CON, client_cb->method,
-                                    response_mid);
-              response_buffer->mid = response_mid;
-              client_cb->mid = response_mid;
+#ifdef OC_TCP
+              if (msg->endpoint.flags & TCP) {
+                coap_tcp_init_message(response, client_cb->method);
+              } else
+#endif /* OC_TCP */
+              {
+                coap_udp_init_message(response, COAP_TYPE_CON,
+                                      client_cb->method, response_mid);
+              }
+              oc_blockwise_set_mid(response_buffer, response_mid);
+              oc_ri_client_cb_set_mid(client_cb, response_mid);
               // TODO: This is still wrong - this code is likely to break down
               // when responding to long requests with type
               // application/link-format - the responses are gonna become
               // application/cbor partway through
               coap_set_header_accept(response, APPLICATION_CBOR);
-              coap_set_header_block2(response, block2_num + 1, 0, block2_size);
+              if (block2_bert) {
+                coap_set_header_block2_bert(
+                  response,
+                  response_buffer->next_block_offset / COAP_BERT_UNIT_SIZE, 0);
+              } else {
+                coap_set_header_block2(response, block2_num + 1, 0,
+                                       block2_size);
+              }
               coap_set_header_uri_path(response, oc_string(client_cb->uri),
                                        oc_string_len(client_cb->uri));
               if (oc_string_len(client_cb->query) > 0) {
@@ -1171,13 +1591,12 @@ send_message:
           }
           response->token_len = (uint8_t)i;
           if (request_buffer) {
-            memcpy(request_buffer->token, response->token, response->token_len);
-            request_buffer->token_len = response->token_len;
+            oc_blockwise_set_token(request_buffer, response->token,
+                                   response->token_len);
           }
           if (response_buffer) {
-            memcpy(response_buffer->token, response->token,
-                   response->token_len);
-            response_buffer->token_len = response->token_len;
+            oc_blockwise_set_token(response_buffer, response->token,
+                                   response->token_len);
           }
         } else {
           coap_set_token(response, message->token, message->token_len);
@@ -1186,8 +1605,8 @@ send_message:
 #endif /* OC_CLIENT && OC_BLOCK_WISE */
     }
     if (response->token_len > 0) {
-      memcpy(transaction->token, response->token, response->token_len);
-      transaction->token_len = response->token_len;
+      coap_transaction_set_token(transaction, response->token,
+                                 response->token_len);
     }
     transaction->message->length =
       coap_serialize_message(response, transaction->message->data);
@@ -1220,6 +1639,17 @@ coap_init_engine(void)
   coap_register_as_transaction_handler();
 }
 /*---------------------------------------------------------------------------*/
+#ifdef OC_DIRECT_DISPATCH
+void
+coap_engine_dispatch(oc_message_t *message)
+{
+  OC_PROCESS_CONTEXT_BEGIN(&coap_engine);
+  coap_receive(message);
+  OC_PROCESS_CONTEXT_END(&coap_engine);
+  oc_message_unref(message);
+}
+#endif /* OC_DIRECT_DISPATCH */
+
 OC_PROCESS_THREAD(coap_engine, ev, data)
 {
   OC_PROCESS_BEGIN();
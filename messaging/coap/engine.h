@@ -62,9 +62,55 @@ OC_PROCESS_NAME(coap_engine);
 void coap_init_engine(void);
 /*---------------------------------------------------------------------------*/
 int coap_receive(oc_message_t *message);
+#ifdef OC_DIRECT_DISPATCH
+/**
+ * @brief handle a received message right away, as the coap_engine process
+ * would do for an INBOUND_RI_EVENT
+ *
+ * @param message the message, the reference is released
+ */
+void coap_engine_dispatch(oc_message_t *message);
+#endif /* OC_DIRECT_DISPATCH */
+#ifdef OC_REQUEST_HISTORY
+/**
+ * @brief check if a message with this message ID was received from the
+ * address within EXCHANGE_LIFETIME
+ *
+ * @param mid the message ID
+ * @param device the device index
+ * @param port the port of the sender
+ * @param address the address of the sender
+ * @return true the message is a duplicate
+ */
 bool oc_coap_check_if_duplicate(uint16_t mid, uint8_t device, uint16_t port,
                                 uint8_t address[16]);
 
+/**
+ * @brief check if the message is a duplicate, if not add it to the history
+ *
+ * @param mid the message ID
+ * @param device the device index
+ * @param port the port of the sender
+ * @param address the address of the sender
+ * @return true the message is a duplicate
+ */
+bool oc_coap_check_and_add_to_history(uint16_t mid, uint8_t device,
+                                      uint16_t port, uint8_t address[16]);
+
+/**
+ * @brief number of history entries that were evicted before they expired,
+ * because the history was full
+ *
+ * @return uint32_t the number of evictions
+ */
+uint32_t oc_coap_history_evictions(void);
+
+/**
+ * @brief clear the history and free its memory
+ */
+void oc_coap_free_history(void);
+#endif /* OC_REQUEST_HISTORY */
+
 #ifdef __cplusplus
 }
 #endif
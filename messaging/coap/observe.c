@@ -49,6 +49,7 @@
 
 #ifdef OC_SERVER
 
+#include "coap_index.h"
 #include "observe.h"
 #include "util/oc_memb.h"
 #include <stdio.h>
@@ -74,6 +75,14 @@ int32_t observe_counter = 3;
 OC_LIST(observers_list);
 OC_MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 
+#ifdef OC_DYNAMIC_ALLOCATION
+/* the representation sent to the observers, allocated once */
+static uint8_t *notify_buffer;
+static bool notify_buffer_busy;
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+static oc_event_callback_retval_t notify_observers_pending(void *data);
+
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -139,6 +148,8 @@ add_observer(const oc_resource_t *resource, oc_endpoint_t *endpoint,
            oc_string_checked(o->url), o->token[0], o->token[1]);
 #endif /* !OC_DYNAMIC_ALLOCATION */
     oc_list_add(observers_list, o);
+    coap_index_add(COAP_INDEX_OBSERVER_TOKEN, o->token, o->token_len, o);
+    coap_index_add_mid(COAP_INDEX_OBSERVER_MID, o->last_mid, o);
     return dup;
   }
   OC_WRN("insufficient memory to add new observer");
@@ -173,6 +184,8 @@ coap_remove_observer(coap_observer_t *o)
 #endif /* OC_BLOCK_WISE */
   o->resource->runtime_data->num_observers--;
   oc_free_string(&o->url);
+  coap_index_remove(COAP_INDEX_OBSERVER_TOKEN, o->token, o->token_len, o);
+  coap_index_remove_mid(COAP_INDEX_OBSERVER_MID, o->last_mid, o);
   oc_list_remove(observers_list, o);
   oc_memb_free(&observers_memb, o);
 }
@@ -186,6 +199,11 @@ coap_free_all_observers(void)
     coap_remove_observer(obs);
     obs = next;
   }
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(notify_buffer);
+  notify_buffer = NULL;
+  notify_buffer_busy = false;
+#endif /* OC_DYNAMIC_ALLOCATION */
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -209,6 +227,21 @@ coap_remove_observer_by_client(oc_endpoint_t *endpoint)
   return removed;
 }
 /*---------------------------------------------------------------------------*/
+static bool
+observer_has_endpoint(const void *obj, const void *ctx)
+{
+  return oc_endpoint_compare(&((const coap_observer_t *)obj)->endpoint,
+                             (const oc_endpoint_t *)ctx) == 0;
+}
+
+static void
+observer_set_last_mid(coap_observer_t *obs, uint16_t mid)
+{
+  coap_index_remove_mid(COAP_INDEX_OBSERVER_MID, obs->last_mid, obs);
+  obs->last_mid = mid;
+  coap_index_add_mid(COAP_INDEX_OBSERVER_MID, obs->last_mid, obs);
+}
+/*---------------------------------------------------------------------------*/
 int
 coap_remove_observer_by_token(oc_endpoint_t *endpoint, uint8_t *token,
                               size_t token_len)
@@ -217,6 +250,16 @@ coap_remove_observer_by_token(oc_endpoint_t *endpoint, uint8_t *token,
   coap_observer_t *obs = (coap_observer_t *)oc_list_head(observers_list);
   OC_DBG("Unregistering observers for request token 0x%02X%02X", token[0],
          token[1]);
+  if (coap_index_is_complete()) {
+    obs = coap_index_find(COAP_INDEX_OBSERVER_TOKEN, token, token_len,
+                          observer_has_endpoint, endpoint);
+    if (obs) {
+      coap_remove_observer(obs);
+      removed++;
+    }
+    OC_DBG("Removed %d observers", removed);
+    return removed;
+  }
   while (obs) {
     if (oc_endpoint_compare(&obs->endpoint, endpoint) == 0 &&
         obs->token_len == token_len &&
@@ -238,6 +281,16 @@ coap_remove_observer_by_mid(oc_endpoint_t *endpoint, uint16_t mid)
   coap_observer_t *obs = NULL;
   OC_DBG("Unregistering observers for request MID %u", mid);
 
+  if (coap_index_is_complete()) {
+    obs = coap_index_find(COAP_INDEX_OBSERVER_MID, &mid, sizeof(mid),
+                          observer_has_endpoint, endpoint);
+    if (obs) {
+      coap_remove_observer(obs);
+      removed++;
+    }
+    OC_DBG("Removed %d observers", removed);
+    return removed;
+  }
   for (obs = (coap_observer_t *)oc_list_head(observers_list); obs != NULL;
        obs = obs->next) {
     if (oc_endpoint_compare(&obs->endpoint, endpoint) == 0 &&
@@ -269,6 +322,7 @@ coap_remove_observer_by_resource(const oc_resource_t *rsc)
     }
     obs = next;
   }
+  oc_ri_remove_timed_event_callback((void *)rsc, &notify_observers_pending);
   return removed;
 }
 
@@ -319,6 +373,55 @@ coap_remove_observers_on_dos_change(size_t device, bool reset)
 }
 #endif /* OC_SECURITY */
 
+#ifdef OC_DYNAMIC_ALLOCATION
+static uint8_t *
+notify_buffer_acquire(void)
+{
+  if (notify_buffer_busy) {
+    /* notification from within a notification */
+    return malloc(OC_MAX_OBSERVE_SIZE);
+  }
+  if (!notify_buffer) {
+    notify_buffer = malloc(OC_MAX_OBSERVE_SIZE);
+  }
+  notify_buffer_busy = (notify_buffer != NULL);
+  return notify_buffer;
+}
+
+static void
+notify_buffer_release(uint8_t *buffer)
+{
+  if (buffer && buffer == notify_buffer) {
+    notify_buffer_busy = false;
+  } else {
+    free(buffer);
+  }
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+static oc_event_callback_retval_t
+notify_observers_pending(void *data)
+{
+  coap_notify_observers((const oc_resource_t *)data, NULL, NULL);
+  return OC_EVENT_DONE;
+}
+
+int
+coap_notify_observers_delayed(const oc_resource_t *resource,
+                              oc_clock_time_t delay)
+{
+  if (!resource || resource->runtime_data->num_observers == 0) {
+    return 0;
+  }
+  /* the pending notification encodes the resource when it is sent, so it
+   * reports this change as well */
+  if (!oc_ri_has_timed_event_callback(resource, &notify_observers_pending)) {
+    oc_ri_add_timed_event_callback_ticks((void *)resource,
+                                         &notify_observers_pending, delay);
+  }
+  return resource->runtime_data->num_observers;
+}
+
 int
 coap_notify_observers(const oc_resource_t *resource,
                       oc_response_buffer_t *response_buf,
@@ -328,6 +431,10 @@ coap_notify_observers(const oc_resource_t *resource,
     OC_WRN("coap_notify_observers: no resource passed; returning");
     return 0;
   }
+  if (resource->runtime_data->num_observers == 0) {
+    OC_DBG("coap_notify_observers: no observers");
+    return 0;
+  }
 
 #ifdef OC_SECURITY
   oc_sec_pstat_t *ps = oc_sec_get_pstat(resource->device);
@@ -339,7 +446,7 @@ coap_notify_observers(const oc_resource_t *resource,
 
   // bool resource_is_collection = false;
   coap_observer_t *obs = NULL;
-  if (resource->runtime_data->num_observers > 0) {
+  {
 #ifdef OC_BLOCK_WISE
     oc_blockwise_state_t *response_state = NULL;
 #endif /* OC_BLOCK_WISE */
@@ -347,7 +454,7 @@ coap_notify_observers(const oc_resource_t *resource,
 #ifndef OC_DYNAMIC_ALLOCATION
     uint8_t buffer[OC_MAX_OBSERVE_SIZE];
 #else  /* !OC_DYNAMIC_ALLOCATION */
-    uint8_t *buffer = malloc(OC_MAX_OBSERVE_SIZE);
+    uint8_t *buffer = notify_buffer_acquire();
     if (!buffer) {
       OC_WRN("coap_notify_observers: out of memory allocating buffer");
       goto leave_notify_observers;
@@ -469,6 +576,8 @@ coap_notify_observers(const oc_resource_t *resource,
                   oc_blockwise_free_response_buffer(response_state);
                   response_state = NULL;
                 } else {
+                  /* previous notification still in transfer */
+                  obs = obs->next;
                   continue;
                 }
               }
@@ -533,7 +642,7 @@ coap_notify_observers(const oc_resource_t *resource,
           transaction = coap_new_transaction(coap_get_mid(), obs->token,
                                              obs->token_len, &obs->endpoint);
           if (transaction) {
-            obs->last_mid = transaction->mid;
+            observer_set_last_mid(obs, transaction->mid);
             notification->mid = transaction->mid;
             transaction->message->length =
               coap_serialize_message(notification, transaction->message->data);
@@ -549,13 +658,8 @@ coap_notify_observers(const oc_resource_t *resource,
     } // iterate over observers
   leave_notify_observers:;
 #ifdef OC_DYNAMIC_ALLOCATION
-    if (buffer) {
-      free(buffer);
-    }
+    notify_buffer_release(buffer);
 #endif /* OC_DYNAMIC_ALLOCATION */
-  }    // num_observers > 0
-  else {
-    OC_WRN("coap_notify_observers: no observers");
   }
 
   return resource->runtime_data->num_observers;
@@ -735,7 +839,7 @@ notify_resource_defaults_observer(const oc_resource_t *resource,
         transaction = coap_new_transaction(coap_get_mid(), obs->token,
                                            obs->token_len, &obs->endpoint);
         if (transaction) {
-          obs->last_mid = transaction->mid;
+          observer_set_last_mid(obs, transaction->mid);
           notification->mid = transaction->mid;
           transaction->message->length =
             coap_serialize_message(notification, transaction->message->data);
@@ -57,6 +57,14 @@
 extern "C" {
 #endif
 
+/* changes of a resource within this window are reported to its observers by
+ * one notification, with the representation at the end of the window */
+#ifndef OC_OBSERVE_COALESCE_WINDOW_MS
+#define OC_OBSERVE_COALESCE_WINDOW_MS (0)
+#endif /* OC_OBSERVE_COALESCE_WINDOW_MS */
+#define OC_OBSERVE_COALESCE_WINDOW_TICKS                                       \
+  ((oc_clock_time_t)OC_OBSERVE_COALESCE_WINDOW_MS * OC_CLOCK_SECOND / 1000)
+
 typedef struct coap_observer
 {
   struct coap_observer *next; /* for LIST */
@@ -91,6 +99,10 @@ void coap_free_all_observers(void);
 int coap_notify_observers(const oc_resource_t *resource,
                           oc_response_buffer_t *response_buf,
                           oc_endpoint_t *endpoint);
+/* schedule a notification of the observers of resource after delay ticks,
+ * unless one is pending already; returns the number of observers */
+int coap_notify_observers_delayed(const oc_resource_t *resource,
+                                  oc_clock_time_t delay);
 void notify_resource_defaults_observer(const oc_resource_t *resource,
                                        oc_interface_mask_t iface_mask,
                                        oc_response_buffer_t *response_buf);
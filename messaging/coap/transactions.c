@@ -57,6 +57,8 @@
 #include "oc_blockwise.h"
 #endif /* OC_BLOCK_WISE */
 
+#include "coap_index.h"
+
 #ifdef OC_CLIENT
 #include "oc_client_state.h"
 #endif /* OC_CLIENT */
@@ -103,6 +105,8 @@ coap_new_transaction(uint16_t mid, uint8_t *token, uint8_t token_len,
       oc_list_add(
         transactions_list,
         t); /* list itself makes sure same element is not added twice */
+      coap_index_add_mid(COAP_INDEX_TRANSACTION_MID, t->mid, t);
+      coap_index_add(COAP_INDEX_TRANSACTION_TOKEN, t->token, t->token_len, t);
     } else {
       oc_memb_free(&transactions_memb, t);
       t = NULL;
@@ -217,15 +221,44 @@ coap_clear_transaction(coap_transaction_t *t)
 
     oc_etimer_stop(&t->retrans_timer);
     oc_message_unref(t->message);
+    coap_index_remove_mid(COAP_INDEX_TRANSACTION_MID, t->mid, t);
+    coap_index_remove(COAP_INDEX_TRANSACTION_TOKEN, t->token, t->token_len, t);
     oc_list_remove(transactions_list, t);
     oc_memb_free(&transactions_memb, t);
   }
 }
+
+void
+coap_transaction_set_mid(coap_transaction_t *t, uint16_t mid)
+{
+  coap_index_remove_mid(COAP_INDEX_TRANSACTION_MID, t->mid, t);
+  t->mid = mid;
+  coap_index_add_mid(COAP_INDEX_TRANSACTION_MID, t->mid, t);
+}
+
+void
+coap_transaction_set_token(coap_transaction_t *t, const uint8_t *token,
+                           uint8_t token_len)
+{
+  coap_index_remove(COAP_INDEX_TRANSACTION_TOKEN, t->token, t->token_len, t);
+  memcpy(t->token, token, token_len);
+  t->token_len = token_len;
+  coap_index_add(COAP_INDEX_TRANSACTION_TOKEN, t->token, t->token_len, t);
+}
+
 coap_transaction_t *
 coap_get_transaction_by_mid(uint16_t mid)
 {
   coap_transaction_t *t = NULL;
 
+  if (coap_index_is_complete()) {
+    t = (coap_transaction_t *)coap_index_find(COAP_INDEX_TRANSACTION_MID,
+                                              &mid, sizeof(mid), NULL, NULL);
+    if (t) {
+      OC_DBG("Found transaction for MID %u: %p", t->mid, (void *)t);
+    }
+    return t;
+  }
   for (t = (coap_transaction_t *)oc_list_head(transactions_list); t;
        t = t->next) {
     if (t->mid == mid) {
@@ -241,6 +274,14 @@ coap_get_transaction_by_token(uint8_t *token, uint8_t token_len)
 {
   coap_transaction_t *t = NULL;
 
+  if (coap_index_is_complete()) {
+    t = (coap_transaction_t *)coap_index_find(
+      COAP_INDEX_TRANSACTION_TOKEN, token, token_len, NULL, NULL);
+    if (t) {
+      OC_DBG("Found transaction by token %p", (void *)t);
+    }
+    return t;
+  }
   for (t = (coap_transaction_t *)oc_list_head(transactions_list); t;
        t = t->next) {
     if (t->token_len == token_len && memcmp(t->token, token, token_len) == 0) {
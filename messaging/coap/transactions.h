@@ -90,6 +90,11 @@ coap_transaction_t *coap_new_transaction(uint16_t mid, uint8_t *token,
 
 void coap_send_transaction(coap_transaction_t *t);
 void coap_clear_transaction(coap_transaction_t *t);
+
+/* change the MID or token of a transaction, keeping the index up to date */
+void coap_transaction_set_mid(coap_transaction_t *t, uint16_t mid);
+void coap_transaction_set_token(coap_transaction_t *t, const uint8_t *token,
+                                uint8_t token_len);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
 coap_transaction_t *coap_get_transaction_by_token(uint8_t *token,
                                                   uint8_t token_len);
@@ -19,11 +19,22 @@
  ******************************************************************/
 
 #include "coap.h"
+#include "coap_index.h"
 #include "coap_signal.h"
+#include "engine.h"
+#include "observe.h"
 #include "oc_api.h"
+#include "oc_buffer.h"
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <poll.h>
 #include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
 
 #ifdef OC_TCP
 
@@ -791,4 +802,978 @@ TEST_F(TestCoapSignal, SignalSerializeParseTest_ABORT)
   ASSERT_STREQ(diagnostic, (char *)parse_packet->payload);
 }
 
+TEST_F(TestCoapSignal, SerializeParseTest_BERT)
+{
+  coap_packet_t packet[1] = { {
+    0,
+  } };
+  coap_tcp_init_message(packet, COAP_PUT);
+
+  static uint8_t payload[2 * COAP_BERT_UNIT_SIZE];
+  coap_set_payload(packet, payload, sizeof(payload));
+  coap_set_header_block1_bert(packet, 6, 1);
+  coap_set_header_block2_bert(packet, 0, 0);
+
+  static uint8_t buffer[sizeof(payload) + COAP_MAX_HEADER_SIZE];
+  size_t buffer_len = coap_serialize_message(packet, buffer);
+
+  coap_packet_t parse_packet[1];
+  coap_status_t ret = coap_tcp_parse_message(parse_packet, buffer, buffer_len);
+
+  ASSERT_EQ(COAP_NO_ERROR, ret);
+  ASSERT_EQ(1, coap_get_header_block1_bert(parse_packet));
+  ASSERT_EQ(1, coap_get_header_block2_bert(parse_packet));
+  uint32_t num = 0, offset = 0;
+  uint8_t more = 0;
+  uint16_t size = 0;
+  coap_get_header_block1(parse_packet, &num, &more, &size, &offset);
+  ASSERT_EQ(6u, num);
+  ASSERT_EQ(1, more);
+  ASSERT_EQ(COAP_BERT_UNIT_SIZE, size);
+  ASSERT_EQ(6u * COAP_BERT_UNIT_SIZE, offset);
+  ASSERT_EQ(sizeof(payload), parse_packet->payload_len);
+}
+
 #endif /* OC_TCP */
+
+TEST(TestCoapFrameTemplate, SameAsSerializedMessage)
+{
+  uint8_t token[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  uint8_t payload[] = { 0xa1, 0x01, 0x02 };
+
+  coap_packet_t packet[1];
+  coap_udp_init_message(packet, COAP_TYPE_NON, COAP_POST, 0x1234);
+  coap_set_header_accept(packet, APPLICATION_CBOR);
+  coap_set_header_uri_path(packet, "/k", 2);
+  coap_set_header_content_format(packet, APPLICATION_CBOR);
+  coap_set_token(packet, token, sizeof(token));
+  coap_set_payload(packet, payload, sizeof(payload));
+  uint8_t expected[COAP_MAX_HEADER_SIZE + sizeof(payload)];
+  size_t expected_len = coap_serialize_message(packet, expected);
+  ASSERT_LT(0u, expected_len);
+
+  const coap_frame_template_t *frame = coap_get_frame_template(
+    COAP_TYPE_NON, COAP_POST, "/k", 2, APPLICATION_CBOR);
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(frame, coap_get_frame_template(COAP_TYPE_NON, COAP_POST, "/k", 2,
+                                           APPLICATION_CBOR));
+  uint8_t buffer[COAP_MAX_HEADER_SIZE + sizeof(payload)];
+  memcpy(buffer + COAP_MAX_HEADER_SIZE, payload, sizeof(payload));
+  size_t len = coap_serialize_frame(frame, 0x1234, token, sizeof(token),
+                                    buffer + COAP_MAX_HEADER_SIZE,
+                                    sizeof(payload), buffer);
+  ASSERT_EQ(expected_len, len);
+  EXPECT_EQ(0, memcmp(expected, buffer, len));
+}
+
+#ifdef OC_REQUEST_HISTORY
+TEST(TestCoapHistory, DuplicateDetection)
+{
+  uint8_t address[16] = { 0xfd, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                          0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
+  oc_coap_free_history();
+  EXPECT_FALSE(oc_coap_check_if_duplicate(1, 0, 5683, address));
+  EXPECT_FALSE(oc_coap_check_and_add_to_history(1, 0, 5683, address));
+  EXPECT_TRUE(oc_coap_check_if_duplicate(1, 0, 5683, address));
+  EXPECT_TRUE(oc_coap_check_and_add_to_history(1, 0, 5683, address));
+  // other message ID, port, device or address
+  EXPECT_FALSE(oc_coap_check_and_add_to_history(2, 0, 5683, address));
+  EXPECT_FALSE(oc_coap_check_and_add_to_history(1, 0, 5684, address));
+  EXPECT_FALSE(oc_coap_check_and_add_to_history(1, 1, 5683, address));
+  address[15] = 0x02;
+  EXPECT_FALSE(oc_coap_check_and_add_to_history(1, 0, 5683, address));
+  EXPECT_EQ(0u, oc_coap_history_evictions());
+  oc_coap_free_history();
+  EXPECT_FALSE(oc_coap_check_if_duplicate(1, 0, 5683, address));
+}
+
+TEST(TestCoapHistory, ManyRequests)
+{
+  uint8_t address[16] = { 0 };
+  oc_coap_free_history();
+  for (uint16_t mid = 0; mid < 1000; mid++) {
+    EXPECT_FALSE(oc_coap_check_and_add_to_history(mid, 0, 5683, address));
+  }
+  // all entries are still within EXCHANGE_LIFETIME
+  uint16_t found = 0;
+  for (uint16_t mid = 0; mid < 1000; mid++) {
+    if (oc_coap_check_if_duplicate(mid, 0, 5683, address)) {
+      found++;
+    }
+  }
+  EXPECT_EQ(1000u - oc_coap_history_evictions(), (uint32_t)found);
+  oc_coap_free_history();
+}
+#endif /* OC_REQUEST_HISTORY */
+
+TEST(TestCoapIndex, AddFindRemove)
+{
+  int a = 0, b = 0;
+  uint16_t mid = 42;
+  uint8_t token[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+  EXPECT_TRUE(coap_index_add_mid(COAP_INDEX_TRANSACTION_MID, mid, &a));
+  EXPECT_TRUE(coap_index_add_mid(COAP_INDEX_TRANSACTION_MID, mid, &b));
+  EXPECT_TRUE(
+    coap_index_add(COAP_INDEX_CLIENT_CB_TOKEN, token, sizeof(token), &b));
+  // the object added first is returned
+  EXPECT_EQ(&a, coap_index_find(COAP_INDEX_TRANSACTION_MID, &mid, sizeof(mid),
+                                NULL, NULL));
+  // the kind is part of the key
+  EXPECT_EQ(NULL, coap_index_find(COAP_INDEX_CLIENT_CB_MID, &mid, sizeof(mid),
+                                  NULL, NULL));
+  EXPECT_EQ(&b, coap_index_find(COAP_INDEX_CLIENT_CB_TOKEN, token,
+                                sizeof(token), NULL, NULL));
+  EXPECT_EQ(NULL, coap_index_find(COAP_INDEX_CLIENT_CB_TOKEN, token,
+                                  sizeof(token) - 1, NULL, NULL));
+
+  coap_index_remove_mid(COAP_INDEX_TRANSACTION_MID, mid, &a);
+  EXPECT_EQ(&b, coap_index_find(COAP_INDEX_TRANSACTION_MID, &mid, sizeof(mid),
+                                NULL, NULL));
+  coap_index_remove_mid(COAP_INDEX_TRANSACTION_MID, mid, &b);
+  coap_index_remove(COAP_INDEX_CLIENT_CB_TOKEN, token, sizeof(token), &b);
+  EXPECT_EQ(NULL, coap_index_find(COAP_INDEX_TRANSACTION_MID, &mid,
+                                  sizeof(mid), NULL, NULL));
+  EXPECT_TRUE(coap_index_is_complete());
+}
+
+#if defined(OC_BLOCK_WISE) && defined(OC_SERVER)
+#define STREAM_URI "stream"
+#define STREAM_BLOCK_SIZE (64)
+#define STREAM_BODY_SIZE (150)
+
+typedef struct stream_block_t
+{
+  uint32_t offset;
+  size_t length;
+  bool more;
+} stream_block_t;
+
+static int stream_sock = -1;
+static oc_endpoint_t stream_peer;
+static std::vector<stream_block_t> stream_blocks;
+static uint8_t stream_body[STREAM_BODY_SIZE];
+
+static void
+stream_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
+                    void *data)
+{
+  (void)iface_mask;
+  (void)data;
+  stream_blocks.push_back(
+    { request->block_offset, request->_payload_len, request->block_more });
+  oc_send_response_no_format(request, OC_STATUS_CHANGED);
+}
+
+static void
+stream_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
+                   void *data)
+{
+  (void)iface_mask;
+  (void)data;
+  size_t offset = request->block_offset;
+  size_t length = request->response->response_buffer->buffer_size;
+  if (offset >= STREAM_BODY_SIZE) {
+    oc_send_response_no_format(request, OC_STATUS_BAD_REQUEST);
+    return;
+  }
+  if (length > STREAM_BODY_SIZE - offset) {
+    length = STREAM_BODY_SIZE - offset;
+  }
+  request->block_more = offset + length < STREAM_BODY_SIZE;
+  stream_blocks.push_back({ request->block_offset, length, false });
+  oc_send_response_raw(request, stream_body + offset, length,
+                       APPLICATION_OCTET_STREAM, OC_STATUS_OK);
+}
+
+static int
+stream_app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("myhname", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+stream_register_resources(void)
+{
+  oc_resource_t *resource = oc_new_resource(NULL, "/" STREAM_URI, 1, 0);
+  oc_resource_bind_resource_type(resource, "urn:knx:test.stream");
+  oc_resource_bind_resource_interface(resource, OC_IF_C);
+  oc_resource_set_block_stream(resource, true);
+  oc_resource_set_request_handler(resource, OC_GET, stream_get_handler, NULL);
+  oc_resource_set_request_handler(resource, OC_POST, stream_post_handler,
+                                  NULL);
+  oc_add_resource(resource);
+}
+
+static void
+stream_signal_event_loop(void)
+{
+}
+
+static oc_handler_t stream_handler = {
+  .init = stream_app_init,
+  .signal_event_loop = stream_signal_event_loop,
+  .register_resources = stream_register_resources,
+  .requests_entry = NULL
+};
+
+class TestCoapBlockStream : public testing::Test {
+protected:
+  static void SetUpTestCase()
+  {
+    for (size_t i = 0; i < sizeof(stream_body); i++) {
+      stream_body[i] = (uint8_t)i;
+    }
+    ASSERT_EQ(0, oc_main_init(&stream_handler));
+
+    // the responses are sent to this socket
+    stream_sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    ASSERT_LE(0, stream_sock);
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    ASSERT_EQ(0, bind(stream_sock, (struct sockaddr *)&addr, sizeof(addr)));
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0,
+              getsockname(stream_sock, (struct sockaddr *)&addr, &addr_len));
+
+    // requests are handed to the engine as if they had been decrypted, the
+    // responses are sent as if they had been encrypted already
+    memset(&stream_peer, 0, sizeof(stream_peer));
+    stream_peer.flags = (enum transport_flags)(IPV6 | OSCORE |
+                                               OSCORE_DECRYPTED |
+                                               OSCORE_ENCRYPTED);
+    memcpy(stream_peer.addr.ipv6.address, &in6addr_loopback,
+           sizeof(stream_peer.addr.ipv6.address));
+    stream_peer.addr.ipv6.port = ntohs(addr.sin6_port);
+    stream_peer.device = 0;
+  }
+
+  static void TearDownTestCase()
+  {
+    if (stream_sock >= 0) {
+      close(stream_sock);
+      stream_sock = -1;
+    }
+    oc_main_shutdown();
+  }
+
+  void SetUp() override { stream_blocks.clear(); }
+};
+
+typedef struct stream_response_t
+{
+  uint8_t data[2048];
+  coap_packet_t packet[1];
+} stream_response_t;
+
+// hand a CON request to the engine and wait for the response to it
+static bool
+stream_exchange(uint8_t code, uint16_t mid, bool block1, uint32_t num,
+                uint8_t more, const uint8_t *payload, size_t payload_len,
+                stream_response_t *response)
+{
+  uint8_t token[] = { 0x51, 0x52, 0x53, 0x54 };
+  coap_packet_t request[1];
+  coap_udp_init_message(request, COAP_TYPE_CON, code, mid);
+  coap_set_token(request, token, sizeof(token));
+  coap_set_header_uri_path(request, STREAM_URI, strlen(STREAM_URI));
+  if (block1) {
+    coap_set_header_block1(request, num, more, STREAM_BLOCK_SIZE);
+    coap_set_header_content_format(request, APPLICATION_OCTET_STREAM);
+    coap_set_payload(request, payload, payload_len);
+  } else {
+    coap_set_header_block2(request, num, 0, STREAM_BLOCK_SIZE);
+  }
+
+  oc_message_t *message = oc_allocate_message();
+  if (message == NULL) {
+    return false;
+  }
+  message->endpoint = stream_peer;
+  message->length = coap_serialize_message(request, message->data);
+  coap_receive(message);
+  oc_message_unref(message);
+
+  for (int i = 0; i < 100; i++) {
+    oc_main_poll();
+    struct pollfd fd = { stream_sock, POLLIN, 0 };
+    if (poll(&fd, 1, 10) <= 0) {
+      continue;
+    }
+    ssize_t len =
+      recv(stream_sock, response->data, sizeof(response->data), 0);
+    return len > 0 &&
+           coap_udp_parse_message(response->packet, response->data,
+                                  (uint16_t)len) == COAP_NO_ERROR &&
+           response->packet->mid == mid;
+  }
+  return false;
+}
+
+TEST_F(TestCoapBlockStream, Block1InOrder)
+{
+  uint8_t payload[3 * STREAM_BLOCK_SIZE] = { 0 };
+  stream_response_t response;
+  uint32_t num;
+  uint8_t more;
+  uint16_t size;
+  uint32_t offset;
+
+  for (uint32_t i = 0; i < 2; i++) {
+    ASSERT_TRUE(stream_exchange(COAP_POST, (uint16_t)(0x100 + i), true, i, 1,
+                                payload + i * STREAM_BLOCK_SIZE,
+                                STREAM_BLOCK_SIZE, &response));
+    EXPECT_EQ(CONTINUE_2_31, response.packet->code);
+    ASSERT_TRUE(
+      coap_get_header_block1(response.packet, &num, &more, &size, &offset));
+    EXPECT_EQ(i, num);
+    EXPECT_EQ(1, more);
+  }
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x102, true, 2, 0,
+                              payload + 2 * STREAM_BLOCK_SIZE, 10, &response));
+  EXPECT_EQ(CHANGED_2_04, response.packet->code);
+  ASSERT_TRUE(
+    coap_get_header_block1(response.packet, &num, &more, &size, &offset));
+  EXPECT_EQ(2u, num);
+  EXPECT_EQ(0, more);
+
+  // every block is handed to the resource once, at its offset
+  ASSERT_EQ(3u, stream_blocks.size());
+  for (uint32_t i = 0; i < 3; i++) {
+    EXPECT_EQ(i * STREAM_BLOCK_SIZE, stream_blocks[i].offset);
+    EXPECT_EQ(i < 2 ? (size_t)STREAM_BLOCK_SIZE : 10u,
+              stream_blocks[i].length);
+    EXPECT_EQ(i < 2, stream_blocks[i].more);
+  }
+}
+
+TEST_F(TestCoapBlockStream, Block1Duplicate)
+{
+  uint8_t payload[2 * STREAM_BLOCK_SIZE] = { 0 };
+  stream_response_t response;
+
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x200, true, 0, 1, payload,
+                              STREAM_BLOCK_SIZE, &response));
+  EXPECT_EQ(CONTINUE_2_31, response.packet->code);
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x201, true, 1, 1,
+                              payload + STREAM_BLOCK_SIZE, STREAM_BLOCK_SIZE,
+                              &response));
+  EXPECT_EQ(CONTINUE_2_31, response.packet->code);
+
+  // a retransmitted block is acknowledged, but not handed over again
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x200, true, 0, 1, payload,
+                              STREAM_BLOCK_SIZE, &response));
+  EXPECT_EQ(CONTINUE_2_31, response.packet->code);
+  EXPECT_EQ(2u, stream_blocks.size());
+
+  // the transfer continues after the duplicate
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x202, true, 2, 0, payload, 1,
+                              &response));
+  EXPECT_EQ(CHANGED_2_04, response.packet->code);
+  ASSERT_EQ(3u, stream_blocks.size());
+  EXPECT_EQ(2u * STREAM_BLOCK_SIZE, stream_blocks[2].offset);
+}
+
+TEST_F(TestCoapBlockStream, Block1GapAborts)
+{
+  uint8_t payload[STREAM_BLOCK_SIZE] = { 0 };
+  stream_response_t response;
+
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x300, true, 0, 1, payload,
+                              sizeof(payload), &response));
+  EXPECT_EQ(CONTINUE_2_31, response.packet->code);
+
+  // block 1 is missing
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x302, true, 2, 1, payload,
+                              sizeof(payload), &response));
+  EXPECT_EQ(COAP_TYPE_RST, response.packet->type);
+
+  // the transfer has been dropped, the missing block comes too late
+  ASSERT_TRUE(stream_exchange(COAP_POST, 0x301, true, 1, 1, payload,
+                              sizeof(payload), &response));
+  EXPECT_EQ(COAP_TYPE_RST, response.packet->type);
+  ASSERT_EQ(1u, stream_blocks.size());
+  EXPECT_EQ(0u, stream_blocks[0].offset);
+}
+
+TEST_F(TestCoapBlockStream, Block2More)
+{
+  stream_response_t response;
+  uint32_t num;
+  uint8_t more;
+  uint16_t size;
+  uint32_t offset;
+  std::vector<uint8_t> body;
+
+  for (uint32_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(stream_exchange(COAP_GET, (uint16_t)(0x400 + i), false, i, 0,
+                                NULL, 0, &response));
+    EXPECT_EQ(CONTENT_2_05, response.packet->code);
+    ASSERT_TRUE(
+      coap_get_header_block2(response.packet, &num, &more, &size, &offset));
+    EXPECT_EQ(i, num);
+    EXPECT_EQ(STREAM_BLOCK_SIZE, size);
+    // the handler tells whether the response continues
+    EXPECT_EQ(i < 2 ? 1 : 0, more);
+    const uint8_t *payload;
+    int payload_len = coap_get_payload(response.packet, &payload);
+    body.insert(body.end(), payload, payload + payload_len);
+  }
+  ASSERT_EQ((size_t)STREAM_BODY_SIZE, body.size());
+  EXPECT_EQ(0, memcmp(stream_body, body.data(), body.size()));
+  ASSERT_EQ(3u, stream_blocks.size());
+  EXPECT_EQ(2u * STREAM_BLOCK_SIZE, stream_blocks[2].offset);
+}
+#endif /* OC_BLOCK_WISE && OC_SERVER */
+
+#ifdef OC_SERVER
+#define OBSERVED_URI "observed"
+// the changes within this many ticks are coalesced
+#define NOTIFY_DELAY (OC_CLOCK_SECOND / 10)
+
+static oc_resource_t *observed_resource;
+static uint8_t observed_state;
+static int observed_gets;
+static int observer_sock = -1;
+static oc_endpoint_t observer;
+
+static void
+observed_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
+                     void *data)
+{
+  (void)iface_mask;
+  (void)data;
+  observed_gets++;
+  oc_send_response_raw(request, &observed_state, sizeof(observed_state),
+                       APPLICATION_OCTET_STREAM, OC_STATUS_OK);
+}
+
+static int
+observed_app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("myhname", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+observed_register_resources(void)
+{
+  observed_resource = oc_new_resource(NULL, "/" OBSERVED_URI, 1, 0);
+  oc_resource_bind_resource_type(observed_resource, "urn:knx:test.observed");
+  oc_resource_bind_resource_interface(observed_resource, OC_IF_C);
+  oc_resource_set_observable(observed_resource, true);
+  oc_resource_set_request_handler(observed_resource, OC_GET,
+                                  observed_get_handler, NULL);
+  oc_add_resource(observed_resource);
+}
+
+static void
+observed_signal_event_loop(void)
+{
+}
+
+static oc_handler_t observed_handler = {
+  .init = observed_app_init,
+  .signal_event_loop = observed_signal_event_loop,
+  .register_resources = observed_register_resources,
+  .requests_entry = NULL
+};
+
+class TestCoapNotifyDelayed : public testing::Test {
+protected:
+  static void SetUpTestCase()
+  {
+    ASSERT_EQ(0, oc_main_init(&observed_handler));
+    ASSERT_NE(nullptr, observed_resource);
+
+    // the notifications are sent to this socket
+    observer_sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    ASSERT_LE(0, observer_sock);
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    ASSERT_EQ(0, bind(observer_sock, (struct sockaddr *)&addr, sizeof(addr)));
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0,
+              getsockname(observer_sock, (struct sockaddr *)&addr, &addr_len));
+
+    // the notifications are sent as if they had been encrypted already
+    memset(&observer, 0, sizeof(observer));
+    observer.flags = (enum transport_flags)(IPV6 | OSCORE | OSCORE_DECRYPTED |
+                                            OSCORE_ENCRYPTED);
+    memcpy(observer.addr.ipv6.address, &in6addr_loopback,
+           sizeof(observer.addr.ipv6.address));
+    observer.addr.ipv6.port = ntohs(addr.sin6_port);
+    observer.device = 0;
+  }
+
+  static void TearDownTestCase()
+  {
+    if (observer_sock >= 0) {
+      close(observer_sock);
+      observer_sock = -1;
+    }
+    oc_main_shutdown();
+  }
+
+  void SetUp() override
+  {
+    observed_state = 0;
+    observed_gets = 0;
+  }
+
+  void TearDown() override
+  {
+    // let a pending notification go before the observer is removed
+    wait_for_notifications(2 * NOTIFY_DELAY, NULL);
+    coap_remove_observer_by_resource(observed_resource);
+  }
+
+  // registers the observer as a GET with Observe 0 would
+  static void add_observer(void)
+  {
+    uint8_t token[] = { 0x71, 0x72, 0x73, 0x74 };
+    coap_packet_t request[1];
+    coap_udp_init_message(request, COAP_TYPE_CON, COAP_GET, 0x500);
+    coap_set_token(request, token, sizeof(token));
+    coap_set_header_uri_path(request, OBSERVED_URI, strlen(OBSERVED_URI));
+    coap_set_header_observe(request, 0);
+    coap_packet_t response[1];
+    coap_udp_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, 0x500);
+#ifdef OC_BLOCK_WISE
+    coap_observe_handler(request, response, observed_resource,
+                         (uint16_t)OC_BLOCK_SIZE, &observer, OC_IF_C);
+#else  /* OC_BLOCK_WISE */
+    coap_observe_handler(request, response, observed_resource, &observer,
+                         OC_IF_C);
+#endif /* !OC_BLOCK_WISE */
+  }
+
+  // runs the stack for the given ticks, collecting the notification payloads
+  static void wait_for_notifications(oc_clock_time_t ticks,
+                                     std::vector<uint8_t> *states)
+  {
+    oc_clock_time_t end = oc_clock_time() + ticks;
+    while (oc_clock_time() < end) {
+      oc_main_poll();
+      struct pollfd fd = { observer_sock, POLLIN, 0 };
+      if (poll(&fd, 1, 5) <= 0) {
+        continue;
+      }
+      uint8_t data[256];
+      ssize_t len = recv(observer_sock, data, sizeof(data), 0);
+      if (len <= 0) {
+        continue;
+      }
+      coap_packet_t notification[1];
+      if (coap_udp_parse_message(notification, data, (uint16_t)len) !=
+          COAP_NO_ERROR) {
+        continue;
+      }
+      const uint8_t *payload;
+      int payload_len = coap_get_payload(notification, &payload);
+      if (states && payload_len == 1) {
+        states->push_back(payload[0]);
+      }
+    }
+  }
+};
+
+TEST_F(TestCoapNotifyDelayed, CoalescesChanges)
+{
+  add_observer();
+  ASSERT_EQ(1, observed_resource->runtime_data->num_observers);
+
+  // three changes within the delay
+  for (uint8_t state = 1; state <= 3; state++) {
+    observed_state = state;
+    EXPECT_EQ(1, coap_notify_observers_delayed(observed_resource,
+                                                NOTIFY_DELAY));
+  }
+  EXPECT_EQ(0, observed_gets);
+
+  // one notification, with the state at the end of the delay
+  std::vector<uint8_t> states;
+  wait_for_notifications(3 * NOTIFY_DELAY, &states);
+  EXPECT_EQ(1, observed_gets);
+  ASSERT_EQ(1u, states.size());
+  EXPECT_EQ(3, states[0]);
+
+  // a later change is notified again
+  observed_state = 4;
+  EXPECT_EQ(1, coap_notify_observers_delayed(observed_resource, NOTIFY_DELAY));
+  states.clear();
+  wait_for_notifications(3 * NOTIFY_DELAY, &states);
+  ASSERT_EQ(1u, states.size());
+  EXPECT_EQ(4, states[0]);
+}
+
+TEST_F(TestCoapNotifyDelayed, NoObservers)
+{
+  ASSERT_EQ(0, observed_resource->runtime_data->num_observers);
+  observed_state = 1;
+  EXPECT_EQ(0, coap_notify_observers_delayed(observed_resource, NOTIFY_DELAY));
+  EXPECT_EQ(0, coap_notify_observers_delayed(NULL, NOTIFY_DELAY));
+
+  // nothing was scheduled: an observer added now is not notified
+  add_observer();
+  std::vector<uint8_t> states;
+  wait_for_notifications(3 * NOTIFY_DELAY, &states);
+  EXPECT_EQ(0, observed_gets);
+  EXPECT_TRUE(states.empty());
+}
+#endif /* OC_SERVER */
+
+#if defined(OC_TCP) && defined(OC_BLOCK_WISE) && defined(OC_SERVER)
+#define BERT_URI "bert"
+#define BERT_UNIT (COAP_BERT_UNIT_SIZE)
+// sent in messages of two units, the last one is not a multiple of the unit
+#define BERT_BODY_SIZE (4 * BERT_UNIT + 300)
+// the peer takes two units in a message, with room for the headers
+#define BERT_MAX_MESSAGE_SIZE (2 * BERT_UNIT + 2 * COAP_MAX_HEADER_SIZE)
+
+static std::vector<uint8_t> bert_received;
+static uint8_t bert_body[BERT_BODY_SIZE];
+
+static void
+bert_post_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
+                  void *data)
+{
+  (void)iface_mask;
+  (void)data;
+  const uint8_t *payload = NULL;
+  size_t len = 0;
+  oc_content_format_t content_format;
+  bert_received.clear();
+  if (oc_get_request_payload_raw(request, &payload, &len, &content_format)) {
+    bert_received.assign(payload, payload + len);
+  }
+  oc_send_response_no_format(request, OC_STATUS_CHANGED);
+}
+
+static void
+bert_get_handler(oc_request_t *request, oc_interface_mask_t iface_mask,
+                 void *data)
+{
+  (void)iface_mask;
+  (void)data;
+  oc_send_response_raw(request, bert_body, sizeof(bert_body),
+                       APPLICATION_OCTET_STREAM, OC_STATUS_OK);
+}
+
+static int
+bert_app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("myhname", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+bert_register_resources(void)
+{
+  oc_resource_t *resource = oc_new_resource(NULL, "/" BERT_URI, 1, 0);
+  oc_resource_bind_resource_type(resource, "urn:knx:test.bert");
+  oc_resource_bind_resource_interface(resource, OC_IF_C);
+  oc_resource_set_request_handler(resource, OC_GET, bert_get_handler, NULL);
+  oc_resource_set_request_handler(resource, OC_POST, bert_post_handler, NULL);
+  oc_add_resource(resource);
+}
+
+static void
+bert_signal_event_loop(void)
+{
+}
+
+static oc_handler_t bert_handler = { .init = bert_app_init,
+                                     .signal_event_loop =
+                                       bert_signal_event_loop,
+                                     .register_resources =
+                                       bert_register_resources,
+                                     .requests_entry = NULL };
+
+typedef struct bert_response_t
+{
+  uint8_t data[BERT_BODY_SIZE + 2 * COAP_MAX_HEADER_SIZE];
+  coap_packet_t packet[1];
+} bert_response_t;
+
+class TestCoapBert : public testing::Test {
+protected:
+  static void SetUpTestCase()
+  {
+    for (size_t i = 0; i < sizeof(bert_body); i++) {
+      bert_body[i] = (uint8_t)(i * 13 + 1);
+    }
+    ASSERT_EQ(0, oc_main_init(&bert_handler));
+  }
+
+  static void TearDownTestCase() { oc_main_shutdown(); }
+
+  // the peer listens, the engine connects to it to send the responses
+  void SetUp() override
+  {
+    bert_received.clear();
+    rx.clear();
+    peer_sock = -1;
+    listen_sock = socket(AF_INET6, SOCK_STREAM, 0);
+    ASSERT_LE(0, listen_sock);
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    ASSERT_EQ(0, bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)));
+    ASSERT_EQ(0, listen(listen_sock, 1));
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0,
+              getsockname(listen_sock, (struct sockaddr *)&addr, &addr_len));
+
+    // requests are handed to the engine as if they had been decrypted, the
+    // responses are sent as if they had been encrypted already
+    memset(&peer, 0, sizeof(peer));
+#ifdef OC_OSCORE
+    peer.flags = (enum transport_flags)(IPV6 | TCP | OSCORE | OSCORE_DECRYPTED |
+                                        OSCORE_ENCRYPTED);
+#else  /* OC_OSCORE */
+    peer.flags = (enum transport_flags)(IPV6 | TCP);
+#endif /* !OC_OSCORE */
+    memcpy(peer.addr.ipv6.address, &in6addr_loopback,
+           sizeof(peer.addr.ipv6.address));
+    peer.addr.ipv6.port = ntohs(addr.sin6_port);
+    peer.device = 0;
+  }
+
+  void TearDown() override
+  {
+    if (peer_sock >= 0) {
+      close(peer_sock);
+    }
+    close(listen_sock);
+    // the engine sees the connection close
+    for (int i = 0; i < 10; i++) {
+      oc_main_poll();
+      usleep(1000);
+    }
+  }
+
+  // the engine opens the connection, then the peer sends its CSM
+  void connect_peer(bool bert)
+  {
+    ASSERT_EQ(1, coap_send_csm_message(&peer, OC_PDU_SIZE, 1));
+    oc_main_poll();
+    struct pollfd fd = { listen_sock, POLLIN, 0 };
+    ASSERT_EQ(1, poll(&fd, 1, 1000));
+    peer_sock = accept(listen_sock, NULL, NULL);
+    ASSERT_LE(0, peer_sock);
+
+    coap_packet_t csm[1];
+    coap_tcp_init_message(csm, CSM_7_01);
+    coap_signal_set_max_msg_size(csm, BERT_MAX_MESSAGE_SIZE);
+    if (bert) {
+      coap_signal_set_blockwise_transfer(csm, 1);
+    }
+    deliver(csm);
+    uint32_t max_message_size = 0;
+    bool peer_bert = !bert;
+    ASSERT_EQ(0, oc_tcp_get_csm_options(&peer, &max_message_size, &peer_bert));
+    EXPECT_EQ((uint32_t)BERT_MAX_MESSAGE_SIZE, max_message_size);
+    EXPECT_EQ(bert, peer_bert);
+  }
+
+  static void init_request(coap_packet_t *request, uint8_t code, uint8_t id)
+  {
+    uint8_t token[] = { 0x61, 0x62, 0x63, id };
+    coap_tcp_init_message(request, code);
+    coap_set_token(request, token, sizeof(token));
+    coap_set_header_uri_path(request, BERT_URI, strlen(BERT_URI));
+  }
+
+  void deliver(coap_packet_t *packet)
+  {
+    oc_message_t *message = oc_allocate_message();
+    ASSERT_NE(nullptr, message);
+    message->endpoint = peer;
+    message->length = coap_serialize_message(packet, message->data);
+    coap_receive(message);
+    oc_message_unref(message);
+  }
+
+  // takes the next complete message off the connection
+  bool next_message(bert_response_t *response)
+  {
+    if (rx.size() < 5) {
+      return false;
+    }
+    size_t size = coap_tcp_get_packet_size(rx.data());
+    if (rx.size() < size || size > sizeof(response->data)) {
+      return false;
+    }
+    memcpy(response->data, rx.data(), size);
+    rx.erase(rx.begin(), rx.begin() + size);
+    return coap_tcp_parse_message(response->packet, response->data,
+                                  (uint32_t)size) == COAP_NO_ERROR;
+  }
+
+  // hand a request to the engine and wait for the response to it, the
+  // signal messages of the engine are skipped
+  bool exchange(coap_packet_t *request, bert_response_t *response)
+  {
+    deliver(request);
+    for (int i = 0; i < 200; i++) {
+      oc_main_poll();
+      while (next_message(response)) {
+        if (!coap_check_signal_message(response->packet)) {
+          return response->packet->token_len == request->token_len &&
+                 memcmp(response->packet->token, request->token,
+                        request->token_len) == 0;
+        }
+      }
+      struct pollfd fd = { peer_sock, POLLIN, 0 };
+      if (poll(&fd, 1, 10) <= 0) {
+        continue;
+      }
+      uint8_t data[1024];
+      ssize_t len = recv(peer_sock, data, sizeof(data), 0);
+      if (len <= 0) {
+        return false;
+      }
+      rx.insert(rx.end(), data, data + len);
+    }
+    return false;
+  }
+
+  int listen_sock;
+  int peer_sock;
+  oc_endpoint_t peer;
+  std::vector<uint8_t> rx;
+};
+
+TEST_F(TestCoapBert, Block1Upload)
+{
+  connect_peer(true);
+  bert_response_t response;
+  uint32_t num;
+  uint8_t more;
+  uint16_t size;
+  uint32_t offset;
+
+  uint8_t id = 0x10;
+  for (uint32_t sent = 0; sent < BERT_BODY_SIZE;) {
+    size_t len = std::min<size_t>(2 * BERT_UNIT, BERT_BODY_SIZE - sent);
+    bool last = sent + len == BERT_BODY_SIZE;
+    coap_packet_t request[1];
+    init_request(request, COAP_POST, id++);
+    coap_set_header_content_format(request, APPLICATION_OCTET_STREAM);
+    coap_set_header_block1_bert(request, sent / BERT_UNIT, last ? 0 : 1);
+    coap_set_payload(request, bert_body + sent, len);
+    ASSERT_TRUE(exchange(request, &response));
+
+    EXPECT_EQ(last ? CHANGED_2_04 : CONTINUE_2_31, response.packet->code);
+    // answered in BERT as well
+    EXPECT_TRUE(coap_get_header_block1_bert(response.packet));
+    ASSERT_TRUE(
+      coap_get_header_block1(response.packet, &num, &more, &size, &offset));
+    EXPECT_EQ(sent / BERT_UNIT, num);
+    EXPECT_EQ(last ? 0 : 1, more);
+    sent += len;
+  }
+
+  // the tail block completes the payload, handed to the resource once
+  ASSERT_EQ((size_t)BERT_BODY_SIZE, bert_received.size());
+  EXPECT_EQ(0, memcmp(bert_body, bert_received.data(), BERT_BODY_SIZE));
+}
+
+TEST_F(TestCoapBert, Block2Download)
+{
+  connect_peer(true);
+  bert_response_t response;
+  uint32_t num;
+  uint8_t more;
+  uint16_t size;
+  uint32_t offset;
+  std::vector<uint8_t> body;
+
+  // the response does not fit in a message to the peer
+  coap_packet_t request[1];
+  uint8_t id = 0x20;
+  init_request(request, COAP_GET, id++);
+  ASSERT_TRUE(exchange(request, &response));
+  uint32_t size2 = 0;
+  ASSERT_TRUE(coap_get_header_size2(response.packet, &size2));
+  EXPECT_EQ((uint32_t)BERT_BODY_SIZE, size2);
+
+  for (;;) {
+    EXPECT_EQ(CONTENT_2_05, response.packet->code);
+    ASSERT_TRUE(coap_get_header_block2_bert(response.packet));
+    ASSERT_TRUE(
+      coap_get_header_block2(response.packet, &num, &more, &size, &offset));
+    EXPECT_EQ(body.size(), (size_t)offset);
+    const uint8_t *payload;
+    int payload_len = coap_get_payload(response.packet, &payload);
+    // as many units as fit in a message, the tail is what is left
+    EXPECT_EQ(std::min<size_t>(2 * BERT_UNIT, BERT_BODY_SIZE - body.size()),
+              (size_t)payload_len);
+    body.insert(body.end(), payload, payload + payload_len);
+    if (!more) {
+      break;
+    }
+    ASSERT_LT(body.size(), (size_t)BERT_BODY_SIZE);
+    init_request(request, COAP_GET, id++);
+    coap_set_header_block2_bert(request, (uint32_t)body.size() / BERT_UNIT, 0);
+    ASSERT_TRUE(exchange(request, &response));
+  }
+  ASSERT_EQ((size_t)BERT_BODY_SIZE, body.size());
+  EXPECT_EQ(0, memcmp(bert_body, body.data(), body.size()));
+}
+
+TEST_F(TestCoapBert, NoBertFromPeer)
+{
+  connect_peer(false);
+  bert_response_t response;
+  uint32_t num;
+  uint8_t more;
+  uint16_t size;
+  uint32_t offset;
+
+  // without BERT the response is sent whole, as before
+  coap_packet_t request[1];
+  init_request(request, COAP_GET, 0x30);
+  ASSERT_TRUE(exchange(request, &response));
+  EXPECT_EQ(CONTENT_2_05, response.packet->code);
+  EXPECT_FALSE(
+    coap_get_header_block2(response.packet, &num, &more, &size, &offset));
+  const uint8_t *payload;
+  int payload_len = coap_get_payload(response.packet, &payload);
+  ASSERT_EQ(BERT_BODY_SIZE, payload_len);
+  EXPECT_EQ(0, memcmp(bert_body, payload, BERT_BODY_SIZE));
+
+  // blocks of a size are answered with that size
+  uint8_t id = 0x31;
+  const uint16_t block_size = 512;
+  for (uint32_t sent = 0; sent < BERT_BODY_SIZE;) {
+    size_t len = std::min<size_t>(block_size, BERT_BODY_SIZE - sent);
+    bool last = sent + len == BERT_BODY_SIZE;
+    init_request(request, COAP_POST, id++);
+    coap_set_header_content_format(request, APPLICATION_OCTET_STREAM);
+    coap_set_header_block1(request, sent / block_size, last ? 0 : 1,
+                           block_size);
+    coap_set_payload(request, bert_body + sent, len);
+    ASSERT_TRUE(exchange(request, &response));
+    EXPECT_EQ(last ? CHANGED_2_04 : CONTINUE_2_31, response.packet->code);
+    EXPECT_FALSE(coap_get_header_block1_bert(response.packet));
+    ASSERT_TRUE(
+      coap_get_header_block1(response.packet, &num, &more, &size, &offset));
+    EXPECT_EQ(sent / block_size, num);
+    EXPECT_EQ(block_size, size);
+    sent += len;
+  }
+  ASSERT_EQ((size_t)BERT_BODY_SIZE, bert_received.size());
+  EXPECT_EQ(0, memcmp(bert_body, bert_received.data(), BERT_BODY_SIZE));
+}
+#endif /* OC_TCP && OC_BLOCK_WISE && OC_SERVER */
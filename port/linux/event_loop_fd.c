@@ -0,0 +1,138 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "oc_event_loop_fd.h"
+#include "oc_api.h"
+#include "port/oc_log.h"
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static int wakeup_fd = -1;
+static int timer_fd = -1;
+/* expiration time the timer fd is armed with, 0 if disarmed */
+static oc_clock_time_t armed_time;
+
+int
+oc_event_loop_fd_init(void)
+{
+  if (wakeup_fd >= 0) {
+    return 0;
+  }
+  wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd < 0) {
+    OC_ERR("creating wakeup eventfd %d", errno);
+    return -1;
+  }
+  /* oc_clock_time is based on CLOCK_REALTIME */
+  timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    OC_ERR("creating timerfd %d", errno);
+    close(wakeup_fd);
+    wakeup_fd = -1;
+    return -1;
+  }
+  armed_time = 0;
+  return 0;
+}
+
+void
+oc_event_loop_fd_shutdown(void)
+{
+  if (wakeup_fd >= 0) {
+    close(wakeup_fd);
+    wakeup_fd = -1;
+  }
+  if (timer_fd >= 0) {
+    close(timer_fd);
+    timer_fd = -1;
+  }
+  armed_time = 0;
+}
+
+void
+oc_event_loop_fd_signal(void)
+{
+  uint64_t one = 1;
+  if (wakeup_fd < 0) {
+    return;
+  }
+  /* EAGAIN means the counter is saturated: the fd is readable anyway */
+  if (write(wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    OC_WRN("cannot signal wakeup eventfd %d", errno);
+  }
+}
+
+int
+oc_event_loop_fd_get_wakeup_fd(void)
+{
+  return wakeup_fd;
+}
+
+int
+oc_event_loop_fd_get_timer_fd(void)
+{
+  return timer_fd;
+}
+
+static void
+arm_timer(oc_clock_time_t next_event)
+{
+  if (next_event == armed_time) {
+    return;
+  }
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  if (next_event != 0) {
+    its.it_value.tv_sec = (time_t)(next_event / OC_CLOCK_SECOND);
+    its.it_value.tv_nsec =
+      (long)((next_event % OC_CLOCK_SECOND) * (1000000000 / OC_CLOCK_SECOND));
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+      /* a zero it_value disarms the timer */
+      its.it_value.tv_nsec = 1;
+    }
+  }
+  if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+    OC_ERR("arming timerfd %d", errno);
+    armed_time = 0;
+    return;
+  }
+  armed_time = next_event;
+}
+
+oc_clock_time_t
+oc_event_loop_fd_poll(void)
+{
+  uint64_t count;
+  if (wakeup_fd >= 0) {
+    while (read(wakeup_fd, &count, sizeof(count)) > 0) {
+    }
+  }
+  if (timer_fd >= 0) {
+    if (read(timer_fd, &count, sizeof(count)) > 0) {
+      /* the expiration time has passed, the timer is disarmed */
+      armed_time = 0;
+    }
+  }
+  oc_clock_time_t next_event = oc_main_poll();
+  if (timer_fd >= 0) {
+    arm_timer(next_event);
+  }
+  return next_event;
+}
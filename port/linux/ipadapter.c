@@ -28,6 +28,7 @@
 #include "oc_network_monitor.h"
 #include "port/oc_assert.h"
 #include "port/oc_connectivity.h"
+#include "util/oc_atomic.h"
 #include <arpa/inet.h>
 #include <assert.h>
 #include <errno.h>
@@ -61,6 +62,9 @@ static const uint8_t ALL_COAP_NODES_SL[] = { 0xff, 0x05, 0, 0, 0, 0, 0, 0,
 
 #define ALL_COAP_NODES_V4 0xe00001bb
 
+/* Maximum number of interfaces on which group multicasts are joined */
+#define MAX_MCAST_INTERFACES (32)
+
 static pthread_mutex_t mutex;
 struct sockaddr_nl ifchange_nl;
 int ifchange_sock;
@@ -71,6 +75,120 @@ OC_MEMB(ip_context_s, ip_context_t, OC_MAX_NUM_DEVICES);
 
 OC_MEMB(device_eps, oc_endpoint_t, 8 * OC_MAX_NUM_DEVICES); // fix
 
+/**
+ * Cache of the interfaces that are up, with the source addresses used for
+ * multicasts. Rebuilt on the first send after a netlink address or link
+ * event, so that a multicast costs one sendmsg per interface.
+ */
+typedef struct ip_if_cache_t
+{
+  unsigned int if_index;
+  bool has_ipv6;       /* has any IPv6 address */
+  bool has_ll_addr;    /* IPv6 link-local address */
+  uint8_t ll_addr[16]; /* (other than the Thread mesh local ones) */
+  bool has_addr;       /* IPv6 address with a larger scope */
+  uint8_t addr[16];
+#ifdef OC_IPV4
+  bool has_addr4;
+  uint8_t addr4[4];
+#endif /* OC_IPV4 */
+} ip_if_cache_t;
+
+static pthread_mutex_t if_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ip_if_cache_t if_cache[MAX_MCAST_INTERFACES];
+static int if_cache_size;
+static bool if_cache_valid;
+
+static void
+if_cache_invalidate(void)
+{
+  pthread_mutex_lock(&if_cache_mutex);
+  if_cache_valid = false;
+  pthread_mutex_unlock(&if_cache_mutex);
+}
+
+static bool
+is_thread_mesh_local(const uint8_t *addr)
+{
+  static const uint8_t thread_prefix[8] = { 0xfd, 0xde, 0xad, 0x00,
+                                            0xbe, 0xef, 0x00, 0x00 };
+  return memcmp(addr, thread_prefix, 8) == 0;
+}
+
+static ip_if_cache_t *
+if_cache_get(unsigned int if_index)
+{
+  if (if_index == 0) {
+    return NULL;
+  }
+  for (int i = 0; i < if_cache_size; i++) {
+    if (if_cache[i].if_index == if_index) {
+      return &if_cache[i];
+    }
+  }
+  if (if_cache_size == MAX_MCAST_INTERFACES) {
+    return NULL;
+  }
+  ip_if_cache_t *entry = &if_cache[if_cache_size++];
+  memset(entry, 0, sizeof(ip_if_cache_t));
+  entry->if_index = if_index;
+  return entry;
+}
+
+/* called with if_cache_mutex locked */
+static void
+if_cache_refresh(void)
+{
+  if (if_cache_valid) {
+    return;
+  }
+  struct ifaddrs *ifs = NULL, *iface = NULL;
+  if (getifaddrs(&ifs) < 0) {
+    OC_ERR("querying interfaces: %d", errno);
+    return;
+  }
+  if_cache_size = 0;
+  for (iface = ifs; iface != NULL; iface = iface->ifa_next) {
+    /* Ignore interfaces that are down and the loopback interface */
+    if (!(iface->ifa_flags & IFF_UP) || (iface->ifa_flags & IFF_LOOPBACK) ||
+        iface->ifa_addr == NULL) {
+      continue;
+    }
+    if (iface->ifa_addr->sa_family == AF_INET6) {
+      struct sockaddr_in6 *addr = (struct sockaddr_in6 *)iface->ifa_addr;
+      ip_if_cache_t *entry = if_cache_get(if_nametoindex(iface->ifa_name));
+      if (entry == NULL) {
+        continue;
+      }
+      entry->has_ipv6 = true;
+      if (is_thread_mesh_local(addr->sin6_addr.s6_addr)) {
+        continue;
+      }
+      if (IN6_IS_ADDR_LINKLOCAL(&addr->sin6_addr)) {
+        if (!entry->has_ll_addr) {
+          memcpy(entry->ll_addr, addr->sin6_addr.s6_addr, 16);
+          entry->has_ll_addr = true;
+        }
+      } else if (!entry->has_addr) {
+        memcpy(entry->addr, addr->sin6_addr.s6_addr, 16);
+        entry->has_addr = true;
+      }
+    }
+#ifdef OC_IPV4
+    else if (iface->ifa_addr->sa_family == AF_INET) {
+      struct sockaddr_in *addr = (struct sockaddr_in *)iface->ifa_addr;
+      ip_if_cache_t *entry = if_cache_get(if_nametoindex(iface->ifa_name));
+      if (entry != NULL && !entry->has_addr4) {
+        memcpy(entry->addr4, &addr->sin_addr.s_addr, 4);
+        entry->has_addr4 = true;
+      }
+    }
+#endif /* OC_IPV4 */
+  }
+  freeifaddrs(ifs);
+  if_cache_valid = true;
+}
+
 #ifdef OC_NETWORK_MONITOR
 /**
  * Structure to manage interface list.
@@ -599,6 +717,12 @@ process_interface_change_event(void)
   bool if_state_changed = false;
 
   while (NLMSG_OK(response, response_len)) {
+    if (response->nlmsg_type == RTM_NEWADDR ||
+        response->nlmsg_type == RTM_DELADDR ||
+        response->nlmsg_type == RTM_NEWLINK ||
+        response->nlmsg_type == RTM_DELLINK) {
+      if_cache_invalidate();
+    }
     if (response->nlmsg_type == RTM_NEWADDR) {
       struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(response);
       if (ifa) {
@@ -766,12 +890,73 @@ oc_udp_add_socks_to_fd_set(ip_context_t *dev)
 #endif /* OC_IPV4 */
 }
 
+static int
+message_capacity(const oc_message_t *message)
+{
+#ifdef OC_MESSAGE_SIZE_CLASSES
+  return (int)message->size;
+#else  /* OC_MESSAGE_SIZE_CLASSES */
+  (void)message;
+  return OC_PDU_SIZE;
+#endif /* !OC_MESSAGE_SIZE_CLASSES */
+}
+
+#ifdef OC_MESSAGE_SIZE_CLASSES
+/* length of the datagram that oc_udp_receive_message will read next, so that
+ * the message can be allocated from a fitting size class */
+static size_t
+udp_next_datagram_size(ip_context_t *dev, fd_set *fds)
+{
+  int sock = -1;
+  if (FD_ISSET(dev->server_sock, fds)) {
+    sock = dev->server_sock;
+  } else if (FD_ISSET(dev->mcast_sock, fds)) {
+    sock = dev->mcast_sock;
+  } else {
+    int num_socks = (int)OC_ATOMIC_LOAD32(dev->num_mcast_overflow_socks);
+    for (int i = 0; i < num_socks; i++) {
+      if (FD_ISSET(dev->mcast_overflow_socks[i], fds)) {
+        sock = dev->mcast_overflow_socks[i];
+        break;
+      }
+    }
+  }
+#ifdef OC_IPV4
+  if (sock < 0 && FD_ISSET(dev->server4_sock, fds)) {
+    sock = dev->server4_sock;
+  } else if (sock < 0 && FD_ISSET(dev->mcast4_sock, fds)) {
+    sock = dev->mcast4_sock;
+  }
+#endif /* OC_IPV4 */
+#ifdef OC_OSCORE
+  if (sock < 0 && FD_ISSET(dev->secure_sock, fds)) {
+    sock = dev->secure_sock;
+  }
+#ifdef OC_IPV4
+  if (sock < 0 && FD_ISSET(dev->secure4_sock, fds)) {
+    sock = dev->secure4_sock;
+  }
+#endif /* OC_IPV4 */
+#endif /* OC_OSCORE */
+  if (sock < 0) {
+    return OC_PDU_SIZE;
+  }
+  /* MSG_TRUNC: the real length of the datagram, without reading it */
+  ssize_t len = recv(sock, NULL, 0, MSG_PEEK | MSG_TRUNC);
+  if (len < 0 || (size_t)len > (size_t)OC_PDU_SIZE) {
+    return OC_PDU_SIZE;
+  }
+  return (size_t)len;
+}
+#endif /* OC_MESSAGE_SIZE_CLASSES */
+
 static adapter_receive_state_t
 oc_udp_receive_message(ip_context_t *dev, fd_set *fds, oc_message_t *message)
 {
   if (FD_ISSET(dev->server_sock, fds)) {
-    int count = recv_msg(dev->server_sock, message->data, OC_PDU_SIZE,
-                         &message->endpoint, false, &message->mcast_dest);
+    int count = recv_msg(dev->server_sock, message->data,
+                         message_capacity(message), &message->endpoint, false,
+                         &message->mcast_dest);
     if (count < 0) {
       return ADAPTER_STATUS_ERROR;
     }
@@ -782,8 +967,9 @@ oc_udp_receive_message(ip_context_t *dev, fd_set *fds, oc_message_t *message)
   }
 
   if (FD_ISSET(dev->mcast_sock, fds)) {
-    int count = recv_msg(dev->mcast_sock, message->data, OC_PDU_SIZE,
-                         &message->endpoint, true, &message->mcast_dest);
+    int count = recv_msg(dev->mcast_sock, message->data,
+                         message_capacity(message), &message->endpoint, true,
+                         &message->mcast_dest);
     if (count < 0) {
       return ADAPTER_STATUS_ERROR;
     }
@@ -793,10 +979,26 @@ oc_udp_receive_message(ip_context_t *dev, fd_set *fds, oc_message_t *message)
     return ADAPTER_STATUS_RECEIVE;
   }
 
+  int num_socks = (int)OC_ATOMIC_LOAD32(dev->num_mcast_overflow_socks);
+  for (int i = 0; i < num_socks; i++) {
+    int sock = dev->mcast_overflow_socks[i];
+    if (FD_ISSET(sock, fds)) {
+      int count = recv_msg(sock, message->data, message_capacity(message),
+                           &message->endpoint, true, &message->mcast_dest);
+      if (count < 0) {
+        return ADAPTER_STATUS_ERROR;
+      }
+      message->length = (size_t)count;
+      message->endpoint.flags = IPV6 | MULTICAST;
+      FD_CLR(sock, fds);
+      return ADAPTER_STATUS_RECEIVE;
+    }
+  }
+
 #ifdef OC_IPV4
   if (FD_ISSET(dev->server4_sock, fds)) {
-    int count = recv_msg(dev->server4_sock, message->data, OC_PDU_SIZE,
-                         &message->endpoint, false);
+    int count = recv_msg(dev->server4_sock, message->data,
+                         message_capacity(message), &message->endpoint, false);
     if (count < 0) {
       return ADAPTER_STATUS_ERROR;
     }
@@ -807,8 +1009,8 @@ oc_udp_receive_message(ip_context_t *dev, fd_set *fds, oc_message_t *message)
   }
 
   if (FD_ISSET(dev->mcast4_sock, fds)) {
-    int count = recv_msg(dev->mcast4_sock, message->data, OC_PDU_SIZE,
-                         &message->endpoint, true);
+    int count = recv_msg(dev->mcast4_sock, message->data,
+                         message_capacity(message), &message->endpoint, true);
     if (count < 0) {
       return ADAPTER_STATUS_ERROR;
     }
@@ -821,8 +1023,9 @@ oc_udp_receive_message(ip_context_t *dev, fd_set *fds, oc_message_t *message)
 
 #ifdef OC_OSCORE
   if (FD_ISSET(dev->secure_sock, fds)) {
-    int count = recv_msg(dev->secure_sock, message->data, OC_PDU_SIZE,
-                         &message->endpoint, false, &message->mcast_dest);
+    int count = recv_msg(dev->secure_sock, message->data,
+                         message_capacity(message), &message->endpoint, false,
+                         &message->mcast_dest);
     if (count < 0) {
       return ADAPTER_STATUS_ERROR;
     }
@@ -834,8 +1037,8 @@ oc_udp_receive_message(ip_context_t *dev, fd_set *fds, oc_message_t *message)
   }
 #ifdef OC_IPV4
   if (FD_ISSET(dev->secure4_sock, fds)) {
-    int count = recv_msg(dev->secure4_sock, message->data, OC_PDU_SIZE,
-                         &message->endpoint, false);
+    int count = recv_msg(dev->secure4_sock, message->data,
+                         message_capacity(message), &message->endpoint, false);
     if (count < 0) {
       return ADAPTER_STATUS_ERROR;
     }
@@ -857,7 +1060,9 @@ network_event_thread(void *data)
   ip_context_t *dev = (ip_context_t *)data;
 
   fd_set setfds;
+  fd_set wsetfds;
   FD_ZERO(&dev->rfds);
+  FD_ZERO(&dev->wfds);
   /* Monitor network interface changes on the platform from only the 0th logical
    * device
    */
@@ -875,7 +1080,15 @@ network_event_thread(void *data)
 
   while (dev->terminate != 1) {
     setfds = ip_context_rfds_fd_copy(dev);
-    n = select(FD_SETSIZE, &setfds, NULL, NULL, NULL);
+    wsetfds = ip_context_wfds_fd_copy(dev);
+    struct timeval *select_timeout = NULL;
+#ifdef OC_TCP
+    struct timeval timeout;
+    if (oc_tcp_get_connect_timeout(dev, &timeout)) {
+      select_timeout = &timeout;
+    }
+#endif /* OC_TCP */
+    n = select(FD_SETSIZE, &setfds, &wsetfds, NULL, select_timeout);
 
     if (FD_ISSET(dev->shutdown_pipe[0], &setfds)) {
       char buf;
@@ -889,6 +1102,13 @@ network_event_thread(void *data)
       break;
     }
 
+#ifdef OC_TCP
+    if (n < 0) {
+      FD_ZERO(&wsetfds);
+    }
+    n -= oc_tcp_process_writable(dev, &setfds, &wsetfds);
+#endif /* OC_TCP */
+
     for (i = 0; i < n; i++) {
       if (dev->device == 0) {
         if (FD_ISSET(ifchange_sock, &setfds)) {
@@ -900,7 +1120,12 @@ network_event_thread(void *data)
         }
       }
 
+#ifdef OC_MESSAGE_SIZE_CLASSES
+      oc_message_t *message =
+        oc_allocate_message_with_size(udp_next_datagram_size(dev, &setfds));
+#else  /* OC_MESSAGE_SIZE_CLASSES */
       oc_message_t *message = oc_allocate_message();
+#endif /* !OC_MESSAGE_SIZE_CLASSES */
 
       if (!message) {
         break;
@@ -953,9 +1178,22 @@ send_msg(int sock, struct sockaddr_storage *receiver, oc_message_t *message)
   if (message->endpoint.flags & IPV6) {
     struct cmsghdr *cmsg;
     struct in6_pktinfo *pktinfo;
+    const uint8_t *dest = message->endpoint.addr.ipv6.address;
+    /* hop limit of multicasts: link local stays on the link, realm and site
+     * local may be routed */
+    int hops = 0;
+    if (IN6_IS_ADDR_MC_LINKLOCAL(dest)) {
+      hops = 1;
+    } else if (IN6_IS_ADDR_MC_SITELOCAL(dest) ||
+               (IN6_IS_ADDR_MULTICAST(dest) && (dest[1] & 0x0f) == 0x03)) {
+      hops = 255;
+    }
 
     msg.msg_control = msg_control;
     msg.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
+    if (hops > 0) {
+      msg.msg_controllen += CMSG_SPACE(sizeof(int));
+    }
     memset(msg.msg_control, 0, msg.msg_controllen);
 
     cmsg = CMSG_FIRSTHDR(&msg);
@@ -972,6 +1210,14 @@ send_msg(int sock, struct sockaddr_storage *receiver, oc_message_t *message)
      * from the endpoint's addr_local attribute.
      */
     memcpy(&pktinfo->ipi6_addr, message->endpoint.addr_local.ipv6.address, 16);
+
+    if (hops > 0) {
+      cmsg = CMSG_NXTHDR(&msg, cmsg);
+      cmsg->cmsg_level = IPPROTO_IPV6;
+      cmsg->cmsg_type = IPV6_HOPLIMIT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(cmsg), &hops, sizeof(int));
+    }
   }
 #ifdef OC_IPV4
   else if (message->endpoint.flags & IPV4) {
@@ -1095,81 +1341,42 @@ oc_send_buffer(oc_message_t *message)
 void
 oc_send_discovery_request(oc_message_t *message)
 {
-  struct ifaddrs *ifs = NULL, *iface = NULL;
-  if (getifaddrs(&ifs) < 0) {
-    OC_ERR("querying interfaces: %d", errno);
-    goto done;
-  }
-
   memset(&message->endpoint.addr_local, 0,
          sizeof(message->endpoint.addr_local));
   message->endpoint.interface_index = 0;
 
-  ip_context_t *dev = get_ip_context_for_device(message->endpoint.device);
-
-#define IN6_IS_ADDR_MC_REALM_LOCAL(addr)                                       \
-  IN6_IS_ADDR_MULTICAST(addr) && ((((const uint8_t *)(addr))[1] & 0x0f) == 0x03)
-
-  for (iface = ifs; iface != NULL; iface = iface->ifa_next) {
-    if (!(iface->ifa_flags & IFF_UP) || (iface->ifa_flags & IFF_LOOPBACK))
-      continue;
-    if ((message->endpoint.flags & IPV6) && iface->ifa_addr &&
-        iface->ifa_addr->sa_family == AF_INET6) {
-      struct sockaddr_in6 *addr = (struct sockaddr_in6 *)iface->ifa_addr;
-      // check for Thread mesh local prefix
-      memcpy(&message->endpoint.addr_local.ipv6.address, &addr->sin6_addr, 16);
-      uint8_t *epaddr = message->endpoint.addr_local.ipv6.address;
-      uint8_t thread_prefix[8] = { 0xfd, 0xde, 0xad, 0x00,
-                                   0xbe, 0xef, 0x00, 0x00 };
-      bool is_thread_mesh = memcmp(epaddr, thread_prefix, 8) == 0;
-      if (is_thread_mesh)
-        continue;
-      unsigned int mif = if_nametoindex(iface->ifa_name);
-      if (setsockopt(dev->server_sock, IPPROTO_IPV6, IPV6_MULTICAST_IF, &mif,
-                     sizeof(mif)) == -1) {
-        OC_ERR("setting socket option for default IPV6_MULTICAST_IF: %d",
-               errno);
-        goto done;
-      }
-      message->endpoint.interface_index = mif;
-      if (IN6_IS_ADDR_MC_LINKLOCAL(message->endpoint.addr.ipv6.address)) {
-        message->endpoint.addr.ipv6.scope = mif;
-        unsigned int hops = 1;
-        setsockopt(dev->server_sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops,
-                   sizeof(hops));
-      } else if (IN6_IS_ADDR_MC_REALM_LOCAL(
-                   message->endpoint.addr.ipv6.address)) {
-        unsigned int hops = 255;
-        setsockopt(dev->server_sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops,
-                   sizeof(hops));
-        message->endpoint.addr.ipv6.scope = 0;
-      } else if (IN6_IS_ADDR_MC_SITELOCAL(
-                   message->endpoint.addr.ipv6.address)) {
-        unsigned int hops = 255;
-        setsockopt(dev->server_sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops,
-                   sizeof(hops));
+  /* the outgoing interface, the source address and the hop limit are set
+   * per datagram by send_msg */
+  pthread_mutex_lock(&if_cache_mutex);
+  if_cache_refresh();
+  for (int i = 0; i < if_cache_size; i++) {
+    const ip_if_cache_t *iface = &if_cache[i];
+    message->endpoint.interface_index = (int)iface->if_index;
+    if (message->endpoint.flags & IPV6) {
+      const uint8_t *dest = message->endpoint.addr.ipv6.address;
+      const uint8_t *source = NULL;
+      if (IN6_IS_ADDR_MC_LINKLOCAL(dest)) {
+        message->endpoint.addr.ipv6.scope = iface->if_index;
+        source = iface->has_ll_addr ? iface->ll_addr
+                                    : (iface->has_addr ? iface->addr : NULL);
+      } else {
         message->endpoint.addr.ipv6.scope = 0;
+        source = iface->has_addr ? iface->addr
+                                 : (iface->has_ll_addr ? iface->ll_addr : NULL);
+      }
+      if (source == NULL) {
+        continue;
       }
+      memcpy(message->endpoint.addr_local.ipv6.address, source, 16);
       oc_send_buffer(message);
 #ifdef OC_IPV4
-    } else if (message->endpoint.flags & IPV4 && iface->ifa_addr &&
-               iface->ifa_addr->sa_family == AF_INET) {
-      struct sockaddr_in *addr = (struct sockaddr_in *)iface->ifa_addr;
-      if (setsockopt(dev->server4_sock, IPPROTO_IP, IP_MULTICAST_IF,
-                     &addr->sin_addr, sizeof(addr->sin_addr)) == -1) {
-        OC_ERR("setting socket option for default IP_MULTICAST_IF: %d", errno);
-        goto done;
-      }
-      message->endpoint.iface = if_nametoindex(iface->ifa_name);
+    } else if ((message->endpoint.flags & IPV4) && iface->has_addr4) {
+      memcpy(message->endpoint.addr_local.ipv4.address, iface->addr4, 4);
       oc_send_buffer(message);
+#endif /* OC_IPV4 */
     }
-#else  /* OC_IPV4 */
-    }
-#endif /* !OC_IPV4 */
   }
-done:
-#undef IN6_IS_ADDR_MC_REALM_LOCAL
-  freeifaddrs(ifs);
+  pthread_mutex_unlock(&if_cache_mutex);
 }
 
 #ifdef OC_NETWORK_MONITOR
@@ -1392,7 +1599,7 @@ static void
 register_multicasts(oc_interface_event_t event)
 {
   if (event == NETWORK_INTERFACE_DOWN || event == NETWORK_INTERFACE_UP) {
-    oc_register_group_multicasts();
+    oc_rejoin_group_multicasts();
   }
 }
 
@@ -1416,6 +1623,7 @@ oc_connectivity_init(size_t device)
   }
   oc_list_add(ip_contexts, dev);
   dev->device = device;
+  dev->num_mcast_overflow_socks = 0;
   OC_LIST_STRUCT_INIT(dev, eps);
 
   if (pthread_mutex_init(&dev->rfds_mutex, NULL) != 0) {
@@ -1636,6 +1844,10 @@ oc_connectivity_shutdown(size_t device)
 
   close(dev->server_sock);
   close(dev->mcast_sock);
+  for (int i = 0; i < (int)dev->num_mcast_overflow_socks; i++) {
+    close(dev->mcast_overflow_socks[i]);
+  }
+  dev->num_mcast_overflow_socks = 0;
 
 #ifdef OC_IPV4
   close(dev->server4_sock);
@@ -1851,62 +2063,149 @@ ip_context_rfds_fd_copy(ip_context_t *dev)
 }
 
 void
-oc_connectivity_subscribe_mcast_ipv6(oc_endpoint_t *address)
+ip_context_wfds_fd_set(ip_context_t *dev, int sockfd)
 {
-  ip_context_t *dev = get_ip_context_for_device(address->device);
+  pthread_mutex_lock(&dev->rfds_mutex);
+  FD_SET(sockfd, &dev->wfds);
+  pthread_mutex_unlock(&dev->rfds_mutex);
+}
 
-  if (dev == NULL) {
-    OC_ERR(" dev is NULL");
-    return;
+void
+ip_context_wfds_fd_clr(ip_context_t *dev, int sockfd)
+{
+  pthread_mutex_lock(&dev->rfds_mutex);
+  FD_CLR(sockfd, &dev->wfds);
+  pthread_mutex_unlock(&dev->rfds_mutex);
+}
+
+fd_set
+ip_context_wfds_fd_copy(ip_context_t *dev)
+{
+  fd_set setfds;
+  pthread_mutex_lock(&dev->rfds_mutex);
+  memcpy(&setfds, &dev->wfds, sizeof(dev->wfds));
+  pthread_mutex_unlock(&dev->rfds_mutex);
+  return setfds;
+}
+
+/* Collects the indexes of the interfaces that are up and have an IPv6
+ * address. An interface with several addresses is listed only once.
+ */
+static int
+get_ipv6_interface_indexes(unsigned int *indexes, int max_indexes)
+{
+  int nr_indexes = 0;
+  pthread_mutex_lock(&if_cache_mutex);
+  if_cache_refresh();
+  for (int i = 0; i < if_cache_size && nr_indexes < max_indexes; i++) {
+    if (if_cache[i].has_ipv6) {
+      indexes[nr_indexes++] = if_cache[i].if_index;
+    }
   }
+  pthread_mutex_unlock(&if_cache_mutex);
+  return nr_indexes;
+}
 
-  // for every interface...
-  int ret = 0;
-  struct ifaddrs *ifs = NULL, *interface = NULL;
-  if (getifaddrs(&ifs) < 0) {
-    return;
+/* Opens an additional multicast socket, bound to the same address and port as
+ * the multicast socket. Used when the kernel refuses more group memberships on
+ * the existing multicast sockets.
+ */
+static int
+add_mcast_overflow_socket(ip_context_t *dev)
+{
+  if (dev->num_mcast_overflow_socks >= OC_MAX_MCAST_OVERFLOW_SOCKETS) {
+    OC_ERR("no multicast overflow socket available");
+    return -1;
   }
-  for (interface = ifs; interface != NULL; interface = interface->ifa_next) {
-    /* Ignore interfaces that are down and the loopback interface */
-    if (!(interface->ifa_flags & IFF_UP) ||
-        (interface->ifa_flags & IFF_LOOPBACK)) {
-      continue;
+  int sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    OC_ERR("creating multicast overflow socket %d", errno);
+    return -1;
+  }
+  int on = 1;
+  if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on)) ==
+        -1 ||
+      setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1) {
+    OC_ERR("setting multicast overflow socket options %d", errno);
+    close(sock);
+    return -1;
+  }
+#ifdef IPV6_MULTICAST_ALL
+  /* deliver only the groups joined on a socket to that socket, otherwise all
+   * sockets bound to the port receive a copy of each group message */
+  int off = 0;
+  (void)setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &off, sizeof(off));
+  (void)setsockopt(dev->mcast_sock, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &off,
+                   sizeof(off));
+#endif /* IPV6_MULTICAST_ALL */
+  if (bind(sock, (struct sockaddr *)&dev->mcast, sizeof(dev->mcast)) == -1) {
+    OC_ERR("binding multicast overflow socket %d", errno);
+    close(sock);
+    return -1;
+  }
+
+  /* the socket is stored before the count is published to the network
+   * thread */
+  uint32_t num_socks = dev->num_mcast_overflow_socks;
+  dev->mcast_overflow_socks[num_socks] = sock;
+  OC_ATOMIC_STORE32(dev->num_mcast_overflow_socks, num_socks + 1);
+  ip_context_rfds_fd_set(dev, sock);
+  /* wake up the network thread, so that it listens to the new socket */
+  if (write(dev->shutdown_pipe[1], "\n", 1) < 0) {
+    OC_WRN("cannot wakeup network thread");
+  }
+  OC_DBG("added multicast overflow socket %u", (unsigned)num_socks + 1);
+  return sock;
+}
+
+/* Joins the group on the first multicast socket that accepts the membership.
+ * ENOBUFS/ENOMEM indicate that the per socket membership limit is reached.
+ */
+static int
+join_ipv6_mcast_group(ip_context_t *dev, struct ipv6_mreq *mreq)
+{
+  int sock = dev->mcast_sock;
+  int i = 0;
+  while (setsockopt(sock, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP, mreq,
+                    sizeof(*mreq)) == -1) {
+    if (errno == EADDRINUSE) {
+      /* already joined */
+      return 0;
     }
-    /* Ignore interfaces not belonging to the address family under consideration
-     */
-    if (interface->ifa_addr && interface->ifa_addr->sa_family != AF_INET6) {
-      continue;
+    if (errno != ENOBUFS && errno != ENOMEM) {
+      OC_ERR("Failed to add IPv6 multicast membership! %d", errno);
+      return -1;
     }
-    /* Obtain interface index for this address */
-    int if_index = if_nametoindex(interface->ifa_name);
-    /* Accordingly handle IPv6/IPv4 addresses */
-    struct sockaddr_in6 *a = (struct sockaddr_in6 *)interface->ifa_addr;
-    if (a) {
-      // Subscribe to multicast group
-      struct ipv6_mreq mreq;
-
-      /* Link-local scope */
-      memset(&mreq, 0, sizeof(mreq));
-      memcpy(mreq.ipv6mr_multiaddr.s6_addr, address->addr.ipv6.address, 16);
-      mreq.ipv6mr_interface = if_index;
-
-      (void)setsockopt(dev->mcast_sock, IPPROTO_IPV6, IPV6_DROP_MEMBERSHIP,
-                       &mreq, sizeof(mreq));
-
-      if (setsockopt(dev->mcast_sock, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP, &mreq,
-                     sizeof(mreq)) == -1) {
-        OC_ERR("Failed to add IPv6 multicast membership!");
-        return;
+    if (i < (int)dev->num_mcast_overflow_socks) {
+      sock = dev->mcast_overflow_socks[i];
+    } else {
+      sock = add_mcast_overflow_socket(dev);
+      if (sock < 0) {
+        return -1;
       }
     }
+    i++;
   }
+  return 0;
+}
 
-  freeifaddrs(ifs);
-  return;
+static void
+leave_ipv6_mcast_group(ip_context_t *dev, struct ipv6_mreq *mreq)
+{
+  if (setsockopt(dev->mcast_sock, IPPROTO_IPV6, IPV6_DROP_MEMBERSHIP, mreq,
+                 sizeof(*mreq)) == 0) {
+    return;
+  }
+  for (int i = 0; i < (int)dev->num_mcast_overflow_socks; i++) {
+    if (setsockopt(dev->mcast_overflow_socks[i], IPPROTO_IPV6,
+                   IPV6_DROP_MEMBERSHIP, mreq, sizeof(*mreq)) == 0) {
+      return;
+    }
+  }
 }
 
 void
-oc_connectivity_unsubscribe_mcast_ipv6(oc_endpoint_t *address)
+oc_connectivity_subscribe_mcast_ipv6(oc_endpoint_t *address)
 {
   ip_context_t *dev = get_ip_context_for_device(address->device);
 
@@ -1916,47 +2215,44 @@ oc_connectivity_unsubscribe_mcast_ipv6(oc_endpoint_t *address)
   }
 
   // for every interface...
-  int ret = 0;
-  struct ifaddrs *ifs = NULL, *interface = NULL;
-  if (getifaddrs(&ifs) < 0) {
-    return;
-  }
-  for (interface = ifs; interface != NULL; interface = interface->ifa_next) {
-    /* Ignore interfaces that are down and the loopback interface */
-    if (!(interface->ifa_flags & IFF_UP) ||
-        (interface->ifa_flags & IFF_LOOPBACK)) {
-      continue;
-    }
-    /* Ignore interfaces not belonging to the address family under consideration
-     */
-    if (interface->ifa_addr && interface->ifa_addr->sa_family != AF_INET6) {
-      continue;
-    }
-    /* Obtain interface index for this address */
-    int if_index = if_nametoindex(interface->ifa_name);
-    /* Accordingly handle IPv6/IPv4 addresses */
-    struct sockaddr_in6 *a = (struct sockaddr_in6 *)interface->ifa_addr;
-    if (a) {
-      // Subscribe to multicast group
-      struct ipv6_mreq mreq;
-
-      /* Link-local scope */
-      memset(&mreq, 0, sizeof(mreq));
-      memcpy(mreq.ipv6mr_multiaddr.s6_addr, address->addr.ipv6.address, 16);
-      mreq.ipv6mr_interface = if_index;
-
-      (void)setsockopt(dev->mcast_sock, IPPROTO_IPV6, IPV6_DROP_MEMBERSHIP,
-                       &mreq, sizeof(mreq));
-
-      // if (setsockopt(dev->mcast_sock, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP,
-      // &mreq,
-      //               sizeof(mreq)) == -1) {
-      //  OC_ERR("Failed to add IPv6 multicast membership!");
-      //  return;
-      //}
+  unsigned int if_indexes[MAX_MCAST_INTERFACES];
+  int nr_interfaces =
+    get_ipv6_interface_indexes(if_indexes, MAX_MCAST_INTERFACES);
+  for (int i = 0; i < nr_interfaces; i++) {
+    // Subscribe to multicast group
+    struct ipv6_mreq mreq;
+
+    memset(&mreq, 0, sizeof(mreq));
+    memcpy(mreq.ipv6mr_multiaddr.s6_addr, address->addr.ipv6.address, 16);
+    mreq.ipv6mr_interface = if_indexes[i];
+
+    if (join_ipv6_mcast_group(dev, &mreq) < 0) {
+      return;
     }
   }
+}
 
-  freeifaddrs(ifs);
-  return;
-}
\ No newline at end of file
+void
+oc_connectivity_unsubscribe_mcast_ipv6(oc_endpoint_t *address)
+{
+  ip_context_t *dev = get_ip_context_for_device(address->device);
+
+  if (dev == NULL) {
+    OC_ERR(" dev is NULL");
+    return;
+  }
+
+  // for every interface...
+  unsigned int if_indexes[MAX_MCAST_INTERFACES];
+  int nr_interfaces =
+    get_ipv6_interface_indexes(if_indexes, MAX_MCAST_INTERFACES);
+  for (int i = 0; i < nr_interfaces; i++) {
+    struct ipv6_mreq mreq;
+
+    memset(&mreq, 0, sizeof(mreq));
+    memcpy(mreq.ipv6mr_multiaddr.s6_addr, address->addr.ipv6.address, 16);
+    mreq.ipv6mr_interface = if_indexes[i];
+
+    leave_ipv6_mcast_group(dev, &mreq);
+  }
+}
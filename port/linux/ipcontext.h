@@ -19,6 +19,7 @@
 #ifndef IPCONTEXT_H
 #define IPCONTEXT_H
 
+#include "oc_config.h"
 #include "oc_endpoint.h"
 #include <pthread.h>
 #include <stdint.h>
@@ -70,6 +71,10 @@ typedef struct ip_context_t
   struct sockaddr_storage mcast;
   struct sockaddr_storage server;
   int mcast_sock;
+  int mcast_overflow_socks[OC_MAX_MCAST_OVERFLOW_SOCKETS];
+  /* added by the event loop, read by the network thread: stored with release
+   * and loaded with acquire semantics (see oc_atomic.h) */
+  uint32_t num_mcast_overflow_socks;
   int server_sock;
   uint16_t port;
 //#ifdef OC_SECURITY
@@ -99,6 +104,7 @@ typedef struct ip_context_t
   size_t device;
   pthread_mutex_t rfds_mutex;
   fd_set rfds;
+  fd_set wfds; /* TCP sessions waiting to connect or to flush, rfds_mutex */
   int shutdown_pipe[2];
 } ip_context_t;
 
@@ -128,6 +134,32 @@ void ip_context_rfds_fd_clr(ip_context_t *dev, int sockfd);
  */
 fd_set ip_context_rfds_fd_copy(ip_context_t *dev);
 
+/**
+ * Set a given file descriptor to a set (dev->wfds) under the mutex(rfds_mutex).
+ *
+ * @param[in] dev the device network context.
+ * @param[in] sockfd the file descriptor.
+ */
+void ip_context_wfds_fd_set(ip_context_t *dev, int sockfd);
+
+/**
+ * Remove a given file descriptor from a set (dev->wfds) under the
+ * mutex(rfds_mutex).
+ *
+ * @param[in] dev the device network context.
+ * @param[in] sockfd the file descriptor.
+ */
+void ip_context_wfds_fd_clr(ip_context_t *dev, int sockfd);
+
+/**
+ * Make a copy of file descriptor set (dev->wfds) under the mutex(rfds_mutex).
+ *
+ * @param[in] dev the device network context.
+ *
+ * @return a copy of file descriptor set.
+ */
+fd_set ip_context_wfds_fd_copy(ip_context_t *dev);
+
 #ifdef __cplusplus
 }
 #endif
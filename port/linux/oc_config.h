@@ -105,6 +105,10 @@ typedef uint64_t oc_clock_time_t;
 /* Maximum number of interfaces for IP adapter */
 #define OC_MAX_IP_INTERFACES (3)
 
+/* Maximum number of additional IPv6 multicast sockets, used when the kernel
+ * refuses more group memberships on a single socket */
+#define OC_MAX_MCAST_OVERFLOW_SOCKETS (8)
+
 /* Maximum number of callbacks for Network interface event monitoring */
 #define OC_MAX_NETWORK_INTERFACE_CBS (4)
 
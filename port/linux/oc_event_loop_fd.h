@@ -0,0 +1,107 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/**
+  @brief pollable file descriptors for driving the stack from an external
+  event loop (Linux)
+  @file
+
+  The stack is normally driven by a loop that calls oc_main_poll() and then
+  waits on a condition variable that is signalled by the signal_event_loop
+  handler. Applications that already have a reactor (select/poll/epoll) can
+  instead register two file descriptors:
+  - the wakeup fd (eventfd) becomes readable when the stack signals the event
+    loop.
+  - the timer fd (timerfd) becomes readable when the next timer of the stack
+    expires.
+
+  Usage:
+  ~~~{.c}
+  static const oc_handler_t handler = {
+    .init = app_init,
+    .signal_event_loop = oc_event_loop_fd_signal,
+    .register_resources = register_resources,
+  };
+
+  oc_event_loop_fd_init();
+  oc_main_init(&handler);
+  epoll_ctl(ep, EPOLL_CTL_ADD, oc_event_loop_fd_get_wakeup_fd(), &ev1);
+  epoll_ctl(ep, EPOLL_CTL_ADD, oc_event_loop_fd_get_timer_fd(), &ev2);
+  oc_event_loop_fd_poll();
+  while (epoll_wait(ep, events, MAX_EVENTS, -1) >= 0) {
+    // for events on either fd:
+    oc_event_loop_fd_poll();
+  }
+  ~~~
+*/
+#ifndef OC_EVENT_LOOP_FD_H
+#define OC_EVENT_LOOP_FD_H
+
+#include "port/oc_clock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief create the wakeup and timer file descriptors
+ *
+ * must be called before oc_main_init, since the stack can signal the event
+ * loop during initialization.
+ *
+ * @return int 0 on success, -1 on failure
+ */
+int oc_event_loop_fd_init(void);
+
+/**
+ * @brief close the wakeup and timer file descriptors
+ */
+void oc_event_loop_fd_shutdown(void);
+
+/**
+ * @brief signal_event_loop handler that makes the wakeup fd readable
+ *
+ * can be called from any thread.
+ */
+void oc_event_loop_fd_signal(void);
+
+/**
+ * @brief the wakeup fd (eventfd), readable when the stack needs to be polled
+ *
+ * @return int the file descriptor, -1 if not initialized
+ */
+int oc_event_loop_fd_get_wakeup_fd(void);
+
+/**
+ * @brief the timer fd (timerfd), readable when the next timer expires
+ *
+ * @return int the file descriptor, -1 if not initialized
+ */
+int oc_event_loop_fd_get_timer_fd(void);
+
+/**
+ * @brief consume the pending wakeups, run oc_main_poll and arm the timer fd
+ * with the next expiration time of the stack
+ *
+ * @return oc_clock_time_t the absolute time of the next timer event, 0 if
+ * there is none
+ */
+oc_clock_time_t oc_event_loop_fd_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OC_EVENT_LOOP_FD_H */
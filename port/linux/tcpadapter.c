@@ -24,9 +24,11 @@
 #include "ipadapter.h"
 #include "ipcontext.h"
 #include "messaging/coap/coap.h"
+#include "oc_buffer.h"
 #include "oc_endpoint.h"
 #include "oc_session_events.h"
 #include "port/oc_assert.h"
+#include "port/oc_clock.h"
 #include "util/oc_memb.h"
 #include <arpa/inet.h>
 #include <assert.h>
@@ -35,6 +37,7 @@
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <stdlib.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #ifdef OC_TCP
@@ -46,10 +49,23 @@
 #define DEFAULT_RECEIVE_SIZE                                                   \
   (COAP_TCP_DEFAULT_HEADER_LEN + COAP_TCP_MAX_EXTENDED_LENGTH_LEN)
 
-#define LIMIT_RETRY_CONNECT 5
-
 #define TCP_CONNECT_TIMEOUT 5
 
+/* Number of outgoing messages that can be queued on a single session before
+ * oc_tcp_send_buffer() reports back-pressure to the caller.
+ * The queue holds copies of the messages: the network thread writes and frees
+ * them, the messages themselves stay with the event loop.
+ */
+#ifndef OC_TCP_SESSION_QUEUE_SIZE
+#define OC_TCP_SESSION_QUEUE_SIZE 8
+#endif /* OC_TCP_SESSION_QUEUE_SIZE */
+
+typedef struct tcp_send_buffer_t
+{
+  uint8_t *data;
+  size_t length;
+} tcp_send_buffer_t;
+
 typedef struct tcp_session
 {
   struct tcp_session *next;
@@ -57,6 +73,14 @@ typedef struct tcp_session
   oc_endpoint_t endpoint;
   int sock;
   tcp_csm_state_t csm_state;
+  uint32_t peer_max_message_size;
+  bool peer_bert;
+  tcp_send_buffer_t send_queue[OC_TCP_SESSION_QUEUE_SIZE];
+  uint8_t send_queue_head;
+  uint8_t send_queue_len;
+  size_t send_offset; /* bytes of the head message already written */
+  int sock_flags;     /* file status flags to restore once connected */
+  oc_clock_time_t connect_deadline; /* 0 once the connection is established */
 } tcp_session_t;
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -159,6 +183,97 @@ oc_tcp_add_socks_to_fd_set(ip_context_t *dev)
   FD_SET(dev->tcp.connect_pipe[0], &dev->rfds);
 }
 
+static void
+session_queue_clear(tcp_session_t *session)
+{
+  while (session->send_queue_len > 0) {
+    free(session->send_queue[session->send_queue_head].data);
+    session->send_queue_head =
+      (session->send_queue_head + 1) % OC_TCP_SESSION_QUEUE_SIZE;
+    session->send_queue_len--;
+  }
+  session->send_offset = 0;
+}
+
+static bool
+session_queue_push(tcp_session_t *session, oc_message_t *message)
+{
+  if (session->send_queue_len == OC_TCP_SESSION_QUEUE_SIZE) {
+    return false;
+  }
+  uint8_t *data = (uint8_t *)malloc(message->length);
+  if (data == NULL) {
+    OC_ERR("out of memory for the TCP send queue");
+    return false;
+  }
+  memcpy(data, message->data, message->length);
+  uint8_t tail = (session->send_queue_head + session->send_queue_len) %
+                 OC_TCP_SESSION_QUEUE_SIZE;
+  session->send_queue[tail].data = data;
+  session->send_queue[tail].length = message->length;
+  session->send_queue_len++;
+  return true;
+}
+
+/* Writes as much of the send queue as the socket accepts without blocking.
+ * Returns 0 when the queue has been drained, 1 when data is still pending
+ * and -1 when the session is broken.
+ */
+static int
+flush_session_locked(tcp_session_t *session)
+{
+  while (session->send_queue_len > 0) {
+    struct iovec iov[OC_TCP_SESSION_QUEUE_SIZE];
+    uint8_t i;
+    for (i = 0; i < session->send_queue_len; i++) {
+      tcp_send_buffer_t *buffer =
+        &session->send_queue[(session->send_queue_head + i) %
+                             OC_TCP_SESSION_QUEUE_SIZE];
+      size_t offset = (i == 0) ? session->send_offset : 0;
+      iov[i].iov_base = buffer->data + offset;
+      iov[i].iov_len = buffer->length - offset;
+    }
+
+    /* sendmsg() is writev() with flags, MSG_NOSIGNAL avoids SIGPIPE */
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = session->send_queue_len;
+    ssize_t send_len =
+      sendmsg(session->sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (send_len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 1;
+      }
+      OC_WRN("sendmsg() returned errno %d", errno);
+      return -1;
+    }
+    OC_DBG("Sent %zd bytes", send_len);
+
+    size_t written = (size_t)send_len;
+    while (written > 0) {
+      tcp_send_buffer_t *buffer =
+        &session->send_queue[session->send_queue_head];
+      size_t left = buffer->length - session->send_offset;
+      if (written < left) {
+        session->send_offset += written;
+        break;
+      }
+      written -= left;
+      session->send_offset = 0;
+      free(buffer->data);
+      buffer->data = NULL;
+      session->send_queue_head =
+        (session->send_queue_head + 1) % OC_TCP_SESSION_QUEUE_SIZE;
+      session->send_queue_len--;
+    }
+  }
+  return 0;
+}
+
 static void
 free_tcp_session_async_locked(tcp_session_t *session)
 {
@@ -182,6 +297,8 @@ free_tcp_session(tcp_session_t *session)
   }
 
   ip_context_rfds_fd_clr(session->dev, session->sock);
+  ip_context_wfds_fd_clr(session->dev, session->sock);
+  session_queue_clear(session);
 
   ssize_t len = 0;
   do {
@@ -208,14 +325,14 @@ process_free_tcp_session_locked()
   }
 }
 
-static int
+static tcp_session_t *
 add_new_session(int sock, ip_context_t *dev, oc_endpoint_t *endpoint,
                 tcp_csm_state_t state)
 {
   tcp_session_t *session = oc_memb_alloc(&tcp_session_s);
   if (!session) {
     OC_ERR("could not allocate new TCP session object");
-    return -1;
+    return NULL;
   }
 
   endpoint->interface_index = get_interface_index(sock);
@@ -225,6 +342,12 @@ add_new_session(int sock, ip_context_t *dev, oc_endpoint_t *endpoint,
   session->endpoint.next = NULL;
   session->sock = sock;
   session->csm_state = state;
+  session->peer_max_message_size = OC_TCP_DEFAULT_MAX_MESSAGE_SIZE;
+  session->peer_bert = false;
+  session->send_queue_head = 0;
+  session->send_queue_len = 0;
+  session->send_offset = 0;
+  session->connect_deadline = 0;
 
   oc_list_add(session_list, session);
 
@@ -234,7 +357,7 @@ add_new_session(int sock, ip_context_t *dev, oc_endpoint_t *endpoint,
 
   OC_DBG("recorded new TCP session");
 
-  return 0;
+  return session;
 }
 
 static int
@@ -268,7 +391,7 @@ accept_new_session(ip_context_t *dev, int fd, fd_set *setfds,
 
   FD_CLR(fd, setfds);
 
-  if (add_new_session(new_socket, dev, endpoint, CSM_NONE) < 0) {
+  if (add_new_session(new_socket, dev, endpoint, CSM_NONE) == NULL) {
     OC_ERR("could not record new TCP session");
     close(new_socket);
     return -1;
@@ -468,82 +591,6 @@ oc_tcp_end_session(ip_context_t *dev, oc_endpoint_t *endpoint)
   pthread_mutex_unlock(&mutex);
 }
 
-static int
-get_session_socket(oc_endpoint_t *endpoint)
-{
-  int sock = -1;
-  tcp_session_t *session = find_session_by_endpoint(endpoint);
-  if (!session) {
-    return -1;
-  }
-
-  sock = session->sock;
-  return sock;
-}
-
-static int
-connect_nonb(int sockfd, const struct sockaddr *r, int r_len, int nsec)
-{
-  int flags, n, error;
-  socklen_t len;
-  fd_set wset;
-  struct timeval tval;
-
-  flags = fcntl(sockfd, F_GETFL, 0);
-  if (flags < 0) {
-    return -1;
-  }
-
-  error = fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
-  if (error < 0) {
-    return -1;
-  }
-
-  error = 0;
-  if ((n = connect(sockfd, (struct sockaddr *)r, r_len)) < 0) {
-    if (errno != EINPROGRESS)
-      return -1;
-  }
-
-  /* Do whatever we want while the connect is taking place. */
-  if (n == 0) {
-    goto done; /* connect completed immediately */
-  }
-
-  FD_ZERO(&wset);
-  FD_SET(sockfd, &wset);
-  tval.tv_sec = nsec;
-  tval.tv_usec = 0;
-
-  if ((n = select(sockfd + 1, NULL, &wset, NULL, nsec ? &tval : NULL)) == 0) {
-    /* timeout */
-    errno = ETIMEDOUT;
-    return -1;
-  }
-
-  if (FD_ISSET(sockfd, &wset)) {
-    len = sizeof(error);
-    if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
-      return -1; /* Solaris pending error */
-  } else {
-    OC_DBG("select error: sockfd not set");
-    return -1;
-  }
-
-done:
-  if (error < 0) {
-    close(sockfd); /* just in case */
-    errno = error;
-    return -1;
-  } else {
-    error = fcntl(sockfd, F_SETFL, flags); /* restore file status flags */
-    if (error < 0) {
-      return -1;
-    }
-  }
-  return 0;
-}
-
 static void
 signal_network_thread(ip_context_t *dev)
 {
@@ -554,50 +601,67 @@ signal_network_thread(ip_context_t *dev)
   } while (len == -1 && errno == EINTR);
 }
 
-static int
+/* Starts a non-blocking connect. The session is returned straight away, the
+ * network thread completes the connection once the socket becomes writable
+ * and then flushes whatever has been queued in the meantime.
+ */
+static tcp_session_t *
 initiate_new_session(ip_context_t *dev, oc_endpoint_t *endpoint,
                      const struct sockaddr_storage *receiver)
 {
   int sock = -1;
-  uint8_t retry_cnt = 0;
-
-  while (retry_cnt < LIMIT_RETRY_CONNECT) {
-    if (endpoint->flags & IPV6) {
-      sock = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+  if (endpoint->flags & IPV6) {
+    sock = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
 #ifdef OC_IPV4
-    } else if (endpoint->flags & IPV4) {
-      sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  } else if (endpoint->flags & IPV4) {
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 #endif
-    }
-
-    if (sock < 0) {
-      OC_ERR("could not create socket for new TCP session");
-      return -1;
-    }
+  }
 
-    socklen_t receiver_size = sizeof(*receiver);
-    int ret = 0;
-    if ((ret = connect_nonb(sock, (struct sockaddr *)receiver, receiver_size,
-                            TCP_CONNECT_TIMEOUT)) == 0) {
-      break;
-    }
+  if (sock < 0) {
+    OC_ERR("could not create socket for new TCP session");
+    return NULL;
+  }
 
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+    OC_ERR("could not set new TCP session socket to non-blocking");
     close(sock);
-    retry_cnt++;
-    OC_DBG("connect fail with %d. retry(%d)", ret, retry_cnt);
+    return NULL;
   }
 
-  if (retry_cnt >= LIMIT_RETRY_CONNECT) {
-    OC_ERR("could not initiate TCP connection");
-    return -1;
+  bool connected = true;
+  socklen_t receiver_size = sizeof(*receiver);
+  if (connect(sock, (struct sockaddr *)receiver, receiver_size) < 0) {
+    if (errno != EINPROGRESS) {
+      OC_ERR("could not initiate TCP connection %d", errno);
+      close(sock);
+      return NULL;
+    }
+    connected = false;
   }
 
-  OC_DBG("successfully initiated TCP connection");
-
-  if (add_new_session(sock, dev, endpoint, CSM_SENT) < 0) {
+  tcp_session_t *session = add_new_session(sock, dev, endpoint, CSM_SENT);
+  if (!session) {
     OC_ERR("could not record new TCP session");
     close(sock);
-    return -1;
+    return NULL;
+  }
+  session->sock_flags = flags;
+
+  if (connected) {
+    /* the receive path reads whole messages with blocking recv() */
+    if (fcntl(sock, F_SETFL, flags) < 0) {
+      OC_ERR("could not restore TCP session socket flags");
+      free_tcp_session(session);
+      return NULL;
+    }
+    OC_DBG("successfully initiated TCP connection");
+  } else {
+    session->connect_deadline =
+      oc_clock_time() + TCP_CONNECT_TIMEOUT * OC_CLOCK_SECOND;
+    ip_context_wfds_fd_set(dev, sock);
+    OC_DBG("TCP connection in progress");
   }
 
   ip_context_rfds_fd_set(dev, sock);
@@ -605,53 +669,149 @@ initiate_new_session(ip_context_t *dev, oc_endpoint_t *endpoint,
   signal_network_thread(dev);
   OC_DBG("signaled network event thread to monitor the newly added session");
 
-  return sock;
+  return session;
+}
+
+static int
+complete_connect_locked(tcp_session_t *session)
+{
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(session->sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+    error = errno;
+  }
+  if (error != 0) {
+    OC_ERR("could not initiate TCP connection %d", error);
+    return -1;
+  }
+  if (fcntl(session->sock, F_SETFL, session->sock_flags) < 0) {
+    OC_ERR("could not restore TCP session socket flags");
+    return -1;
+  }
+  session->connect_deadline = 0;
+  OC_DBG("successfully initiated TCP connection");
+  return 0;
 }
 
 int
 oc_tcp_send_buffer(ip_context_t *dev, oc_message_t *message,
                    const struct sockaddr_storage *receiver)
 {
+  int ret = -1;
   pthread_mutex_lock(&mutex);
-  int send_sock = get_session_socket(&message->endpoint);
-
-  size_t bytes_sent = 0;
-  if (send_sock < 0) {
+  tcp_session_t *session = find_session_by_endpoint(&message->endpoint);
+  if (!session) {
     if (message->endpoint.flags & ACCEPTED) {
       OC_ERR("connection was closed");
       goto oc_tcp_send_buffer_done;
     }
-    if ((send_sock = initiate_new_session(dev, &message->endpoint, receiver)) <
-        0) {
+    session = initiate_new_session(dev, &message->endpoint, receiver);
+    if (!session) {
       OC_ERR("could not initiate new TCP session");
       goto oc_tcp_send_buffer_done;
     }
   }
 
-  send_sock = get_session_socket(&message->endpoint);
-  if (send_sock < 0) {
+  if (!session_queue_push(session, message)) {
+    OC_WRN("TCP session send queue is full");
     goto oc_tcp_send_buffer_done;
   }
+  ret = (int)message->length;
 
-  do {
-    ssize_t send_len = send(send_sock, message->data + bytes_sent,
-                            message->length - bytes_sent, MSG_NOSIGNAL);
-    if (send_len < 0) {
-      OC_WRN("send() returned errno %d", errno);
-      goto oc_tcp_send_buffer_done;
-    }
-    bytes_sent += send_len;
-  } while (bytes_sent < message->length);
+  if (session->connect_deadline != 0) {
+    /* flushed by the network thread once connected */
+    goto oc_tcp_send_buffer_done;
+  }
+
+  int status = flush_session_locked(session);
+  if (status < 0) {
+    free_tcp_session_async_locked(session);
+    ret = -1;
+  } else if (status > 0) {
+    ip_context_wfds_fd_set(dev, session->sock);
+    signal_network_thread(dev);
+  }
 
-  OC_DBG("Sent %zd bytes", bytes_sent);
 oc_tcp_send_buffer_done:
   pthread_mutex_unlock(&mutex);
+  return ret;
+}
 
-  if (bytes_sent == 0) {
-    return -1;
+int
+oc_tcp_process_writable(ip_context_t *dev, fd_set *rfds, fd_set *wfds)
+{
+  int handled = 0;
+  oc_clock_time_t now = oc_clock_time();
+
+  pthread_mutex_lock(&mutex);
+  process_free_tcp_session_locked();
+  tcp_session_t *session = (tcp_session_t *)oc_list_head(session_list), *next;
+  while (session != NULL) {
+    next = session->next;
+    if (session->dev != dev) {
+      session = next;
+      continue;
+    }
+
+    int status = 0;
+    if (FD_ISSET(session->sock, wfds)) {
+      FD_CLR(session->sock, wfds);
+      handled++;
+      if (session->connect_deadline != 0 &&
+          complete_connect_locked(session) < 0) {
+        status = -1;
+      } else {
+        status = flush_session_locked(session);
+      }
+      if (status == 0) {
+        ip_context_wfds_fd_clr(dev, session->sock);
+      }
+    } else if (session->connect_deadline != 0 &&
+               now >= session->connect_deadline) {
+      OC_ERR("TCP connection timed out");
+      status = -1;
+    }
+
+    if (status < 0) {
+      /* the descriptor may be reused by an accept() in this iteration */
+      if (FD_ISSET(session->sock, rfds)) {
+        FD_CLR(session->sock, rfds);
+        handled++;
+      }
+      free_tcp_session(session);
+    }
+    session = next;
   }
+  pthread_mutex_unlock(&mutex);
 
-  return bytes_sent;
+  return handled;
+}
+
+bool
+oc_tcp_get_connect_timeout(ip_context_t *dev, struct timeval *timeout)
+{
+  oc_clock_time_t deadline = 0;
+
+  pthread_mutex_lock(&mutex);
+  tcp_session_t *session = (tcp_session_t *)oc_list_head(session_list);
+  for (; session != NULL; session = session->next) {
+    if (session->dev == dev && session->connect_deadline != 0 &&
+        (deadline == 0 || session->connect_deadline < deadline)) {
+      deadline = session->connect_deadline;
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  if (deadline == 0) {
+    return false;
+  }
+
+  oc_clock_time_t now = oc_clock_time();
+  oc_clock_time_t left = (deadline > now) ? deadline - now : 0;
+  timeout->tv_sec = (time_t)(left / OC_CLOCK_SECOND);
+  timeout->tv_usec =
+    (suseconds_t)((left % OC_CLOCK_SECOND) * 1000000 / OC_CLOCK_SECOND);
+  return true;
 }
 
 #ifdef OC_IPV4
@@ -876,4 +1036,42 @@ oc_tcp_update_csm_state(oc_endpoint_t *endpoint, tcp_csm_state_t csm)
   session->csm_state = csm;
   return 0;
 }
+
+int
+oc_tcp_update_csm_options(oc_endpoint_t *endpoint, uint32_t max_message_size,
+                          bool bert)
+{
+  if (!endpoint) {
+    return -1;
+  }
+
+  tcp_session_t *session = find_session_by_endpoint(endpoint);
+  if (!session) {
+    return -1;
+  }
+
+  session->peer_max_message_size = max_message_size;
+  session->peer_bert = bert;
+  return 0;
+}
+
+int
+oc_tcp_get_csm_options(oc_endpoint_t *endpoint, uint32_t *max_message_size,
+                       bool *bert)
+{
+  *max_message_size = OC_TCP_DEFAULT_MAX_MESSAGE_SIZE;
+  *bert = false;
+  if (!endpoint) {
+    return -1;
+  }
+
+  tcp_session_t *session = find_session_by_endpoint(endpoint);
+  if (!session) {
+    return -1;
+  }
+
+  *max_message_size = session->peer_max_message_size;
+  *bert = session->peer_bert;
+  return 0;
+}
 #endif /* OC_TCP */
@@ -21,7 +21,9 @@
 
 #include "ipcontext.h"
 #include "port/oc_connectivity.h"
+#include <stdbool.h>
 #include <sys/select.h>
+#include <sys/time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,9 +33,24 @@ int oc_tcp_connectivity_init(ip_context_t *dev);
 
 void oc_tcp_connectivity_shutdown(ip_context_t *dev);
 
+/* Queues the message on the session of its endpoint and writes as much as
+ * the socket accepts without blocking. Returns -1 when the session could not
+ * be set up or its send queue is full.
+ */
 int oc_tcp_send_buffer(ip_context_t *dev, oc_message_t *message,
                        const struct sockaddr_storage *receiver);
 
+/* Completes pending connects and flushes the send queues of the sessions in
+ * wfds, and drops connects that timed out. Returns the number of descriptors
+ * consumed from rfds and wfds.
+ */
+int oc_tcp_process_writable(ip_context_t *dev, fd_set *rfds, fd_set *wfds);
+
+/* Time left until the earliest pending connect of the device times out.
+ * Returns false when no connect is pending.
+ */
+bool oc_tcp_get_connect_timeout(ip_context_t *dev, struct timeval *timeout);
+
 void oc_tcp_add_socks_to_fd_set(ip_context_t *dev);
 
 void oc_tcp_set_session_fds(fd_set *fds);
@@ -27,6 +27,7 @@
 #include "oc_session_events.h"
 #include "port/oc_log.h"
 #include "util/oc_process.h"
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -102,6 +103,11 @@ extern "C" {
 #define OC_MAX_APP_DATA_SIZE (oc_get_max_app_data_size())
 #endif /* OC_DYNAMIC_ALLOCATION */
 
+#if defined(OC_MESSAGE_SIZE_CLASSES) &&                                        \
+  (!defined(OC_DYNAMIC_ALLOCATION) || defined(OC_INOUT_BUFFER_SIZE))
+#error "OC_MESSAGE_SIZE_CLASSES is not supported with fixed size buffers"
+#endif
+
 struct oc_message_s
 {
   struct oc_message_s *next;
@@ -115,6 +121,10 @@ struct oc_message_s
   uint8_t data[OC_INOUT_BUFFER_SIZE];
 #else  /* OC_INOUT_BUFFER_SIZE */
   uint8_t *data;
+#ifdef OC_MESSAGE_SIZE_CLASSES
+  /* capacity of data */
+  size_t size;
+#endif /* OC_MESSAGE_SIZE_CLASSES */
 #endif /* !OC_INOUT_BUFFER_SIZE */
 #else  /* OC_DYNAMIC_ALLOCATION */
   uint8_t data[OC_PDU_SIZE];
@@ -271,6 +281,36 @@ tcp_csm_state_t oc_tcp_get_csm_state(oc_endpoint_t *endpoint);
  * @return int 0 = success
  */
 int oc_tcp_update_csm_state(oc_endpoint_t *endpoint, tcp_csm_state_t csm);
+
+/**
+ * @brief Max-Message-Size of a peer that has not sent a CSM (RFC 8323)
+ */
+#define OC_TCP_DEFAULT_MAX_MESSAGE_SIZE (1152)
+
+/**
+ * @brief store the options of the CSM received on the tcp connection
+ *
+ * @param endpoint the endpoint
+ * @param max_message_size the Max-Message-Size of the peer
+ * @param bert the peer supports block-wise transfer, including BERT
+ * @return int 0 = success
+ */
+int oc_tcp_update_csm_options(oc_endpoint_t *endpoint,
+                              uint32_t max_message_size, bool bert);
+
+/**
+ * @brief retrieve the options of the CSM received on the tcp connection
+ *
+ * Before a CSM has been received, the Max-Message-Size is
+ * OC_TCP_DEFAULT_MAX_MESSAGE_SIZE and BERT is not supported.
+ *
+ * @param endpoint the endpoint
+ * @param max_message_size the Max-Message-Size of the peer
+ * @param bert the peer supports block-wise transfer, including BERT
+ * @return int 0 = success
+ */
+int oc_tcp_get_csm_options(oc_endpoint_t *endpoint,
+                           uint32_t *max_message_size, bool *bert);
 #endif /* OC_TCP */
 
 #ifdef __cplusplus
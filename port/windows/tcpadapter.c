@@ -51,6 +51,8 @@ typedef struct tcp_session
   SOCKET sock;
   HANDLE sock_event;
   tcp_csm_state_t csm_state;
+  uint32_t peer_max_message_size;
+  bool peer_bert;
 } tcp_session_t;
 
 OC_LIST(session_list);
@@ -236,6 +238,8 @@ add_new_session_locked(SOCKET sock, ip_context_t *dev, oc_endpoint_t *endpoint,
   session->endpoint.next = NULL;
   session->sock = sock;
   session->csm_state = state;
+  session->peer_max_message_size = OC_TCP_DEFAULT_MAX_MESSAGE_SIZE;
+  session->peer_bert = false;
   session->sock_event = sock_event;
 
   oc_list_add(session_list, session);
@@ -1107,4 +1111,48 @@ oc_tcp_update_csm_state(oc_endpoint_t *endpoint, tcp_csm_state_t csm)
   return 0;
 }
 
+int
+oc_tcp_update_csm_options(oc_endpoint_t *endpoint, uint32_t max_message_size,
+                          bool bert)
+{
+  if (!endpoint) {
+    return -1;
+  }
+
+  oc_tcp_adapter_mutex_lock();
+  tcp_session_t *session = find_session_by_endpoint_locked(endpoint);
+  if (!session) {
+    oc_tcp_adapter_mutex_unlock();
+    return -1;
+  }
+  session->peer_max_message_size = max_message_size;
+  session->peer_bert = bert;
+  oc_tcp_adapter_mutex_unlock();
+
+  return 0;
+}
+
+int
+oc_tcp_get_csm_options(oc_endpoint_t *endpoint, uint32_t *max_message_size,
+                       bool *bert)
+{
+  *max_message_size = OC_TCP_DEFAULT_MAX_MESSAGE_SIZE;
+  *bert = false;
+  if (!endpoint) {
+    return -1;
+  }
+
+  oc_tcp_adapter_mutex_lock();
+  tcp_session_t *session = find_session_by_endpoint_locked(endpoint);
+  if (!session) {
+    oc_tcp_adapter_mutex_unlock();
+    return -1;
+  }
+  *max_message_size = session->peer_max_message_size;
+  *bert = session->peer_bert;
+  oc_tcp_adapter_mutex_unlock();
+
+  return 0;
+}
+
 #endif /* OC_TCP */
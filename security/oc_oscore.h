@@ -32,6 +32,48 @@ void oc_oscore_set_next_ssn(uint64_t ssn);
 uint64_t oc_oscore_get_next_ssn();
 bool oc_oscore_is_g_ssn_in_use();
 
+/**
+ * @brief verify and decrypt a received OSCORE message and hand it to the CoAP
+ * engine, as for an INBOUND_OSCORE_EVENT
+ *
+ * @param message the received message, the reference is released
+ * @return 0 on success, -1 on error
+ */
+int oc_oscore_recv_message(oc_message_t *message);
+
+/**
+ * @brief protect a unicast message and send it, as for an
+ * OUTBOUND_OSCORE_EVENT
+ *
+ * @param message the serialized CoAP message, the reference is released
+ * @return 0 on success, -1 on error
+ */
+int oc_oscore_send_message(oc_message_t *message);
+
+#ifdef OC_CLIENT
+/**
+ * @brief protect a group (multicast) message and send it, as for an
+ * OUTBOUND_GROUP_OSCORE_EVENT
+ *
+ * @param message the serialized CoAP message, the reference is released
+ * @return 0 on success, -1 on error
+ */
+int oc_oscore_send_multicast_message(oc_message_t *message);
+
+/**
+ * @brief protect a group (multicast) message in place with the group OSCORE
+ * context of message->endpoint.group_address
+ *
+ * On success OSCORE_ENCRYPTED is set on the endpoint, so that copies of the
+ * protected message can be sent to other multicast destinations without
+ * protecting (and consuming an SSN) again.
+ *
+ * @param message the serialized CoAP message
+ * @return 0 on success, -1 on error
+ */
+int oc_oscore_protect_multicast_message(oc_message_t *message);
+#endif /* OC_CLIENT */
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,22 +29,70 @@
 #include "oc_rep.h"
 //#include "oc_store.h"
 #include "port/oc_log.h"
+
+#ifndef OC_MAX_OSCORE_CONTEXTS
+#define OC_MAX_OSCORE_CONTEXTS (20)
+#endif
+
 OC_LIST(contexts);
-OC_MEMB(ctx_s, oc_oscore_context_t, 20);
+OC_MEMB(ctx_s, oc_oscore_context_t, OC_MAX_OSCORE_CONTEXTS);
+/* counted, so that the cache is also bounded with dynamic allocation */
+static int num_contexts = 0;
 
-void
-oc_oscore_free_lru_recipient_context(void)
+/* recipient contexts (no sender id) can be made again from the auth/at table,
+ * these are kept in LRU order and are evicted when the cache is full */
+static oc_oscore_context_t *lru_head = NULL;
+static oc_oscore_context_t *lru_tail = NULL;
+
+static bool
+is_recipient_context(const oc_oscore_context_t *ctx)
 {
-  oc_oscore_context_t *ctx, *lru_ctx;
-  ctx = lru_ctx = oc_list_head(contexts);
+  return ctx->sendid_len == 0;
+}
 
-  while (ctx != NULL) {
-    if (ctx->sendid_len == 0 && ctx->last_used < lru_ctx->last_used)
-      lru_ctx = ctx;
+static void
+lru_remove(oc_oscore_context_t *ctx)
+{
+  if (ctx->lru_prev) {
+    ctx->lru_prev->lru_next = ctx->lru_next;
+  } else if (lru_head == ctx) {
+    lru_head = ctx->lru_next;
+  }
+  if (ctx->lru_next) {
+    ctx->lru_next->lru_prev = ctx->lru_prev;
+  } else if (lru_tail == ctx) {
+    lru_tail = ctx->lru_prev;
+  }
+  ctx->lru_prev = ctx->lru_next = NULL;
+}
 
-    ctx = ctx->next;
+static void
+lru_append(oc_oscore_context_t *ctx)
+{
+  ctx->lru_prev = lru_tail;
+  ctx->lru_next = NULL;
+  if (lru_tail) {
+    lru_tail->lru_next = ctx;
+  } else {
+    lru_head = ctx;
   }
-  oc_oscore_free_context(lru_ctx);
+  lru_tail = ctx;
+}
+
+static void
+context_touch(oc_oscore_context_t *ctx)
+{
+  ctx->last_used = oc_clock_time();
+  if (is_recipient_context(ctx) && lru_tail != ctx) {
+    lru_remove(ctx);
+    lru_append(ctx);
+  }
+}
+
+void
+oc_oscore_free_lru_recipient_context(void)
+{
+  oc_oscore_free_context(lru_head);
 }
 
 // checking against receiver in contexts
@@ -70,7 +118,7 @@ oc_oscore_find_context_by_kid(oc_oscore_context_t *ctx, size_t device_index,
     if (kid_len == ctx->recvid_len && memcmp(kid, ctx->recvid, kid_len) == 0) {
       PRINT("oc_oscore_find_context_by_kid FOUND  auth/at index: %d\n",
             ctx->auth_at_index);
-      ctx->last_used = oc_clock_time();
+      context_touch(ctx);
       return ctx;
     }
     ctx = ctx->next;
@@ -104,7 +152,7 @@ oc_oscore_find_context_by_kid_idctx(oc_oscore_context_t *ctx,
         memcmp(kid_ctx, ctx->idctx, kid_ctx_len) == 0) {
       PRINT("oc_oscore_find_context_by_kid_idctx FOUND  auth/at index: %d\n",
             ctx->auth_at_index);
-      ctx->last_used = oc_clock_time();
+      context_touch(ctx);
       return ctx;
     }
     ctx = ctx->next;
@@ -171,7 +219,7 @@ oc_oscore_find_context_by_token_mid(size_t device, uint8_t *token,
     if (memcmp(oscore_id, ctx->sendid, oscore_id_len) == 0) {
       PRINT("oc_oscore_find_context_by_token_mid FOUND auth/at index: %d\n",
             ctx->auth_at_index);
-      ctx->last_used = oc_clock_time();
+      context_touch(ctx);
       return ctx;
     }
     ctx = ctx->next;
@@ -214,7 +262,7 @@ oc_oscore_find_context_by_oscore_id(size_t device, char *oscore_id,
             ctx->auth_at_index);
       OC_DBG_OSCORE("    Common IV:");
       OC_LOGbytes_OSCORE(ctx->commoniv, OSCORE_COMMON_IV_LEN);
-      ctx->last_used = oc_clock_time();
+      context_touch(ctx);
       return ctx;
     }
     ctx = ctx->next;
@@ -257,7 +305,7 @@ oc_oscore_find_context_by_rid(size_t device, char *rid, size_t rid_len)
             ctx->auth_at_index);
       OC_DBG_OSCORE("    Common IV:");
       OC_LOGbytes_OSCORE(ctx->commoniv, OSCORE_COMMON_IV_LEN);
-      ctx->last_used = oc_clock_time();
+      context_touch(ctx);
       return ctx;
     }
     ctx = ctx->next;
@@ -284,7 +332,7 @@ oc_oscore_find_context_by_group_address(size_t device, uint32_t group_address)
           "   oc_oscore_find_context_by_group_address : find: %u value: %u\n",
           group_address, group_value);
         if (group_address == group_value) {
-          ctx->last_used = oc_clock_time();
+          context_touch(ctx);
           return ctx;
         }
       }
@@ -304,6 +352,8 @@ oc_oscore_free_all_contexts()
     ctx = next;
   }
   oc_list_init(contexts);
+  lru_head = lru_tail = NULL;
+  num_contexts = 0;
 }
 
 void
@@ -337,11 +387,50 @@ oc_oscore_free_context(oc_oscore_context_t *ctx)
     if (ctx->desc.size > 0) {
       oc_free_string(&ctx->desc);
     }
+    if (is_recipient_context(ctx)) {
+      lru_remove(ctx);
+    }
     oc_list_remove(contexts, ctx);
     oc_memb_free(&ctx_s, ctx);
+    num_contexts--;
   }
 }
 
+static bool
+at_param_equal(oc_string_t param, const char *value, int value_size)
+{
+  return (int)oc_byte_string_len(param) == value_size &&
+         (value_size == 0 || memcmp(oc_string(param), value, value_size) == 0);
+}
+
+/* the derived keys of the auth/at entry of the context, when the context is
+ * made from the parameters of that entry. id_is_sender tells whether the
+ * sender id of the context is the osc_id of the entry. */
+static oc_at_derived_keys_t *
+context_at_keys(const oc_oscore_context_t *ctx, const char *mastersecret,
+                int mastersecret_size, const char *salt, int salt_size,
+                bool *id_is_sender)
+{
+  oc_auth_at_t *entry = oc_get_auth_at_entry(ctx->device, ctx->auth_at_index);
+  if (entry == NULL ||
+      !at_param_equal(entry->osc_ms, mastersecret, mastersecret_size) ||
+      !at_param_equal(entry->osc_salt, salt, salt_size)) {
+    return NULL;
+  }
+  const char *sendid = (const char *)ctx->sendid;
+  const char *recvid = (const char *)ctx->recvid;
+  if (at_param_equal(entry->osc_id, sendid, ctx->sendid_len) &&
+      at_param_equal(entry->osc_rid, recvid, ctx->recvid_len)) {
+    *id_is_sender = true;
+  } else if (at_param_equal(entry->osc_id, recvid, ctx->recvid_len) &&
+             at_param_equal(entry->osc_rid, sendid, ctx->sendid_len)) {
+    *id_is_sender = false;
+  } else {
+    return NULL;
+  }
+  return oc_core_get_at_derived_keys(ctx->device, ctx->auth_at_index);
+}
+
 oc_oscore_context_t *
 oc_oscore_add_context(size_t device, const char *senderid, int senderid_size,
                       const char *recipientid, int recipientid_size,
@@ -352,12 +441,7 @@ oc_oscore_add_context(size_t device, const char *senderid, int senderid_size,
 {
   PRINT("-----oc_oscore_add_context--SID:");
   oc_char_println_hex(senderid, senderid_size);
-  oc_oscore_context_t *ctx = (oc_oscore_context_t *)oc_memb_alloc(&ctx_s);
 
-  if (!ctx) {
-    OC_ERR("No memory for allocating context!!!");
-    return NULL;
-  }
   if (!senderid && !recipientid && !mastersecret) {
     OC_ERR("No sender or recipient ID or Master secret");
     return NULL;
@@ -382,6 +466,21 @@ oc_oscore_add_context(size_t device, const char *senderid, int senderid_size,
     return NULL;
   }
 
+  if (num_contexts >= OC_MAX_OSCORE_CONTEXTS) {
+    if (lru_head == NULL) {
+      OC_ERR("context cache is full with sender contexts");
+      return NULL;
+    }
+    PRINT("  context cache full, freeing LRU recipient context\n");
+    oc_oscore_free_lru_recipient_context();
+  }
+  oc_oscore_context_t *ctx = (oc_oscore_context_t *)oc_memb_alloc(&ctx_s);
+  if (!ctx) {
+    OC_ERR("No memory for allocating context!!!");
+    return NULL;
+  }
+  memset(ctx, 0, sizeof(oc_oscore_context_t));
+
   ctx->device = device;
   ctx->ssn = ssn;
   ctx->auth_at_index = auth_at_index;
@@ -454,6 +553,22 @@ oc_oscore_add_context(size_t device, const char *senderid, int senderid_size,
     memcpy((char *)&ctx->master_secret, mastersecret, mastersecret_size);
   }
 
+  bool id_is_sender = true;
+  oc_at_derived_keys_t *keys =
+    context_at_keys(ctx, mastersecret, mastersecret_size, salt, salt_size,
+                    &id_is_sender);
+  if (keys && keys->valid && keys->idctx_len == ctx->idctx_len &&
+      memcmp(keys->idctx, ctx->idctx, ctx->idctx_len) == 0) {
+    OC_DBG_OSCORE("### using keys derived for auth/at entry %d ###",
+                  auth_at_index);
+    memcpy(ctx->sendkey, id_is_sender ? keys->id_key : keys->rid_key,
+           OSCORE_KEY_LEN);
+    memcpy(ctx->recvkey, id_is_sender ? keys->rid_key : keys->id_key,
+           OSCORE_KEY_LEN);
+    memcpy(ctx->commoniv, keys->commoniv, OSCORE_COMMON_IV_LEN);
+    goto add_oscore_context_done;
+  }
+
   OC_DBG_OSCORE("### Reading OSCORE context ###");
   OC_DBG_OSCORE("### \t\tderiving Sender key ###");
   if (oc_oscore_context_derive_param(
@@ -496,12 +611,31 @@ oc_oscore_add_context(size_t device, const char *senderid, int senderid_size,
   OC_LOGbytes_OSCORE(ctx->commoniv, OSCORE_COMMON_IV_LEN);
   OC_DBG_OSCORE("### derived Common IV ###");
 
+  if (keys) {
+    memcpy(keys->idctx, ctx->idctx, ctx->idctx_len);
+    keys->idctx_len = ctx->idctx_len;
+    memcpy(keys->id_key, id_is_sender ? ctx->sendkey : ctx->recvkey,
+           OSCORE_KEY_LEN);
+    memcpy(keys->rid_key, id_is_sender ? ctx->recvkey : ctx->sendkey,
+           OSCORE_KEY_LEN);
+    memcpy(keys->commoniv, ctx->commoniv, OSCORE_COMMON_IV_LEN);
+    keys->valid = true;
+  }
+
+add_oscore_context_done:
   oc_list_add(contexts, ctx);
+  num_contexts++;
+  if (is_recipient_context(ctx)) {
+    lru_append(ctx);
+  }
 
   return ctx;
 
 add_oscore_context_error:
   OC_DBG_OSCORE("Encountered error while adding new context!");
+  if (ctx->desc.size > 0) {
+    oc_free_string(&ctx->desc);
+  }
   oc_memb_free(&ctx_s, ctx);
   return NULL;
 }
@@ -84,6 +84,9 @@ typedef struct oc_oscore_context_t
   uint8_t commoniv[OSCORE_COMMON_IV_LEN];
   /* Time of last use, for runtime caching of recipient contexts */
   oc_clock_time_t last_used;
+  /* LRU list of the recipient contexts, least recently used first */
+  struct oc_oscore_context_t *lru_prev;
+  struct oc_oscore_context_t *lru_next;
 } oc_oscore_context_t;
 
 /**
@@ -140,6 +143,10 @@ void oc_oscore_free_contexts_at_id(int auth_at_index);
  *
  * Note: OSCORE context is also a field.
  *
+ * At most OC_MAX_OSCORE_CONTEXTS contexts exist, when the cache is full the
+ * least recently used recipient context is freed. The derived keys are taken
+ * from the auth/at entry when it was derived from the same parameters before.
+ *
  * @param device the device index
  *
  * @param senderid the SID
@@ -172,8 +179,8 @@ oc_oscore_context_t *oc_oscore_add_context(
 /**
  * @brief Free the least recently used recipient context
  *
- * The use times are updated when the contexts are created or found using the
- * find_context_by_* functions
+ * The contexts move to the end of the LRU list when they are created or found
+ * using the find_context_by_* functions
  *
  */
 void oc_oscore_free_lru_recipient_context(void);
@@ -88,7 +88,7 @@ dump_cred(void *data)
   return OC_EVENT_DONE;
 }
 
-static int
+int
 oc_oscore_recv_message(oc_message_t *message)
 {
   /* OSCORE layer receive path pseudocode
@@ -212,25 +212,12 @@ oc_oscore_recv_message(oc_message_t *message)
           oc_byte_string_len(at_entry->osc_salt), oscore_pkt->kid_ctx,
           oscore_pkt->kid_ctx_len, idx, false);
 
-        // if context is null, free one & try adding again
+        // the context cache frees the least recently used recipient context
+        // when it is full, so this only fails on invalid parameters
         if (!oscore_ctx) {
-          oc_oscore_free_lru_recipient_context();
-          oscore_ctx = oc_oscore_add_context(
-            0, oc_string(at_entry->osc_rid), /* sender id (empty string) */
-            oc_byte_string_len(
-              at_entry->osc_rid),        /* sender id len (ought to be 0)*/
-            oc_string(at_entry->osc_id), /* recipient id */
-            oc_byte_string_len(at_entry->osc_id), /* recipient id len */
-            0, "desc", oc_string(at_entry->osc_ms),
-            oc_byte_string_len(at_entry->osc_ms), oc_string(at_entry->osc_salt),
-            oc_byte_string_len(at_entry->osc_salt), oscore_pkt->kid_ctx,
-            oscore_pkt->kid_ctx_len, idx, false);
-          if (!oscore_ctx) {
-            OC_ERR("***Could not create oscore recipient context!***");
-            oscore_send_error(oscore_pkt, UNAUTHORIZED_4_01,
-                              &message->endpoint);
-            goto oscore_recv_error;
-          }
+          OC_ERR("***Could not create oscore recipient context!***");
+          oscore_send_error(oscore_pkt, UNAUTHORIZED_4_01, &message->endpoint);
+          goto oscore_recv_error;
         }
       }
     } else {
@@ -440,10 +427,14 @@ oc_oscore_recv_message(oc_message_t *message)
   OC_DBG_OSCORE("#################################");
 
   /* Dispatch oc_message_t to the CoAP layer */
+#ifdef OC_DIRECT_DISPATCH
+  coap_engine_dispatch(message);
+#else  /* OC_DIRECT_DISPATCH */
   if (oc_process_post(&coap_engine, oc_events[INBOUND_RI_EVENT], message) ==
       OC_PROCESS_ERR_FULL) {
     goto oscore_recv_error;
   }
+#endif /* !OC_DIRECT_DISPATCH */
   return 0;
 
 oscore_recv_error:
@@ -452,8 +443,8 @@ oscore_recv_error:
 }
 
 #ifdef OC_CLIENT
-static int
-oc_oscore_send_multicast_message(oc_message_t *message)
+int
+oc_oscore_protect_multicast_message(oc_message_t *message)
 {
   /* OSCORE layer secure multicast pseudocode
    * ----------------------------------------
@@ -474,7 +465,6 @@ oc_oscore_send_multicast_message(oc_message_t *message)
    *   Set OSCORE packet payload length to the plain text size + tag length (8)
    *   Set OSCORE option in OSCORE packet
    *   Serialize OSCORE message to oc_message_t
-   * Dispatch oc_message_t to IP layer
    */
   uint32_t group_address = 0;
 
@@ -612,7 +602,23 @@ oc_oscore_send_multicast_message(oc_message_t *message)
     OC_DBG_OSCORE("### serialized OSCORE message ###");
   } else {
     OC_ERR("*** could not find group OSCORE context ***");
-    goto oscore_group_send_error;
+    return -1;
+  }
+
+  message->endpoint.flags |= OSCORE_ENCRYPTED;
+  return 0;
+
+oscore_group_send_error:
+  OC_ERR("received malformed CoAP packet from stack");
+  return -1;
+}
+
+int
+oc_oscore_send_multicast_message(oc_message_t *message)
+{
+  if (oc_oscore_protect_multicast_message(message) != 0) {
+    oc_message_unref(message);
+    return -1;
   }
 
   OC_DBG_OSCORE("#################################");
@@ -621,15 +627,10 @@ oc_oscore_send_multicast_message(oc_message_t *message)
   oc_send_discovery_request(message);
   oc_message_unref(message);
   return 0;
-
-oscore_group_send_error:
-  OC_ERR("received malformed CoAP packet from stack");
-  oc_message_unref(message);
-  return -1;
 }
 #endif /* OC_CLIENT */
 
-static int
+int
 oc_oscore_send_message(oc_message_t *msg)
 {
   /* OSCORE layer sending path pseudocode
@@ -1071,11 +1072,16 @@ oscore_send_dispatch:
 #ifdef OC_CLIENT
   /* Dispatch oc_message_t to the message buffer layer */
   OC_DBG_OSCORE("Outbound network event: OUTBOUND_NETWORK_EVENT_ENCRYPTED");
+#ifdef OC_DIRECT_DISPATCH
+  oc_send_buffer(message);
+  oc_message_unref(message);
+#else  /* OC_DIRECT_DISPATCH */
   if (oc_process_post(&message_buffer_handler,
                       oc_events[OUTBOUND_NETWORK_EVENT_ENCRYPTED],
                       message) == OC_PROCESS_ERR_FULL) {
     OC_ERR(" could not send message");
   }
+#endif /* !OC_DIRECT_DISPATCH */
   return 0;
 #endif /* OC_CLIENT */
 
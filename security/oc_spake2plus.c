@@ -22,7 +22,9 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/hkdf.h"
 #include "mbedtls/pkcs5.h"
+#include "mbedtls/sha256.h"
 #include <assert.h>
+#include <stdlib.h>
 
 #include "oc_spake2plus.h"
 #include "port/oc_random.h"
@@ -70,6 +72,88 @@ struct spake_parameters
   uint32_t iter;
 } g_spake_parameters;
 
+#ifndef OC_SPAKE_W0_L_CACHE_SIZE
+#define OC_SPAKE_W0_L_CACHE_SIZE (2)
+#endif /* OC_SPAKE_W0_L_CACHE_SIZE */
+
+/* w0 and L only depend on the password, the salt and the number of PBKDF2
+ * iterations, so they are cached to avoid running PBKDF2 again when a client
+ * repeats the handshake with the same parameters.
+ * Entries are keyed by a SHA-256 digest of the inputs, the password itself is
+ * not stored. The cache is only accessed from the event loop.
+ */
+typedef struct w0_L_cache_entry_t
+{
+  uint8_t key[32];
+  uint32_t last_used; /* 0: entry not in use */
+  mbedtls_mpi w0;
+  mbedtls_ecp_point L;
+} w0_L_cache_entry_t;
+
+static w0_L_cache_entry_t w0_L_cache[OC_SPAKE_W0_L_CACHE_SIZE];
+static uint32_t w0_L_cache_clock;
+
+size_t encode_string(const char *str, uint8_t *buffer);
+size_t encode_uint(uint64_t value, uint8_t *buffer);
+static int calc_w0_L(const char *pw, size_t len_salt, const uint8_t *salt,
+                     int it, mbedtls_mpi *w0, mbedtls_ecp_point *L,
+                     mbedtls_ctr_drbg_context *rng);
+
+static void
+w0_L_cache_clear(void)
+{
+  for (size_t i = 0; i < OC_SPAKE_W0_L_CACHE_SIZE; i++) {
+    mbedtls_mpi_free(&w0_L_cache[i].w0);
+    mbedtls_ecp_point_free(&w0_L_cache[i].L);
+    memset(w0_L_cache[i].key, 0, sizeof(w0_L_cache[i].key));
+    w0_L_cache[i].last_used = 0;
+  }
+  w0_L_cache_clock = 0;
+}
+
+static int
+w0_L_cache_key(const char *pw, size_t len_salt, const uint8_t *salt, int it,
+               uint8_t key[32])
+{
+  size_t len_input = 0;
+  uint8_t *input = malloc(3 * sizeof(uint64_t) + strlen(pw) + len_salt);
+  if (input == NULL) {
+    return -1;
+  }
+  len_input += encode_string(pw, input + len_input);
+  len_input += encode_uint(len_salt, input + len_input);
+  memcpy(input + len_input, salt, len_salt);
+  len_input += len_salt;
+  len_input += encode_uint((uint64_t)it, input + len_input);
+  mbedtls_sha256(input, len_input, key, 0);
+  memset(input, 0, len_input);
+  free(input);
+  return 0;
+}
+
+static w0_L_cache_entry_t *
+w0_L_cache_find(const uint8_t key[32])
+{
+  for (size_t i = 0; i < OC_SPAKE_W0_L_CACHE_SIZE; i++) {
+    if (w0_L_cache[i].last_used != 0 &&
+        memcmp(w0_L_cache[i].key, key, sizeof(w0_L_cache[i].key)) == 0) {
+      return &w0_L_cache[i];
+    }
+  }
+  return NULL;
+}
+
+static int
+copy_w0_L(mbedtls_mpi *w0_dst, mbedtls_ecp_point *L_dst,
+          const mbedtls_mpi *w0_src, const mbedtls_ecp_point *L_src)
+{
+  int ret;
+  MBEDTLS_MPI_CHK(mbedtls_mpi_copy(w0_dst, w0_src));
+  MBEDTLS_MPI_CHK(mbedtls_ecp_copy(L_dst, L_src));
+cleanup:
+  return ret;
+}
+
 int
 oc_spake_init(void)
 {
@@ -80,6 +164,21 @@ oc_spake_init(void)
   MBEDTLS_MPI_CHK(mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1));
 
   ctr_drbg_ctx = oc_random_get_ctr_drbg_context();
+#ifdef OC_CRYPTO_WORKER
+  {
+    /* mbedTLS stores the precomputed multiples of the generator in the group
+     * on first use. Compute them now, so that the group is only read when it
+     * is shared with the crypto worker threads. */
+    mbedtls_mpi d;
+    mbedtls_ecp_point Q;
+    mbedtls_mpi_init(&d);
+    mbedtls_ecp_point_init(&Q);
+    ret = mbedtls_ecp_gen_keypair(&grp, &d, &Q, mbedtls_ctr_drbg_random,
+                                  ctr_drbg_ctx);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_point_free(&Q);
+  }
+#endif /* OC_CRYPTO_WORKER */
 cleanup:
   return ret;
 }
@@ -87,6 +186,7 @@ cleanup:
 int
 oc_spake_free(void)
 {
+  w0_L_cache_clear();
   mbedtls_ecp_group_free(&grp);
   return 0;
 }
@@ -101,6 +201,8 @@ void
 oc_spake_set_password(char *new_pass)
 {
   strncpy(password, new_pass, sizeof(password));
+  // cached values were derived from the previous password
+  w0_L_cache_clear();
 }
 
 int
@@ -165,20 +267,77 @@ oc_spake_get_pbkdf_params(uint8_t rnd[32], uint8_t salt[32], int *it)
   return oc_spake_parameter_exchange(rnd, salt, it);
 }
 
+int
+oc_spake_lookup_w0_L(const char *pw, size_t len_salt, const uint8_t *salt,
+                     int it, mbedtls_mpi *w0, mbedtls_ecp_point *L)
+{
+  uint8_t key[32];
+
+  // the pre-loaded parameters are only valid for their own salt & iterations
+  if (g_spake_parameters.loaded == 1 &&
+      len_salt == sizeof(g_spake_parameters.salt) &&
+      memcmp(g_spake_parameters.salt, salt, len_salt) == 0 &&
+      g_spake_parameters.iter == (uint32_t)it &&
+      oc_spake_get_parameters(NULL, NULL, NULL, w0, L) == 0) {
+    return 0;
+  }
+
+  if (w0_L_cache_key(pw, len_salt, salt, it, key) != 0) {
+    return 1;
+  }
+  w0_L_cache_entry_t *entry = w0_L_cache_find(key);
+  if (entry == NULL || copy_w0_L(w0, L, &entry->w0, &entry->L) != 0) {
+    return 1;
+  }
+  entry->last_used = ++w0_L_cache_clock;
+  return 0;
+}
+
+void
+oc_spake_cache_w0_L(const char *pw, size_t len_salt, const uint8_t *salt,
+                    int it, const mbedtls_mpi *w0, const mbedtls_ecp_point *L)
+{
+  uint8_t key[32];
+  if (w0_L_cache_key(pw, len_salt, salt, it, key) != 0) {
+    return;
+  }
+
+  w0_L_cache_entry_t *entry = w0_L_cache_find(key);
+  if (entry == NULL) {
+    // replace the least recently used entry
+    entry = &w0_L_cache[0];
+    for (size_t i = 1; i < OC_SPAKE_W0_L_CACHE_SIZE; i++) {
+      if (w0_L_cache[i].last_used < entry->last_used) {
+        entry = &w0_L_cache[i];
+      }
+    }
+  }
+  if (copy_w0_L(&entry->w0, &entry->L, w0, L) != 0) {
+    mbedtls_mpi_free(&entry->w0);
+    mbedtls_ecp_point_free(&entry->L);
+    entry->last_used = 0;
+    return;
+  }
+  memcpy(entry->key, key, sizeof(entry->key));
+  entry->last_used = ++w0_L_cache_clock;
+}
+
 int
 oc_spake_get_w0_L(const char *pw, size_t len_salt, const uint8_t *salt, int it,
                   mbedtls_mpi *w0, mbedtls_ecp_point *L)
 {
   int ret;
-  if (oc_spake_get_parameters(NULL, NULL, NULL, w0, L) == 0)
+  if (oc_spake_lookup_w0_L(pw, len_salt, salt, it, w0, L) == 0)
     return 0;
 
-  ret = oc_spake_calc_w0_L(password, len_salt, salt, it, w0, L);
+  ret = oc_spake_calc_w0_L(pw, len_salt, salt, it, w0, L);
 
   if (ret != 0) {
     OC_ERR("oc_spake_calc_w0_L failed with code %d", ret);
+    return ret;
   }
-  return ret;
+  oc_spake_cache_w0_L(pw, len_salt, salt, it, w0, L);
+  return 0;
 }
 
 // encode value as zero-padded little endian bytes
@@ -349,21 +508,28 @@ cleanup:
   return ret;
 }
 
-int
-oc_spake_calc_w0_L(const char *pw, size_t len_salt, const uint8_t *salt, int it,
-                   mbedtls_mpi *w0, mbedtls_ecp_point *L)
+static int
+calc_w0_L(const char *pw, size_t len_salt, const uint8_t *salt, int it,
+          mbedtls_mpi *w0, mbedtls_ecp_point *L, mbedtls_ctr_drbg_context *rng)
 {
   int ret;
   mbedtls_mpi w1;
   mbedtls_mpi_init(&w1);
   MBEDTLS_MPI_CHK(oc_spake_calc_w0_w1(pw, len_salt, salt, it, w0, &w1));
-  MBEDTLS_MPI_CHK(mbedtls_ecp_mul(&grp, L, &w1, &grp.G, mbedtls_ctr_drbg_random,
-                                  ctr_drbg_ctx));
+  MBEDTLS_MPI_CHK(
+    mbedtls_ecp_mul(&grp, L, &w1, &grp.G, mbedtls_ctr_drbg_random, rng));
 cleanup:
   mbedtls_mpi_free(&w1);
   return ret;
 }
 
+int
+oc_spake_calc_w0_L(const char *pw, size_t len_salt, const uint8_t *salt, int it,
+                   mbedtls_mpi *w0, mbedtls_ecp_point *L)
+{
+  return calc_w0_L(pw, len_salt, salt, it, w0, L, ctr_drbg_ctx);
+}
+
 int
 oc_spake_gen_keypair(mbedtls_mpi *y, mbedtls_ecp_point *pub_y)
 {
@@ -425,7 +591,7 @@ oc_spake_calc_shareV(mbedtls_ecp_point *shareV, const mbedtls_ecp_point *pubB,
 static int
 calculate_JfKgL(mbedtls_ecp_point *J, const mbedtls_mpi *f,
                 const mbedtls_ecp_point *K, const mbedtls_mpi *g,
-                const mbedtls_ecp_point *L)
+                const mbedtls_ecp_point *L, mbedtls_ctr_drbg_context *rng)
 {
   int ret;
   mbedtls_mpi negative_g, zero, one;
@@ -447,8 +613,8 @@ calculate_JfKgL(mbedtls_ecp_point *J, const mbedtls_mpi *f,
     mbedtls_ecp_muladd(&grp, &K_minus_g_L, &one, K, &negative_g, L));
 
   // J = f * (K_minus_g_L)
-  MBEDTLS_MPI_CHK(mbedtls_ecp_mul(&grp, J, f, &K_minus_g_L,
-                                  mbedtls_ctr_drbg_random, ctr_drbg_ctx));
+  MBEDTLS_MPI_CHK(
+    mbedtls_ecp_mul(&grp, J, f, &K_minus_g_L, mbedtls_ctr_drbg_random, rng));
 
 cleanup:
   mbedtls_mpi_free(&negative_g);
@@ -463,7 +629,8 @@ cleanup:
 // V = h*w1*(Y - w0*N)
 static int
 calculate_ZV_N(mbedtls_ecp_point *Z, const mbedtls_mpi *x,
-               const mbedtls_ecp_point *Y, const mbedtls_mpi *w0)
+               const mbedtls_ecp_point *Y, const mbedtls_mpi *w0,
+               mbedtls_ctr_drbg_context *rng)
 {
   int ret;
 
@@ -474,7 +641,7 @@ calculate_ZV_N(mbedtls_ecp_point *Z, const mbedtls_mpi *x,
     mbedtls_ecp_point_read_binary(&grp, &N, bytes_N, sizeof(bytes_N)));
 
   // For the secp256r1 curve, h is 1, so we don't need to do anything
-  MBEDTLS_MPI_CHK(calculate_JfKgL(Z, x, Y, w0, &N));
+  MBEDTLS_MPI_CHK(calculate_JfKgL(Z, x, Y, w0, &N, rng));
 
 cleanup:
   mbedtls_ecp_point_free(&N);
@@ -483,7 +650,8 @@ cleanup:
 // Z = h*y*(X - w0*M)
 static int
 calculate_Z_M(mbedtls_ecp_point *Z, const mbedtls_mpi *x,
-              const mbedtls_ecp_point *Y, const mbedtls_mpi *w0)
+              const mbedtls_ecp_point *Y, const mbedtls_mpi *w0,
+              mbedtls_ctr_drbg_context *rng)
 {
   int ret;
 
@@ -494,18 +662,19 @@ calculate_Z_M(mbedtls_ecp_point *Z, const mbedtls_mpi *x,
     mbedtls_ecp_point_read_binary(&grp, &M, bytes_M, sizeof(bytes_M)));
 
   // For the secp256r1 curve, h is 1, so we don't need to do anything
-  MBEDTLS_MPI_CHK(calculate_JfKgL(Z, x, Y, w0, &M));
+  MBEDTLS_MPI_CHK(calculate_JfKgL(Z, x, Y, w0, &M, rng));
 
 cleanup:
   mbedtls_ecp_point_free(&M);
   return ret;
 }
 
-int
-calc_transcript_responder(spake_data_t *spake_data,
-                          const uint8_t shareP_enc[kPubKeySize],
-                          mbedtls_ecp_point *shareV, char *idProver,
-                          char *idVerifier, char *context)
+static int
+transcript_responder(spake_data_t *spake_data,
+                     const uint8_t shareP_enc[kPubKeySize],
+                     mbedtls_ecp_point *shareV, char *idProver,
+                     char *idVerifier, char *context,
+                     mbedtls_ctr_drbg_context *rng)
 {
   int ret = 0;
   mbedtls_ecp_point Z, V, shareP;
@@ -521,11 +690,12 @@ calc_transcript_responder(spake_data_t *spake_data,
   MBEDTLS_MPI_CHK(mbedtls_ecp_is_zero(&shareP));
 
   // Z = h*y*(X - w0*M)
-  MBEDTLS_MPI_CHK(calculate_Z_M(&Z, &spake_data->y, &shareP, &spake_data->w0));
+  MBEDTLS_MPI_CHK(
+    calculate_Z_M(&Z, &spake_data->y, &shareP, &spake_data->w0, rng));
 
   // V = h*y*L, where L = w1*P
   MBEDTLS_MPI_CHK(mbedtls_ecp_mul(&grp, &V, &spake_data->y, &spake_data->L,
-                                  mbedtls_ctr_drbg_random, ctr_drbg_ctx));
+                                  mbedtls_ctr_drbg_random, rng));
 
   // calculate transcript
   ttlen += encode_string(context, ttbuf + ttlen);
@@ -564,6 +734,16 @@ cleanup:
   return ret;
 }
 
+int
+calc_transcript_responder(spake_data_t *spake_data,
+                          const uint8_t shareP_enc[kPubKeySize],
+                          mbedtls_ecp_point *shareV, char *idProver,
+                          char *idVerifier, char *context)
+{
+  return transcript_responder(spake_data, shareP_enc, shareV, idProver,
+                              idVerifier, context, ctr_drbg_ctx);
+}
+
 int
 oc_spake_calc_transcript_responder(spake_data_t *spake_data,
                                    const uint8_t shareP_enc[kPubKeySize],
@@ -574,6 +754,36 @@ oc_spake_calc_transcript_responder(spake_data_t *spake_data,
                                    SPAKE_CONTEXT);
 }
 
+int
+oc_spake_calc_responder_share(spake_data_t *spake_data, const char *pw,
+                              size_t len_salt, const uint8_t *salt, int it,
+                              bool have_w0_L, uint8_t pA[kPubKeySize],
+                              uint8_t pB[kPubKeySize], uint8_t cB[32],
+                              mbedtls_ctr_drbg_context *rng)
+{
+  int ret;
+  mbedtls_ecp_point shareV;
+  mbedtls_ecp_point_init(&shareV);
+
+  if (!have_w0_L) {
+    MBEDTLS_MPI_CHK(
+      calc_w0_L(pw, len_salt, salt, it, &spake_data->w0, &spake_data->L, rng));
+  }
+  MBEDTLS_MPI_CHK(mbedtls_ecp_gen_keypair(&grp, &spake_data->y,
+                                          &spake_data->pub_y,
+                                          mbedtls_ctr_drbg_random, rng));
+  MBEDTLS_MPI_CHK(
+    oc_spake_calc_shareV(&shareV, &spake_data->pub_y, &spake_data->w0));
+  MBEDTLS_MPI_CHK(oc_spake_encode_pubkey(&shareV, pB));
+  MBEDTLS_MPI_CHK(transcript_responder(spake_data, pA, &shareV, "", "",
+                                       SPAKE_CONTEXT, rng));
+  MBEDTLS_MPI_CHK(oc_spake_calc_confirmV(spake_data->K_main, cB, pA));
+
+cleanup:
+  mbedtls_ecp_point_free(&shareV);
+  return ret;
+}
+
 int
 calc_transcript_initiator(mbedtls_mpi *w0, mbedtls_mpi *w1, mbedtls_mpi *x,
                           mbedtls_ecp_point *shareP,
@@ -593,10 +803,10 @@ calc_transcript_initiator(mbedtls_mpi *w0, mbedtls_mpi *w1, mbedtls_mpi *x,
   mbedtls_ecp_point_read_binary(&grp, &Y, shareV_enc, kPubKeySize);
 
   // Z = h*x*(Y - w0*N)
-  MBEDTLS_MPI_CHK(calculate_ZV_N(&Z, x, &Y, w0));
+  MBEDTLS_MPI_CHK(calculate_ZV_N(&Z, x, &Y, w0, ctr_drbg_ctx));
 
   // V = h*w1*(Y - w0*N)
-  MBEDTLS_MPI_CHK(calculate_ZV_N(&V, w1, &Y, w0));
+  MBEDTLS_MPI_CHK(calculate_ZV_N(&V, w1, &Y, w0, ctr_drbg_ctx));
 
   // calculate transcript
   ttlen += encode_string(context, ttbuf + ttlen);
@@ -22,6 +22,7 @@
 #define OC_SPAKE2PLUS_H
 
 #include "mbedtls/bignum.h"
+#include "mbedtls/ctr_drbg.h"
 #include "mbedtls/ecp.h"
 #include "oc_helpers.h"
 #include "oscore_constants.h"
@@ -133,6 +134,65 @@ int oc_spake_get_pbkdf_params(uint8_t rnd[32], uint8_t salt[32], int *it);
 int oc_spake_get_w0_L(const char *pw, size_t len_salt, const uint8_t *salt,
                       int it, mbedtls_mpi *w0, mbedtls_ecp_point *L);
 
+/**
+ * @brief look up previously calculated W0 and L values
+ *
+ * Returns the pre-loaded parameters when salt & it match them, otherwise the
+ * values cached for (pw, salt, it). Must be called from the event loop.
+ *
+ * @param pw the null-terminated password
+ * @param len_salt the length of the salt
+ * @param salt the salt
+ * @param it the number of iterations used within PBKDF2
+ * @param w0 the w0 parameter, must be initialized by the caller
+ * @param L the L parameter, must be initialized by the caller
+ * @return int 0 when found, 1 when not cached
+ */
+int oc_spake_lookup_w0_L(const char *pw, size_t len_salt, const uint8_t *salt,
+                         int it, mbedtls_mpi *w0, mbedtls_ecp_point *L);
+
+/**
+ * @brief store calculated W0 and L values in the cache
+ *
+ * The least recently used entry is replaced when the cache is full. The cache
+ * is cleared when the password changes. Must be called from the event loop.
+ *
+ * @param pw the null-terminated password
+ * @param len_salt the length of the salt
+ * @param salt the salt
+ * @param it the number of iterations used within PBKDF2
+ * @param w0 the w0 parameter
+ * @param L the L parameter
+ */
+void oc_spake_cache_w0_L(const char *pw, size_t len_salt, const uint8_t *salt,
+                         int it, const mbedtls_mpi *w0,
+                         const mbedtls_ecp_point *L);
+
+/**
+ * @brief calculate the responder (verifier) part of the handshake
+ *
+ * Calculates w0 & L (unless already present), the ephemeral key pair, pB,
+ * the transcript and cB in one go. Only uses the given random generator and
+ * the read-only curve parameters, so it can be run on a crypto worker thread.
+ *
+ * @param spake_data the SPAKE2+ state, w0 & L are used as is when have_w0_L
+ * @param pw the null-terminated password
+ * @param len_salt the length of the salt
+ * @param salt the salt
+ * @param it the number of iterations used within PBKDF2
+ * @param have_w0_L true when w0 & L in spake_data are already calculated
+ * @param pA the encoded share of the initiator
+ * @param pB the encoded share of the responder (output)
+ * @param cB the confirmation of the responder (output)
+ * @param rng the random generator to use
+ * @return int 0 on success, mbedtls error code on failure
+ */
+int oc_spake_calc_responder_share(spake_data_t *spake_data, const char *pw,
+                                  size_t len_salt, const uint8_t *salt, int it,
+                                  bool have_w0_L, uint8_t pA[kPubKeySize],
+                                  uint8_t pB[kPubKeySize], uint8_t cB[32],
+                                  mbedtls_ctr_drbg_context *rng);
+
 /**
  * @brief Get the currently set Spake2+ password
  *
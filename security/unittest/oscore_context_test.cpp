@@ -0,0 +1,234 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#if defined(OC_OSCORE)
+
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <cstring>
+
+#include "api/oc_knx_sec.h"
+#include "oc_api.h"
+#include "security/oc_oscore_context.h"
+
+#ifndef OC_MAX_OSCORE_CONTEXTS
+#define OC_MAX_OSCORE_CONTEXTS (20)
+#endif
+
+static const char master_secret[OSCORE_KEY_LEN] = {
+  0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+  0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10
+};
+static const char other_secret[OSCORE_KEY_LEN] = {
+  0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+  0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20
+};
+static const char id_context[6] = { 'c', 't', 'x', '0', '0', '1' };
+
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Cascoda", NULL, NULL);
+  ret |= oc_add_device("my_name", "1.0.0", "//", "000001", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+class TestOscoreContext : public testing::Test {
+protected:
+  void SetUp() override
+  {
+    static oc_handler_t handler = {};
+    handler.init = app_init;
+    handler.signal_event_loop = signal_event_loop;
+    ASSERT_EQ(0, oc_main_init(&handler));
+    oc_oscore_free_all_contexts();
+  }
+
+  void TearDown() override
+  {
+    oc_at_delete_entry(0, 0);
+    oc_oscore_free_all_contexts();
+    oc_main_shutdown();
+  }
+
+  // a recipient context, as made for a received request
+  static oc_oscore_context_t *add_recipient(uint8_t n)
+  {
+    char rid[2] = { 'r', (char)n };
+    return oc_oscore_add_context(0, NULL, 0, rid, sizeof(rid), 0, "desc",
+                                 master_secret, sizeof(master_secret), NULL, 0,
+                                 NULL, 0, -1, false);
+  }
+
+  static oc_oscore_context_t *find_recipient(uint8_t n)
+  {
+    uint8_t rid[2] = { 'r', n };
+    return oc_oscore_find_context_by_kid(NULL, 0, rid, sizeof(rid));
+  }
+
+  // auth/at entry 0, with osc_id "id1" and the given master secret
+  static void set_at_entry(const char *ms)
+  {
+    oc_auth_at_t entry;
+    memset(&entry, 0, sizeof(entry));
+    oc_new_string(&entry.id, "at1", 3);
+    oc_new_string(&entry.sub, "", 0);
+    oc_new_string(&entry.kid, "", 0);
+    entry.scope = OC_IF_SEC;
+    entry.profile = OC_PROFILE_COAP_OSCORE;
+    oc_new_byte_string(&entry.osc_ms, ms, OSCORE_KEY_LEN);
+    oc_new_byte_string(&entry.osc_contextid, id_context, sizeof(id_context));
+    oc_new_byte_string(&entry.osc_rid, "", 0);
+    oc_new_byte_string(&entry.osc_id, "id1", 3);
+    oc_core_set_at_table(0, 0, entry, false);
+    oc_free_string(&entry.id);
+    oc_free_string(&entry.sub);
+    oc_free_string(&entry.kid);
+    oc_free_string(&entry.osc_ms);
+    oc_free_string(&entry.osc_contextid);
+    oc_free_string(&entry.osc_rid);
+    oc_free_string(&entry.osc_id);
+  }
+
+  // the recipient context for a request from osc_id "id1", as made by the
+  // OSCORE engine
+  static oc_oscore_context_t *add_at_recipient(const char *ms)
+  {
+    return oc_oscore_add_context(0, "", 0, "id1", 3, 0, "desc", ms,
+                                 OSCORE_KEY_LEN, "", 0, id_context,
+                                 sizeof(id_context), 0, false);
+  }
+
+  static oc_oscore_context_t *find_at_recipient(void)
+  {
+    uint8_t kid[3] = { 'i', 'd', '1' };
+    return oc_oscore_find_context_by_kid(NULL, 0, kid, sizeof(kid));
+  }
+
+  static oc_oscore_context_t *find_at_sender(void)
+  {
+    char id[3] = { 'i', 'd', '1' };
+    return oc_oscore_find_context_by_oscore_id(0, id, sizeof(id));
+  }
+};
+
+TEST_F(TestOscoreContext, LruPromotion)
+{
+  for (int i = 0; i < OC_MAX_OSCORE_CONTEXTS; i++) {
+    ASSERT_NE(nullptr, add_recipient((uint8_t)i));
+  }
+  // a lookup makes the first context the most recently used one
+  ASSERT_NE(nullptr, find_recipient(0));
+
+  // so the full cache frees the second one
+  ASSERT_NE(nullptr, add_recipient(OC_MAX_OSCORE_CONTEXTS));
+  EXPECT_NE(nullptr, find_recipient(0));
+  EXPECT_EQ(nullptr, find_recipient(1));
+  EXPECT_NE(nullptr, find_recipient(2));
+  EXPECT_NE(nullptr, find_recipient(OC_MAX_OSCORE_CONTEXTS));
+}
+
+TEST_F(TestOscoreContext, EvictsRecipientContextsOnly)
+{
+  char sid[2] = { 's', '1' };
+  ASSERT_NE(nullptr,
+            oc_oscore_add_context(0, sid, sizeof(sid), NULL, 0, 0, "desc",
+                                  master_secret, sizeof(master_secret), NULL,
+                                  0, NULL, 0, -1, false));
+  for (int i = 1; i < OC_MAX_OSCORE_CONTEXTS; i++) {
+    ASSERT_NE(nullptr, add_recipient((uint8_t)i));
+  }
+
+  // the sender context is older, but can not be made again
+  ASSERT_NE(nullptr, add_recipient(OC_MAX_OSCORE_CONTEXTS));
+  EXPECT_NE(nullptr, oc_oscore_find_context_by_oscore_id(0, sid, sizeof(sid)));
+  EXPECT_EQ(nullptr, find_recipient(1));
+  EXPECT_NE(nullptr, find_recipient(2));
+
+  // freeing explicitly takes the least recently used one as well
+  oc_oscore_free_lru_recipient_context();
+  EXPECT_EQ(nullptr, find_recipient(2));
+  EXPECT_NE(nullptr, find_recipient(3));
+}
+
+TEST_F(TestOscoreContext, DerivedKeysReused)
+{
+  set_at_entry(master_secret);
+  oc_at_derived_keys_t *keys = oc_core_get_at_derived_keys(0, 0);
+  ASSERT_NE(nullptr, keys);
+  // derived when the sender context of the entry was made
+  ASSERT_TRUE(keys->valid);
+  oc_oscore_context_t *sender = find_at_sender();
+  ASSERT_NE(nullptr, sender);
+  EXPECT_EQ(0, memcmp(sender->sendkey, keys->id_key, OSCORE_KEY_LEN));
+
+  // the recipient context takes the keys of the entry, which are the ones
+  // that HKDF gives
+  oc_oscore_context_t *recipient = add_at_recipient(master_secret);
+  ASSERT_NE(nullptr, recipient);
+  uint8_t key[OSCORE_KEY_LEN];
+  ASSERT_EQ(0, oc_oscore_context_derive_param(
+                 (const uint8_t *)"id1", 3, (uint8_t *)id_context,
+                 sizeof(id_context), "Key", (uint8_t *)master_secret,
+                 sizeof(master_secret), NULL, 0, key, OSCORE_KEY_LEN));
+  EXPECT_EQ(0, memcmp(recipient->recvkey, key, OSCORE_KEY_LEN));
+  EXPECT_EQ(0, memcmp(recipient->commoniv, sender->commoniv,
+                      OSCORE_COMMON_IV_LEN));
+}
+
+TEST_F(TestOscoreContext, RekeyInvalidatesDerivedKeys)
+{
+  set_at_entry(master_secret);
+  ASSERT_NE(nullptr, add_at_recipient(master_secret));
+  oc_at_derived_keys_t *keys = oc_core_get_at_derived_keys(0, 0);
+  ASSERT_TRUE(keys->valid);
+  uint8_t old_key[OSCORE_KEY_LEN];
+  memcpy(old_key, keys->id_key, OSCORE_KEY_LEN);
+
+  // a new master secret drops the recipient context and the old keys
+  set_at_entry(other_secret);
+  EXPECT_EQ(nullptr, find_at_recipient());
+  ASSERT_TRUE(keys->valid);
+  EXPECT_NE(0, memcmp(old_key, keys->id_key, OSCORE_KEY_LEN));
+  oc_oscore_context_t *sender = find_at_sender();
+  ASSERT_NE(nullptr, sender);
+  EXPECT_EQ(0, memcmp(sender->sendkey, keys->id_key, OSCORE_KEY_LEN));
+
+  oc_oscore_context_t *recipient = add_at_recipient(other_secret);
+  ASSERT_NE(nullptr, recipient);
+  EXPECT_EQ(0, memcmp(recipient->recvkey, keys->id_key, OSCORE_KEY_LEN));
+}
+
+TEST_F(TestOscoreContext, FreeInvalidatesDerivedKeys)
+{
+  set_at_entry(master_secret);
+  ASSERT_NE(nullptr, add_at_recipient(master_secret));
+  oc_at_derived_keys_t *keys = oc_core_get_at_derived_keys(0, 0);
+  ASSERT_TRUE(keys->valid);
+
+  // deleting the entry frees its contexts and its keys
+  oc_at_delete_entry(0, 0);
+  EXPECT_FALSE(keys->valid);
+  EXPECT_EQ(nullptr, find_at_recipient());
+  EXPECT_EQ(nullptr, find_at_sender());
+}
+
+#endif /* OC_OSCORE */
@@ -8,6 +8,11 @@
 
 #include "port/oc_random.h"
 
+#include <chrono>
+#include <thread>
+
+#include "api/oc_crypto_worker.h"
+
 extern "C" {
 #include "security/oc_spake2plus.h"
 
@@ -306,3 +311,191 @@ TEST_F(Spake2Plus, CalculateConfirmationB)
   EXPECT_TRUE(memcmp(HMAC_K_confirmV_shareP, calculated_confirmV,
                      sizeof(HMAC_K_confirmV_shareP)) == 0);
 }
+
+#ifndef OC_SPAKE_W0_L_CACHE_SIZE
+#define OC_SPAKE_W0_L_CACHE_SIZE (2)
+#endif /* OC_SPAKE_W0_L_CACHE_SIZE */
+
+#if OC_SPAKE_W0_L_CACHE_SIZE < 2
+#error "the w0 & L cache tests need at least 2 entries"
+#endif
+
+static char cache_pw[] = "LETTUCE";
+static uint8_t cache_salt[32] = { 0x5a };
+
+// the cache key only depends on pw, salt & it, use it to get distinct entries
+static int
+cache_lookup(int it, mbedtls_mpi *w0, mbedtls_ecp_point *L)
+{
+  return oc_spake_lookup_w0_L(cache_pw, sizeof(cache_salt), cache_salt, it,
+                              w0, L);
+}
+
+TEST_F(Spake2Plus, W0LCacheMissAndHit)
+{
+  mbedtls_mpi w0, w0_cached;
+  mbedtls_ecp_point L, L_cached;
+  mbedtls_mpi_init(&w0);
+  mbedtls_mpi_init(&w0_cached);
+  mbedtls_ecp_point_init(&L);
+  mbedtls_ecp_point_init(&L_cached);
+
+  ASSERT_RET(mbedtls_mpi_read_binary(&w0, bytes_w0, sizeof(bytes_w0)));
+  ASSERT_RET(mbedtls_ecp_point_read_binary(&grp, &L, bytes_L, sizeof(bytes_L)));
+
+  EXPECT_EQ(1, cache_lookup(1000, &w0_cached, &L_cached));
+  oc_spake_cache_w0_L(cache_pw, sizeof(cache_salt), cache_salt, 1000, &w0, &L);
+  ASSERT_RET(cache_lookup(1000, &w0_cached, &L_cached));
+  EXPECT_EQ(0, mbedtls_mpi_cmp_mpi(&w0, &w0_cached));
+  EXPECT_EQ(0, mbedtls_ecp_point_cmp(&L, &L_cached));
+
+  // other iterations, salt or password miss
+  EXPECT_EQ(1, cache_lookup(1001, &w0_cached, &L_cached));
+  uint8_t other_salt[32] = { 0xa5 };
+  EXPECT_EQ(1, oc_spake_lookup_w0_L(cache_pw, sizeof(other_salt), other_salt,
+                                    1000, &w0_cached, &L_cached));
+  EXPECT_EQ(1, oc_spake_lookup_w0_L("LETTUCF", sizeof(cache_salt), cache_salt,
+                                    1000, &w0_cached, &L_cached));
+
+  // a new password clears the cache
+  char new_pw[] = "LETTUCE";
+  oc_spake_set_password(new_pw);
+  EXPECT_EQ(1, cache_lookup(1000, &w0_cached, &L_cached));
+
+  mbedtls_mpi_free(&w0);
+  mbedtls_mpi_free(&w0_cached);
+  mbedtls_ecp_point_free(&L);
+  mbedtls_ecp_point_free(&L_cached);
+}
+
+TEST_F(Spake2Plus, W0LCacheEviction)
+{
+  mbedtls_mpi w0, w0_cached;
+  mbedtls_ecp_point L, L_cached;
+  mbedtls_mpi_init(&w0);
+  mbedtls_mpi_init(&w0_cached);
+  mbedtls_ecp_point_init(&L);
+  mbedtls_ecp_point_init(&L_cached);
+
+  ASSERT_RET(mbedtls_mpi_read_binary(&w0, bytes_w0, sizeof(bytes_w0)));
+  ASSERT_RET(mbedtls_ecp_point_read_binary(&grp, &L, bytes_L, sizeof(bytes_L)));
+
+  // fill the cache, then use the oldest entry again
+  for (int i = 0; i < OC_SPAKE_W0_L_CACHE_SIZE; i++) {
+    oc_spake_cache_w0_L(cache_pw, sizeof(cache_salt), cache_salt, 1000 + i,
+                        &w0, &L);
+  }
+  for (int i = 0; i < OC_SPAKE_W0_L_CACHE_SIZE; i++) {
+    EXPECT_RET(cache_lookup(1000 + i, &w0_cached, &L_cached));
+  }
+  ASSERT_RET(cache_lookup(1000, &w0_cached, &L_cached));
+
+  // the least recently used entry (the second one) is replaced
+  oc_spake_cache_w0_L(cache_pw, sizeof(cache_salt), cache_salt, 2000, &w0,
+                      &L);
+  EXPECT_RET(cache_lookup(2000, &w0_cached, &L_cached));
+  EXPECT_RET(cache_lookup(1000, &w0_cached, &L_cached));
+  EXPECT_EQ(1, cache_lookup(1001, &w0_cached, &L_cached));
+  for (int i = 2; i < OC_SPAKE_W0_L_CACHE_SIZE; i++) {
+    EXPECT_RET(cache_lookup(1000 + i, &w0_cached, &L_cached));
+  }
+
+  mbedtls_mpi_free(&w0);
+  mbedtls_mpi_free(&w0_cached);
+  mbedtls_ecp_point_free(&L);
+  mbedtls_ecp_point_free(&L_cached);
+}
+
+typedef struct
+{
+  oc_crypto_job_t job;
+  spake_data_t data;
+  uint8_t pB[kPubKeySize];
+  uint8_t cB[32];
+  int ret;
+  bool done;
+} share_job_t;
+
+static void
+share_job_init(share_job_t *job)
+{
+  memset(job, 0, sizeof(*job));
+  mbedtls_mpi_init(&job->data.w0);
+  mbedtls_ecp_point_init(&job->data.L);
+  mbedtls_mpi_init(&job->data.y);
+  mbedtls_ecp_point_init(&job->data.pub_y);
+}
+
+static void
+share_job_free(share_job_t *job)
+{
+  mbedtls_mpi_free(&job->data.w0);
+  mbedtls_ecp_point_free(&job->data.L);
+  mbedtls_mpi_free(&job->data.y);
+  mbedtls_ecp_point_free(&job->data.pub_y);
+}
+
+static void
+share_job_work(oc_crypto_job_t *job)
+{
+  share_job_t *share = (share_job_t *)job;
+  share->ret = oc_spake_calc_responder_share(
+    &share->data, cache_pw, sizeof(cache_salt), cache_salt, 1000, false,
+    bytes_shareP, share->pB, share->cB, job->rng);
+}
+
+static void
+share_job_complete(oc_crypto_job_t *job)
+{
+  ((share_job_t *)job)->done = true;
+}
+
+TEST_F(Spake2Plus, CryptoWorkerMatchesSynchronous)
+{
+  share_job_t sync_job, worker_job;
+  share_job_init(&sync_job);
+  share_job_init(&worker_job);
+
+  // without the worker process the job is run to completion by the caller
+  ASSERT_TRUE(oc_crypto_worker_submit(&sync_job.job, share_job_work,
+                                      share_job_complete));
+  ASSERT_TRUE(sync_job.done);
+  ASSERT_RET(sync_job.ret);
+
+#ifdef OC_CRYPTO_WORKER
+  oc_process_init();
+  oc_process_start(&oc_crypto_worker_events, NULL);
+  ASSERT_TRUE(oc_crypto_worker_submit(&worker_job.job, share_job_work,
+                                      share_job_complete));
+  for (int i = 0; i < 10000 && !worker_job.done; i++) {
+    oc_process_run();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  oc_crypto_worker_shutdown();
+  oc_process_exit(&oc_crypto_worker_events);
+#else  /* !OC_CRYPTO_WORKER */
+  ASSERT_TRUE(oc_crypto_worker_submit(&worker_job.job, share_job_work,
+                                      share_job_complete));
+#endif /* !OC_CRYPTO_WORKER */
+  ASSERT_TRUE(worker_job.done);
+  ASSERT_RET(worker_job.ret);
+
+  // w0 & L are deterministic, the shares use different random y
+  EXPECT_EQ(0, mbedtls_mpi_cmp_mpi(&sync_job.data.w0, &worker_job.data.w0));
+  EXPECT_EQ(0, mbedtls_ecp_point_cmp(&sync_job.data.L, &worker_job.data.L));
+  EXPECT_NE(0, memcmp(sync_job.pB, worker_job.pB, sizeof(sync_job.pB)));
+
+  mbedtls_mpi w0;
+  mbedtls_ecp_point L;
+  mbedtls_mpi_init(&w0);
+  mbedtls_ecp_point_init(&L);
+  ASSERT_RET(oc_spake_calc_w0_L(cache_pw, sizeof(cache_salt), cache_salt, 1000,
+                                &w0, &L));
+  EXPECT_EQ(0, mbedtls_mpi_cmp_mpi(&w0, &worker_job.data.w0));
+  EXPECT_EQ(0, mbedtls_ecp_point_cmp(&L, &worker_job.data.L));
+  mbedtls_mpi_free(&w0);
+  mbedtls_ecp_point_free(&L);
+
+  share_job_free(&sync_job);
+  share_job_free(&worker_job);
+}
@@ -0,0 +1,96 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/**
+  @brief minimal set of atomic operations on 32 bit unsigned integers
+  @file
+
+  Used for the lock-free data structures that are shared between the network
+  thread(s) and the event loop.
+  Loads have acquire semantics, stores have release semantics.
+*/
+#ifndef OC_ATOMIC_H
+#define OC_ATOMIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#define OC_ATOMIC_LOAD32(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define OC_ATOMIC_STORE32(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define OC_ATOMIC_INCREMENT32(x) __atomic_add_fetch(&(x), 1, __ATOMIC_ACQ_REL)
+/* on failure, expected is updated with the current value */
+#define OC_ATOMIC_COMPARE_AND_SWAP32(x, expected, desired)                     \
+  __atomic_compare_exchange_n(&(x), &(expected), (desired), false,             \
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+
+static inline bool
+oc_atomic_compare_and_swap32(volatile uint32_t *x, uint32_t *expected,
+                             uint32_t desired)
+{
+  uint32_t prev = (uint32_t)_InterlockedCompareExchange(
+    (volatile long *)x, (long)desired, (long)*expected);
+  if (prev == *expected) {
+    return true;
+  }
+  *expected = prev;
+  return false;
+}
+
+#define OC_ATOMIC_LOAD32(x)                                                    \
+  ((uint32_t)_InterlockedOr((volatile long *)&(x), 0))
+#define OC_ATOMIC_STORE32(x, v)                                                \
+  ((void)_InterlockedExchange((volatile long *)&(x), (long)(v)))
+#define OC_ATOMIC_INCREMENT32(x)                                               \
+  ((uint32_t)_InterlockedIncrement((volatile long *)&(x)))
+#define OC_ATOMIC_COMPARE_AND_SWAP32(x, expected, desired)                     \
+  oc_atomic_compare_and_swap32(&(x), &(expected), (desired))
+
+#else /* single threaded platforms */
+
+static inline bool
+oc_atomic_compare_and_swap32(volatile uint32_t *x, uint32_t *expected,
+                             uint32_t desired)
+{
+  if (*x == *expected) {
+    *x = desired;
+    return true;
+  }
+  *expected = *x;
+  return false;
+}
+
+#define OC_ATOMIC_LOAD32(x) (x)
+#define OC_ATOMIC_STORE32(x, v) ((x) = (v))
+#define OC_ATOMIC_INCREMENT32(x) (++(x))
+#define OC_ATOMIC_COMPARE_AND_SWAP32(x, expected, desired)                     \
+  oc_atomic_compare_and_swap32(&(x), &(expected), (desired))
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OC_ATOMIC_H */
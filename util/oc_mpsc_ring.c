@@ -0,0 +1,71 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "oc_mpsc_ring.h"
+#include "oc_atomic.h"
+#include <stddef.h>
+
+bool
+oc_mpsc_ring_push(oc_mpsc_ring_t *ring, void *item)
+{
+  oc_mpsc_ring_slot_t *slot;
+  uint32_t pos = OC_ATOMIC_LOAD32(ring->enqueue_pos);
+  for (;;) {
+    uint32_t index = pos & ring->mask;
+    slot = &ring->slots[index];
+    int32_t diff = (int32_t)(OC_ATOMIC_LOAD32(slot->seq) + index - pos);
+    if (diff == 0) {
+      /* slot is free, claim it. on failure pos holds the current position */
+      if (OC_ATOMIC_COMPARE_AND_SWAP32(ring->enqueue_pos, pos, pos + 1)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* the consumer did not release this slot yet: the ring is full */
+      return false;
+    } else {
+      /* another producer claimed the slot */
+      pos = OC_ATOMIC_LOAD32(ring->enqueue_pos);
+    }
+  }
+  slot->item = item;
+  OC_ATOMIC_STORE32(slot->seq, pos + 1 - (pos & ring->mask));
+  return true;
+}
+
+void *
+oc_mpsc_ring_pop(oc_mpsc_ring_t *ring)
+{
+  uint32_t pos = ring->dequeue_pos;
+  uint32_t index = pos & ring->mask;
+  oc_mpsc_ring_slot_t *slot = &ring->slots[index];
+  int32_t diff = (int32_t)(OC_ATOMIC_LOAD32(slot->seq) + index - (pos + 1));
+  if (diff < 0) {
+    /* empty, or the producer of this slot did not publish it yet */
+    return NULL;
+  }
+  void *item = slot->item;
+  slot->item = NULL;
+  /* hand the slot back to the producers for the next lap */
+  OC_ATOMIC_STORE32(slot->seq, pos + ring->mask + 1 - index);
+  ring->dequeue_pos = pos + 1;
+  return item;
+}
+
+uint32_t
+oc_mpsc_ring_size(oc_mpsc_ring_t *ring)
+{
+  return OC_ATOMIC_LOAD32(ring->enqueue_pos) - ring->dequeue_pos;
+}
@@ -0,0 +1,102 @@
+/*
+// Copyright (c) 2023 Cascoda Ltd
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/**
+  @brief bounded lock-free multi producer, single consumer ring
+  @file
+
+  Any number of threads can push, one thread pops. The ring holds pointers,
+  the number of slots is a power of 2. A ring is declared statically with
+  OC_MPSC_RING() and is ready for use without initialization.
+*/
+#ifndef OC_MPSC_RING_H
+#define OC_MPSC_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief a slot of the ring
+ *
+ * The sequence number of a slot tells who owns it: the slot at position pos
+ * can be written when seq == pos and read when seq == pos + 1. The sequence
+ * number is stored relative to the slot index, so that the zero initialized
+ * slot is free for the first lap.
+ */
+typedef struct oc_mpsc_ring_slot_t
+{
+  uint32_t seq; /**< sequence number */
+  void *item;   /**< the queued item */
+} oc_mpsc_ring_slot_t;
+
+/**
+ * @brief the ring
+ */
+typedef struct oc_mpsc_ring_t
+{
+  oc_mpsc_ring_slot_t *slots; /**< the slots */
+  uint32_t mask;              /**< number of slots - 1 */
+  uint32_t enqueue_pos;       /**< next position to push to */
+  uint32_t dequeue_pos;       /**< next position to pop, consumer only */
+} oc_mpsc_ring_t;
+
+/**
+ * @brief declare a ring
+ *
+ * @param name the name of the ring (an oc_mpsc_ring_t)
+ * @param size the number of slots, a power of 2
+ */
+#define OC_MPSC_RING(name, size)                                               \
+  static oc_mpsc_ring_slot_t name##_slots[(size)];                             \
+  static oc_mpsc_ring_t name = { name##_slots, (uint32_t)(size)-1, 0, 0 }
+
+/**
+ * @brief queue an item, may be called from any thread
+ *
+ * @param ring the ring
+ * @param item the item, not NULL
+ * @return true the item is queued
+ * @return false the ring is full
+ */
+bool oc_mpsc_ring_push(oc_mpsc_ring_t *ring, void *item);
+
+/**
+ * @brief take the oldest item, only to be called from the consumer thread
+ *
+ * Items pushed by the same thread are popped in the order of pushing.
+ *
+ * @param ring the ring
+ * @return void* the item, NULL when the ring is empty (or the oldest item is
+ * still being written)
+ */
+void *oc_mpsc_ring_pop(oc_mpsc_ring_t *ring);
+
+/**
+ * @brief number of queued items, only to be called from the consumer thread
+ *
+ * @param ring the ring
+ * @return uint32_t the number of items (including the ones being written)
+ */
+uint32_t oc_mpsc_ring_size(oc_mpsc_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OC_MPSC_RING_H */